@@ -63,6 +63,7 @@ LOCAL_CPPFLAGS += \
 endif
 
 LOCAL_SRC_FILES := \
+        compositor/compositionregion.cpp \
         compositor/compositor.cpp \
         compositor/compositorthread.cpp \
         compositor/factory.cpp \
@@ -80,13 +81,26 @@ LOCAL_SRC_FILES := \
 	core/nesteddisplay.cpp \
         display/displayplanemanager.cpp \
 	display/displayplanestate.cpp \
+	display/clonepresentationhandler.cpp \
+	display/layerstackdiff.cpp \
+	display/modifiernegotiator.cpp \
+	display/placementhistory.cpp \
+	display/planeassignment.cpp \
+	display/planetestcache.cpp \
+	display/presenttrace.cpp \
+	display/scalercapabilities.cpp \
+	display/surfacepool.cpp \
         display/displayqueue.cpp \
         display/vblankeventhandler.cpp \
         display/virtualdisplay.cpp \
+        utils/allocationtracker.cpp \
+        utils/damageregion.cpp \
         utils/fdhandler.cpp \
+        utils/frametimingtracker.cpp \
         utils/hwcevent.cpp \
         utils/hwcthread.cpp \
         utils/hwcutils.cpp \
+        utils/rectbatch.cpp \
         utils/disjoint_layers.cpp
 
 ifeq ($(strip $(TARGET_USES_HWC2)), false)
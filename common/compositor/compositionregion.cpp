@@ -0,0 +1,245 @@
+/*
+// Copyright (c) 2018 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+
+#include "compositionregion.h"
+
+#include <algorithm>
+
+#include "disjoint_layers.h"
+#include "hwctrace.h"
+#include "hwcutils.h"
+
+namespace hwcomposer {
+
+// Rather separate everything again once this share of layers moved.
+static const size_t kMaxDirtyLayerRatio = 4;
+
+// Below code is taken from drm_hwcomposer adopted to our needs.
+// layer_rects holds frames of dedicated layers followed by those of
+// source layers.
+static void SeparateRects(const std::vector<size_t> &dedicated_layers,
+                          const std::vector<size_t> &source_layers,
+                          const std::vector<HwcRect<int>> &layer_rects,
+                          std::vector<CompositionRegion> &comp_regions) {
+  // Index at which the actual layers begin
+  size_t layer_offset = dedicated_layers.size();
+  std::vector<RectSet<int>> separate_regions;
+  get_draw_regions(layer_rects, &separate_regions);
+  comp_regions.reserve(comp_regions.size() + separate_regions.size());
+  for (RectSet<int> &region : separate_regions) {
+    // If a rect intersects one of the dedicated layers, we need to remove the
+    // layers from the composition region which appear *below* the dedicated
+    // layer. This effectively punches a hole through the composition layer such
+    // that the dedicated layer can be placed below the composition and not
+    // be occluded.
+    for (RectIDs::TId i = region.id_set.next(0); i < layer_offset;
+         i = region.id_set.next(i + 1)) {
+      for (size_t j = 0; j < source_layers.size(); ++j) {
+        if (source_layers[j] < dedicated_layers[i])
+          region.id_set.subtract(j + layer_offset);
+      }
+    }
+
+    RectIDs::TId id = region.id_set.next(layer_offset);
+    if (id == RectIDs::npos)
+      continue;
+
+    comp_regions.emplace_back(CompositionRegion{region.rect, {}});
+    // Regions list source layers top most first.
+    std::vector<size_t> &layers = comp_regions.back().source_layers;
+    for (; id != RectIDs::npos; id = region.id_set.next(id + 1)) {
+      layers.emplace_back(source_layers[id - layer_offset]);
+    }
+
+    std::reverse(layers.begin(), layers.end());
+  }
+}
+
+void SeparateLayers(const std::vector<size_t> &dedicated_layers,
+                    const std::vector<size_t> &source_layers,
+                    const std::vector<HwcRect<int>> &display_frame,
+                    std::vector<CompositionRegion> &comp_regions) {
+  CTRACE();
+  // We add the dedicated layers first, followed by the lower layers. The
+  // rects that intersect with the dedicated layers will be inspected and
+  // only those which are to be composited above the layer will be
+  // included in the composition regions.
+  std::vector<HwcRect<int>> layer_rects;
+  layer_rects.reserve(dedicated_layers.size() + source_layers.size());
+  for (size_t layer_index : dedicated_layers)
+    layer_rects.emplace_back(display_frame[layer_index]);
+
+  for (size_t layer_index : source_layers)
+    layer_rects.emplace_back(display_frame[layer_index]);
+
+  SeparateRects(dedicated_layers, source_layers, layer_rects, comp_regions);
+}
+
+static bool IsEmpty(const HwcRect<int> &rect) {
+  return rect.left >= rect.right || rect.top >= rect.bottom;
+}
+
+bool CompositionRegionCache::Update(
+    const std::vector<size_t> &dedicated_layers,
+    const std::vector<size_t> &source_layers,
+    const std::vector<HwcRect<int>> &display_frame) {
+  CTRACE();
+  size_t layer_offset = dedicated_layers.size();
+  size_t total_layers = layer_offset + source_layers.size();
+  if (regions_.empty() || layers_.size() != total_layers ||
+      !std::equal(dedicated_layers.begin(), dedicated_layers.end(),
+                  layers_.begin()) ||
+      !std::equal(source_layers.begin(), source_layers.end(),
+                  layers_.begin() + layer_offset)) {
+    SeparateAll(dedicated_layers, source_layers, display_frame);
+    return true;
+  }
+
+  size_t dirty_layers = 0;
+  for (size_t i = 0; i < total_layers; i++) {
+    if (!(layer_rects_[i] == display_frame[layers_[i]]))
+      dirty_layers++;
+  }
+
+  updated_regions_ = 0;
+  if (!dirty_layers)
+    return false;
+
+  if (dirty_layers * kMaxDirtyLayerRatio > total_layers ||
+      regions_.size() > separated_regions_ * 2) {
+    SeparateAll(dedicated_layers, source_layers, display_frame);
+    return true;
+  }
+
+  // Apply one layer at a time, so that the dirty area stays around
+  // the layer instead of spanning all layers which moved.
+  for (size_t i = 0; i < total_layers; i++) {
+    HwcRect<int> &old_frame = layer_rects_[i];
+    const HwcRect<int> &frame = display_frame[layers_[i]];
+    if (old_frame == frame)
+      continue;
+
+    HwcRect<int> dirty = frame;
+    if (IsEmpty(frame)) {
+      dirty = old_frame;
+    } else if (!IsEmpty(old_frame)) {
+      dirty.left = std::min(frame.left, old_frame.left);
+      dirty.top = std::min(frame.top, old_frame.top);
+      dirty.right = std::max(frame.right, old_frame.right);
+      dirty.bottom = std::max(frame.bottom, old_frame.bottom);
+    }
+
+    old_frame = frame;
+    if (!IsEmpty(dirty))
+      SeparateDirty(dirty, layer_offset);
+  }
+
+  return true;
+}
+
+void CompositionRegionCache::Reset() {
+  std::vector<CompositionRegion>().swap(regions_);
+  std::vector<size_t>().swap(layers_);
+  std::vector<HwcRect<int>>().swap(layer_rects_);
+  std::vector<uint8_t>().swap(overlap_);
+  batch_.Clear();
+  separated_regions_ = 0;
+  updated_regions_ = 0;
+}
+
+void CompositionRegionCache::SeparateAll(
+    const std::vector<size_t> &dedicated_layers,
+    const std::vector<size_t> &source_layers,
+    const std::vector<HwcRect<int>> &display_frame) {
+  layers_.clear();
+  layers_.insert(layers_.end(), dedicated_layers.begin(),
+                 dedicated_layers.end());
+  layers_.insert(layers_.end(), source_layers.begin(), source_layers.end());
+  layer_rects_.clear();
+  for (size_t layer_index : layers_)
+    layer_rects_.emplace_back(display_frame[layer_index]);
+
+  regions_.clear();
+  SeparateRects(dedicated_layers, source_layers, layer_rects_, regions_);
+  separated_regions_ = regions_.size();
+  updated_regions_ = regions_.size();
+}
+
+void CompositionRegionCache::SeparateDirty(const HwcRect<int> &dirty,
+                                           size_t layer_offset) {
+  // Coverage outside of dirty didn't change, keep the parts of regions
+  // lying there.
+  size_t total_regions = regions_.size();
+  batch_.Clear();
+  for (const CompositionRegion &region : regions_)
+    batch_.Add(region.frame);
+
+  overlap_.resize(total_regions);
+  batch_.Classify(dirty, overlap_.data());
+  std::vector<CompositionRegion> regions;
+  regions.reserve(total_regions);
+  for (size_t i = 0; i < total_regions; i++) {
+    CompositionRegion &region = regions_[i];
+    const HwcRect<int> &frame = region.frame;
+    if (overlap_[i] == kOutside) {
+      regions.emplace_back(std::move(region));
+      continue;
+    }
+
+    int top = std::max(frame.top, dirty.top);
+    int bottom = std::min(frame.bottom, dirty.bottom);
+    if (frame.top < dirty.top)
+      regions.emplace_back(CompositionRegion{
+          HwcRect<int>(frame.left, frame.top, frame.right, dirty.top),
+          region.source_layers});
+
+    if (frame.bottom > dirty.bottom)
+      regions.emplace_back(CompositionRegion{
+          HwcRect<int>(frame.left, dirty.bottom, frame.right, frame.bottom),
+          region.source_layers});
+
+    if (frame.left < dirty.left)
+      regions.emplace_back(CompositionRegion{
+          HwcRect<int>(frame.left, top, dirty.left, bottom),
+          region.source_layers});
+
+    if (frame.right > dirty.right)
+      regions.emplace_back(CompositionRegion{
+          HwcRect<int>(dirty.right, top, frame.right, bottom),
+          region.source_layers});
+  }
+
+  // Separate layers again, clipped to dirty.
+  size_t total_layers = layer_rects_.size();
+  batch_.Reset(layer_rects_.data(), total_layers);
+  batch_.Clip(dirty);
+  std::vector<HwcRect<int>> layer_rects;
+  layer_rects.reserve(total_layers);
+  for (size_t i = 0; i < total_layers; i++)
+    layer_rects.emplace_back(batch_.Get(i));
+
+  size_t kept_regions = regions.size();
+  std::vector<size_t> dedicated_layers(layers_.begin(),
+                                       layers_.begin() + layer_offset);
+  std::vector<size_t> source_layers(layers_.begin() + layer_offset,
+                                    layers_.end());
+  SeparateRects(dedicated_layers, source_layers, layer_rects, regions);
+  updated_regions_ += regions.size() - kept_regions;
+  regions_.swap(regions);
+}
+
+}  // namespace hwcomposer
@@ -17,10 +17,14 @@
 #ifndef COMMON_COMPOSITOR_COMPOSITIONREGION_H_
 #define COMMON_COMPOSITOR_COMPOSITIONREGION_H_
 
+#include <stddef.h>
+
 #include <hwcdefs.h>
 
 #include <vector>
 
+#include "rectbatch.h"
+
 namespace hwcomposer {
 
 struct CompositionRegion {
@@ -28,5 +32,57 @@ struct CompositionRegion {
   std::vector<size_t> source_layers;
 };
 
+// Splits display frames of source_layers into disjoint regions, each
+// listing source layers covering it. Parts of source layers which are
+// below a dedicated layer are left out of regions the dedicated layer
+// covers, so that it isn't occluded by the composition.
+void SeparateLayers(const std::vector<size_t> &dedicated_layers,
+                    const std::vector<size_t> &source_layers,
+                    const std::vector<HwcRect<int>> &display_frame,
+                    std::vector<CompositionRegion> &comp_regions);
+
+// Composition regions of a plane along with the layer frames they were
+// separated from. When only a few layers move or resize, regions away
+// from their old and new frames are kept and only the area around them
+// is separated again.
+class CompositionRegionCache {
+ public:
+  // Brings regions up to date with display frames of layers. Returns
+  // false if the cached regions could be used as is.
+  bool Update(const std::vector<size_t> &dedicated_layers,
+              const std::vector<size_t> &source_layers,
+              const std::vector<HwcRect<int>> &display_frame);
+
+  const std::vector<CompositionRegion> &GetRegions() const {
+    return regions_;
+  }
+
+  // Number of regions separated again by the last Update.
+  size_t GetUpdatedRegionCount() const {
+    return updated_regions_;
+  }
+
+  void Reset();
+
+ private:
+  void SeparateAll(const std::vector<size_t> &dedicated_layers,
+                   const std::vector<size_t> &source_layers,
+                   const std::vector<HwcRect<int>> &display_frame);
+  void SeparateDirty(const HwcRect<int> &dirty, size_t layer_offset);
+
+  std::vector<CompositionRegion> regions_;
+  // Dedicated layers followed by source layers and their display
+  // frames, as regions were separated from.
+  std::vector<size_t> layers_;
+  std::vector<HwcRect<int>> layer_rects_;
+  // Regions after last full separation. Incremental updates split
+  // regions around the dirty area, this bounds the fragmentation.
+  size_t separated_regions_ = 0;
+  size_t updated_regions_ = 0;
+  // Scratch space for checking regions and layers against dirty.
+  RectBatch batch_;
+  std::vector<uint8_t> overlap_;
+};
+
 }  // namespace hwcomposer
 #endif  // COMMON_COMPOSITOR_COMPOSITIONREGION_H_
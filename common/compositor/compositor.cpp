@@ -19,8 +19,8 @@
 #include <xf86drmMode.h>
 
 #include <algorithm>
+#include <utility>
 
-#include "disjoint_layers.h"
 #include "displayplanestate.h"
 #include "hwctrace.h"
 #include "nativegpuresource.h"
@@ -83,12 +83,11 @@ bool Compositor::Draw(DisplayPlaneStateList &comp_planes,
       media_state.layer_ = &layer;
     } else if (plane.NeedsOffScreenComposition()) {
       comp = &plane;
-      std::vector<CompositionRegion> &comp_regions =
-          plane.GetCompositionRegion();
-      if (comp_regions.empty()) {
-        SeparateLayers(dedicated_layers, comp->GetSourceLayers(), display_frame,
-                       comp_regions);
-      }
+      CompositionRegionCache &region_cache = plane.GetCompositionRegion();
+      region_cache.Update(dedicated_layers, comp->GetSourceLayers(),
+                          display_frame);
+      const std::vector<CompositionRegion> &comp_regions =
+          region_cache.GetRegions();
 
       std::vector<size_t>().swap(dedicated_layers);
       if (comp_regions.empty())
@@ -177,17 +176,37 @@ bool Compositor::CalculateRenderState(
     const std::vector<CompositionRegion> &comp_regions, DrawState &draw_state) {
   CTRACE();
   size_t num_regions = comp_regions.size();
+  // Damage isn't tracked at reduced resolution, as scaled pixels
+  // would straddle damage rects. Such targets are cheap to redraw.
+  float scale = draw_state.surface_->GetCompositionScale();
+  bool clear_surface = draw_state.surface_->ClearSurface() || scale != 1.0f;
+  // Sampling parameters of layers are computed once they are needed.
+  layer_sampling_.assign(layers.size(), RenderState::LayerSampling());
+  size_t first_state = draw_state.states_.size();
   for (size_t region_index = 0; region_index < num_regions; region_index++) {
     const CompositionRegion &region = comp_regions.at(region_index);
     RenderState state;
-    state.ConstructState(layers, region,
+    state.ConstructState(layers, layer_sampling_, region,
                          draw_state.surface_->GetSurfaceDamage(),
-                         draw_state.surface_->ClearSurface());
+                         clear_surface);
     if (state.layer_state_.empty()) {
       continue;
     }
 
-    draw_state.states_.emplace(draw_state.states_.begin(), state);
+    // Regions are in display coordinates, target may only
+    // cover part of the display.
+    int origin_x = draw_state.surface_->GetOriginX();
+    int origin_y = draw_state.surface_->GetOriginY();
+    if (origin_x || origin_y) {
+      state.x_ -= origin_x;
+      state.y_ -= origin_y;
+      state.scissor_.Offset(-origin_x, -origin_y);
+    }
+
+    if (scale != 1.0f)
+      state.Scale(scale);
+
+    draw_state.states_.emplace_back(std::move(state));
     const std::vector<size_t> &source = region.source_layers;
     for (size_t texture_index : source) {
       OverlayLayer &layer = layers.at(texture_index);
@@ -198,6 +217,10 @@ bool Compositor::CalculateRenderState(
     }
   }
 
+  // States are drawn in reverse order of regions.
+  std::reverse(draw_state.states_.begin() + first_state,
+               draw_state.states_.end());
+
   return true;
 }
 
@@ -219,87 +242,4 @@ void Compositor::RestoreVideoDefaultColor(HWCColorControl color) {
   lock_.unlock();
 }
 
-// Below code is taken from drm_hwcomposer adopted to our needs.
-static std::vector<size_t> SetBitsToVector(
-    uint64_t in, const std::vector<size_t> &index_map) {
-  std::vector<size_t> out;
-  size_t msb = sizeof(in) * 8 - 1;
-  uint64_t mask = (uint64_t)1 << msb;
-  for (size_t i = msb; mask != (uint64_t)0; i--, mask >>= 1)
-    if (in & mask)
-      out.emplace_back(index_map[i]);
-  return out;
-}
-
-void Compositor::SeparateLayers(const std::vector<size_t> &dedicated_layers,
-                                const std::vector<size_t> &source_layers,
-                                const std::vector<HwcRect<int>> &display_frame,
-                                std::vector<CompositionRegion> &comp_regions) {
-  CTRACE();
-  if (source_layers.size() > 64) {
-    ETRACE("Failed to separate layers because there are more than 64");
-    return;
-  }
-
-  size_t num_exclude_rects = 0;
-  // Index at which the actual layers begin
-  size_t layer_offset = dedicated_layers.size();
-  if (source_layers.size() + layer_offset > 64) {
-    WTRACE(
-        "Exclusion rectangles are being truncated to make the rectangle count "
-        "fit into 64");
-    num_exclude_rects = 64 - source_layers.size() - dedicated_layers.size();
-  }
-
-  // We inject all the exclude rects into the rects list. Any resulting rect
-  // that includes ANY of the first num_exclude_rects is rejected. After the
-  // exclude rects, we add the lower layers. The rects that intersect with
-  // these layers will be inspected and only those which are to be composited
-  // above the layer will be included in the composition regions.
-  std::vector<HwcRect<int>> layer_rects(source_layers.size() + layer_offset);
-  std::transform(
-      dedicated_layers.begin(), dedicated_layers.end(),
-      layer_rects.begin() + num_exclude_rects,
-      [=](size_t layer_index) { return display_frame[layer_index]; });
-  std::transform(source_layers.begin(), source_layers.end(),
-                 layer_rects.begin() + layer_offset, [=](size_t layer_index) {
-    return display_frame[layer_index];
-  });
-
-  std::vector<RectSet<int>> separate_regions;
-  get_draw_regions(layer_rects, &separate_regions);
-  uint64_t exclude_mask = ((uint64_t)1 << num_exclude_rects) - 1;
-  uint64_t dedicated_mask = (((uint64_t)1 << dedicated_layers.size()) - 1)
-                            << num_exclude_rects;
-
-  for (RectSet<int> &region : separate_regions) {
-    if (region.id_set.getBits() & exclude_mask)
-      continue;
-
-    // If a rect intersects one of the dedicated layers, we need to remove the
-    // layers from the composition region which appear *below* the dedicated
-    // layer. This effectively punches a hole through the composition layer such
-    // that the dedicated layer can be placed below the composition and not
-    // be occluded.
-    uint64_t dedicated_intersect = region.id_set.getBits() & dedicated_mask;
-    for (size_t i = 0; dedicated_intersect && i < dedicated_layers.size();
-         ++i) {
-      // Only exclude layers if they intersect this particular dedicated layer
-      if (!(dedicated_intersect & (1 << (i + num_exclude_rects))))
-        continue;
-
-      for (size_t j = 0; j < source_layers.size(); ++j) {
-        if (source_layers[j] < dedicated_layers[i])
-          region.id_set.subtract(j + layer_offset);
-      }
-    }
-    if (!(region.id_set.getBits() >> layer_offset))
-      continue;
-
-    comp_regions.emplace_back(CompositionRegion{
-        region.rect, SetBitsToVector(region.id_set.getBits() >> layer_offset,
-                                     source_layers)});
-  }
-}
-
 }  // namespace hwcomposer
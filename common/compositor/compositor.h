@@ -64,14 +64,11 @@ class Compositor {
   bool CalculateRenderState(std::vector<OverlayLayer> &layers,
                             const std::vector<CompositionRegion> &comp_regions,
                             DrawState &state);
-  void SeparateLayers(const std::vector<size_t> &dedicated_layers,
-                      const std::vector<size_t> &source_layers,
-                      const std::vector<HwcRect<int>> &display_frame,
-                      std::vector<CompositionRegion> &comp_regions);
 
   std::unique_ptr<CompositorThread> thread_;
   SpinLock lock_;
   HWCColorMap colors_;
+  std::vector<RenderState::LayerSampling> layer_sampling_;
 };
 
 }  // namespace hwcomposer
@@ -84,10 +84,17 @@ bool CompositorThread::Draw(std::vector<DrawState> &states,
   tasks_lock_.lock();
 
   if (!states_.empty()) {
-    std::vector<OverlayBuffer *>().swap(buffers_);
-    buffers_.reserve(layers.size());
-    for (auto &layer : layers) {
-      buffers_.emplace_back(layer.GetBuffer());
+    // Only import layers some state samples from. Layers which are
+    // scanned out or hidden below opaque layers are left out.
+    buffers_.assign(layers.size(), nullptr);
+    for (const DrawState &draw_state : states_) {
+      for (const RenderState &render_state : draw_state.states_) {
+        for (const RenderState::LayerState &layer_state :
+             render_state.layer_state_) {
+          size_t index = layer_state.layer_index_;
+          buffers_.at(index) = layers.at(index).GetBuffer();
+        }
+      }
     }
 
     tasks_ |= kRender3D;
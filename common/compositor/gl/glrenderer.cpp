@@ -108,10 +108,12 @@ bool GLRenderer::Draw(const std::vector<RenderState> &render_states,
       continue;
 
     program->UseProgram(state, frame_width, frame_height);
-    glScissor(state.scissor_x_, state.scissor_y_, state.scissor_width_,
-              state.scissor_height_);
-
-    glDrawArrays(GL_TRIANGLES, 0, 3);
+    // Damage rects don't overlap, so every pixel is blended only once.
+    for (const HwcRect<int> &scissor : state.scissor_) {
+      glScissor(scissor.left, scissor.top, scissor.right - scissor.left,
+                scissor.bottom - scissor.top);
+      glDrawArrays(GL_TRIANGLES, 0, 3);
+    }
 
     for (unsigned src_index = 0; src_index < size; src_index++) {
       glActiveTexture(GL_TEXTURE0 + src_index);
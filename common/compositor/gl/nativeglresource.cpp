@@ -28,6 +28,11 @@ bool NativeGLResource::PrepareResources(
   layer_textures_.reserve(buffers.size());
   EGLDisplay egl_display = eglGetCurrentDisplay();
   for (auto& buffer : buffers) {
+    if (!buffer) {
+      layer_textures_.emplace_back(0);
+      continue;
+    }
+
     // Create EGLImage.
     const ResourceHandle& import_image =
         buffer->GetGpuResource(egl_display, true);
@@ -38,6 +38,8 @@ class NativeGpuResource {
 
   NativeGpuResource& operator=(NativeGpuResource&& rhs) = delete;
 
+  // Imports buffers, indexed by layer. Null entries are layers which
+  // aren't sampled this frame and get no resource.
   virtual bool PrepareResources(const std::vector<OverlayBuffer*>& buffers) = 0;
   virtual GpuResourceHandle GetResourceHandle(uint32_t layer_index) const = 0;
   virtual void ReleaseGPUResources(
@@ -21,6 +21,7 @@
 #include "hwctrace.h"
 #include "nativebufferhandler.h"
 #include "resourcemanager.h"
+#include "surfacepool.h"
 
 namespace hwcomposer {
 
@@ -42,9 +43,17 @@ NativeSurface::~NativeSurface() {
 }
 
 bool NativeSurface::Init(ResourceManager *resource_manager, uint32_t format,
-                         uint32_t usage) {
-  resource_manager->GetNativeBufferHandler()->CreateBuffer(
-      width_, height_, format, &native_handle_, usage);
+                         uint32_t usage,
+                         const std::vector<uint64_t> &modifiers) {
+  const NativeBufferHandler *handler =
+      resource_manager->GetNativeBufferHandler();
+  uint64_t modifier = 0;
+  if (modifiers.empty() ||
+      !handler->CreateBufferWithModifiers(width_, height_, format, modifiers,
+                                          &native_handle_, &modifier)) {
+    handler->CreateBuffer(width_, height_, format, &native_handle_, usage);
+  }
+
   if (!native_handle_) {
     ETRACE("NativeSurface: Failed to create buffer.");
     return false;
@@ -70,7 +79,12 @@ void NativeSurface::SetNativeFence(int32_t fd) {
 }
 
 void NativeSurface::SetInUse(bool inuse) {
+  if (in_use_ == inuse)
+    return;
+
   in_use_ = inuse;
+  if (pool_)
+    pool_->SurfaceInUseChanged(pool_slot_, inuse);
 }
 
 void NativeSurface::SetClearSurface(bool clear_surface) {
@@ -81,45 +95,54 @@ void NativeSurface::SetSurfaceAge(uint32_t value) {
   surface_age_ = value;
 }
 
-void NativeSurface::SetPlaneTarget(const DisplayPlaneState &plane,
-                                   uint32_t gpu_fd) {
-  const HwcRect<int> &display_rect = plane.GetDisplayFrame();
-  surface_damage_ = display_rect;
-  last_surface_damage_ = surface_damage_;
+void NativeSurface::SetPlaneTarget(const DisplayPlaneState &plane) {
+  ResetSurfaceDamage(plane.GetDisplayFrame());
   layer_.UsePlaneScalar(plane.IsUsingPlaneScalar());
-  in_use_ = true;
+  SetInUse(true);
   clear_surface_ = true;
   surface_age_ = 0;
-  if (layer_.GetBuffer()->GetFb() == 0) {
-    layer_.GetBuffer()->CreateFrameBuffer(gpu_fd);
-  }
 }
 
 void NativeSurface::ResetDisplayFrame(const HwcRect<int> &display_frame) {
-  surface_damage_ = display_frame;
-  last_surface_damage_ = surface_damage_;
+  ResetSurfaceDamage(display_frame);
   layer_.SetDisplayFrame(display_frame);
   clear_surface_ = true;
 }
 
+void NativeSurface::SetOrigin(int x, int y) {
+  origin_x_ = x;
+  origin_y_ = y;
+}
+
 void NativeSurface::ResetSourceCrop(const HwcRect<float> &source_crop) {
-  layer_.SetSourceCrop(source_crop);
+  HwcRect<float> crop = source_crop;
+  crop.left -= origin_x_;
+  crop.right -= origin_x_;
+  crop.top -= origin_y_;
+  crop.bottom -= origin_y_;
+  if (composition_scale_ != 1.0f) {
+    crop.left *= composition_scale_;
+    crop.right *= composition_scale_;
+    crop.top *= composition_scale_;
+    crop.bottom *= composition_scale_;
+  }
+
+  layer_.SetSourceCrop(crop);
 }
 
 void NativeSurface::UpdateSurfaceDamage(
-    const HwcRect<int> &currentsurface_damage,
-    const HwcRect<int> &last_surface_damage) {
-  surface_damage_.left =
-      std::min(last_surface_damage.left, currentsurface_damage.left);
-  surface_damage_.top =
-      std::min(last_surface_damage.top, currentsurface_damage.top);
-  surface_damage_.right =
-      std::max(last_surface_damage.right, currentsurface_damage.right);
-  surface_damage_.bottom =
-      std::max(last_surface_damage.bottom, currentsurface_damage.bottom);
+    const DamageRegion &currentsurface_damage,
+    const DamageRegion &last_surface_damage) {
+  surface_damage_ = currentsurface_damage;
+  surface_damage_.Union(last_surface_damage);
   last_surface_damage_ = currentsurface_damage;
 }
 
+void NativeSurface::ResetSurfaceDamage(const HwcRect<int> &damage) {
+  surface_damage_.Reset(damage);
+  last_surface_damage_ = surface_damage_;
+}
+
 void NativeSurface::InitializeLayer(HWCNativeHandle native_handle) {
   layer_.SetBlending(HWCBlending::kBlendingPremult);
   layer_.SetBuffer(native_handle, -1, resource_manager_, false);
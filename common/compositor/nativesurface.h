@@ -18,7 +18,9 @@
 #define COMMON_COMPOSITOR_NATIVESURFACE_H_
 
 #include <memory>
+#include <vector>
 
+#include "damageregion.h"
 #include "overlaylayer.h"
 #include "platformdefines.h"
 
@@ -26,6 +28,7 @@ namespace hwcomposer {
 
 class ResourceManager;
 class DisplayPlaneState;
+class SurfacePool;
 
 class NativeSurface {
  public:
@@ -36,7 +39,10 @@ class NativeSurface {
 
   virtual ~NativeSurface();
 
-  bool Init(ResourceManager* resource_manager, uint32_t format, uint32_t usage);
+  // Lays the surface out as per the first of modifiers the allocator
+  // can use, falling back to an implicit layout.
+  bool Init(ResourceManager* resource_manager, uint32_t format, uint32_t usage,
+            const std::vector<uint64_t>& modifiers);
 
   bool InitializeForOffScreenRendering(HWCNativeHandle native_handle,
                                        ResourceManager* resource_manager);
@@ -53,6 +59,30 @@ class NativeSurface {
     return height_;
   }
 
+  // Position of the top left corner of this surface on the display.
+  // Targets can cover just the part of the display their plane shows,
+  // layers are rendered and scanned out relative to this point.
+  void SetOrigin(int x, int y);
+
+  int GetOriginX() const {
+    return origin_x_;
+  }
+
+  int GetOriginY() const {
+    return origin_y_;
+  }
+
+  // Targets can be composed at a fraction of display resolution,
+  // the plane scaling them up on scanout. Needs to be set before
+  // ResetSourceCrop.
+  void SetCompositionScale(float scale) {
+    composition_scale_ = scale;
+  }
+
+  float GetCompositionScale() const {
+    return composition_scale_;
+  }
+
   OverlayLayer* GetLayer() {
     return &layer_;
   }
@@ -84,21 +114,28 @@ class NativeSurface {
     return clear_surface_;
   }
 
-  void SetPlaneTarget(const DisplayPlaneState& plane, uint32_t gpu_fd);
+  void SetPlaneTarget(const DisplayPlaneState& plane);
 
   // Resets DisplayFrame, SurfaceDamage to display_frame.
   void ResetDisplayFrame(const HwcRect<int>& display_frame);
 
-  // Resets Source Crop to source_crop..
+  // Resets Source Crop to source_crop, given in display
+  // coordinates.
   void ResetSourceCrop(const HwcRect<float>& source_crop);
 
-  void UpdateSurfaceDamage(const HwcRect<int>& currentsurface_damage,
-                           const HwcRect<int>& last_surface_damage);
+  // Sets damage of this surface to currentsurface_damage plus
+  // last_surface_damage, the part of the surface which changed
+  // since it was last rendered.
+  void UpdateSurfaceDamage(const DamageRegion& currentsurface_damage,
+                           const DamageRegion& last_surface_damage);
 
-  const HwcRect<int>& GetLastSurfaceDamage() const {
+  // Resets both damage and last damage of this surface to damage.
+  void ResetSurfaceDamage(const HwcRect<int>& damage);
+
+  const DamageRegion& GetLastSurfaceDamage() const {
     return last_surface_damage_;
   }
-  const HwcRect<int>& GetSurfaceDamage() const {
+  const DamageRegion& GetSurfaceDamage() const {
     return surface_damage_;
   }
 
@@ -107,6 +144,8 @@ class NativeSurface {
   ResourceManager* resource_manager_;
 
  private:
+  friend class SurfacePool;
+
   void InitializeLayer(HWCNativeHandle native_handle);
   HWCNativeHandle native_handle_;
   int width_;
@@ -114,8 +153,14 @@ class NativeSurface {
   bool in_use_;
   bool clear_surface_;
   uint32_t surface_age_;
-  HwcRect<int> surface_damage_;
-  HwcRect<int> last_surface_damage_;
+  int origin_x_ = 0;
+  int origin_y_ = 0;
+  float composition_scale_ = 1.0f;
+  DamageRegion surface_damage_;
+  DamageRegion last_surface_damage_;
+  // Pool owning this surface, told whenever it goes in or out of use.
+  SurfacePool* pool_ = NULL;
+  uint32_t pool_slot_ = 0;
 };
 
 }  // namespace hwcomposer
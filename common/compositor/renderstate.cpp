@@ -16,8 +16,11 @@
 
 #include "renderstate.h"
 
+#include <drm_fourcc.h>
 #include <hwcutils.h>
 
+#include <cmath>
+
 #include "compositionregion.h"
 #include "nativegpuresource.h"
 #include "overlaybuffer.h"
@@ -25,9 +28,116 @@
 
 namespace hwcomposer {
 
+// Formats which always sample with full alpha.
+static bool IsOpaqueFormat(uint32_t format) {
+  switch (format) {
+    case DRM_FORMAT_XRGB8888:
+    case DRM_FORMAT_XBGR8888:
+    case DRM_FORMAT_RGBX8888:
+    case DRM_FORMAT_BGRX8888:
+    case DRM_FORMAT_XRGB2101010:
+    case DRM_FORMAT_XBGR2101010:
+    case DRM_FORMAT_RGB888:
+    case DRM_FORMAT_BGR888:
+    case DRM_FORMAT_RGB565:
+    case DRM_FORMAT_BGR565:
+      return true;
+    case DRM_FORMAT_AYUV:
+      return false;
+    default:
+      break;
+  }
+
+  return IsSupportedMediaFormat(format);
+}
+
+void RenderState::LayerSampling::Initialize(const OverlayLayer &layer) {
+  swap_xy_ = false;
+  flip_xy_[0] = false;
+  flip_xy_[1] = false;
+  switch (layer.GetTransform()) {
+    case HWCTransform::kTransform180: {
+      swap_xy_ = false;
+      flip_xy_[0] = true;
+      flip_xy_[1] = true;
+      break;
+    }
+    case HWCTransform::kTransform270: {
+      swap_xy_ = true;
+      flip_xy_[0] = true;
+      flip_xy_[1] = false;
+      break;
+    }
+    case HWCTransform::kTransform90: {
+      swap_xy_ = true;
+      if (layer.GetTransform() & HWCTransform::kReflectX) {
+        flip_xy_[0] = true;
+        flip_xy_[1] = true;
+      } else if (layer.GetTransform() & HWCTransform::kReflectY) {
+        flip_xy_[0] = false;
+        flip_xy_[1] = false;
+      } else {
+        flip_xy_[0] = false;
+        flip_xy_[1] = true;
+      }
+      break;
+    }
+    default: {
+      if (layer.GetTransform() & HWCTransform::kReflectX)
+        flip_xy_[0] = true;
+      if (layer.GetTransform() & HWCTransform::kReflectY)
+        flip_xy_[1] = true;
+    }
+  }
+
+  if (swap_xy_)
+    std::copy_n(&TransformMatrices[4], 4, texture_matrix_);
+  else
+    std::copy_n(&TransformMatrices[0], 4, texture_matrix_);
+
+  if (layer.IsUsingPlaneScalar()) {
+    const HwcRect<float> &display_rect = layer.GetSourceCrop();
+    display_origin_[0] = display_rect.left;
+    display_origin_[1] = display_rect.top;
+    display_size_[0] = static_cast<float>(layer.GetSourceCropWidth());
+    display_size_[1] = static_cast<float>(layer.GetSourceCropHeight());
+  } else {
+    const HwcRect<int> &display_rect = layer.GetDisplayFrame();
+    display_origin_[0] = static_cast<float>(display_rect.left);
+    display_origin_[1] = static_cast<float>(display_rect.top);
+    display_size_[0] = static_cast<float>(layer.GetDisplayFrameWidth());
+    display_size_[1] = static_cast<float>(layer.GetDisplayFrameHeight());
+  }
+
+  float tex_width = static_cast<float>(layer.GetBuffer()->GetWidth());
+  float tex_height = static_cast<float>(layer.GetBuffer()->GetHeight());
+  const HwcRect<float> &source_crop = layer.GetSourceCrop();
+  crop_rect_[0] = source_crop.left / tex_width;
+  crop_rect_[1] = source_crop.top / tex_height;
+  crop_rect_[2] = source_crop.right / tex_width;
+  crop_rect_[3] = source_crop.bottom / tex_height;
+  crop_size_[0] = crop_rect_[2] - crop_rect_[0];
+  crop_size_[1] = crop_rect_[3] - crop_rect_[1];
+
+  if (layer.GetBlending() == HWCBlending::kBlendingNone) {
+    opaque_ = true;
+    alpha_ = premult_ = 1.0f;
+  } else {
+    alpha_ = layer.GetAlpha() / 255.0f;
+    premult_ =
+        (layer.GetBlending() == HWCBlending::kBlendingPremult) ? 1.0f : 0.0f;
+    // Blending a fully opaque source leaves nothing of what is below.
+    opaque_ = layer.GetAlpha() == 0xFF &&
+              IsOpaqueFormat(layer.GetBuffer()->GetFormat());
+  }
+
+  initialized_ = true;
+}
+
 void RenderState::ConstructState(std::vector<OverlayLayer> &layers,
+                                 std::vector<LayerSampling> &sampling,
                                  const CompositionRegion &region,
-                                 const HwcRect<int> &damage,
+                                 const DamageRegion &damage,
                                  bool clear_surface) {
   float bounds[4];
   std::copy_n(region.frame.bounds, 4, bounds);
@@ -36,135 +146,69 @@ void RenderState::ConstructState(std::vector<OverlayLayer> &layers,
   width_ = bounds[2] - bounds[0];
   height_ = bounds[3] - bounds[1];
   if (!clear_surface) {
-    // If viewport and layer doesn't interact we can avoid re-rendering
+    scissor_ = damage;
+    scissor_.Intersect(region.frame);
+    // If viewport and damage doesn't interact we can avoid re-rendering
     // this state.
-    if (AnalyseOverlap(region.frame, damage) == kOutside) {
+    if (scissor_.IsEmpty()) {
       return;
     }
-
-    uint32_t top = damage.top;
-    uint32_t left = damage.left;
-    uint32_t scissor_right = std::min(damage.right, (int)bounds[2]);
-    uint32_t scissor_bottom = std::min(damage.bottom, (int)bounds[3]);
-
-    scissor_x_ = std::max(x_, left);
-    scissor_y_ = std::max(y_, top);
-    scissor_width_ = scissor_right - scissor_x_;
-    scissor_height_ = scissor_bottom - scissor_y_;
   } else {
-    scissor_x_ = x_;
-    scissor_y_ = y_;
-    scissor_width_ = width_;
-    scissor_height_ = height_;
+    scissor_.Reset(region.frame);
   }
 
   const std::vector<size_t> &source = region.source_layers;
+  layer_state_.reserve(source.size());
   for (size_t texture_index : source) {
     OverlayLayer &layer = layers.at(texture_index);
     if (!clear_surface) {
       // If viewport and layer doesn't interact we can avoid re-rendering
       // this state.
-      const HwcRect<int> &layer_damage = layer.GetDisplayFrame();
-      if (AnalyseOverlap(layer_damage, damage) == kOutside) {
-	continue;
+      if (!scissor_.Intersects(layer.GetDisplayFrame())) {
+        continue;
       }
     }
 
+    LayerSampling &layer_sampling = sampling.at(texture_index);
+    if (!layer_sampling.initialized_)
+      layer_sampling.Initialize(layer);
+
     layer_state_.emplace_back();
     RenderState::LayerState &src = layer_state_.back();
     src.layer_index_ = texture_index;
-    bool swap_xy = false;
-    bool flip_xy[2] = {false, false};
-    switch (layer.GetTransform()) {
-      case HWCTransform::kTransform180: {
-        swap_xy = false;
-        flip_xy[0] = true;
-        flip_xy[1] = true;
-        break;
-      }
-      case HWCTransform::kTransform270: {
-        swap_xy = true;
-        flip_xy[0] = true;
-        flip_xy[1] = false;
-        break;
-      }
-      case HWCTransform::kTransform90: {
-        swap_xy = true;
-        if (layer.GetTransform() & HWCTransform::kReflectX) {
-          flip_xy[0] = true;
-          flip_xy[1] = true;
-        } else if (layer.GetTransform() & HWCTransform::kReflectY) {
-          flip_xy[0] = false;
-          flip_xy[1] = false;
-        } else {
-          flip_xy[0] = false;
-          flip_xy[1] = true;
-        }
-        break;
-      }
-      default: {
-        if (layer.GetTransform() & HWCTransform::kReflectX)
-          flip_xy[0] = true;
-        if (layer.GetTransform() & HWCTransform::kReflectY)
-          flip_xy[1] = true;
-      }
-    }
-
-    if (swap_xy)
-      std::copy_n(&TransformMatrices[4], 4, src.texture_matrix_);
-    else
-      std::copy_n(&TransformMatrices[0], 4, src.texture_matrix_);
-
-    HwcRect<float> display_rect;
-    float display_size[2];
-
-    if (layer.IsUsingPlaneScalar()) {
-      display_rect = layer.GetSourceCrop();
-      display_size[0] = static_cast<float>(layer.GetSourceCropWidth());
-      display_size[1] = static_cast<float>(layer.GetSourceCropHeight());
-    } else {
-      const HwcRect<int> &display_Rect = layer.GetDisplayFrame();
-      display_rect.left = static_cast<float>(display_Rect.left);
-      display_rect.right = static_cast<float>(display_Rect.right);
-      display_rect.top = static_cast<float>(display_Rect.top);
-      display_rect.bottom = static_cast<float>(display_Rect.bottom);
-      display_size[0] = static_cast<float>(layer.GetDisplayFrameWidth());
-      display_size[1] = static_cast<float>(layer.GetDisplayFrameHeight());
-    }
-
-    float tex_width = static_cast<float>(layer.GetBuffer()->GetWidth());
-    float tex_height = static_cast<float>(layer.GetBuffer()->GetHeight());
-    const HwcRect<float> &source_crop = layer.GetSourceCrop();
-
-    HwcRect<float> crop_rect(
-        source_crop.left / tex_width, source_crop.top / tex_height,
-        source_crop.right / tex_width, source_crop.bottom / tex_height);
-
-    float crop_size[2] = {crop_rect.bounds[2] - crop_rect.bounds[0],
-                          crop_rect.bounds[3] - crop_rect.bounds[1]};
-
+    std::copy_n(layer_sampling.texture_matrix_, 4, src.texture_matrix_);
+    bool swap_xy = layer_sampling.swap_xy_;
     for (int j = 0; j < 4; j++) {
       int b = j ^ (swap_xy ? 1 : 0);
       float bound_percent =
-          (bounds[b] - display_rect.bounds[b % 2]) / display_size[b % 2];
-      if (flip_xy[j % 2]) {
-        src.crop_bounds_[j] =
-            crop_rect.bounds[j % 2 + 2] - bound_percent * crop_size[j % 2];
+          (bounds[b] - layer_sampling.display_origin_[b % 2]) /
+          layer_sampling.display_size_[b % 2];
+      if (layer_sampling.flip_xy_[j % 2]) {
+        src.crop_bounds_[j] = layer_sampling.crop_rect_[j % 2 + 2] -
+                              bound_percent * layer_sampling.crop_size_[j % 2];
       } else {
-        src.crop_bounds_[j] =
-            crop_rect.bounds[j % 2] + bound_percent * crop_size[j % 2];
+        src.crop_bounds_[j] = layer_sampling.crop_rect_[j % 2] +
+                              bound_percent * layer_sampling.crop_size_[j % 2];
       }
     }
 
-    if (layer.GetBlending() == HWCBlending::kBlendingNone) {
-      src.alpha_ = src.premult_ = 1.0f;
+    src.alpha_ = layer_sampling.alpha_;
+    src.premult_ = layer_sampling.premult_;
+    if (layer_sampling.opaque_)
       break;
-    }
-
-    src.alpha_ = layer.GetAlpha() / 255.0f;
-    src.premult_ =
-        (layer.GetBlending() == HWCBlending::kBlendingPremult) ? 1.0f : 0.0f;
   }
 }
 
+void RenderState::Scale(float scale) {
+  int left = static_cast<int>(std::lround(x_ * scale));
+  int top = static_cast<int>(std::lround(y_ * scale));
+  int right = static_cast<int>(std::lround((x_ + width_) * scale));
+  int bottom = static_cast<int>(std::lround((y_ + height_) * scale));
+  x_ = left;
+  y_ = top;
+  width_ = right - left;
+  height_ = bottom - top;
+  scissor_.Reset(HwcRect<int>(left, top, right, bottom));
+}
+
 }  // namespace hwcomposer
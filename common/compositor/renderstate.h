@@ -23,6 +23,7 @@
 #include <stdint.h>
 
 #include "compositordefs.h"
+#include "damageregion.h"
 #include "hwcdefs.h"
 
 namespace hwcomposer {
@@ -43,18 +44,47 @@ struct RenderState {
     GpuResourceHandle handle_;
   };
 
+  // Sampling parameters of a layer. They are the same for every region
+  // the layer is drawn in, so they are computed once per frame and
+  // looked up by layer index.
+  struct LayerSampling {
+    void Initialize(const OverlayLayer &layer);
+
+    float texture_matrix_[4];
+    // Origin and size of the area the layer is drawn to.
+    float display_origin_[2];
+    float display_size_[2];
+    // Source crop normalized to texture size.
+    float crop_rect_[4];
+    float crop_size_[2];
+    float alpha_;
+    float premult_;
+    bool swap_xy_;
+    bool flip_xy_[2];
+    // Layer hides everything below it.
+    bool opaque_;
+    bool initialized_ = false;
+  };
+
+  // Initializes entries of sampling for layers of region on first use.
   void ConstructState(std::vector<OverlayLayer> &layers,
+                      std::vector<LayerSampling> &sampling,
                       const CompositionRegion &region,
-                      const HwcRect<int> &damage, bool clear_surface);
+                      const DamageRegion &damage, bool clear_surface);
+
+  // Maps a state constructed with clear_surface to a target composed
+  // at scale times display resolution. Edges are rounded to the
+  // nearest pixel, so that neighbouring states still meet without
+  // gaps or overlaps.
+  void Scale(float scale);
 
   uint32_t x_;
   uint32_t y_;
   uint32_t width_;
   uint32_t height_;
-  uint32_t scissor_x_;
-  uint32_t scissor_y_;
-  uint32_t scissor_width_;
-  uint32_t scissor_height_;
+  // Part of the region to be rendered. Renderers draw once
+  // per rect, scissored to it.
+  DamageRegion scissor_;
   std::vector<LayerState> layer_state_;
 };
 
@@ -32,6 +32,12 @@ bool NativeVKResource::PrepareResources(
   clear_range.layerCount = 1;
 
   for (auto& buffer : buffers) {
+    if (!buffer) {
+      struct vk_resource resource = {};
+      layer_textures_.emplace_back(resource);
+      continue;
+    }
+
     const struct vk_import& import = buffer->GetGpuResource(dev_, true);
     if (import.res != VK_SUCCESS) {
       ETRACE("Failed to make import image (%d)\n", import.res);
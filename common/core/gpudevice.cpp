@@ -53,6 +53,17 @@ bool GpuDevice::Initialize() {
   bool use_mosaic = false;
   bool use_cloned = false;
   bool rotate_display = false;
+  std::string present_trace;
+  bool set_parallel_clones = false;
+  bool parallel_clones = true;
+  bool set_plane_assignment = false;
+  HWCPlaneAssignment plane_assignment = kPlaneAssignmentGreedy;
+  bool set_offscreen_budget = false;
+  uint64_t offscreen_budget = 0;
+  bool share_offscreen_budget = false;
+  bool set_hysteresis = false;
+  uint32_t hysteresis_frames = 0;
+  uint32_t hysteresis_margin = 0;
   std::vector<uint32_t> logical_displays;
   std::vector<uint32_t> physical_displays;
   std::vector<uint32_t> display_rotation;
@@ -69,6 +80,12 @@ bool GpuDevice::Initialize() {
   std::string key_physical_display("PHYSICAL_DISPLAY");
   std::string key_physical_display_rotation("PHYSICAL_DISPLAY_ROTATION");
   std::string key_clone_display("CLONE_DISPLAY");
+  std::string key_present_trace("PRESENT_TRACE");
+  std::string key_parallel_clones("PARALLEL_CLONE_PRESENTATION");
+  std::string key_plane_assignment("PLANE_ASSIGNMENT");
+  std::string key_offscreen_budget("OFFSCREEN_TARGET_BUDGET_MB");
+  std::string key_share_offscreen_budget("SHARE_OFFSCREEN_TARGET_BUDGET");
+  std::string key_hysteresis("PLACEMENT_HYSTERESIS");
   std::vector<uint32_t> mosaic_duplicate_check;
   std::vector<uint32_t> clone_duplicate_check;
   std::vector<uint32_t> physical_duplicate_check;
@@ -107,6 +124,50 @@ bool GpuDevice::Initialize() {
           if (!value.compare(enable_str)) {
             rotate_display = true;
           }
+          // Got present trace file prefix.
+        } else if (!key.compare(key_present_trace)) {
+          present_trace = value;
+          // Got parallel clone presentation switch.
+        } else if (!key.compare(key_parallel_clones)) {
+          parallel_clones = !value.compare(enable_str);
+          set_parallel_clones = true;
+          // Got plane assignment strategy.
+        } else if (!key.compare(key_plane_assignment)) {
+          if (!value.compare("greedy")) {
+            plane_assignment = kPlaneAssignmentGreedy;
+            set_plane_assignment = true;
+          } else if (!value.compare("cost")) {
+            plane_assignment = kPlaneAssignmentCost;
+            set_plane_assignment = true;
+          } else if (!value.compare("bisect")) {
+            plane_assignment = kPlaneAssignmentBisect;
+            set_plane_assignment = true;
+          }
+          // Got offscreen target budget.
+        } else if (!key.compare(key_offscreen_budget)) {
+          if (value.find_first_not_of("0123456789") != std::string::npos)
+            continue;
+
+          offscreen_budget = atoi(value.c_str()) * 1024ull * 1024ull;
+          set_offscreen_budget = true;
+          // Got offscreen target budget sharing switch.
+        } else if (!key.compare(key_share_offscreen_budget)) {
+          share_offscreen_budget = !value.compare(enable_str);
+          // Got placement hysteresis frames and margin.
+        } else if (!key.compare(key_hysteresis)) {
+          std::string frames_str;
+          std::string margin_str;
+          std::istringstream i_value(value);
+          std::getline(i_value, frames_str, ':');
+          std::getline(i_value, margin_str, ':');
+          if (frames_str.empty() || margin_str.empty() ||
+              frames_str.find_first_not_of("0123456789") != std::string::npos ||
+              margin_str.find_first_not_of("0123456789") != std::string::npos)
+            continue;
+
+          hysteresis_frames = atoi(frames_str.c_str());
+          hysteresis_margin = atoi(margin_str.c_str());
+          set_hysteresis = true;
         } else if (!key.compare(key_logical_display)) {
           std::string physical_index_str;
           std::istringstream i_value(value);
@@ -322,6 +383,39 @@ bool GpuDevice::Initialize() {
     }
   }
 
+  if (!present_trace.empty()) {
+    for (size_t i = 0; i < size; i++) {
+      std::string file = present_trace + "." + std::to_string(i);
+      displays.at(i)->SetPresentTraceFile(file.c_str());
+    }
+  }
+
+  if (set_parallel_clones) {
+    for (size_t i = 0; i < size; i++) {
+      displays.at(i)->SetParallelClonePresentation(parallel_clones);
+    }
+  }
+
+  if (set_plane_assignment) {
+    for (size_t i = 0; i < size; i++) {
+      displays.at(i)->SetPlaneAssignment(plane_assignment);
+    }
+  }
+
+  if (set_offscreen_budget) {
+    for (size_t i = 0; i < size; i++) {
+      displays.at(i)->SetOffScreenTargetBudget(offscreen_budget,
+                                               share_offscreen_budget);
+    }
+  }
+
+  if (set_hysteresis) {
+    for (size_t i = 0; i < size; i++) {
+      displays.at(i)->SetPlacementHysteresis(hysteresis_frames,
+                                             hysteresis_margin);
+    }
+  }
+
   // Now, we should have all physical displays ordered as required.
   // Let's handle any Logical Display combinations or Mosaic.
   std::vector<NativeDisplay *> temp_displays;
@@ -16,12 +16,21 @@
 
 #include <hwclayer.h>
 
+#include <atomic>
 #include <cmath>
 
 #include <hwcutils.h>
 
 namespace hwcomposer {
 
+static const uint64_t kGeneratedLayerId = 1ULL << 63;
+static std::atomic<uint64_t> next_layer_id(0);
+
+HwcLayer::HwcLayer()
+    : layer_id_(kGeneratedLayerId |
+                next_layer_id.fetch_add(1, std::memory_order_relaxed)) {
+}
+
 HwcLayer::~HwcLayer() {
   if (release_fd_ > 0) {
     close(release_fd_);
@@ -101,12 +110,15 @@ void HwcLayer::SetSurfaceDamage(const HwcRegion& surface_damage) {
       state_ &= ~kLayerContentChanged;
       state_ &= ~kSurfaceDamageChanged;
       surface_damage_ = rect;
+      surface_damage_region_.clear();
       return;
     }
   } else if (rects == 0) {
     rect = display_frame_;
   }
 
+  surface_damage_region_.assign(surface_damage.begin(), surface_damage.end());
+
   if ((surface_damage_.left == rect.left) &&
       (surface_damage_.top == rect.top) &&
       (surface_damage_.right == rect.right) &&
@@ -177,7 +189,11 @@ void HwcLayer::SetAcquireFence(int32_t fd) {
 
 int32_t HwcLayer::GetAcquireFence() {
   int32_t old_fd = acquire_fence_;
-  acquire_fence_ = -1;
+  // Clones of a display read the layer concurrently once the
+  // fence has been taken, so don't write unless we need to.
+  if (old_fd != -1)
+    acquire_fence_ = -1;
+
   return old_fd;
 }
 
@@ -215,6 +231,10 @@ void HwcLayer::SetLayerZOrder(uint32_t order) {
   }
 }
 
+void HwcLayer::SetLayerId(uint64_t id) {
+  layer_id_ = id;
+}
+
 void HwcLayer::SetLeftConstraint(int32_t left_constraint) {
   left_constraint_.emplace_back(left_constraint);
 }
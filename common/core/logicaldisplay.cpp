@@ -129,6 +129,11 @@ bool LogicalDisplay::CheckPlaneFormat(uint32_t format) {
   return physical_display_->CheckPlaneFormat(format);
 }
 
+uint32_t LogicalDisplay::GetFrameTimings(HwcFrameTiming *timings,
+                                         uint32_t max_frames) {
+  return physical_display_->GetFrameTimings(timings, max_frames);
+}
+
 void LogicalDisplay::SetGamma(float red, float green, float blue) {
   physical_display_->SetGamma(red, green, blue);
 }
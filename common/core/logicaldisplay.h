@@ -80,6 +80,9 @@ class LogicalDisplay : public NativeDisplay {
                      float *end) override;
   void RestoreVideoDefaultColor(HWCColorControl color) override;
 
+  uint32_t GetFrameTimings(HwcFrameTiming *timings,
+                           uint32_t max_frames) override;
+
   bool IsConnected() const override;
 
   void UpdateScalingRatio(uint32_t primary_width, uint32_t primary_height,
@@ -16,12 +16,15 @@
 
 #include "mosaicdisplay.h"
 
+#include <stdint.h>
+
 #include <string>
 #include <sstream>
 
 #include <hwclayer.h>
 
 #include "hwctrace.h"
+#include "rectbatch.h"
 
 namespace hwcomposer {
 
@@ -185,6 +188,11 @@ bool MosaicDisplay::Present(std::vector<HwcLayer *> &source_layers,
   uint32_t size = connected_displays_.size();
   int32_t left_constraint = 0;
   size_t total_layers = source_layers.size();
+  RectBatch frames;
+  for (HwcLayer *layer : source_layers)
+    frames.Add(layer->GetDisplayFrame());
+
+  std::vector<uint8_t> overlap(total_layers);
   for (uint32_t i = 0; i < size; i++) {
     NativeDisplay *display = connected_displays_.at(i);
     int32_t right_constraint = left_constraint + display->Width();
@@ -196,11 +204,13 @@ bool MosaicDisplay::Present(std::vector<HwcLayer *> &source_layers,
     IMOSAICDISPLAYTRACE("drconstraint %d \n", drconstraint);
     IMOSAICDISPLAYTRACE("right_constraint %d \n", right_constraint);
     IMOSAICDISPLAYTRACE("left_constraint %d \n", left_constraint);
+    // Layers touching the display edge still belong to it.
+    frames.Classify(HwcRect<int>(left_constraint - 1, INT32_MIN,
+                                 right_constraint + 1, INT32_MAX),
+                    overlap.data());
     for (size_t i = 0; i < total_layers; i++) {
       HwcLayer *layer = source_layers.at(i);
-      const HwcRect<int> &frame_Rect = layer->GetDisplayFrame();
-      if ((frame_Rect.right < left_constraint) ||
-          (frame_Rect.left > right_constraint)) {
+      if (overlap[i] == kOutside) {
         continue;
       }
 
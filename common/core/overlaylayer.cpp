@@ -27,41 +27,80 @@
 
 namespace hwcomposer {
 
+static HwcRect<int> MapDamageRect(const HwcRect<int>& rect,
+                                  const HwcRect<int>& display_frame,
+                                  const HwcRect<float>& source_crop,
+                                  float scale_x, float scale_y) {
+  return HwcRect<int>(
+      display_frame.left +
+          static_cast<int>(floorf((rect.left - source_crop.left) * scale_x)),
+      display_frame.top +
+          static_cast<int>(floorf((rect.top - source_crop.top) * scale_y)),
+      display_frame.left +
+          static_cast<int>(ceilf((rect.right - source_crop.left) * scale_x)),
+      display_frame.top +
+          static_cast<int>(ceilf((rect.bottom - source_crop.top) * scale_y)));
+}
+
 OverlayLayer::ImportedBuffer::~ImportedBuffer() {
   if (acquire_fence_ > 0) {
     close(acquire_fence_);
   }
 }
 
-OverlayLayer::ImportedBuffer::ImportedBuffer(
-    std::shared_ptr<OverlayBuffer>& buffer, int32_t acquire_fence)
-    : acquire_fence_(acquire_fence) {
+OverlayLayer::ImportedBuffer::ImportedBuffer(ImportedBuffer&& rhs)
+    : buffer_(std::move(rhs.buffer_)), acquire_fence_(rhs.acquire_fence_) {
+  rhs.acquire_fence_ = -1;
+}
+
+OverlayLayer::ImportedBuffer& OverlayLayer::ImportedBuffer::operator=(
+    ImportedBuffer&& rhs) {
+  if (this == &rhs)
+    return *this;
+
+  if (acquire_fence_ > 0) {
+    close(acquire_fence_);
+  }
+
+  buffer_ = std::move(rhs.buffer_);
+  acquire_fence_ = rhs.acquire_fence_;
+  rhs.acquire_fence_ = -1;
+  return *this;
+}
+
+void OverlayLayer::ImportedBuffer::Reset(std::shared_ptr<OverlayBuffer>& buffer,
+                                         int32_t acquire_fence) {
+  if (acquire_fence_ > 0) {
+    close(acquire_fence_);
+  }
+
   buffer_ = buffer;
+  acquire_fence_ = acquire_fence;
 }
 
 void OverlayLayer::SetAcquireFence(int32_t acquire_fence) {
   // Release any existing fence.
-  if (imported_buffer_->acquire_fence_ > 0) {
-    close(imported_buffer_->acquire_fence_);
+  if (imported_buffer_.acquire_fence_ > 0) {
+    close(imported_buffer_.acquire_fence_);
   }
 
-  imported_buffer_->acquire_fence_ = acquire_fence;
+  imported_buffer_.acquire_fence_ = acquire_fence;
 }
 
 int32_t OverlayLayer::GetAcquireFence() const {
-  return imported_buffer_->acquire_fence_;
+  return imported_buffer_.acquire_fence_;
 }
 
 int32_t OverlayLayer::ReleaseAcquireFence() const {
-  int32_t fence = imported_buffer_->acquire_fence_;
-  imported_buffer_->acquire_fence_ = -1;
+  int32_t fence = imported_buffer_.acquire_fence_;
+  imported_buffer_.acquire_fence_ = -1;
   return fence;
 }
 
 OverlayBuffer* OverlayLayer::GetBuffer() const {
-  if (imported_buffer_->buffer_.get() == NULL)
+  if (imported_buffer_.buffer_.get() == NULL)
     ETRACE("hwc layer get NullBuffer");
-  return imported_buffer_->buffer_.get();
+  return imported_buffer_.buffer_.get();
 }
 
 void OverlayLayer::SetBuffer(HWCNativeHandle handle, int32_t acquire_fence,
@@ -80,7 +119,7 @@ void OverlayLayer::SetBuffer(HWCNativeHandle handle, int32_t acquire_fence,
       resource_manager->RegisterBuffer(GETNATIVEBUFFER(handle), buffer);
     }
   }
-  imported_buffer_.reset(new ImportedBuffer(buffer, acquire_fence));
+  imported_buffer_.Reset(buffer, acquire_fence);
   if (!register_buffer) {
     ValidateForOverlayUsage();
   }
@@ -102,7 +141,7 @@ void OverlayLayer::SetDisplayFrame(const HwcRect<int>& display_frame) {
   display_frame_width_ = display_frame.right - display_frame.left;
   display_frame_height_ = display_frame.bottom - display_frame.top;
   display_frame_ = display_frame;
-  surface_damage_ = display_frame;
+  surface_damage_.Reset(display_frame);
 }
 
 void OverlayLayer::ValidateTransform(uint32_t transform,
@@ -185,15 +224,41 @@ void OverlayLayer::ValidateTransform(uint32_t transform,
 
 void OverlayLayer::UpdateSurfaceDamage(HwcLayer* layer) {
   if (!(actual_composition_ & kGpu)) {
-    surface_damage_ = display_frame_;
+    surface_damage_.Reset(display_frame_);
     return;
   }
 
   if (!layer->HasLayerContentChanged()) {
-    surface_damage_ = HwcRect<int> (0, 0, 0, 0);
+    surface_damage_.Clear();
+    return;
+  }
+
+  // Damage is in buffer coordinates. We map it to the display frame
+  // only in case of no transform, otherwise whole layer is damaged.
+  const HwcRegion& damage = layer->GetSurfaceDamageRegion();
+  float crop_width = source_crop_.right - source_crop_.left;
+  float crop_height = source_crop_.bottom - source_crop_.top;
+  if (damage.empty() || transform_ != kIdentity || crop_width <= 0 ||
+      crop_height <= 0) {
+    surface_damage_.Reset(display_frame_);
+    return;
+  }
+
+  float scale_x = (display_frame_.right - display_frame_.left) / crop_width;
+  float scale_y = (display_frame_.bottom - display_frame_.top) / crop_height;
+  if (damage.size() == 1) {
+    surface_damage_.Reset(
+        MapDamageRect(damage.front(), display_frame_, source_crop_, scale_x,
+                      scale_y));
   } else {
-    surface_damage_ = display_frame_;
+    surface_damage_.Clear();
+    for (const HwcRect<int>& rect : damage) {
+      surface_damage_.Union(MapDamageRect(rect, display_frame_, source_crop_,
+                                          scale_x, scale_y));
+    }
   }
+
+  surface_damage_.Intersect(display_frame_);
 }
 
 void OverlayLayer::InitializeState(HwcLayer* layer,
@@ -214,6 +279,7 @@ void OverlayLayer::InitializeState(HwcLayer* layer,
 
   alpha_ = layer->GetAlpha();
   layer_index_ = layer_index;
+  layer_id_ = layer->GetLayerId();
   z_order_ = z_order;
   source_crop_width_ = layer->GetSourceCropWidth();
   source_crop_height_ = layer->GetSourceCropHeight();
@@ -231,6 +297,11 @@ void OverlayLayer::InitializeState(HwcLayer* layer,
     state_ |= kLayerContentChanged;
   }
 
+  if (previous_layer && !(state_ & kLayerContentChanged) &&
+      previous_layer->layer_id_ == layer_id_) {
+    static_frames_ = previous_layer->static_frames_ + 1;
+  }
+
   if (!handle_constraints) {
     UpdateSurfaceDamage(layer);
     return;
@@ -277,21 +348,11 @@ void OverlayLayer::InitializeState(HwcLayer* layer,
     display_frame_width_ = display_frame_.right - display_frame_.left;
     display_frame_height_ = display_frame_.bottom - display_frame_.top;
 
+    // Source crop doesn't match the display frame yet, so we can't map
+    // damage rects of the layer. Refresh the visible part of it.
     UpdateSurfaceDamage(layer);
-    if (actual_composition_ & kGpu) {
-      // If viewport and layer doesn't interact we can avoid re-rendering
-      // this layer.
-      if (AnalyseOverlap(surface_damage_, display_frame_) != kOutside) {
-        surface_damage_.left =
-            std::max(surface_damage_.left, display_frame_.left);
-        surface_damage_.right =
-            std::min(surface_damage_.right, display_frame_.right);
-        surface_damage_.top = std::max(surface_damage_.top, display_frame_.top);
-        surface_damage_.bottom =
-            std::min(surface_damage_.bottom, display_frame_.bottom);
-      } else {
-        surface_damage_ = HwcRect<int>(0, 0, 0, 0);
-      }
+    if ((actual_composition_ & kGpu) && !surface_damage_.IsEmpty()) {
+      surface_damage_.Reset(display_frame_);
     }
 
     // split the source in proportion of frame rect offset for sub displays as:
@@ -336,11 +397,11 @@ void OverlayLayer::InitializeFromScaledHwcLayer(
 
 void OverlayLayer::ValidatePreviousFrameState(OverlayLayer* rhs,
                                               HwcLayer* layer) {
-  OverlayBuffer* buffer = imported_buffer_->buffer_.get();
+  OverlayBuffer* buffer = imported_buffer_.buffer_.get();
   display_scaled_ = rhs->display_scaled_;
   supported_composition_ = rhs->supported_composition_;
   actual_composition_ = rhs->actual_composition_;
-  if (buffer->GetFormat() != rhs->imported_buffer_->buffer_->GetFormat()) {
+  if (buffer->GetFormat() != rhs->imported_buffer_.buffer_->GetFormat()) {
     state_ |= kNeedsReValidation;
     return;
   }
@@ -416,7 +477,7 @@ void OverlayLayer::ValidatePreviousFrameState(OverlayLayer* rhs,
 }
 
 void OverlayLayer::ValidateForOverlayUsage() {
-  const std::shared_ptr<OverlayBuffer>& buffer = imported_buffer_->buffer_;
+  const std::shared_ptr<OverlayBuffer>& buffer = imported_buffer_.buffer_;
   type_ = buffer->GetUsage();
 }
 
@@ -455,9 +516,9 @@ void OverlayLayer::Dump() {
   DUMPTRACE("SourceHeight: %d", source_crop_height_);
   DUMPTRACE("DstWidth: %d", display_frame_width_);
   DUMPTRACE("DstHeight: %d", display_frame_height_);
-  DUMPTRACE("AquireFence: %d", imported_buffer_->acquire_fence_);
+  DUMPTRACE("AquireFence: %d", imported_buffer_.acquire_fence_);
 
-  imported_buffer_->buffer_->Dump();
+  imported_buffer_.buffer_->Dump();
 }
 
 }  // namespace hwcomposer
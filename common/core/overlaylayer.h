@@ -23,6 +23,7 @@
 #include <memory>
 #include <hwclayer.h>
 
+#include "damageregion.h"
 #include "overlaybuffer.h"
 
 namespace hwcomposer {
@@ -69,6 +70,11 @@ struct OverlayLayer {
     return layer_index_;
   }
 
+  // Id of hwclayer which this layer represents.
+  uint64_t GetLayerId() const {
+    return layer_id_;
+  }
+
   uint8_t GetAlpha() const {
     return alpha_;
   }
@@ -106,7 +112,8 @@ struct OverlayLayer {
     return display_frame_;
   }
 
-  const HwcRect<int>& GetSurfaceDamage() const {
+  // Damaged part of this layer, in display coordinates.
+  const DamageRegion& GetSurfaceDamage() const {
     return surface_damage_;
   }
 
@@ -186,6 +193,12 @@ struct OverlayLayer {
     return type_ == kLayerVideo;
   }
 
+  // Number of frames in a row content of this layer
+  // didn't change.
+  uint32_t GetStaticFrames() const {
+    return static_frames_;
+  }
+
   bool HasDimensionsChanged() const {
     return state_ & kDimensionsChanged;
   }
@@ -225,12 +238,18 @@ struct OverlayLayer {
     kNeedsReValidation = 1 << 5
   };
 
+  // Kept inline in OverlayLayer, so that re-initializing a layer
+  // every frame doesn't need a heap allocation.
   struct ImportedBuffer {
    public:
-    ImportedBuffer(std::shared_ptr<OverlayBuffer>& buffer,
-                   int32_t acquire_fence);
+    ImportedBuffer() = default;
+    ImportedBuffer(ImportedBuffer&& rhs);
+    ImportedBuffer& operator=(ImportedBuffer&& rhs);
     ~ImportedBuffer();
 
+    // Replaces current buffer and takes ownership of acquire_fence.
+    void Reset(std::shared_ptr<OverlayBuffer>& buffer, int32_t acquire_fence);
+
     std::shared_ptr<OverlayBuffer> buffer_;
     int32_t acquire_fence_ = -1;
   };
@@ -256,17 +275,19 @@ struct OverlayLayer {
   uint32_t plane_transform_ = 0;
   uint32_t z_order_ = 0;
   uint32_t layer_index_ = 0;
+  uint64_t layer_id_ = 0;
   uint32_t source_crop_width_ = 0;
   uint32_t source_crop_height_ = 0;
   uint32_t display_frame_width_ = 0;
   uint32_t display_frame_height_ = 0;
+  uint32_t static_frames_ = 0;
   uint8_t alpha_ = 0xff;
   HwcRect<float> source_crop_;
   HwcRect<int> display_frame_;
-  HwcRect<int> surface_damage_;
+  DamageRegion surface_damage_;
   HWCBlending blending_ = HWCBlending::kBlendingNone;
   uint32_t state_ = kLayerContentChanged | kDimensionsChanged;
-  std::unique_ptr<ImportedBuffer> imported_buffer_;
+  mutable ImportedBuffer imported_buffer_;
   bool display_scaled_ = false;
   LayerComposition supported_composition_;
   LayerComposition actual_composition_;
@@ -20,8 +20,6 @@ namespace hwcomposer {
 
 ResourceManager::ResourceManager(NativeBufferHandler* buffer_handler)
     : buffer_handler_(buffer_handler) {
-  for (size_t i = 0; i < BUFFER_CACHE_LENGTH; i++)
-    cached_buffers_.emplace_back();
 }
 
 ResourceManager::~ResourceManager() {
@@ -39,9 +37,7 @@ ResourceManager::~ResourceManager() {
 }
 
 void ResourceManager::PurgeBuffer() {
-  for (auto& map : cached_buffers_) {
-    map.clear();
-  }
+  cached_buffers_.clear();
 
   PreparePurgedResources();
 }
@@ -51,25 +47,15 @@ void ResourceManager::Dump() {
 
 std::shared_ptr<OverlayBuffer>& ResourceManager::FindCachedBuffer(
     const HWCNativeBuffer& native_buffer) {
-  BUFFER_MAP& first_map = cached_buffers_[0];
   static std::shared_ptr<OverlayBuffer> pBufNull = nullptr;
-  for (auto& map : cached_buffers_) {
-    if (map.empty()) {
-      continue;
-    }
-
-    BUFFER_MAP::iterator it = map.find(native_buffer);
-
-    if (it != map.end()) {
-      std::shared_ptr<OverlayBuffer>& pBuf = it->second;
-      if (&map != &first_map) {
-        first_map.emplace(std::make_pair(native_buffer, pBuf));
-      }
+  BUFFER_MAP::iterator it = cached_buffers_.find(native_buffer);
+  if (it != cached_buffers_.end()) {
+    CachedBuffer& cached = it->second;
+    cached.last_frame_ = frame_;
 #ifdef RESOURCE_CACHE_TRACING
-      hit_count_++;
+    hit_count_++;
 #endif
-      return pBuf;
-    }
+    return cached.buffer_;
   }
 
 #ifdef RESOURCE_CACHE_TRACING
@@ -84,8 +70,9 @@ std::shared_ptr<OverlayBuffer>& ResourceManager::FindCachedBuffer(
 
 void ResourceManager::RegisterBuffer(const HWCNativeBuffer& native_buffer,
                                      std::shared_ptr<OverlayBuffer>& pBuffer) {
-  BUFFER_MAP& first_map = cached_buffers_[0];
-  first_map.emplace(std::make_pair(native_buffer, pBuffer));
+  CachedBuffer& cached = cached_buffers_[native_buffer];
+  cached.buffer_ = pBuffer;
+  cached.last_frame_ = frame_;
 }
 
 void ResourceManager::MarkResourceForDeletion(const ResourceHandle& handle,
@@ -139,13 +126,18 @@ void ResourceManager::GetPurgedResources(
 }
 
 void ResourceManager::RefreshBufferCache() {
-  auto begin = cached_buffers_.begin();
-  cached_buffers_.emplace(begin);
+  frame_++;
 }
 
 bool ResourceManager::PreparePurgedResources() {
-  if (cached_buffers_.size() > 4)
-    cached_buffers_.pop_back();
+  BUFFER_MAP::iterator it = cached_buffers_.begin();
+  while (it != cached_buffers_.end()) {
+    if (frame_ - it->second.last_frame_ >= BUFFER_CACHE_LENGTH) {
+      it = cached_buffers_.erase(it);
+    } else {
+      ++it;
+    }
+  }
 
   if (purged_resources_.empty() && purged_media_resources_.empty())
     return false;
@@ -22,15 +22,13 @@ to avoid import buffer and glimage/texture generation overhead
 1: the ResourceManager is owned per display, as each display has a
 separate
 GL context
-2: ResourceManager stores a refernce of external buffers in a vector
-   cached_buffers, each vector member is hash map.
-   The vector stores history buffer in this way, vector[0] is for the current
-   frame buffers, vector[1] is for last frame (-1) buffers, vector[2] is -2
-   frames buffers etc. A constant (currently 4) frames of buffers is stored.
-   When a buffer refernce is stored in vector[3] and it is not used in the
-   current frame present, it will go out of scope and be released.
-   If a buffer is fetched from map, it will always re-registered in vector[0]
-map.
+2: ResourceManager stores a refernce of external buffers in a hash map
+   cached_buffers, together with the last frame in which the buffer was
+   used. Every lookup stamps the entry with the current frame. Buffers not
+   used in the last BUFFER_CACHE_LENGTH (currently 4) frames are removed
+   from the map, go out of scope and are released. As entries are only
+   updated in place, a frame re-using already cached buffers doesn't need
+   any heap allocations.
 3. By this way, drm_buffer now owns eglImage and gltexture and they
    can be resued.
 */
@@ -85,9 +83,16 @@ class ResourceManager {
 
  private:
 #define BUFFER_CACHE_LENGTH 4
-  typedef std::unordered_map<HWCNativeBuffer, std::shared_ptr<OverlayBuffer>,
-                             BufferHash, BufferEqual> BUFFER_MAP;
-  std::vector<BUFFER_MAP> cached_buffers_;
+  struct CachedBuffer {
+    std::shared_ptr<OverlayBuffer> buffer_;
+    // Frame in which this buffer was last used.
+    uint32_t last_frame_ = 0;
+  };
+
+  typedef std::unordered_map<HWCNativeBuffer, CachedBuffer, BufferHash,
+                             BufferEqual> BUFFER_MAP;
+  BUFFER_MAP cached_buffers_;
+  uint32_t frame_ = 0;
   // This should be used in same thread handling
   // Present in NativeDisplay.
   std::vector<ResourceHandle> purged_resources_;
@@ -0,0 +1,142 @@
+/*
+// Copyright (c) 2018 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+#include "clonepresentationhandler.h"
+
+#include <unistd.h>
+
+#include <nativedisplay.h>
+
+#include "hwctrace.h"
+
+namespace hwcomposer {
+
+ClonePresentationHandler::ClonePresentationHandler(NativeDisplay* clone)
+    : HWCThread(-8, "ClonePresentationHandler"), clone_(clone) {
+}
+
+ClonePresentationHandler::~ClonePresentationHandler() {
+  ExitThread();
+}
+
+bool ClonePresentationHandler::Initialize() {
+  if (initialized_)
+    return true;
+
+  if (!done_event_.Initialize())
+    return false;
+
+  done_fd_.AddFd(done_event_.get_fd());
+  if (!InitWorker()) {
+    ETRACE("Failed to initalize thread for ClonePresentationHandler. %s",
+           PRINTERROR());
+    return false;
+  }
+
+  return true;
+}
+
+void ClonePresentationHandler::Present(std::vector<HwcLayer*>* source_layers,
+                                       bool idle_frame) {
+  if (!initialized_) {
+    success_ = PresentClone(source_layers, idle_frame);
+    return;
+  }
+
+  spin_lock_.lock();
+  source_layers_ = source_layers;
+  idle_frame_ = idle_frame;
+  pending_ = true;
+  spin_lock_.unlock();
+  Resume();
+}
+
+bool ClonePresentationHandler::Wait() {
+  while (true) {
+    spin_lock_.lock();
+    bool pending = pending_;
+    bool success = success_;
+    spin_lock_.unlock();
+    if (!pending)
+      return success;
+
+    if (done_fd_.Poll(-1) <= 0) {
+      ETRACE("Poll Failed in ClonePresentationHandler %s", PRINTERROR());
+      return false;
+    }
+
+    if (done_fd_.IsReady(done_event_.get_fd())) {
+      // If eventfd_ is ready, we need to wait on it (using read()) to clean
+      // the flag that says it is ready.
+      done_event_.Wait();
+    }
+  }
+}
+
+void ClonePresentationHandler::ExitThread() {
+  HWCThread::Exit();
+  // Thread is gone, make sure nobody keeps waiting for it.
+  HandleExit();
+}
+
+bool ClonePresentationHandler::PresentClone(
+    std::vector<HwcLayer*>* source_layers, bool idle_frame) {
+  // Clones don't hand out retire fences, source display does.
+  int32_t retire_fence = -1;
+  bool success = clone_->PresentClone(*source_layers, &retire_fence,
+                                      idle_frame);
+  if (retire_fence > 0)
+    close(retire_fence);
+
+  return success;
+}
+
+void ClonePresentationHandler::HandleRoutine() {
+  spin_lock_.lock();
+  if (!pending_) {
+    spin_lock_.unlock();
+    return;
+  }
+
+  std::vector<HwcLayer*>* source_layers = source_layers_;
+  bool idle_frame = idle_frame_;
+  spin_lock_.unlock();
+
+  bool success = PresentClone(source_layers, idle_frame);
+
+  spin_lock_.lock();
+  source_layers_ = NULL;
+  success_ = success;
+  pending_ = false;
+  spin_lock_.unlock();
+  done_event_.Signal();
+}
+
+void ClonePresentationHandler::HandleExit() {
+  spin_lock_.lock();
+  bool signal = pending_;
+  if (pending_) {
+    source_layers_ = NULL;
+    success_ = false;
+    pending_ = false;
+  }
+  spin_lock_.unlock();
+
+  if (signal)
+    done_event_.Signal();
+}
+
+}  // namespace hwcomposer
@@ -0,0 +1,78 @@
+/*
+// Copyright (c) 2018 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+#ifndef COMMON_DISPLAY_CLONEPRESENTATIONHANDLER_H_
+#define COMMON_DISPLAY_CLONEPRESENTATIONHANDLER_H_
+
+#include <spinlock.h>
+
+#include <stdint.h>
+
+#include <vector>
+
+#include "fdhandler.h"
+#include "hwcevent.h"
+#include "hwcthread.h"
+
+namespace hwcomposer {
+
+class NativeDisplay;
+struct HwcLayer;
+
+// Presents frames of a source display on one of its clones using a
+// thread of its own, so that clones of the same source are updated
+// concurrently with each other and with the source waiting for its
+// own commit to complete.
+class ClonePresentationHandler : public HWCThread {
+ public:
+  explicit ClonePresentationHandler(NativeDisplay* clone);
+  ~ClonePresentationHandler() override;
+
+  bool Initialize();
+
+  NativeDisplay* GetDisplay() const {
+    return clone_;
+  }
+
+  // Starts presenting source_layers on the clone. The layers are only
+  // read, but must not change until Wait returns.
+  void Present(std::vector<HwcLayer*>* source_layers, bool idle_frame);
+
+  // Blocks until the frame passed to last Present has been queued on
+  // the clone. Returns false if that failed.
+  bool Wait();
+
+  void ExitThread();
+
+ protected:
+  void HandleRoutine() override;
+  void HandleExit() override;
+
+ private:
+  bool PresentClone(std::vector<HwcLayer*>* source_layers, bool idle_frame);
+
+  NativeDisplay* clone_;
+  SpinLock spin_lock_;
+  std::vector<HwcLayer*>* source_layers_ = NULL;
+  bool idle_frame_ = false;
+  bool pending_ = false;
+  bool success_ = true;
+  HWCEvent done_event_;
+  FDHandler done_fd_;
+};
+
+}  // namespace hwcomposer
+#endif  // COMMON_DISPLAY_CLONEPRESENTATIONHANDLER_H_
@@ -16,19 +16,43 @@
 
 #include "displayplanemanager.h"
 
+#include <drm_fourcc.h>
+
+#include <algorithm>
+#include <cmath>
+
 #include "displayplane.h"
 #include "factory.h"
 #include "hwctrace.h"
+#include "hwcutils.h"
+#include "modifiernegotiator.h"
+#include "nativebufferhandler.h"
 #include "nativesurface.h"
+#include "resourcemanager.h"
 #include "overlaylayer.h"
 
 namespace hwcomposer {
 
+// Time we are ready to spend searching for the cheapest
+// plane assignment, before falling back to first fit.
+static const int64_t kPlaneAssignmentBudgetNs = 200000;
+
+// Frames a layer needs to stay unchanged before its plane can be
+// given up for layers which need one more.
+static const uint32_t kConsolidateStaticFrames = 60;
+
+// Offscreen targets are composed at reduced resolution only if that
+// saves at least this much in each direction. Scales are rounded up
+// to multiples of 1 / kCompositionScaleSteps.
+static const float kMaxCompositionScale = 0.75f;
+static const float kCompositionScaleSteps = 8.0f;
+
 DisplayPlaneManager::DisplayPlaneManager(int gpu_fd,
                                          DisplayPlaneHandler *plane_handler,
                                          ResourceManager *resource_manager)
     : plane_handler_(plane_handler),
       resource_manager_(resource_manager),
+      cost_model_(new DefaultPlaneCostModel()),
       width_(0),
       height_(0),
       gpu_fd_(gpu_fd) {
@@ -40,7 +64,14 @@ DisplayPlaneManager::~DisplayPlaneManager() {
 bool DisplayPlaneManager::Initialize(uint32_t width, uint32_t height) {
   width_ = width;
   height_ = height;
+  test_cache_.SetDisplaySize(width, height);
+  surface_pool_.SetMaxSize(width, height);
   bool status = plane_handler_->PopulatePlanes(overlay_planes_);
+  scaler_caps_.Initialize(overlay_planes_,
+                          plane_handler_->GetMaxScaledPlanes());
+  assignment_.SetScalerCapabilities(&scaler_caps_);
+  sticky_assignment_.SetScalerCapabilities(&scaler_caps_);
+  InitializeTargetModifiers();
   if (!overlay_planes_.empty()) {
     if (overlay_planes_.size() > 1) {
       cursor_plane_ = overlay_planes_.back().get();
@@ -68,6 +99,28 @@ bool DisplayPlaneManager::ValidateLayers(
   CTRACE();
   std::vector<OverlayPlane> commit_planes;
 
+  // Layers below add_index keep their planes. If there aren't enough
+  // left for new layers preferring a plane of their own, make room by
+  // consolidating existing planes rather than compositing these.
+  bool consolidated = false;
+  if (add_index > 0 && !disable_overlay) {
+    uint32_t needed = 0;
+    for (size_t i = add_index; i < layers.size(); ++i) {
+      if (layers.at(i).PreferSeparatePlane())
+        needed++;
+    }
+
+    size_t free_planes = 0;
+    size_t overlay_count = GetOverlayPlaneCount();
+    if (overlay_count > composition.size())
+      free_planes = overlay_count - composition.size();
+
+    if (needed > free_planes) {
+      consolidated = ConsolidatePlanes(layers, composition, mark_later,
+                                       needed - free_planes) > 0;
+    }
+  }
+
   for (DisplayPlaneState &temp : composition) {
     commit_planes.emplace_back(
         OverlayPlane(temp.GetDisplayPlane(), temp.GetOverlayLayer()));
@@ -142,15 +195,20 @@ bool DisplayPlaneManager::ValidateLayers(
     layer_begin = layers.begin() + add_index;
   }
 
-  if (layer_begin != layer_end) {
-    auto overlay_end = overlay_planes_.end();
-#ifdef DISABLE_CURSOR_PLANE
-    overlay_end = overlay_planes_.end() - 1;
-#else
-    if (!cursor_plane_->IsUniversal()) {
-      overlay_end = overlay_planes_.end() - 1;
-    }
-#endif
+  // Bisection also places layers added on top of cached planes, cost
+  // based assignment only works on the whole stack.
+  bool assigned = false;
+  if (!check_plane && ((add_index == 0 &&
+                        plane_assignment_ != kPlaneAssignmentGreedy) ||
+                       (add_index > 0 &&
+                        plane_assignment_ == kPlaneAssignmentBisect))) {
+    assigned = AssignPlanes(layers, std::max(add_index, 0), commit_planes,
+                            composition, cursor_layers, mark_later,
+                            &render_layers);
+  }
+
+  if (!assigned && layer_begin != layer_end) {
+    auto overlay_end = overlay_planes_.begin() + GetOverlayPlaneCount();
 
     // Handle layers for overlays.
     for (auto j = overlay_begin; j != overlay_end; ++j) {
@@ -187,6 +245,13 @@ bool DisplayPlaneManager::ValidateLayers(
         // If we are able to composite buffer with the given plane, lets use
         // it.
         bool fall_back = FallbacktoGPU(plane, layer, commit_planes);
+        // Keep a layer composited last frame with the ones below it,
+        // unless it could have had its own plane for a while.
+        if (!placement_history_.AllowScanout(*layer, !fall_back) &&
+            !prefer_seperate_plane && !composition.empty() &&
+            composition.back().NeedsOffScreenComposition())
+          fall_back = true;
+
         validate_final_layers = false;
         if (!fall_back || prefer_seperate_plane) {
           composition.emplace_back(plane, layer, layer->GetZorder());
@@ -300,6 +365,12 @@ bool DisplayPlaneManager::ValidateLayers(
     }
   }
 
+  // Consolidated planes haven't been tested together yet.
+  if (consolidated) {
+    render_layers = true;
+    validate_final_layers = true;
+  }
+
   if (render_layers) {
     if (validate_final_layers) {
       ValidateFinalLayers(commit_planes, composition, layers, mark_later,
@@ -346,7 +417,7 @@ void DisplayPlaneManager::ReValidateLayers(std::vector<OverlayLayer> &layers,
   }
 
   // If this combination fails just fall back to full validation.
-  if (plane_handler_->TestCommit(commit_planes)) {
+  if (TestCommit(commit_planes)) {
     *request_full_validation = false;
   } else {
 #ifdef SURFACE_TRACING
@@ -357,6 +428,429 @@ void DisplayPlaneManager::ReValidateLayers(std::vector<OverlayLayer> &layers,
   }
 }
 
+uint32_t DisplayPlaneManager::ConsolidatePlanes(
+    const std::vector<OverlayLayer> &layers, DisplayPlaneStateList &composition,
+    std::vector<NativeSurface *> &mark_later, uint32_t planes) {
+  size_t size = composition.size();
+  // Cursor plane stays where it is.
+  if (size && composition.back().IsCursorPlane())
+    size--;
+
+  if (size < 2)
+    return 0;
+
+  std::vector<DisplayPlane *> display_planes;
+  display_planes.reserve(size);
+  for (size_t i = 0; i < size; ++i) {
+    display_planes.emplace_back(composition.at(i).GetDisplayPlane());
+  }
+
+  uint32_t freed = 0;
+  // Start from the top, closest to the layers which need planes.
+  for (size_t i = size - 1; i > 0 && freed < planes; --i) {
+    DisplayPlaneState &lower = composition.at(i - 1);
+    DisplayPlaneState &upper = composition.at(i);
+    if (!CanConsolidate(layers, lower, upper))
+      continue;
+
+    // Planes above move down by one, make sure layers and offscreen
+    // targets they scan out can be shown there.
+    bool can_move = true;
+    for (size_t j = i + 1; j < size && can_move; ++j) {
+      DisplayPlaneState &state = composition.at(j);
+      DisplayPlane *plane = display_planes.at(j - 1);
+      if (state.NeedsOffScreenComposition()) {
+        can_move = OffScreenTargetFitsPlane(state, plane);
+        continue;
+      }
+
+      const OverlayLayer *layer = &(layers.at(state.GetSourceLayers().front()));
+      can_move = plane->ValidateLayer(layer);
+    }
+
+    if (!can_move)
+      continue;
+
+#ifdef SURFACE_TRACING
+    ISURFACETRACE("Consolidating plane index: %d into plane index: %d \n", i,
+                  i - 1);
+#endif
+    // State of the previous frame still describes what is on screen.
+    lower.DetachState();
+    const std::vector<size_t> &source_layers = upper.GetSourceLayers();
+    for (const size_t &index : source_layers) {
+      lower.AddLayer(&(layers.at(index)));
+    }
+
+    MarkSurfacesForRecycling(&upper, mark_later, false);
+    composition.erase(composition.begin() + i);
+    size--;
+
+    if (lower.GetOffScreenTarget()) {
+      lower.RefreshSurfaces(true);
+      lower.ForceGPURendering();
+    } else {
+      SetOffScreenPlaneTarget(lower);
+    }
+
+    freed++;
+  }
+
+  if (!freed)
+    return 0;
+
+  // Planes left over are disabled on commit, as the previous frame's
+  // states still refer to them.
+  for (size_t i = 0; i < display_planes.size(); ++i) {
+    if (i >= size) {
+      display_planes.at(i)->SetInUse(false);
+      continue;
+    }
+
+    DisplayPlaneState &state = composition.at(i);
+    if (state.GetDisplayPlane() == display_planes.at(i))
+      continue;
+
+    state.DetachState();
+    state.SetDisplayPlane(display_planes.at(i));
+  }
+
+  return freed;
+}
+
+bool DisplayPlaneManager::CanConsolidate(
+    const std::vector<OverlayLayer> &layers, DisplayPlaneState &lower,
+    DisplayPlaneState &upper) const {
+  if (lower.IsCursorPlane() || upper.IsCursorPlane())
+    return false;
+
+  // Source crop of scaled planes doesn't follow their display frame.
+  if (lower.IsUsingPlaneScalar() || upper.IsUsingPlaneScalar())
+    return false;
+
+  if (!lower.NeedsOffScreenComposition() || !lower.CanSquash())
+    return false;
+
+  if (upper.NeedsOffScreenComposition())
+    return upper.CanSquash();
+
+  // Scanout layer is worth compositing only if it rarely changes.
+  const std::vector<size_t> &source_layers = upper.GetSourceLayers();
+  if (source_layers.size() != 1)
+    return false;
+
+  const OverlayLayer &layer = layers.at(source_layers.front());
+  if (layer.PreferSeparatePlane() || layer.IsCursorLayer())
+    return false;
+
+  return layer.GetStaticFrames() >= kConsolidateStaticFrames;
+}
+
+bool DisplayPlaneManager::OffScreenTargetFitsPlane(DisplayPlaneState &state,
+                                                   DisplayPlane *plane) {
+  // Targets not created yet are allocated for the plane they end up on.
+  NativeSurface *target = state.GetOffScreenTarget();
+  if (!target)
+    return true;
+
+  const OverlayBuffer *buffer = target->GetLayer()->GetBuffer();
+  uint32_t format = buffer->GetFormat();
+  if (!plane->IsSupportedFormat(format))
+    return false;
+
+  uint64_t modifier = 0;
+  if (!buffer->GetModifier(&modifier))
+    return true;
+
+  // Planes which report no modifiers only take implicit layouts.
+  plane_modifiers_.clear();
+  if (!plane->GetFormatModifiers(format, &plane_modifiers_))
+    return false;
+
+  return std::find(plane_modifiers_.begin(), plane_modifiers_.end(),
+                   modifier) != plane_modifiers_.end();
+}
+
+size_t DisplayPlaneManager::GetOverlayPlaneCount() const {
+#ifdef DISABLE_CURSOR_PLANE
+  return overlay_planes_.size() - 1;
+#else
+  if (!cursor_plane_->IsUniversal())
+    return overlay_planes_.size() - 1;
+
+  return overlay_planes_.size();
+#endif
+}
+
+bool DisplayPlaneManager::AssignPlanes(
+    std::vector<OverlayLayer> &layers, size_t first_layer,
+    std::vector<OverlayPlane> &commit_planes,
+    DisplayPlaneStateList &composition,
+    std::vector<OverlayLayer *> &cursor_layers,
+    std::vector<NativeSurface *> &mark_later, bool *render_layers) {
+  CTRACE();
+  assignment_layers_.clear();
+  size_t size = layers.size();
+  for (size_t i = first_layer; i < size; i++) {
+    // Cursor layers are handled separately.
+    if (!layers.at(i).IsCursorLayer())
+      assignment_layers_.emplace_back(&layers.at(i));
+  }
+
+  assignment_planes_.clear();
+  auto overlay_end = overlay_planes_.end();
+#ifdef DISABLE_CURSOR_PLANE
+  overlay_end = overlay_planes_.end() - 1;
+#else
+  if (cursor_plane_ && !cursor_plane_->IsUniversal()) {
+    overlay_end = overlay_planes_.end() - 1;
+  }
+#endif
+  // Planes of layers below first_layer stay as they are.
+  size_t used_planes = composition.size();
+  if (used_planes >= static_cast<size_t>(overlay_end - overlay_planes_.begin()))
+    return false;
+
+  for (auto j = overlay_planes_.begin() + used_planes; j != overlay_end; ++j) {
+    assignment_planes_.emplace_back(j->get());
+  }
+
+  if (assignment_layers_.empty() || assignment_planes_.empty())
+    return false;
+
+  size_t commit_size = commit_planes.size();
+  size_t composition_size = composition.size();
+  const std::vector<PlaneAssignment::Group> *groups = NULL;
+  if (plane_assignment_ == kPlaneAssignmentBisect) {
+    if (!FindScanoutPrefix(commit_planes, composition, mark_later))
+      return false;
+
+    groups = &assignment_groups_;
+  } else {
+    if (!assignment_.Solve(assignment_layers_, assignment_planes_,
+                           *cost_model_, width_, height_,
+                           kPlaneAssignmentBudgetNs)) {
+      return false;
+    }
+
+    groups = &assignment_.GetGroups();
+    if (placement_history_.IsEnabled() && !AllowPlacementChanges())
+      groups = &sticky_assignment_.GetGroups();
+  }
+
+  bool render = false;
+  // Bisection already tested this combination, in which
+  // case result comes from test cache.
+  if (!BuildComposition(*groups, commit_planes, composition, &render) ||
+      !TestCommit(commit_planes)) {
+    IDISPLAYMANAGERTRACE("Plane assignment failed, using first fit.");
+    DropComposition(commit_size, composition_size, commit_planes,
+                    composition, mark_later);
+    return false;
+  }
+
+  for (size_t i = first_layer; i < size; i++) {
+    if (layers.at(i).IsCursorLayer())
+      cursor_layers.emplace_back(&layers.at(i));
+  }
+
+  if (render)
+    *render_layers = true;
+
+  return true;
+}
+
+bool DisplayPlaneManager::AllowPlacementChanges() {
+  assignment_.GetPlacements(assignment_scanout_);
+  if (!placement_history_.CountChanges(assignment_layers_,
+                                       assignment_scanout_)) {
+    // Nothing moves, streaks of all layers start over.
+    placement_history_.AllowSwitch(assignment_layers_, assignment_scanout_,
+                                   false);
+    return true;
+  }
+
+  // Cheapest assignment keeping layers where they are.
+  StickyPlaneCostModel sticky_model(*cost_model_, placement_history_);
+  if (!sticky_assignment_.Solve(assignment_layers_, assignment_planes_,
+                                sticky_model, width_, height_,
+                                kPlaneAssignmentBudgetNs)) {
+    return true;
+  }
+
+  // Take out penalties of layers which had to move anyway.
+  sticky_assignment_.GetPlacements(sticky_scanout_);
+  uint64_t sticky_cost =
+      sticky_assignment_.GetCost() -
+      StickyPlaneCostModel::kSwitchPenalty *
+          placement_history_.CountChanges(assignment_layers_, sticky_scanout_);
+  uint64_t margin = placement_history_.GetSwitchMargin();
+  bool better = assignment_.GetCost() * 100 <= sticky_cost * (100 - margin);
+  return placement_history_.AllowSwitch(assignment_layers_, assignment_scanout_,
+                                        better);
+}
+
+bool DisplayPlaneManager::FindScanoutPrefix(
+    std::vector<OverlayPlane> &commit_planes,
+    DisplayPlaneStateList &composition,
+    std::vector<NativeSurface *> &mark_later) {
+  uint32_t num_layers = assignment_layers_.size();
+  uint32_t num_planes = assignment_planes_.size();
+  // Layers above the prefix need a plane of their own to be
+  // composited to.
+  uint32_t max_prefix = num_layers;
+  if (num_layers > num_planes)
+    max_prefix = num_planes - 1;
+
+  // Planes rejecting a layer outright don't need a test commit.
+  uint32_t high = 0;
+  uint32_t scaled_planes =
+      ScalerCapabilities::CountScaledPlanes(commit_planes, NULL);
+  while (high < max_prefix) {
+    DisplayPlane *plane = assignment_planes_.at(high);
+    OverlayLayer *layer = assignment_layers_.at(high);
+    if (!plane->ValidateLayer(layer) ||
+        !scaler_caps_.CanScale(plane, layer, scaled_planes))
+      break;
+
+    if (ScalerCapabilities::NeedsScaling(layer))
+      scaled_planes++;
+
+    high++;
+  }
+
+  // Find largest prefix of layers which can be scanned out, assuming
+  // that if a prefix works all shorter ones work too. The common case
+  // of everything fitting needs a single test commit.
+  size_t commit_size = commit_planes.size();
+  size_t composition_size = composition.size();
+  uint32_t low = 0;
+  uint32_t prefix = high;
+  while (low < high) {
+    BuildPrefixGroups(prefix);
+    bool render = false;
+    bool passed =
+        BuildComposition(assignment_groups_, commit_planes, composition,
+                         &render) &&
+        TestCommit(commit_planes);
+    DropComposition(commit_size, composition_size, commit_planes,
+                    composition, mark_later);
+    if (passed) {
+      low = prefix;
+    } else {
+      high = prefix - 1;
+    }
+
+    prefix = (low + high + 1) / 2;
+  }
+
+  BuildPrefixGroups(low);
+  if (low > 0)
+    return true;
+
+  // Compositing everything is the last resort, but it isn't
+  // guaranteed to work either.
+  bool render = false;
+  bool passed =
+      BuildComposition(assignment_groups_, commit_planes, composition,
+                       &render) &&
+      TestCommit(commit_planes);
+  DropComposition(commit_size, composition_size, commit_planes, composition,
+                  mark_later);
+  return passed;
+}
+
+void DisplayPlaneManager::BuildPrefixGroups(uint32_t prefix) {
+  uint32_t num_layers = assignment_layers_.size();
+  assignment_groups_.clear();
+  for (uint32_t i = 0; i < prefix; i++) {
+    PlaneAssignment::Group group;
+    group.begin_ = i;
+    group.end_ = i + 1;
+    group.scanout_ = true;
+    assignment_groups_.emplace_back(group);
+  }
+
+  if (prefix < num_layers) {
+    PlaneAssignment::Group group;
+    group.begin_ = prefix;
+    group.end_ = num_layers;
+    group.scanout_ = false;
+    assignment_groups_.emplace_back(group);
+  }
+}
+
+bool DisplayPlaneManager::BuildComposition(
+    const std::vector<PlaneAssignment::Group> &groups,
+    std::vector<OverlayPlane> &commit_planes,
+    DisplayPlaneStateList &composition, bool *render_layers) {
+  size_t total_groups = groups.size();
+  for (size_t i = 0; i < total_groups; i++) {
+    const PlaneAssignment::Group &group = groups.at(i);
+    DisplayPlane *plane = assignment_planes_.at(i);
+    OverlayLayer *layer = assignment_layers_.at(group.begin_);
+    commit_planes.emplace_back(OverlayPlane(plane, layer));
+    composition.emplace_back(plane, layer, layer->GetZorder());
+    plane->SetInUse(true);
+    DisplayPlaneState &last_plane = composition.back();
+    bool single_layer = group.end_ == group.begin_ + 1;
+    if (single_layer && layer->IsVideoLayer()) {
+      last_plane.SetVideoPlane();
+    }
+
+    if (group.scanout_) {
+      layer->SupportedDisplayComposition(OverlayLayer::kAll);
+      if (!plane_handler_->CreateFrameBuffer(layer->GetBuffer()))
+        return false;
+
+      continue;
+    }
+
+    for (uint32_t j = group.begin_; j < group.end_; j++) {
+      OverlayLayer *source = assignment_layers_.at(j);
+      // For Video, we always want to support Display Composition.
+      source->SupportedDisplayComposition(source->IsVideoLayer()
+                                              ? OverlayLayer::kAll
+                                              : OverlayLayer::kGpu);
+      if (j != group.begin_) {
+#ifdef SURFACE_TRACING
+        ISURFACETRACE("Added Layer: %d \n", source->GetZorder());
+#endif
+        last_plane.AddLayer(source);
+      }
+    }
+
+    ResetPlaneTarget(last_plane, commit_planes.back());
+    if (single_layer) {
+      ValidateForDisplayScaling(last_plane, commit_planes, layer);
+    }
+
+    *render_layers = true;
+  }
+
+  return true;
+}
+
+void DisplayPlaneManager::DropComposition(
+    size_t commit_size, size_t composition_size,
+    std::vector<OverlayPlane> &commit_planes,
+    DisplayPlaneStateList &composition,
+    std::vector<NativeSurface *> &mark_later) {
+  for (auto i = composition.begin() + composition_size; i != composition.end();
+       ++i) {
+    i->GetDisplayPlane()->SetInUse(false);
+    MarkSurfacesForRecycling(&(*i), mark_later, false);
+  }
+
+  composition.erase(composition.begin() + composition_size,
+                    composition.end());
+  commit_planes.erase(commit_planes.begin() + commit_size,
+                      commit_planes.end());
+  for (OverlayLayer *layer : assignment_layers_) {
+    layer->UsePlaneScalar(false);
+  }
+}
+
 DisplayPlaneState *DisplayPlaneManager::GetLastUsedOverlay(
     DisplayPlaneStateList &composition) {
   CTRACE();
@@ -455,10 +949,8 @@ bool DisplayPlaneManager::ValidateCursorLayer(
         if (cached) {
           fall_back = false;
           cursor_layer->SupportedDisplayComposition(OverlayLayer::kAll);
-          if (cursor_layer->GetBuffer()->GetFb() == 0) {
-            if (!cursor_layer->GetBuffer()->CreateFrameBuffer(gpu_fd_)) {
-              fall_back = true;
-            }
+          if (!plane_handler_->CreateFrameBuffer(cursor_layer->GetBuffer())) {
+            fall_back = true;
           }
 
           if (!fall_back) {
@@ -591,6 +1083,11 @@ void DisplayPlaneManager::ValidateForDisplayScaling(
     return;
   }
 
+  // Targets composed at reduced resolution use the scaler already.
+  NativeSurface *target = last_plane.GetOffScreenTarget();
+  if (target && target->GetCompositionScale() != 1.0f)
+    return;
+
   uint32_t display_frame_width = current_layer->GetDisplayFrameWidth();
   uint32_t display_frame_height = current_layer->GetDisplayFrameHeight();
   uint32_t source_crop_width = current_layer->GetSourceCropWidth();
@@ -650,6 +1147,17 @@ void DisplayPlaneManager::ValidateForDisplayScaling(
 
   // Display frame and Source rect are different, let's check if
   // we can take advantage of scalars attached to this plane.
+  DisplayPlane *plane = last_plane.GetDisplayPlane();
+  OverlayLayer *target_layer = last_plane.GetOffScreenTarget()->GetLayer();
+  uint32_t scaled_planes =
+      ScalerCapabilities::CountScaledPlanes(commit_planes, plane);
+  if (!scaler_caps_.CanScale(plane, target_layer->GetBuffer()->GetFormat(),
+                             target_layer->GetPlaneTransform(),
+                             source_crop_width, source_crop_height,
+                             display_frame_width, display_frame_height,
+                             scaled_planes))
+    return;
+
   const HwcRect<float> &crop = current_layer->GetSourceCrop();
   last_plane.SetSourceCrop(crop);
   last_plane.RefreshSurfaces(false);
@@ -657,12 +1165,21 @@ void DisplayPlaneManager::ValidateForDisplayScaling(
   OverlayPlane &last_overlay_plane = commit_planes.back();
   last_overlay_plane.layer = last_plane.GetOverlayLayer();
 
+  bool test_failed = false;
   bool fall_back =
-      FallbacktoGPU(last_plane.GetDisplayPlane(),
-                    last_plane.GetOffScreenTarget()->GetLayer(), commit_planes);
+      FallbacktoGPU(plane, target_layer, commit_planes, &test_failed);
   if (fall_back) {
     last_plane.ResetSourceRectToDisplayFrame();
     last_plane.RefreshSurfaces(false);
+    // Only blame the scaler if the commit passes without it, it may
+    // as well have failed for bandwidth or watermarks.
+    if (test_failed && TestCommit(commit_planes)) {
+      scaler_caps_.ScalingFailed(plane, target_layer->GetBuffer()->GetFormat(),
+                                 target_layer->GetPlaneTransform(),
+                                 source_crop_width, source_crop_height,
+                                 display_frame_width, display_frame_height,
+                                 scaled_planes);
+    }
   } else {
     last_plane.UsePlaneScalar(true);
     current_layer->UsePlaneScalar(true);
@@ -685,59 +1202,435 @@ void DisplayPlaneManager::SetOffScreenPlaneTarget(DisplayPlaneState &plane) {
 
 void DisplayPlaneManager::ReleaseAllOffScreenTargets() {
   CTRACE();
-  std::vector<std::unique_ptr<NativeSurface>>().swap(surfaces_);
+  surface_pool_.ReleaseAll();
 }
 
 void DisplayPlaneManager::ReleaseFreeOffScreenTargets() {
-  std::vector<std::unique_ptr<NativeSurface>> surfaces;
-  for (auto &fb : surfaces_) {
-    if (fb->InUse()) {
-      surfaces.emplace_back(fb.release());
+  surface_pool_.ReleaseFree();
+}
+
+void DisplayPlaneManager::TrimOffScreenTargets() {
+  surface_pool_.Trim();
+}
+
+void DisplayPlaneManager::SetOffScreenTargetBudget(uint64_t budget,
+                                                   bool shared) {
+  std::shared_ptr<SurfacePoolBudget> pool_budget;
+  if (shared) {
+    pool_budget = SurfacePoolBudget::Shared();
+  } else {
+    pool_budget.reset(new SurfacePoolBudget());
+  }
+
+  pool_budget->SetLimit(budget);
+  surface_pool_.SetBudget(std::move(pool_budget));
+}
+
+// Formats offscreen targets holding only opaque content can use
+// instead of the preferred one, narrowest first.
+static void GetOpaqueTargetFormats(uint32_t preferred_format,
+                                   std::vector<uint32_t> *formats) {
+  formats->emplace_back(DRM_FORMAT_RGB565);
+  switch (preferred_format) {
+    case DRM_FORMAT_ARGB8888:
+      formats->emplace_back(DRM_FORMAT_XRGB8888);
+      break;
+    case DRM_FORMAT_ABGR8888:
+      formats->emplace_back(DRM_FORMAT_XBGR8888);
+      break;
+    case DRM_FORMAT_RGBA8888:
+      formats->emplace_back(DRM_FORMAT_RGBX8888);
+      break;
+    case DRM_FORMAT_BGRA8888:
+      formats->emplace_back(DRM_FORMAT_BGRX8888);
+      break;
+    default:
+      break;
+  }
+}
+
+static bool IsLowDepthFormat(uint32_t format) {
+  return format == DRM_FORMAT_RGB565 || format == DRM_FORMAT_BGR565;
+}
+
+void DisplayPlaneManager::InitializeTargetModifiers() {
+  target_modifiers_.clear();
+  const NativeBufferHandler *handler =
+      resource_manager_->GetNativeBufferHandler();
+  std::vector<uint32_t> formats;
+  for (std::unique_ptr<DisplayPlane> &plane : overlay_planes_) {
+    formats.clear();
+    formats.emplace_back(plane->GetPreferredFormat());
+    GetOpaqueTargetFormats(plane->GetPreferredFormat(), &formats);
+    for (uint32_t format : formats) {
+      std::vector<uint64_t> plane_modifiers;
+      if (!plane->IsSupportedFormat(format) ||
+          !plane->GetFormatModifiers(format, &plane_modifiers))
+        continue;
+
+      std::vector<uint64_t> allocator_modifiers;
+      bool allocator_known =
+          handler->GetSupportedModifiers(format, &allocator_modifiers);
+      TargetModifiers target;
+      target.plane_ = plane.get();
+      target.format_ = format;
+      ModifierNegotiator::Negotiate(plane_modifiers, allocator_modifiers,
+                                    allocator_known, &target.modifiers_);
+      target_modifiers_.emplace_back(std::move(target));
     }
   }
+}
+
+const std::vector<uint64_t> &DisplayPlaneManager::GetTargetModifiers(
+    const DisplayPlane *plane, uint32_t format) const {
+  static const std::vector<uint64_t> kImplicitLayout;
+  for (const TargetModifiers &target : target_modifiers_) {
+    if (target.plane_ == plane && target.format_ == format)
+      return target.modifiers_;
+  }
 
-  surfaces.swap(surfaces_);
+  return kImplicitLayout;
 }
 
-void DisplayPlaneManager::EnsureOffScreenTarget(DisplayPlaneState &plane) {
-  NativeSurface *surface = NULL;
-  bool video_separate = plane.IsVideoPlane();
-  uint32_t preferred_format = 0;
-  uint32_t usage = hwcomposer::kLayerNormal;
-  if (video_separate) {
-    preferred_format = plane.GetDisplayPlane()->GetPreferredVideoFormat();
-  } else {
-    preferred_format = plane.GetDisplayPlane()->GetPreferredFormat();
+uint32_t DisplayPlaneManager::GetOffScreenTargetFormat(
+    const DisplayPlaneState &plane,
+    const std::vector<OverlayLayer> &layers) const {
+  DisplayPlane *display_plane = plane.GetDisplayPlane();
+  if (plane.IsVideoPlane())
+    return display_plane->GetPreferredVideoFormat();
+
+  uint32_t preferred_format = display_plane->GetPreferredFormat();
+  // Planes scaling their target show parts of it no layer covers.
+  if (plane.IsUsingPlaneScalar())
+    return preferred_format;
+
+  // Without alpha, anything not covered by an opaque layer would
+  // hide planes below instead of showing them.
+  const HwcRect<int> &display_frame = plane.GetDisplayFrame();
+  bool covered = false;
+  bool low_depth = true;
+  for (const size_t &index : plane.GetSourceLayers()) {
+    const OverlayLayer &layer = layers.at(index);
+    OverlayBuffer *buffer = layer.GetBuffer();
+    if (!buffer || layer.GetBlending() != HWCBlending::kBlendingNone ||
+        layer.GetAlpha() != 0xFF)
+      return preferred_format;
+
+    if (low_depth)
+      low_depth = IsLowDepthFormat(buffer->GetFormat());
+
+    if (!covered)
+      covered = IsEnclosedBy(display_frame, layer.GetDisplayFrame());
   }
 
-  for (auto &fb : surfaces_) {
-    if (!fb->InUse()) {
-      uint32_t surface_format = fb->GetLayer()->GetBuffer()->GetFormat();
-      if (preferred_format == surface_format) {
-        surface = fb.get();
+  if (!covered)
+    return preferred_format;
+
+  target_formats_.clear();
+  GetOpaqueTargetFormats(preferred_format, &target_formats_);
+  for (uint32_t format : target_formats_) {
+    if (!low_depth && GetBytesPerPixel(format) < 4)
+      continue;
+
+    if (!display_plane->IsSupportedFormat(format))
+      continue;
+
+    bool rejected = false;
+    for (const std::pair<uint32_t, uint32_t> &entry :
+         rejected_target_formats_) {
+      if (entry.first == display_plane->id() && entry.second == format) {
+        rejected = true;
         break;
       }
     }
+
+    if (!rejected)
+      return format;
+  }
+
+  return preferred_format;
+}
+
+uint64_t DisplayPlaneManager::GetTargetBytesSaved(
+    const DisplayPlaneStateList &composition, bool rendered) const {
+  uint64_t saved = 0;
+  for (const DisplayPlaneState &plane : composition) {
+    NativeSurface *surface = plane.GetOffScreenTarget();
+    if (plane.Scanout() || plane.IsVideoPlane() || !surface)
+      continue;
+
+    const HwcRect<int> &frame = plane.GetDisplayFrame();
+    uint64_t pixels = static_cast<uint64_t>(frame.right - frame.left) *
+                      (frame.bottom - frame.top);
+    float scale = surface->GetCompositionScale();
+    uint64_t full_bytes =
+        pixels *
+        GetBytesPerPixel(plane.GetDisplayPlane()->GetPreferredFormat());
+    uint64_t bytes =
+        static_cast<uint64_t>(pixels * scale * scale) *
+        GetBytesPerPixel(surface->GetLayer()->GetBuffer()->GetFormat());
+    if (bytes >= full_bytes)
+      continue;
+
+    saved += rendered ? (full_bytes - bytes) * 2 : full_bytes - bytes;
+  }
+
+  return saved;
+}
+
+void DisplayPlaneManager::EnsureOffScreenTarget(DisplayPlaneState &plane) {
+  // New back buffers match targets the plane already has, which
+  // EnsureOffScreenTargetsFit keeps suitable for its layers.
+  NativeSurface *target = plane.GetOffScreenTarget();
+  if (target) {
+    EnsureOffScreenTarget(plane, target->GetLayer()->GetBuffer()->GetFormat(),
+                          target->GetCompositionScale());
+  } else if (plane.IsVideoPlane()) {
+    EnsureOffScreenTarget(
+        plane, plane.GetDisplayPlane()->GetPreferredVideoFormat(), 1.0f);
+  } else {
+    EnsureOffScreenTarget(plane, plane.GetDisplayPlane()->GetPreferredFormat(),
+                          1.0f);
   }
+}
 
+void DisplayPlaneManager::EnsureOffScreenTarget(DisplayPlaneState &plane,
+                                                uint32_t format, float scale) {
+  static const std::vector<uint64_t> kImplicitLayout;
+  bool video_separate = plane.IsVideoPlane();
+  uint32_t usage = hwcomposer::kLayerNormal;
+  // Media surfaces keep the layout chosen by the allocator.
+  const std::vector<uint64_t> *modifiers = &kImplicitLayout;
+  if (video_separate) {
+    usage = hwcomposer::kLayerVideo;
+  } else {
+    modifiers = &GetTargetModifiers(plane.GetDisplayPlane(), format);
+  }
+
+  uint32_t width = 0;
+  uint32_t height = 0;
+  GetOffScreenTargetSize(plane, scale, &width, &height);
+  NativeSurface *surface =
+      surface_pool_.Acquire(format, usage, *modifiers, &width, &height);
   if (!surface) {
     NativeSurface *new_surface = NULL;
     if (video_separate) {
-      new_surface = CreateVideoBuffer(width_, height_);
-      usage = hwcomposer::kLayerVideo;
+      new_surface = CreateVideoBuffer(width, height);
     } else {
-      new_surface = Create3DBuffer(width_, height_);
+      new_surface = Create3DBuffer(width, height);
     }
 
-    new_surface->Init(resource_manager_, preferred_format, usage);
-    surfaces_.emplace_back(std::move(new_surface));
-    surface = surfaces_.back().get();
+    new_surface->Init(resource_manager_, format, usage, *modifiers);
+    surface = surface_pool_.Add(new_surface, format, usage);
   }
 
-  surface->SetPlaneTarget(plane, gpu_fd_);
+  surface->SetPlaneTarget(plane);
+  surface->SetCompositionScale(scale);
+  plane_handler_->CreateFrameBuffer(surface->GetLayer()->GetBuffer());
   plane.SetOffScreenTarget(surface);
 }
 
+void DisplayPlaneManager::GetOffScreenTargetSize(const DisplayPlaneState &plane,
+                                                 float scale, uint32_t *width,
+                                                 uint32_t *height) const {
+  // Targets never need to be larger than the display.
+  HwcRect<int> bounds = plane.GetOffScreenTargetBounds();
+  int width_needed = std::max(bounds.right - bounds.left, 1);
+  int height_needed = std::max(bounds.bottom - bounds.top, 1);
+  if (scale != 1.0f) {
+    width_needed = static_cast<int>(std::ceil(width_needed * scale));
+    height_needed = static_cast<int>(std::ceil(height_needed * scale));
+  }
+
+  *width = std::min(static_cast<uint32_t>(width_needed), width_);
+  *height = std::min(static_cast<uint32_t>(height_needed), height_);
+}
+
+bool DisplayPlaneManager::OffScreenTargetsFit(
+    const DisplayPlaneState &plane) const {
+  for (NativeSurface *surface : plane.GetSurfaces()) {
+    uint32_t width = 0;
+    uint32_t height = 0;
+    GetOffScreenTargetSize(plane, surface->GetCompositionScale(), &width,
+                           &height);
+    if (static_cast<uint32_t>(surface->GetWidth()) < width ||
+        static_cast<uint32_t>(surface->GetHeight()) < height)
+      return false;
+  }
+
+  return true;
+}
+
+float DisplayPlaneManager::GetOffScreenTargetScale(
+    const DisplayPlaneState &plane, const std::vector<OverlayLayer> &layers,
+    uint32_t format, uint32_t other_scaled_planes) const {
+  if (plane.IsVideoPlane() || plane.HasCursorLayer() ||
+      plane.IsUsingPlaneScalar())
+    return 1.0f;
+
+  // Freeing fill rate of small planes isn't worth a scaler.
+  const HwcRect<int> &display_frame = plane.GetDisplayFrame();
+  uint32_t display_width = display_frame.right - display_frame.left;
+  uint32_t display_height = display_frame.bottom - display_frame.top;
+  if (static_cast<uint64_t>(display_width) * display_height * 4 <
+      static_cast<uint64_t>(width_) * height_)
+    return 1.0f;
+
+  // Composing at the resolution of the least enlarged layer loses
+  // nothing the plane scaler doesn't bring back.
+  float scale = 0.0f;
+  for (const size_t &index : plane.GetSourceLayers()) {
+    const OverlayLayer &layer = layers.at(index);
+    uint32_t source_width = layer.GetSourceCropWidth();
+    uint32_t source_height = layer.GetSourceCropHeight();
+    if (layer.GetTransform() & (kTransform90 | kTransform270))
+      std::swap(source_width, source_height);
+
+    uint32_t layer_width = layer.GetDisplayFrameWidth();
+    uint32_t layer_height = layer.GetDisplayFrameHeight();
+    if (!layer_width || !layer_height)
+      return 1.0f;
+
+    scale = std::max(scale, static_cast<float>(source_width) / layer_width);
+    scale = std::max(scale, static_cast<float>(source_height) / layer_height);
+  }
+
+  // Steps keep small changes of layer sizes from replacing targets.
+  scale = std::ceil(scale * kCompositionScaleSteps) / kCompositionScaleSteps;
+  if (scale <= 0.0f || scale > kMaxCompositionScale)
+    return 1.0f;
+
+  DisplayPlane *display_plane = plane.GetDisplayPlane();
+  for (const uint32_t &plane_id : rejected_scaled_planes_) {
+    if (plane_id == display_plane->id())
+      return 1.0f;
+  }
+
+  uint32_t width = 0;
+  uint32_t height = 0;
+  GetOffScreenTargetSize(plane, scale, &width, &height);
+  if (!scaler_caps_.CanScale(display_plane, format, kIdentity, width, height,
+                             display_width, display_height,
+                             other_scaled_planes))
+    return 1.0f;
+
+  return scale;
+}
+
+bool DisplayPlaneManager::EnsureOffScreenTargetsFit(
+    DisplayPlaneStateList &composition, const std::vector<OverlayLayer> &layers,
+    std::vector<NativeSurface *> &mark_later) {
+  std::vector<OverlayPlane> &commit_planes = target_commit_planes_;
+  commit_planes.clear();
+  for (DisplayPlaneState &plane : composition) {
+    commit_planes.emplace_back(
+        OverlayPlane(plane.GetDisplayPlane(), plane.GetOverlayLayer()));
+  }
+
+  bool replaced = false;
+  bool needs_test = false;
+  for (DisplayPlaneState &plane : composition) {
+    if (!plane.NeedsOffScreenComposition() || plane.GetSurfaces().empty())
+      continue;
+
+    NativeSurface *target = plane.GetOffScreenTarget();
+    uint32_t current_format = target->GetLayer()->GetBuffer()->GetFormat();
+    float current_scale = target->GetCompositionScale();
+    uint32_t format = GetOffScreenTargetFormat(plane, layers);
+    float scale = GetOffScreenTargetScale(
+        plane, layers, format,
+        ScalerCapabilities::CountScaledPlanes(commit_planes,
+                                              plane.GetDisplayPlane()));
+    if (format == current_format && scale == current_scale &&
+        OffScreenTargetsFit(plane))
+      continue;
+
+    MarkSurfacesForRecycling(&plane, mark_later, false);
+    EnsureOffScreenTarget(plane, format, scale);
+    plane.ResetCompositionRegion();
+    replaced = true;
+    if (format != current_format || scale != current_scale)
+      needs_test = true;
+  }
+
+  // Source and destination of planes stay the same, so the last test
+  // commit still holds for targets which only grew.
+  if (!needs_test)
+    return replaced;
+
+  for (size_t i = 0; i < commit_planes.size(); i++) {
+    commit_planes.at(i).layer = composition.at(i).GetOverlayLayer();
+  }
+
+  if (TestCommit(commit_planes))
+    return true;
+
+  // Go back to full resolution targets in formats planes prefer,
+  // and don't try the rejected ones again.
+  DisplayPlane *scaled_plane = NULL;
+  uint32_t scaled_planes = 0;
+  bool format_changed = false;
+  uint32_t scaled_format = 0;
+  uint32_t scaled_transform = 0;
+  uint32_t source_width = 0;
+  uint32_t source_height = 0;
+  uint32_t display_width = 0;
+  uint32_t display_height = 0;
+  for (DisplayPlaneState &plane : composition) {
+    if (!plane.NeedsOffScreenComposition() || plane.GetSurfaces().empty() ||
+        plane.IsVideoPlane())
+      continue;
+
+    DisplayPlane *display_plane = plane.GetDisplayPlane();
+    NativeSurface *target = plane.GetOffScreenTarget();
+    uint32_t current_format = target->GetLayer()->GetBuffer()->GetFormat();
+    bool scaled = target->GetCompositionScale() != 1.0f;
+    if (current_format == display_plane->GetPreferredFormat() && !scaled)
+      continue;
+
+    if (current_format != display_plane->GetPreferredFormat()) {
+      rejected_target_formats_.emplace_back(display_plane->id(),
+                                            current_format);
+      format_changed = true;
+    }
+
+    if (scaled) {
+      const OverlayLayer *target_layer = target->GetLayer();
+      scaled_plane = display_plane;
+      scaled_planes++;
+      scaled_format = current_format;
+      scaled_transform = target_layer->GetPlaneTransform();
+      source_width = target_layer->GetSourceCropWidth();
+      source_height = target_layer->GetSourceCropHeight();
+      display_width = target_layer->GetDisplayFrameWidth();
+      display_height = target_layer->GetDisplayFrameHeight();
+      rejected_scaled_planes_.emplace_back(display_plane->id());
+    }
+
+    MarkSurfacesForRecycling(&plane, mark_later, false);
+    EnsureOffScreenTarget(plane);
+    plane.ResetCompositionRegion();
+  }
+
+  // Scaling limits are only learned if scaling alone made the
+  // commit fail.
+  if (scaled_planes != 1 || format_changed)
+    return true;
+
+  for (size_t i = 0; i < commit_planes.size(); i++) {
+    commit_planes.at(i).layer = composition.at(i).GetOverlayLayer();
+  }
+
+  if (TestCommit(commit_planes)) {
+    scaler_caps_.ScalingFailed(
+        scaled_plane, scaled_format, scaled_transform, source_width,
+        source_height, display_width, display_height,
+        ScalerCapabilities::CountScaledPlanes(commit_planes, scaled_plane));
+  }
+
+  return true;
+}
+
 void DisplayPlaneManager::ValidateFinalLayers(
     std::vector<OverlayPlane> &commit_planes,
     DisplayPlaneStateList &composition, std::vector<OverlayLayer> &layers,
@@ -749,7 +1642,7 @@ void DisplayPlaneManager::ValidateFinalLayers(
   }
 
   // If this combination fails just fall back to 3D for all layers.
-  if (!plane_handler_->TestCommit(commit_planes)) {
+  if (!TestCommit(commit_planes)) {
     ForceGpuForAllLayers(commit_planes, composition, layers, mark_later,
                          recycle_resources);
   }
@@ -757,7 +1650,7 @@ void DisplayPlaneManager::ValidateFinalLayers(
 
 bool DisplayPlaneManager::FallbacktoGPU(
     DisplayPlane *target_plane, OverlayLayer *layer,
-    const std::vector<OverlayPlane> &commit_planes) const {
+    const std::vector<OverlayPlane> &commit_planes, bool *test_failed) const {
   // For Video, we always want to support Display Composition.
   if (layer->IsVideoLayer()) {
     layer->SupportedDisplayComposition(OverlayLayer::kAll);
@@ -768,15 +1661,23 @@ bool DisplayPlaneManager::FallbacktoGPU(
   if (!target_plane->ValidateLayer(layer))
     return true;
 
-  if (layer->GetBuffer()->GetFb() == 0) {
-    if (!layer->GetBuffer()->CreateFrameBuffer(gpu_fd_)) {
-      return true;
-    }
-  }
+  // Scaling beyond what the plane can do fails without asking
+  // the kernel.
+  if (ScalerCapabilities::NeedsScaling(layer) &&
+      !scaler_caps_.CanScale(target_plane, layer,
+                             ScalerCapabilities::CountScaledPlanes(
+                                 commit_planes, target_plane)))
+    return true;
+
+  if (!plane_handler_->CreateFrameBuffer(layer->GetBuffer()))
+    return true;
 
   // TODO(kalyank): Take relevant factors into consideration to determine if
   // Plane Composition makes sense. i.e. layer size etc
-  if (!plane_handler_->TestCommit(commit_planes)) {
+  if (!TestCommit(commit_planes)) {
+    if (test_failed)
+      *test_failed = true;
+
     return true;
   }
 
@@ -784,6 +1685,18 @@ bool DisplayPlaneManager::FallbacktoGPU(
   return false;
 }
 
+bool DisplayPlaneManager::TestCommit(
+    const std::vector<OverlayPlane> &commit_planes) const {
+  bool result = false;
+  if (test_cache_.Find(commit_planes, &result))
+    return result;
+
+  test_commits_++;
+  result = plane_handler_->TestCommit(commit_planes);
+  test_cache_.Add(result);
+  return result;
+}
+
 bool DisplayPlaneManager::CheckPlaneFormat(uint32_t format) {
   return overlay_planes_.at(0)->IsSupportedFormat(format);
 }
@@ -792,6 +1705,7 @@ void DisplayPlaneManager::ForceGpuForAllLayers(
     std::vector<OverlayPlane> &commit_planes,
     DisplayPlaneStateList &composition, std::vector<OverlayLayer> &layers,
     std::vector<NativeSurface *> &mark_later, bool recycle_resources) {
+  forced_gpu_ = true;
   // Let's mark all planes as free to be used.
   for (auto j = overlay_planes_.begin(); j != overlay_planes_.end(); ++j) {
     j->get()->SetInUse(false);
@@ -884,11 +1798,19 @@ bool DisplayPlaneManager::ReValidatePlanes(
       commit_planes.at(index).layer = last_plane.GetOverlayLayer();
 
       // If this combination fails just fall back to 3D for all layers.
-      if (FallbacktoGPU(last_plane.GetDisplayPlane(), layer, commit_planes)) {
+      // Layer stays composited too until it could have been scanned
+      // out for a while.
+      bool fall_back =
+          FallbacktoGPU(last_plane.GetDisplayPlane(), layer, commit_planes);
+      if (!placement_history_.AllowScanout(*layer, !fall_back))
+        fall_back = true;
+
+      if (fall_back) {
         // Reset to old state.
         last_plane.ForceGPURendering();
         layer->SetLayerComposition(OverlayLayer::kGpu);
         last_plane.SetOverlayLayer(current_layer);
+        commit_planes.at(index).layer = current_layer;
       } else {
 #ifdef SURFACE_TRACING
         ISURFACETRACE("ReValidatePlanes called: moving to scan \n");
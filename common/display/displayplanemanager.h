@@ -22,8 +22,15 @@
 #include <vector>
 #include <tuple>
 
+#include <hwcdefs.h>
+
 #include "displayplanestate.h"
 #include "displayplanehandler.h"
+#include "placementhistory.h"
+#include "planeassignment.h"
+#include "planetestcache.h"
+#include "scalercapabilities.h"
+#include "surfacepool.h"
 
 namespace hwcomposer {
 
@@ -54,6 +61,18 @@ class DisplayPlaneManager {
                         DisplayPlaneStateList &composition,
                         bool *request_full_validation);
 
+  // Frees up to planes display planes used by composition by merging
+  // adjacent planes composited offscreen and folding layers which
+  // haven't changed for a while into the composition plane below them.
+  // Planes above a merge move down to keep their order. Changed states
+  // stop sharing data with previous_composition, whose planes freed
+  // here get disabled on commit. Returns number of planes freed, caller
+  // needs to render and test commit composition if any were.
+  uint32_t ConsolidatePlanes(const std::vector<OverlayLayer> &layers,
+                             DisplayPlaneStateList &composition,
+                             std::vector<NativeSurface *> &mark_later,
+                             uint32_t planes);
+
   void MarkSurfacesForRecycling(DisplayPlaneState *plane,
                                 std::vector<NativeSurface *> &mark_later,
                                 bool recycle_resources);
@@ -66,18 +85,120 @@ class DisplayPlaneManager {
 
   void ReleaseAllOffScreenTargets();
 
+  // Replaces offscreen targets of planes in composition which grew
+  // past them since they were allocated, or whose format doesn't suit
+  // layers they show anymore. Returns true if any target was replaced,
+  // these need to be rendered again.
+  bool EnsureOffScreenTargetsFit(DisplayPlaneStateList &composition,
+                                 const std::vector<OverlayLayer> &layers,
+                                 std::vector<NativeSurface *> &mark_later);
+
+  // Bytes offscreen targets of composition save per frame by being
+  // narrower than the format their plane prefers, or composed at
+  // reduced resolution. Targets are scanned out, and written too
+  // if rendered.
+  uint64_t GetTargetBytesSaved(const DisplayPlaneStateList &composition,
+                               bool rendered) const;
+
+  // Frees least recently used offscreen targets not in use
+  // until memory used by them is within budget.
+  void TrimOffScreenTargets();
+
   bool HasSurfaces() const {
-    return !surfaces_.empty();
+    return !surface_pool_.IsEmpty();
+  }
+
+  // Limits memory used by offscreen targets of this display to
+  // budget bytes, 0 means no limit. If shared, the limit applies
+  // to all displays sharing it together.
+  void SetOffScreenTargetBudget(uint64_t budget, bool shared);
+
+  const SurfacePool& GetSurfacePool() const {
+    return surface_pool_;
   }
 
   uint32_t GetGpuFd() const {
     return gpu_fd_;
   }
 
+  uint32_t GetWidth() const {
+    return width_;
+  }
+
   uint32_t GetHeight() const {
     return height_;
   }
 
+  // Forgets results of earlier test commits, needs to be called
+  // on modeset and whenever the display is (re)connected.
+  void InvalidateTestCache() {
+    test_cache_.Invalidate();
+    scaler_caps_.Reset();
+    rejected_target_formats_.clear();
+    rejected_scaled_planes_.clear();
+  }
+
+  uint64_t GetTestCacheHits() const {
+    return test_cache_.GetHits();
+  }
+
+  uint64_t GetTestCacheMisses() const {
+    return test_cache_.GetMisses();
+  }
+
+  // Number of test commits which reached the plane handler.
+  uint64_t GetTestCommitCount() const {
+    return test_commits_;
+  }
+
+  // Selects how layers are assigned to planes on full validation.
+  void SetPlaneAssignment(HWCPlaneAssignment assignment) {
+    plane_assignment_ = assignment;
+  }
+
+  HWCPlaneAssignment GetPlaneAssignment() const {
+    return plane_assignment_;
+  }
+
+  // Replaces cost model used by kPlaneAssignmentCost.
+  void SetPlaneCostModel(std::unique_ptr<PlaneCostModel> model) {
+    cost_model_ = std::move(model);
+  }
+
+  // kPlaneAssignmentCost moves a layer between scanout and GPU
+  // composition during full validation only once that was at least
+  // margin percent cheaper on frames consecutive frames. First fit
+  // validation and revalidation of cached planes keep a composited layer
+  // so until it could have been scanned out on frames validations in a
+  // row. frames of 0 disables this.
+  void SetPlacementHysteresis(uint32_t frames, uint32_t margin) {
+    placement_history_.SetThresholds(frames, margin);
+  }
+
+  // Records where layers ended up in composition, needs to be called
+  // after every validation. Returns number of layers which moved
+  // between scanout and GPU composition.
+  uint32_t UpdatePlacementHistory(const std::vector<OverlayLayer> &layers,
+                                  const DisplayPlaneStateList &composition) {
+    // Layers didn't choose GPU composition, nothing to hold them to.
+    if (forced_gpu_) {
+      forced_gpu_ = false;
+      placement_history_.Reset();
+      return 0;
+    }
+
+    return placement_history_.Update(layers, composition);
+  }
+
+  // Needs to be called for frames skipping UpdatePlacementHistory.
+  void SkipPlacementUpdate() {
+    placement_history_.SkipFrame();
+  }
+
+  uint64_t GetPlacementTransitions() const {
+    return placement_history_.GetTransitions();
+  }
+
  private:
   struct LayerResultCache {
     uint32_t last_transform_ = 0;
@@ -85,9 +206,72 @@ class DisplayPlaneManager {
     DisplayPlane *plane_;
   };
 
+  // Test commits commit_planes, unless this configuration was
+  // tested already.
+  bool TestCommit(const std::vector<OverlayPlane> &commit_planes) const;
+
+  // Assigns layers from first_layer on to planes not used by composition
+  // as per plane_assignment_. Returns false, leaving composition and
+  // commit_planes untouched, if no assignment was found or it failed
+  // test commit.
+  bool AssignPlanes(std::vector<OverlayLayer> &layers, size_t first_layer,
+                    std::vector<OverlayPlane> &commit_planes,
+                    DisplayPlaneStateList &composition,
+                    std::vector<OverlayLayer *> &cursor_layers,
+                    std::vector<NativeSurface *> &mark_later,
+                    bool *render_layers);
+
+  // Returns false if layers should stay where they were instead of
+  // taking the cheapest assignment, which is then in sticky_assignment_.
+  bool AllowPlacementChanges();
+
+  // Bisects for the largest number of bottom layers which can be
+  // scanned out directly, compositing the rest on the next plane.
+  // Result is stored in assignment_groups_. Returns false if not even
+  // compositing all layers passes a test commit. Used for full
+  // validation and for layers added on top of cached planes.
+  // Revalidation of cached planes still tests each plane on its own,
+  // as planes it moves to scanout are independent of each other rather
+  // than a prefix of the stack.
+  bool FindScanoutPrefix(std::vector<OverlayPlane> &commit_planes,
+                         DisplayPlaneStateList &composition,
+                         std::vector<NativeSurface *> &mark_later);
+
+  void BuildPrefixGroups(uint32_t prefix);
+
+  // Adds planes showing groups of assignment_layers_ to composition.
+  bool BuildComposition(const std::vector<PlaneAssignment::Group> &groups,
+                        std::vector<OverlayPlane> &commit_planes,
+                        DisplayPlaneStateList &composition,
+                        bool *render_layers);
+
+  // Undoes BuildComposition, commit_size and composition_size being
+  // sizes of commit_planes and composition before it was called.
+  void DropComposition(size_t commit_size, size_t composition_size,
+                       std::vector<OverlayPlane> &commit_planes,
+                       DisplayPlaneStateList &composition,
+                       std::vector<NativeSurface *> &mark_later);
+
   DisplayPlaneState *GetLastUsedOverlay(DisplayPlaneStateList &composition);
+
+  // Number of planes layers other than cursor can use.
+  size_t GetOverlayPlaneCount() const;
+
+  // Returns true if upper can be merged into lower.
+  bool CanConsolidate(const std::vector<OverlayLayer> &layers,
+                      DisplayPlaneState &lower,
+                      DisplayPlaneState &upper) const;
+
+  // Returns true if offscreen target of state, if any, can be
+  // scanned out by plane as is.
+  bool OffScreenTargetFitsPlane(DisplayPlaneState &state,
+                                DisplayPlane *plane);
+
+  // Returns true if layer can't be shown by target_plane. test_failed,
+  // if given, is set when only the test commit failed.
   bool FallbacktoGPU(DisplayPlane *target_plane, OverlayLayer *layer,
-                     const std::vector<OverlayPlane> &commit_planes) const;
+                     const std::vector<OverlayPlane> &commit_planes,
+                     bool *test_failed = NULL) const;
 
   void ValidateFinalLayers(std::vector<OverlayPlane> &commit_planes,
                            DisplayPlaneStateList &list,
@@ -97,7 +281,42 @@ class DisplayPlaneManager {
 
   void ResetPlaneTarget(DisplayPlaneState &plane, OverlayPlane &overlay_plane);
 
+  struct TargetModifiers {
+    const DisplayPlane *plane_;
+    uint32_t format_;
+    std::vector<uint64_t> modifiers_;
+  };
+
   void EnsureOffScreenTarget(DisplayPlaneState &plane);
+  void EnsureOffScreenTarget(DisplayPlaneState &plane, uint32_t format,
+                             float scale);
+
+  // Returns the narrowest format plane can scan out which still
+  // holds everything its source layers render into the target.
+  uint32_t GetOffScreenTargetFormat(
+      const DisplayPlaneState &plane,
+      const std::vector<OverlayLayer> &layers) const;
+
+  // Returns the fraction of display resolution offscreen target of
+  // plane can be composed at, to be upscaled by the plane on scanout.
+  // Only planes covering a large part of the display and showing
+  // nothing but upscaled layers use less than 1.
+  float GetOffScreenTargetScale(const DisplayPlaneState &plane,
+                                const std::vector<OverlayLayer> &layers,
+                                uint32_t format,
+                                uint32_t other_scaled_planes) const;
+
+  // Negotiates layouts offscreen targets of every overlay plane
+  // can be allocated with, best first.
+  void InitializeTargetModifiers();
+  const std::vector<uint64_t> &GetTargetModifiers(const DisplayPlane *plane,
+                                                  uint32_t format) const;
+
+  // Offscreen targets are sized to the part of the display
+  // their plane shows, times the scale they are composed at.
+  void GetOffScreenTargetSize(const DisplayPlaneState &plane, float scale,
+                              uint32_t *width, uint32_t *height) const;
+  bool OffScreenTargetsFit(const DisplayPlaneState &plane) const;
 
   void PreparePlaneForCursor(DisplayPlaneState *plane,
                              std::vector<NativeSurface *> &mark_later,
@@ -133,9 +352,35 @@ class DisplayPlaneManager {
   DisplayPlaneHandler *plane_handler_;
   ResourceManager *resource_manager_;
   DisplayPlane *cursor_plane_;
-  std::vector<std::unique_ptr<NativeSurface>> surfaces_;
+  SurfacePool surface_pool_;
   std::vector<std::unique_ptr<DisplayPlane>> overlay_planes_;
+  std::vector<TargetModifiers> target_modifiers_;
+  // Plane ids and offscreen target formats which failed test commits.
+  std::vector<std::pair<uint32_t, uint32_t>> rejected_target_formats_;
+  // Plane ids whose reduced resolution targets failed test commits.
+  std::vector<uint32_t> rejected_scaled_planes_;
   std::vector<LayerResultCache> results_cache_;
+  mutable PlaneTestCache test_cache_;
+  // Scratch lists reused every frame, so that checking offscreen
+  // targets doesn't allocate.
+  std::vector<OverlayPlane> target_commit_planes_;
+  mutable std::vector<uint32_t> target_formats_;
+  std::vector<uint64_t> plane_modifiers_;
+  ScalerCapabilities scaler_caps_;
+  mutable uint64_t test_commits_ = 0;
+  HWCPlaneAssignment plane_assignment_ = kPlaneAssignmentGreedy;
+  std::unique_ptr<PlaneCostModel> cost_model_;
+  PlaneAssignment assignment_;
+  PlaneAssignment sticky_assignment_;
+  PlacementHistory placement_history_;
+  // All layers were composited by ForceGpuForAllLayers since the last
+  // UpdatePlacementHistory.
+  bool forced_gpu_ = false;
+  bool assignment_scanout_[PlaneAssignment::kMaxLayers];
+  bool sticky_scanout_[PlaneAssignment::kMaxLayers];
+  std::vector<OverlayLayer *> assignment_layers_;
+  std::vector<DisplayPlane *> assignment_planes_;
+  std::vector<PlaneAssignment::Group> assignment_groups_;
 
   uint32_t width_;
   uint32_t height_;
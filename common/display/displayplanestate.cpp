@@ -15,6 +15,9 @@
 */
 
 #include "displayplanestate.h"
+
+#include <cmath>
+
 #include "hwctrace.h"
 
 namespace hwcomposer {
@@ -41,6 +44,10 @@ void DisplayPlaneState::CopyState(DisplayPlaneState &state) {
   // should be determined in DisplayQueue for every frame.
 }
 
+void DisplayPlaneState::DetachState() {
+  private_data_ = std::make_shared<DisplayPlanePrivateState>(*private_data_);
+}
+
 const HwcRect<int> &DisplayPlaneState::GetDisplayFrame() const {
   return private_data_->display_frame_;
 }
@@ -49,6 +56,20 @@ const HwcRect<float> &DisplayPlaneState::GetSourceCrop() const {
   return private_data_->source_crop_;
 }
 
+HwcRect<int> DisplayPlaneState::GetOffScreenTargetBounds() const {
+  const HwcRect<int> &display_frame = private_data_->display_frame_;
+  if (!private_data_->use_plane_scalar_)
+    return display_frame;
+
+  // Layers are still rendered at their display frame, while the plane
+  // scales the source crop. Cover both, starting from the display origin.
+  const HwcRect<float> &crop = private_data_->source_crop_;
+  int right = static_cast<int>(std::ceil(crop.right));
+  int bottom = static_cast<int>(std::ceil(crop.bottom));
+  return HwcRect<int>(0, 0, std::max(display_frame.right, right),
+                      std::max(display_frame.bottom, bottom));
+}
+
 void DisplayPlaneState::SetSourceCrop(const HwcRect<float> &crop) {
   private_data_->source_crop_ = crop;
 }
@@ -96,7 +117,31 @@ void DisplayPlaneState::AddLayer(const OverlayLayer *layer) {
 
 void DisplayPlaneState::ResetLayers(const std::vector<OverlayLayer> &layers,
                                     size_t remove_index) {
-  const std::vector<size_t> &current_layers = private_data_->source_layers_;
+  RemapLayers(layers, remove_index, SIZE_MAX, 0);
+}
+
+void DisplayPlaneState::RemapLayers(const std::vector<OverlayLayer> &layers,
+                                    size_t remove_index, size_t remove_end,
+                                    int shift) {
+  std::vector<size_t> &current_layers = private_data_->source_layers_;
+  bool removes_layers = false;
+  for (const size_t &index : current_layers) {
+    if (index >= remove_index && index < remove_end) {
+      removes_layers = true;
+      break;
+    }
+  }
+
+  // Same layers, only their position in the stack changed.
+  if (!removes_layers) {
+    for (size_t &index : current_layers) {
+      if (index >= remove_end)
+        index += shift;
+    }
+
+    return;
+  }
+
   std::vector<size_t> source_layers;
   bool had_cursor = private_data_->has_cursor_layer_;
   private_data_->has_cursor_layer_ = false;
@@ -105,15 +150,16 @@ void DisplayPlaneState::ResetLayers(const std::vector<OverlayLayer> &layers,
   bool use_scalar = false;
   bool has_video = false;
   for (const size_t &index : current_layers) {
-    if (index >= remove_index) {
+    if (index >= remove_index && index < remove_end) {
 #ifdef SURFACE_TRACING
-      ISURFACETRACE("Reset breaks index: %d remove_index %d \n", index,
+      ISURFACETRACE("Reset drops index: %d remove_index %d \n", index,
                     remove_index);
 #endif
-      break;
+      continue;
     }
 
-    const OverlayLayer &layer = layers.at(index);
+    const OverlayLayer &layer =
+        layers.at(index < remove_end ? index : index + shift);
     bool is_cursor = layer.IsCursorLayer();
     if (!had_cursor && is_cursor) {
       continue;
@@ -190,7 +236,7 @@ void DisplayPlaneState::ResetLayers(const std::vector<OverlayLayer> &layers,
     private_data_->type_ = DisplayPlanePrivateState::PlaneType::kNormal;
   }
 
-  std::vector<CompositionRegion>().swap(private_data_->composition_region_);
+  private_data_->composition_region_.Reset();
 }
 
 void DisplayPlaneState::UpdateDisplayFrame(const HwcRect<int> &display_frame) {
@@ -208,6 +254,10 @@ void DisplayPlaneState::UpdateDisplayFrame(const HwcRect<int> &display_frame) {
     private_data_->source_crop_ = HwcRect<float>(target_display_frame);
 }
 
+void DisplayPlaneState::MoveDisplayFrame(const HwcRect<int> &display_frame) {
+  private_data_->display_frame_ = display_frame;
+}
+
 void DisplayPlaneState::ForceGPURendering() {
   private_data_->state_ = DisplayPlanePrivateState::State::kRender;
 }
@@ -234,6 +284,8 @@ const OverlayLayer *DisplayPlaneState::GetOverlayLayer() const {
 
 void DisplayPlaneState::SetOffScreenTarget(NativeSurface *target) {
   private_data_->layer_ = target->GetLayer();
+  HwcRect<int> bounds = GetOffScreenTargetBounds();
+  target->SetOrigin(bounds.left, bounds.top);
   target->ResetDisplayFrame(private_data_->display_frame_);
   target->ResetSourceCrop(private_data_->source_crop_);
   private_data_->surfaces_.emplace(private_data_->surfaces_.begin(), target);
@@ -290,32 +342,36 @@ void DisplayPlaneState::RefreshSurfaces(bool clear_surface) {
   const HwcRect<int> &target_display_frame = private_data_->display_frame_;
   const HwcRect<float> &target_src_rect = private_data_->source_crop_;
   bool use_scalar = private_data_->use_plane_scalar_;
+  HwcRect<int> bounds = GetOffScreenTargetBounds();
   for (NativeSurface *surface : private_data_->surfaces_) {
+    surface->SetOrigin(bounds.left, bounds.top);
     surface->ResetDisplayFrame(target_display_frame);
     surface->ResetSourceCrop(target_src_rect);
-    surface->UpdateSurfaceDamage(target_src_rect, target_src_rect);
+    surface->ResetSurfaceDamage(target_src_rect);
     if (!surface->ClearSurface())
       surface->SetClearSurface(clear_surface);
     surface->GetLayer()->UsePlaneScalar(use_scalar);
   }
-
-  std::vector<CompositionRegion>().swap(private_data_->composition_region_);
 }
 
 DisplayPlane *DisplayPlaneState::GetDisplayPlane() const {
   return private_data_->plane_;
 }
 
+void DisplayPlaneState::SetDisplayPlane(DisplayPlane *plane) {
+  private_data_->plane_ = plane;
+}
+
 const std::vector<size_t> &DisplayPlaneState::GetSourceLayers() const {
   return private_data_->source_layers_;
 }
 
-std::vector<CompositionRegion> &DisplayPlaneState::GetCompositionRegion() {
+CompositionRegionCache &DisplayPlaneState::GetCompositionRegion() {
   return private_data_->composition_region_;
 }
 
 void DisplayPlaneState::ResetCompositionRegion() {
-  std::vector<CompositionRegion>().swap(private_data_->composition_region_);
+  private_data_->composition_region_.Reset();
 }
 
 bool DisplayPlaneState::IsCursorPlane() const {
@@ -44,6 +44,10 @@ class DisplayPlaneState {
   // Copies plane state from state.
   void CopyState(DisplayPlaneState &state);
 
+  // Gives this state its own copy of the data it shares with the state
+  // it was copied from, so changes to one don't show up in the other.
+  void DetachState();
+
   void SetSourceCrop(const HwcRect<float> &crop);
 
   void ResetSourceRectToDisplayFrame();
@@ -55,10 +59,21 @@ class DisplayPlaneState {
   void ResetLayers(const std::vector<OverlayLayer> &layers,
                    size_t remove_index);
 
+  // Like ResetLayers, but only drops source layers from remove_index
+  // up to remove_end. Layers from remove_end on are kept and their
+  // index moved by shift, as layers were added or removed below them.
+  // If no layer is dropped, only indices are updated.
+  void RemapLayers(const std::vector<OverlayLayer> &layers,
+                   size_t remove_index, size_t remove_end, int shift);
+
   // Updates Display frame rect of this plane to include
   // display_frame.
   void UpdateDisplayFrame(const HwcRect<int> &display_frame);
 
+  // Moves this plane to display_frame. Should only be used for planes
+  // scanning out a layer whose size is unchanged.
+  void MoveDisplayFrame(const HwcRect<int> &display_frame);
+
   // Forces GPU Rendering of content for this plane.
   void ForceGPURendering();
 
@@ -87,6 +102,9 @@ class DisplayPlaneState {
 
   const HwcRect<float> &GetSourceCrop() const;
 
+  // Part of the display offscreen targets of this plane need to cover.
+  HwcRect<int> GetOffScreenTargetBounds() const;
+
   bool SurfaceRecycled() const;
 
   const OverlayLayer *GetOverlayLayer() const;
@@ -111,11 +129,16 @@ class DisplayPlaneState {
 
   DisplayPlane *GetDisplayPlane() const;
 
+  // Moves this plane's content to plane. Used when planes
+  // below it were consolidated. Call DetachState first if the
+  // previous frame's state must keep its plane.
+  void SetDisplayPlane(DisplayPlane *plane);
+
   // Returns source layers for this plane.
   const std::vector<size_t> &GetSourceLayers() const;
 
-  // Returns composition region used by this plane.
-  std::vector<CompositionRegion> &GetCompositionRegion();
+  // Returns composition regions used by this plane.
+  CompositionRegionCache &GetCompositionRegion();
 
   // Resets composition region to null.
   void ResetCompositionRegion();
@@ -187,7 +210,7 @@ class DisplayPlaneState {
     HwcRect<int> display_frame_;
     HwcRect<float> source_crop_;
     std::vector<size_t> source_layers_;
-    std::vector<CompositionRegion> composition_region_;
+    CompositionRegionCache composition_region_;
 
     bool use_plane_scalar_ = false;
     // Even if layer can be scanned out
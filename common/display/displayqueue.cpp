@@ -61,6 +61,13 @@ DisplayQueue::DisplayQueue(uint32_t gpu_fd, bool disable_overlay,
 }
 
 DisplayQueue::~DisplayQueue() {
+  for (int32_t fence : clone_release_fences_) {
+    if (fence > 0)
+      close(fence);
+  }
+
+  if (kms_fence_ > 0)
+    close(kms_fence_);
 }
 
 bool DisplayQueue::Initialize(uint32_t pipe, uint32_t width, uint32_t height,
@@ -77,9 +84,16 @@ bool DisplayQueue::Initialize(uint32_t pipe, uint32_t width, uint32_t height,
     return false;
   }
 
+  display_plane_manager_->SetPlaneAssignment(plane_assignment_);
+  display_plane_manager_->SetOffScreenTargetBudget(offscreen_budget_,
+                                                   share_offscreen_budget_);
+  display_plane_manager_->SetPlacementHysteresis(hysteresis_frames_,
+                                                 hysteresis_margin_);
+
   ResetQueue();
   vblank_handler_->SetPowerMode(kOff);
   vblank_handler_->Init(gpu_fd_, pipe);
+
   return true;
 }
 
@@ -115,8 +129,43 @@ void DisplayQueue::RotateDisplay(HWCRotation rotation) {
   rotation_ = rotation;
 }
 
+bool DisplayQueue::CanKeepPlanesAroundEdit(
+    const std::vector<OverlayLayer>& layers, const LayerStackEdit& edit) {
+  if (edit.begin_ == 0)
+    return false;
+
+  // Added layers go to the plane below them, don't take a plane
+  // away from layers which want one of their own.
+  for (uint32_t i = edit.begin_; i < edit.end_; i++) {
+    const OverlayLayer& layer = layers.at(i);
+    if (layer.PreferSeparatePlane() || layer.IsCursorLayer())
+      return false;
+  }
+
+  bool found_below = edit.end_ == edit.begin_;
+  for (DisplayPlaneState& plane : previous_plane_state_) {
+    const std::vector<size_t>& source_layers = plane.GetSourceLayers();
+    // Primary must keep showing something, see GetCachedLayers.
+    if (&plane == &previous_plane_state_.front() &&
+        source_layers.front() >= edit.begin_ &&
+        source_layers.back() < edit.previous_end_)
+      return false;
+
+    if (found_below || source_layers.back() != edit.begin_ - 1)
+      continue;
+
+    found_below = plane.NeedsOffScreenComposition() && plane.CanSquash() &&
+                  !plane.IsCursorPlane() && !plane.IsUsingPlaneScalar();
+    if (!found_below)
+      return false;
+  }
+
+  return found_below;
+}
+
 void DisplayQueue::GetCachedLayers(const std::vector<OverlayLayer>& layers,
                                    int remove_index,
+                                   const LayerStackEdit* edit,
                                    DisplayPlaneStateList* composition,
                                    bool* check_plane, bool* render_layers,
                                    bool* can_ignore_commit,
@@ -131,7 +180,66 @@ void DisplayQueue::GetCachedLayers(const std::vector<OverlayLayer>& layers,
     composition->emplace_back();
     DisplayPlaneState& last_plane = composition->back();
     last_plane.CopyState(previous_plane);
-    if (remove_index != -1) {
+    if (edit) {
+      const std::vector<size_t>& source_layers = last_plane.GetSourceLayers();
+      bool removed = false;
+      bool moved = false;
+      for (const size_t& index : source_layers) {
+        if (index >= edit->previous_end_) {
+          moved = true;
+        } else if (index >= edit->begin_) {
+          removed = true;
+        }
+      }
+
+      bool add = edit->end_ > edit->begin_ &&
+                 source_layers.back() == edit->begin_ - 1;
+      int shift = static_cast<int>(edit->end_) -
+                  static_cast<int>(edit->previous_end_);
+      if (removed || add || (moved && shift)) {
+        // Last frame's state still describes what is on screen.
+        last_plane.DetachState();
+        last_plane.RemapLayers(layers, edit->begin_, edit->previous_end_,
+                               shift);
+      }
+
+      if (removed || add)
+        ignore_commit = false;
+
+      if (last_plane.GetSourceLayers().empty()) {
+        display_plane_manager_->MarkSurfacesForRecycling(
+            &last_plane, surfaces_not_inuse_, false);
+        last_plane.GetDisplayPlane()->SetInUse(false);
+        composition->pop_back();
+        continue;
+      }
+
+      if (add) {
+        for (uint32_t i = edit->begin_; i < edit->end_; i++) {
+          last_plane.AddLayer(&(layers.at(i)));
+        }
+
+        last_plane.RevalidationDone();
+      }
+
+      // Composited planes which lost or gained layers need to be
+      // rendered again from scratch.
+      if (removed || add) {
+        clear_surface = true;
+        if (last_plane.NeedsOffScreenComposition())
+          last_plane.ResetCompositionRegion();
+      }
+
+      if (last_plane.IsRevalidationNeeded()) {
+        const OverlayLayer* layer =
+            &(layers.at(last_plane.GetSourceLayers().front()));
+        if (layer->CanScanOut() && layer->IsGpuRendered()) {
+          *check_plane = true;
+        } else {
+          last_plane.RevalidationDone();
+        }
+      }
+    } else if (remove_index != -1) {
       const std::vector<size_t>& source_layers = last_plane.GetSourceLayers();
       const size_t& index = source_layers.at(source_layers.size() - 1);
       size_t threshold = static_cast<size_t>(remove_index);
@@ -189,7 +297,7 @@ void DisplayQueue::GetCachedLayers(const std::vector<OverlayLayer>& layers,
     }
 
     if (last_plane.NeedsOffScreenComposition()) {
-      HwcRect<int> surface_damage = HwcRect<int>(0, 0, 0, 0);
+      DamageRegion surface_damage;
       bool content_changed = false;
       bool update_rect = false;
       if (remove_index == -1) {
@@ -212,16 +320,13 @@ void DisplayQueue::GetCachedLayers(const std::vector<OverlayLayer>& layers,
           }
 
           if (!clear_surface && layer.HasLayerContentChanged()) {
-            const HwcRect<int>& damage = layer.GetSurfaceDamage();
-            if (content_changed) {
-              surface_damage.left = std::min(surface_damage.left, damage.left);
-              surface_damage.top = std::min(surface_damage.top, damage.top);
-              surface_damage.right =
-                  std::max(surface_damage.right, damage.right);
-              surface_damage.bottom =
-                  std::max(surface_damage.bottom, damage.bottom);
+            const DamageRegion& damage = layer.GetSurfaceDamage();
+            // Content can change without the buffer being damaged,
+            // i.e. alpha. Refresh whole layer in that case.
+            if (damage.IsEmpty()) {
+              surface_damage.Union(layer.GetDisplayFrame());
             } else {
-              surface_damage = damage;
+              surface_damage.Union(damage);
             }
             content_changed = true;
           }
@@ -251,21 +356,13 @@ void DisplayQueue::GetCachedLayers(const std::vector<OverlayLayer>& layers,
       if (content_changed) {
         if (last_plane.GetSurfaces().size() == 3) {
           if (!clear_surface) {
-            HwcRect<int> last_damage;
             const std::vector<NativeSurface*>& surfaces =
                 last_plane.GetSurfaces();
             // Calculate Surface damage for the current surface. This should
             // be always equal to current surface damage + damage of last
             // two surfaces.(We use tripple buffering for our internal surfaces)
-            last_damage = surfaces.at(1)->GetLastSurfaceDamage();
-            const HwcRect<int>& previous_damage =
-                surfaces.at(2)->GetLastSurfaceDamage();
-            last_damage.left = std::min(previous_damage.left, last_damage.left);
-            last_damage.top = std::min(previous_damage.top, last_damage.top);
-            last_damage.right =
-                std::max(previous_damage.right, last_damage.right);
-            last_damage.bottom =
-                std::max(previous_damage.bottom, last_damage.bottom);
+            DamageRegion last_damage = surfaces.at(1)->GetLastSurfaceDamage();
+            last_damage.Union(surfaces.at(2)->GetLastSurfaceDamage());
             surfaces.at(0)->UpdateSurfaceDamage(surface_damage, last_damage);
           }
         } else {
@@ -282,17 +379,12 @@ void DisplayQueue::GetCachedLayers(const std::vector<OverlayLayer>& layers,
     } else {
       const OverlayLayer* layer =
           &(layers.at(last_plane.GetSourceLayers().front()));
-      OverlayBuffer* buffer = layer->GetBuffer();
-      if (buffer->GetFb() == 0) {
-        buffer->CreateFrameBuffer(gpu_fd_);
-
-        // FB creation failed, we need to re-validate the
-        // whole commit.
-        if (buffer->GetFb() == 0) {
-          *force_full_validation = true;
-          ignore_commit = false;
-          break;
-        }
+      // FB creation failed, we need to re-validate the
+      // whole commit.
+      if (!display_->CreateFrameBuffer(layer->GetBuffer())) {
+        *force_full_validation = true;
+        ignore_commit = false;
+        break;
       }
 
       last_plane.SetOverlayLayer(layer);
@@ -308,7 +400,9 @@ void DisplayQueue::GetCachedLayers(const std::vector<OverlayLayer>& layers,
 
   *can_ignore_commit = ignore_commit;
 
-  // Check if we can squash the last overlay (Before Cursor Plane).
+  // Check if we can squash the last overlay (Before Cursor Plane). Only
+  // the top plane is freed here, so no other plane moves and nothing
+  // needs a test commit.
   if (check_to_squash) {
     size_t size = composition->size();
     if (composition->back().IsCursorPlane()) {
@@ -347,9 +441,18 @@ bool DisplayQueue::QueueUpdate(std::vector<HwcLayer*>& source_layers,
     return true;
   }
 
+  ScopedFrameTiming frame_timing(frame_timing_);
+  int64_t stage_start = FrameTimingTracker::Now();
+  uint64_t test_commits = display_plane_manager_->GetTestCommitCount();
+
   size_t size = source_layers.size();
   size_t previous_size = in_flight_layers_.size();
-  std::vector<OverlayLayer> layers;
+  // Layers and planes for this frame are built in containers owned by the
+  // queue, which are swapped with in flight state once committed. This
+  // way, we re-use their storage and don't allocate in steady state.
+  std::vector<OverlayLayer>& layers = current_layers_;
+  layers.clear();
+  layers.reserve(size);
   int remove_index = -1;
   int add_index = -1;
   bool idle_frame = tracker.RenderIdleMode() || idle_update;
@@ -358,24 +461,36 @@ bool DisplayQueue::QueueUpdate(std::vector<HwcLayer*>& source_layers,
   bool validate_layers = tracker.RevalidateLayers() ||
                          last_commit_failed_update_ ||
                          previous_plane_state_.empty();
+  // Mode might have changed, results of earlier test
+  // commits can't be trusted anymore.
+  if (state_ & kConfigurationChanged)
+    display_plane_manager_->InvalidateTestCache();
+
   *retire_fence = -1;
   uint32_t z_order = 0;
   bool has_video_layer = false;
   bool re_validate_commit = false;
+  // Source display owns release fences of layers it shares with its
+  // clones, which may be presented concurrently with each other.
+  bool cloned_mode = state_ & kClonedMode;
 
+  // Layers are matched with the ones of last frame by their id, so that
+  // adding or removing a layer doesn't change state of the others.
+  layer_diff_.Reset(in_flight_layers_);
   for (size_t layer_index = 0; layer_index < size; layer_index++) {
     HwcLayer* layer = source_layers.at(layer_index);
-    layer->SetReleaseFence(-1);
+    if (!cloned_mode)
+      layer->SetReleaseFence(-1);
+
     if (!layer->IsVisible())
       continue;
 
     layers.emplace_back();
     OverlayLayer* overlay_layer = &(layers.back());
     OverlayLayer* previous_layer = NULL;
-    if (previous_size > z_order) {
-      previous_layer = &(in_flight_layers_.at(z_order));
-    } else if (add_index == -1) {
-      add_index = z_order;
+    int previous_index = layer_diff_.Find(layer->GetLayerId());
+    if (previous_index != -1) {
+      previous_layer = &(in_flight_layers_.at(previous_index));
     }
 
     if (scaling_tracker_.scaling_state_ == ScalingTracker::kNeedsScaling) {
@@ -415,63 +530,81 @@ bool DisplayQueue::QueueUpdate(std::vector<HwcLayer*>& source_layers,
       re_validate_commit = true;
     }
 
+    layer_diff_.Add(previous_index);
     z_order++;
-    if (add_index == 0 || validate_layers ||
-        ((add_index != -1) && (remove_index != -1))) {
+    if (validate_layers || !previous_layer)
       continue;
-    }
-
-    // Handle case where Cursor layer has been destroyed/created or has changed
-    // z-order.
-    if (previous_layer &&
-        previous_layer->IsCursorLayer() != overlay_layer->IsCursorLayer()) {
-      if (remove_index == -1)
-        remove_index = previous_layer->GetZorder();
 
+    // Handle case where Cursor layer has been destroyed/created.
+    if (previous_layer->IsCursorLayer() != overlay_layer->IsCursorLayer()) {
       // Treat this case as if a new layer has been created.
-      if (add_index == -1)
-        add_index = overlay_layer->GetZorder();
-
+      layer_diff_.MarkChanged(overlay_layer->GetZorder());
 #ifdef SURFACE_TRACING
-      ISURFACETRACE(
-          "Cursor layer has changed between frames: remove_index: %d "
-          "add_index: "
-          "%d \n",
-          remove_index, add_index);
+      ISURFACETRACE("Cursor layer has changed between frames: index: %d \n",
+                    overlay_layer->GetZorder());
 #endif
     }
 
-    // Handle case where Media layer has been destroyed/created or has changed
-    // z-order.
-    if (previous_layer &&
-        previous_layer->IsVideoLayer() != overlay_layer->IsVideoLayer()) {
-      if (remove_index == -1)
-        remove_index = previous_layer->GetZorder();
-
+    // Handle case where Media layer has been destroyed/created.
+    if (previous_layer->IsVideoLayer() != overlay_layer->IsVideoLayer()) {
       // Treat this case as if a new layer has been created.
-      if (add_index == -1)
-        add_index = overlay_layer->GetZorder();
+      layer_diff_.MarkChanged(overlay_layer->GetZorder());
 #ifdef SURFACE_TRACING
-      ISURFACETRACE(
-          "Video layer has changed between frames: remove_index: %d add_index: "
-          "%d \n",
-          remove_index, add_index);
+      ISURFACETRACE("Video layer has changed between frames: index: %d \n",
+                    overlay_layer->GetZorder());
 #endif
     }
   }
 
+  frame_timing_.AddStageTime(kFrameStageLayerInit, stage_start);
+
+  if (present_trace_) {
+    uint32_t flags = 0;
+    if (idle_update)
+      flags |= kTraceIdleUpdate;
+
+    if (handle_constraints)
+      flags |= kTraceHandleConstraints;
+
+    present_trace_->WriteFrame(source_layers, layers,
+                               display_plane_manager_->GetWidth(),
+                               display_plane_manager_->GetHeight(),
+                               stage_start, flags);
+  }
+
   // We may have skipped layers which are not visible.
   size = layers.size();
-  if ((add_index == 0) || validate_layers) {
+  // Layers and planes below first changed index can be re-used as is.
+  // If layers above the change are the same as last frame, their planes
+  // are kept too and only layers which were added or removed handled.
+  // Otherwise, planes showing layers at or above it are dropped and
+  // these layers validated again. A layer added on top of the stack
+  // doesn't affect any of the existing planes.
+  int changed_index = layer_diff_.GetFirstChangedIndex();
+  LayerStackEdit edit;
+  bool keep_planes_above = false;
+  if (changed_index == 0 || validate_layers) {
     // If index is zero, no point trying for incremental validation.
     validate_layers = true;
-  } else if (previous_size > size) {
-    if (remove_index == -1) {
-      remove_index = size;
-    } else if (add_index != -1) {
-      remove_index = std::min(add_index, remove_index);
-    }
+  } else if (layer_diff_.GetEdit(&edit) &&
+             CanKeepPlanesAroundEdit(layers, edit)) {
+    keep_planes_above = true;
+  } else if (changed_index != -1) {
+    if (static_cast<size_t>(changed_index) < previous_size)
+      remove_index = changed_index;
+
+    if (static_cast<size_t>(changed_index) < size)
+      add_index = changed_index;
+  }
+
+#ifdef SURFACE_TRACING
+  if (changed_index != -1) {
+    ISURFACETRACE(
+        "Layer stack changed at: %d Added layers: %d Removed layers: %d \n",
+        changed_index, layer_diff_.GetAddedLayers(),
+        layer_diff_.GetRemovedLayers());
   }
+#endif
 
 #ifdef SURFACE_TRACING
   if ((remove_index != -1) || (add_index != -1)) {
@@ -490,7 +623,9 @@ bool DisplayQueue::QueueUpdate(std::vector<HwcLayer*>& source_layers,
   }
 #endif
 
-  DisplayPlaneStateList current_composition_planes;
+  DisplayPlaneStateList& current_composition_planes =
+      current_composition_planes_;
+  current_composition_planes.clear();
   bool render_layers;
   bool force_media_composition = false;
   bool requested_video_effect = false;
@@ -503,6 +638,30 @@ bool DisplayQueue::QueueUpdate(std::vector<HwcLayer*>& source_layers,
   }
   video_lock_.unlock();
 
+  // Planes of the last frame don't know where MoveCursor left the
+  // cursor. If its layer is somewhere else now, this frame must be
+  // committed even if no layer changed, so the cursor goes back to it.
+  bool cursor_misplaced = false;
+  int32_t cursor_x = 0;
+  int32_t cursor_y = 0;
+  if (TakeCursorPosition(&cursor_x, &cursor_y)) {
+    DisplayPlaneState* cursor_plane = GetCursorOnlyPlane();
+    size_t index = cursor_plane ? cursor_plane->GetSourceLayers().front() : 0;
+    cursor_misplaced =
+        !cursor_plane || index >= layers.size() ||
+        layers.at(index).GetDisplayFrame().left != cursor_x ||
+        layers.at(index).GetDisplayFrame().top != cursor_y;
+  }
+
+  // Nothing but the cursor moved, only update position of its plane.
+  if (!validate_layers && changed_index == -1 && !re_validate_commit &&
+      !force_media_composition && !idle_frame &&
+      !(state_ & kNeedsColorCorrection) &&
+      MoveCursorPlane(layers, source_layers, retire_fence)) {
+    display_plane_manager_->SkipPlacementUpdate();
+    return true;
+  }
+
   bool composition_passed = true;
   bool disable_ovelays = state_ & kDisableOverlayUsage;
 
@@ -513,10 +672,16 @@ bool DisplayQueue::QueueUpdate(std::vector<HwcLayer*>& source_layers,
     // if not continue showing the current buffer.
     bool check_plane = false;
     bool commit_checked = false;
-    GetCachedLayers(layers, remove_index, &current_composition_planes,
-                    &check_plane, &render_layers, &can_ignore_commit,
-                    &validate_layers);
+    stage_start = FrameTimingTracker::Now();
+    GetCachedLayers(layers, remove_index, keep_planes_above ? &edit : NULL,
+                    &current_composition_planes, &check_plane,
+                    &render_layers, &can_ignore_commit, &validate_layers);
+    // Planes around the edit were never shown together.
+    if (keep_planes_above)
+      re_validate_commit = true;
+    frame_timing_.AddStageTime(kFrameStageCachedLayers, stage_start);
 
+    stage_start = FrameTimingTracker::Now();
     if (!validate_layers && (add_index > 0 || check_plane)) {
       bool render_cursor = display_plane_manager_->ValidateLayers(
           layers, add_index, check_plane, disable_ovelays, &commit_checked,
@@ -537,6 +702,7 @@ bool DisplayQueue::QueueUpdate(std::vector<HwcLayer*>& source_layers,
           layers, current_composition_planes, &validate_layers);
       can_ignore_commit = false;
     }
+    frame_timing_.AddStageTime(kFrameStageValidate, stage_start);
 
     if (!validate_layers) {
       if (force_media_composition) {
@@ -549,8 +715,16 @@ bool DisplayQueue::QueueUpdate(std::vector<HwcLayer*>& source_layers,
         can_ignore_commit = false;
       }
 
+      if (cursor_misplaced)
+        can_ignore_commit = false;
+
       if (can_ignore_commit) {
+        display_plane_manager_->SkipPlacementUpdate();
+        frame_timing_.AddTestCommits(
+            display_plane_manager_->GetTestCommitCount() - test_commits);
         in_flight_layers_.swap(layers);
+        layers.clear();
+        current_composition_planes.clear();
         return true;
       }
     }
@@ -568,9 +742,11 @@ bool DisplayQueue::QueueUpdate(std::vector<HwcLayer*>& source_layers,
     bool force_gpu = disable_ovelays || idle_frame ||
                      (state_ & kConfigurationChanged && (layers.size() > 1));
     bool test_commit = false;
+    stage_start = FrameTimingTracker::Now();
     render_layers = display_plane_manager_->ValidateLayers(
         layers, add_index, false, force_gpu, &test_commit,
         current_composition_planes, previous_plane_state_, surfaces_not_inuse_);
+    frame_timing_.AddStageTime(kFrameStageValidate, stage_start);
     // If Video effects need to be applied, let's make sure
     // we go through the composition pass for Video Layers.
     if (force_media_composition && requested_video_effect) {
@@ -581,18 +757,37 @@ bool DisplayQueue::QueueUpdate(std::vector<HwcLayer*>& source_layers,
     state_ &= ~kConfigurationChanged;
   }
 
+  frame_timing_.AddPlacementTransitions(
+      display_plane_manager_->UpdatePlacementHistory(
+          layers, current_composition_planes));
+
+  // Offscreen targets only cover the part of the display shown by
+  // their plane, make sure planes didn't outgrow them and their
+  // format still suits the layers they show.
+  if (display_plane_manager_->EnsureOffScreenTargetsFit(
+          current_composition_planes, layers, surfaces_not_inuse_))
+    render_layers = true;
+
+  frame_timing_.AddTestCommits(display_plane_manager_->GetTestCommitCount() -
+                               test_commits);
+  frame_timing_.AddTargetBytesSaved(display_plane_manager_->GetTargetBytesSaved(
+      current_composition_planes, render_layers));
+
   DUMP_CURRENT_COMPOSITION_PLANES();
   DUMP_CURRENT_LAYER_PLANE_COMBINATIONS();
   DUMP_CURRENT_DUPLICATE_LAYER_COMBINATIONS();
   // Handle any 3D Composition.
   if (render_layers) {
+    stage_start = FrameTimingTracker::Now();
     if (!compositor_.BeginFrame(disable_ovelays)) {
       ETRACE("Failed to initialize compositor.");
       composition_passed = false;
     }
 
     if (composition_passed) {
-      std::vector<HwcRect<int>> layers_rects;
+      std::vector<HwcRect<int>>& layers_rects = layers_rects_;
+      layers_rects.clear();
+      layers_rects.reserve(size);
       for (size_t layer_index = 0; layer_index < size; layer_index++) {
         const OverlayLayer& layer = layers.at(layer_index);
         layers_rects.emplace_back(layer.GetDisplayFrame());
@@ -604,20 +799,22 @@ bool DisplayQueue::QueueUpdate(std::vector<HwcLayer*>& source_layers,
         composition_passed = false;
       }
     }
+    frame_timing_.AddStageTime(kFrameStageComposition, stage_start);
   }
 
   if (!composition_passed) {
     last_commit_failed_update_ = true;
+    layers.clear();
+    current_composition_planes.clear();
     return false;
   }
 
   int32_t fence = 0;
+  BeginCommit();
 #ifndef ENABLE_DOUBLE_BUFFERING
-  if (kms_fence_ > 0) {
-    HWCPoll(kms_fence_, -1);
-    close(kms_fence_);
-    kms_fence_ = 0;
-  }
+  stage_start = FrameTimingTracker::Now();
+  WaitForKMSFence();
+  frame_timing_.AddStageTime(kFrameStageFenceWait, stage_start);
 #endif
   if (state_ & kNeedsColorCorrection) {
     display_->SetColorCorrection(gamma_, contrast_, brightness_);
@@ -626,12 +823,17 @@ bool DisplayQueue::QueueUpdate(std::vector<HwcLayer*>& source_layers,
     state_ &= ~kNeedsColorCorrection;
   }
 
+  stage_start = FrameTimingTracker::Now();
   composition_passed =
       display_->Commit(current_composition_planes, previous_plane_state_,
                        disable_ovelays, &fence);
+  frame_timing_.AddStageTime(kFrameStageCommit, stage_start);
 
   if (!composition_passed) {
+    EndCommit(false);
     last_commit_failed_update_ = true;
+    layers.clear();
+    current_composition_planes.clear();
     return false;
   }
 
@@ -646,13 +848,16 @@ bool DisplayQueue::QueueUpdate(std::vector<HwcLayer*>& source_layers,
       mark_not_inuse_.at(i)->SetInUse(false);
     }
 
-    std::vector<NativeSurface*>().swap(mark_not_inuse_);
+    mark_not_inuse_.clear();
   }
 
   in_flight_layers_.swap(layers);
+  layers.clear();
 
   // Swap current and previous composition results.
   previous_plane_state_.swap(current_composition_planes);
+  current_composition_planes.clear();
+  EndCommit(true);
 
   // Set Age for all offscreen surfaces.
   UpdateOnScreenSurfaces();
@@ -661,12 +866,12 @@ bool DisplayQueue::QueueUpdate(std::vector<HwcLayer*>& source_layers,
   // use next frame.
   if (!surfaces_not_inuse_.empty()) {
     size_t size = surfaces_not_inuse_.size();
-    std::vector<NativeSurface*> temp;
+    size_t still_in_use = 0;
     for (uint32_t i = 0; i < size; i++) {
       NativeSurface* surface = surfaces_not_inuse_.at(i);
       uint32_t age = surface->GetSurfaceAge();
       if (age > 0) {
-        temp.emplace_back(surface);
+        surfaces_not_inuse_.at(still_in_use++) = surface;
         surface->SetSurfaceAge(surface->GetSurfaceAge() - 1);
         surface->SetInUse(true);
       } else {
@@ -674,7 +879,7 @@ bool DisplayQueue::QueueUpdate(std::vector<HwcLayer*>& source_layers,
       }
     }
 
-    surfaces_not_inuse_.swap(temp);
+    surfaces_not_inuse_.resize(still_in_use);
   }
 
   if (idle_frame) {
@@ -686,24 +891,24 @@ bool DisplayQueue::QueueUpdate(std::vector<HwcLayer*>& source_layers,
   } else {
     state_ &= ~kLastFrameIdleUpdate;
     ReleaseSurfacesAsNeeded(validate_layers);
+    display_plane_manager_->TrimOffScreenTargets();
   }
 
   if (fence > 0) {
-    if (!(state_ & kClonedMode)) {
+    if (!cloned_mode)
       *retire_fence = dup(fence);
-    }
-
-    kms_fence_ = fence;
 
     SetReleaseFenceToLayers(fence, source_layers);
+    kms_fence_ = fence;
   }
 
+  // Clones can be updated while we wait for this frame.
+  display_->StartClonePresentation(source_layers);
+
 #ifdef ENABLE_DOUBLE_BUFFERING
-  if (kms_fence_ > 0) {
-    HWCPoll(kms_fence_, -1);
-    close(kms_fence_);
-    kms_fence_ = 0;
-  }
+  stage_start = FrameTimingTracker::Now();
+  WaitForKMSFence();
+  frame_timing_.AddStageTime(kFrameStageFenceWait, stage_start);
 #endif
 
   // Let Display handle any lazy initalizations.
@@ -715,6 +920,231 @@ bool DisplayQueue::QueueUpdate(std::vector<HwcLayer*>& source_layers,
   return true;
 }
 
+bool DisplayQueue::MoveCursorPlane(std::vector<OverlayLayer>& layers,
+                                   std::vector<HwcLayer*>& source_layers,
+                                   int32_t* retire_fence) {
+  size_t size = layers.size();
+  if (size != in_flight_layers_.size())
+    return false;
+
+  int cursor_index = -1;
+  for (size_t layer_index = 0; layer_index < size; layer_index++) {
+    const OverlayLayer& layer = layers.at(layer_index);
+    const OverlayLayer& last_layer = in_flight_layers_.at(layer_index);
+    if (layer.GetBuffer() != last_layer.GetBuffer() ||
+        layer.HasSourceRectChanged() || layer.NeedsToClearSurface())
+      return false;
+
+    if (!layer.HasDimensionsChanged()) {
+      if (layer.HasLayerContentChanged())
+        return false;
+
+      continue;
+    }
+
+    if (!layer.IsCursorLayer() || cursor_index != -1)
+      return false;
+
+    // Cursor content is marked as changed whenever it moves, check
+    // what was actually updated by the client.
+    const HwcLayer* source_layer = source_layers.at(layer.GetLayerIndex());
+    if (source_layer->HasLayerContentChanged() ||
+        layer.GetAlpha() != last_layer.GetAlpha() ||
+        layer.GetBlending() != last_layer.GetBlending())
+      return false;
+
+    cursor_index = layer_index;
+  }
+
+  if (cursor_index == -1)
+    return false;
+
+  DisplayPlaneState* cursor_plane = GetCursorOnlyPlane();
+  if (!cursor_plane ||
+      cursor_plane->GetSourceLayers().front() !=
+          static_cast<size_t>(cursor_index))
+    return false;
+
+  // A resized cursor needs new plane size and possibly scaling.
+  const HwcRect<int>& last_frame = cursor_plane->GetDisplayFrame();
+  const HwcRect<int>& frame = layers.at(cursor_index).GetDisplayFrame();
+  if ((frame.right - frame.left) != (last_frame.right - last_frame.left) ||
+      (frame.bottom - frame.top) != (last_frame.bottom - last_frame.top))
+    return false;
+
+  BeginCommit();
+  int64_t stage_start;
+#ifndef ENABLE_DOUBLE_BUFFERING
+  stage_start = FrameTimingTracker::Now();
+  WaitForKMSFence();
+  frame_timing_.AddStageTime(kFrameStageFenceWait, stage_start);
+#endif
+
+  int32_t fence = -1;
+  stage_start = FrameTimingTracker::Now();
+  bool moved = display_->CommitPlanePosition(cursor_plane->GetDisplayPlane(),
+                                             frame.left, frame.top, &fence);
+  frame_timing_.AddStageTime(kFrameStageCommit, stage_start);
+  if (!moved) {
+    EndCommit(false);
+    return false;
+  }
+
+  // Everything else stays on screen as is, just point planes scanning
+  // out layers directly to this frame's layers.
+  cursor_plane->MoveDisplayFrame(frame);
+  for (DisplayPlaneState& plane : previous_plane_state_) {
+    if (!plane.NeedsOffScreenComposition())
+      plane.SetOverlayLayer(&layers.at(plane.GetSourceLayers().front()));
+  }
+
+  in_flight_layers_.swap(layers);
+  layers.clear();
+  EndCommit(true);
+
+  if (fence > 0) {
+    if (!(state_ & kClonedMode))
+      *retire_fence = dup(fence);
+
+    SetReleaseFenceToLayers(fence, source_layers);
+    kms_fence_ = fence;
+  }
+
+  display_->StartClonePresentation(source_layers);
+
+#ifdef ENABLE_DOUBLE_BUFFERING
+  stage_start = FrameTimingTracker::Now();
+  WaitForKMSFence();
+  frame_timing_.AddStageTime(kFrameStageFenceWait, stage_start);
+#endif
+  return true;
+}
+
+DisplayPlaneState* DisplayQueue::GetCursorOnlyPlane() {
+  for (DisplayPlaneState& plane : previous_plane_state_) {
+    if (plane.IsCursorPlane() && !plane.NeedsOffScreenComposition() &&
+        plane.GetSourceLayers().size() == 1)
+      return &plane;
+  }
+
+  return NULL;
+}
+
+void DisplayQueue::BeginCommit() {
+  std::lock_guard<std::mutex> lock(cursor_lock_);
+  committing_ = true;
+  // This frame shows the cursor where its layer is.
+  cursor_pending_ = false;
+}
+
+void DisplayQueue::EndCommit(bool succeeded) {
+  DisplayPlaneState* plane = succeeded ? GetCursorOnlyPlane() : NULL;
+  std::lock_guard<std::mutex> lock(cursor_lock_);
+  committing_ = false;
+  cursor_plane_ = plane ? plane->GetDisplayPlane() : NULL;
+  if (!cursor_plane_) {
+    cursor_moved_ = false;
+    cursor_pending_ = false;
+    return;
+  }
+
+  // Cursor was moved while this frame was being committed.
+  ApplyPendingCursorPosition();
+}
+
+void DisplayQueue::WaitForKMSFence() {
+  if (kms_fence_ <= 0)
+    return;
+
+  HWCPoll(kms_fence_, -1);
+  close(kms_fence_);
+  kms_fence_ = 0;
+
+  // Plane position can be updated again now that the flip is done.
+  std::lock_guard<std::mutex> lock(cursor_lock_);
+  ApplyPendingCursorPosition();
+}
+
+void DisplayQueue::ApplyPendingCursorPosition() {
+  if (!cursor_pending_ || committing_ || !cursor_plane_)
+    return;
+
+  int32_t fence = -1;
+  if (!display_->CommitPlanePosition(cursor_plane_, pending_cursor_x_,
+                                     pending_cursor_y_, &fence))
+    return;
+
+  // Next frame can't be committed before this update is on screen.
+  if (fence > 0) {
+    HWCPoll(fence, -1);
+    close(fence);
+  }
+
+  // Planes of the last frame still have the cursor where Present put
+  // it, next Present needs to know it has moved since.
+  cursor_pending_ = false;
+  cursor_moved_ = true;
+  cursor_x_ = pending_cursor_x_;
+  cursor_y_ = pending_cursor_y_;
+}
+
+bool DisplayQueue::TakeCursorPosition(int32_t* x, int32_t* y) {
+  std::lock_guard<std::mutex> lock(cursor_lock_);
+  if (!cursor_moved_)
+    return false;
+
+  *x = cursor_x_;
+  *y = cursor_y_;
+  cursor_moved_ = false;
+  return true;
+}
+
+bool DisplayQueue::MoveCursor(int32_t x, int32_t y) {
+  std::lock_guard<std::mutex> lock(cursor_lock_);
+  if (!committing_ && !cursor_plane_)
+    return false;
+
+  // Frame being committed might move the cursor to another plane and
+  // a plane can't be moved while a flip is pending on it, so this is
+  // applied once either is done if it can't be right away.
+  cursor_pending_ = true;
+  pending_cursor_x_ = x;
+  pending_cursor_y_ = y;
+  ApplyPendingCursorPosition();
+  return true;
+}
+
+void DisplayQueue::SetPresentTraceFile(const char* file) {
+  present_trace_.reset(new PresentTraceWriter());
+  if (!present_trace_->Open(file))
+    present_trace_.reset(nullptr);
+}
+
+void DisplayQueue::SetPlaneAssignment(HWCPlaneAssignment assignment) {
+  plane_assignment_ = assignment;
+  if (display_plane_manager_)
+    display_plane_manager_->SetPlaneAssignment(assignment);
+}
+
+void DisplayQueue::SetOffScreenTargetBudget(uint64_t budget, bool shared) {
+  offscreen_budget_ = budget;
+  share_offscreen_budget_ = shared;
+  if (display_plane_manager_)
+    display_plane_manager_->SetOffScreenTargetBudget(budget, shared);
+}
+
+void DisplayQueue::SetPlacementHysteresis(uint32_t frames, uint32_t margin) {
+  hysteresis_frames_ = frames;
+  hysteresis_margin_ = margin;
+  if (display_plane_manager_)
+    display_plane_manager_->SetPlacementHysteresis(frames, margin);
+}
+
+uint32_t DisplayQueue::GetFrameTimings(HwcFrameTiming* timings,
+                                       uint32_t max_frames) const {
+  return frame_timing_.GetFrameTimings(timings, max_frames);
+}
+
 void DisplayQueue::SetCloneMode(bool cloned) {
   if (cloned) {
     if (!(state_ & kClonedMode)) {
@@ -836,7 +1266,10 @@ void DisplayQueue::UpdateOnScreenSurfaces() {
 }
 
 void DisplayQueue::SetReleaseFenceToLayers(
-    int32_t fence, std::vector<HwcLayer*>& source_layers) const {
+    int32_t fence, std::vector<HwcLayer*>& source_layers) {
+  if (state_ & kClonedMode)
+    clone_release_fences_.resize(source_layers.size(), -1);
+
   for (const DisplayPlaneState& plane : previous_plane_state_) {
     const std::vector<size_t>& layers = plane.GetSourceLayers();
     size_t size = layers.size();
@@ -845,8 +1278,8 @@ void DisplayQueue::SetReleaseFenceToLayers(
       for (size_t layer_index = 0; layer_index < size; layer_index++) {
         const OverlayLayer& overlay_layer =
             in_flight_layers_.at(layers.at(layer_index));
-        HwcLayer* layer = source_layers.at(overlay_layer.GetLayerIndex());
-        layer->SetReleaseFence(dup(fence));
+        SetLayerReleaseFence(source_layers, overlay_layer.GetLayerIndex(),
+                             dup(fence));
       }
     } else {
       release_fence = plane.GetOverlayLayer()->ReleaseAcquireFence();
@@ -854,13 +1287,14 @@ void DisplayQueue::SetReleaseFenceToLayers(
       for (size_t layer_index = 0; layer_index < size; layer_index++) {
         const OverlayLayer& overlay_layer =
             in_flight_layers_.at(layers.at(layer_index));
-        HwcLayer* layer = source_layers.at(overlay_layer.GetLayerIndex());
         if (release_fence > 0) {
-          layer->SetReleaseFence(dup(release_fence));
+          SetLayerReleaseFence(source_layers, overlay_layer.GetLayerIndex(),
+                               dup(release_fence));
         } else {
           int32_t temp = overlay_layer.ReleaseAcquireFence();
           if (temp > 0)
-            layer->SetReleaseFence(temp);
+            SetLayerReleaseFence(source_layers,
+                                 overlay_layer.GetLayerIndex(), temp);
         }
       }
 
@@ -872,20 +1306,55 @@ void DisplayQueue::SetReleaseFenceToLayers(
   }
 }
 
+void DisplayQueue::SetLayerReleaseFence(std::vector<HwcLayer*>& source_layers,
+                                        size_t layer_index, int32_t fence) {
+  if (!(state_ & kClonedMode)) {
+    source_layers.at(layer_index)->SetReleaseFence(fence);
+    return;
+  }
+
+  int32_t& clone_fence = clone_release_fences_.at(layer_index);
+  clone_fence = HWCMergeFences(clone_fence, fence);
+}
+
+void DisplayQueue::TakeCloneReleaseFences(std::vector<int32_t>* fences) {
+  size_t size = clone_release_fences_.size();
+  if (fences->size() < size)
+    fences->resize(size, -1);
+
+  for (size_t layer_index = 0; layer_index < size; layer_index++) {
+    int32_t& fence = fences->at(layer_index);
+    fence = HWCMergeFences(fence, clone_release_fences_.at(layer_index));
+  }
+
+  std::vector<int32_t>().swap(clone_release_fences_);
+}
+
+void DisplayQueue::MergeCloneReleaseFences(const std::vector<int32_t>& fences) {
+  size_t size = fences.size();
+  if (clone_release_fences_.size() < size)
+    clone_release_fences_.resize(size, -1);
+
+  for (size_t layer_index = 0; layer_index < size; layer_index++) {
+    int32_t& fence = clone_release_fences_.at(layer_index);
+    fence = HWCMergeFences(fence, fences.at(layer_index));
+  }
+}
+
 void DisplayQueue::HandleExit() {
   IHOTPLUGEVENTTRACE("HandleExit Called: %p \n", this);
   power_mode_lock_.lock();
   state_ |= kIgnoreIdleRefresh;
   power_mode_lock_.unlock();
   vblank_handler_->SetPowerMode(kOff);
+  // Planes are being disabled, cursor can't be moved anymore.
+  BeginCommit();
+  WaitForKMSFence();
   if (!previous_plane_state_.empty()) {
     display_->Disable(previous_plane_state_);
   }
 
-  if (kms_fence_ > 0) {
-    close(kms_fence_);
-    kms_fence_ = 0;
-  }
+  EndCommit(false);
 
   bool disable_overlay = false;
   if (state_ & kDisableOverlayUsage) {
@@ -1073,12 +1542,16 @@ void DisplayQueue::ResetQueue() {
   applied_video_effect_ = false;
   last_commit_failed_update_ = false;
   std::vector<OverlayLayer>().swap(in_flight_layers_);
+  std::vector<OverlayLayer>().swap(current_layers_);
   DisplayPlaneStateList().swap(previous_plane_state_);
+  DisplayPlaneStateList().swap(current_composition_planes_);
   std::vector<NativeSurface*>().swap(mark_not_inuse_);
   std::vector<NativeSurface*>().swap(surfaces_not_inuse_);
   if (display_plane_manager_->HasSurfaces())
     display_plane_manager_->ReleaseAllOffScreenTargets();
 
+  display_plane_manager_->InvalidateTestCache();
+
   resource_manager_->PurgeBuffer();
   bool ignore_updates = false;
   if (idle_tracker_.state_ & FrameStateTracker::kIgnoreUpdates) {
@@ -24,12 +24,16 @@
 
 #include <queue>
 #include <memory>
+#include <mutex>
 #include <vector>
 
 #include "compositor.h"
 #include "displayplanemanager.h"
+#include "frametimingtracker.h"
 #include "hwcthread.h"
+#include "layerstackdiff.h"
 #include "platformdefines.h"
+#include "presenttrace.h"
 #include "resourcemanager.h"
 #include "vblankeventhandler.h"
 
@@ -88,6 +92,16 @@ class DisplayQueue {
 
   void SetCloneMode(bool cloned);
 
+  // In cloned mode release fences of the source layers are kept here
+  // instead of being set to the layers, which other clones may be
+  // reading at the same time. Merges them into fences, indexed by
+  // source layer, for the source display to hand back.
+  void TakeCloneReleaseFences(std::vector<int32_t>* fences);
+
+  // Takes ownership of fences, release fences of source layers set by
+  // clones of this display, and keeps them with its own.
+  void MergeCloneReleaseFences(const std::vector<int32_t>& fences);
+
   bool WasLastFrameIdleUpdate() {
     return state_ & kLastFrameIdleUpdate;
   }
@@ -95,6 +109,22 @@ class DisplayQueue {
   void RotateDisplay(HWCRotation rotation);
 
   void IgnoreUpdates();
+
+  uint32_t GetFrameTimings(HwcFrameTiming* timings, uint32_t max_frames) const;
+
+  void SetPresentTraceFile(const char* file);
+
+  void SetPlaneAssignment(HWCPlaneAssignment assignment);
+
+  void SetOffScreenTargetBudget(uint64_t budget, bool shared);
+
+  void SetPlacementHysteresis(uint32_t frames, uint32_t margin);
+
+  // Moves cursor plane to x, y without presenting a new frame. Returns
+  // false if cursor isn't shown by its own plane or a frame is being
+  // committed, in which case a new frame needs to be presented.
+  bool MoveCursor(int32_t x, int32_t y);
+
  private:
   enum QueueState {
     kNeedsColorCorrection = 1 << 0,  // Needs Color correction.
@@ -223,12 +253,48 @@ class DisplayQueue {
   };
 
   void HandleExit();
+  // Re-uses planes of the last frame for layers. Planes showing layers
+  // from remove_index on are dropped. If edit is given instead, only
+  // layers it removed are dropped, planes above it are kept and layers
+  // it added are composited by the plane right below them.
   void GetCachedLayers(const std::vector<OverlayLayer>& layers,
-                       int remove_index, DisplayPlaneStateList* composition,
+                       int remove_index, const LayerStackEdit* edit,
+                       DisplayPlaneStateList* composition,
                        bool* revalidate_plane, bool* render_layers,
                        bool* can_ignore_commit, bool* force_full_validation);
+
+  // Returns true if planes of the last frame can be kept for layers
+  // outside edit, as GetCachedLayers does when given one.
+  bool CanKeepPlanesAroundEdit(const std::vector<OverlayLayer>& layers,
+                               const LayerStackEdit& edit);
   void SetReleaseFenceToLayers(int32_t fence,
-                               std::vector<HwcLayer*>& source_layers) const;
+                               std::vector<HwcLayer*>& source_layers);
+  void SetLayerReleaseFence(std::vector<HwcLayer*>& source_layers,
+                            size_t layer_index, int32_t fence);
+
+  // Handles a frame where only the cursor moved by updating position
+  // of its plane. Returns false if a full update is needed.
+  bool MoveCursorPlane(std::vector<OverlayLayer>& layers,
+                       std::vector<HwcLayer*>& source_layers,
+                       int32_t* retire_fence);
+
+  // Returns plane showing only the cursor last frame, if any.
+  DisplayPlaneState* GetCursorOnlyPlane();
+
+  // Bracket commits, so that MoveCursor doesn't race with them.
+  void BeginCommit();
+  void EndCommit(bool succeeded);
+
+  // Waits for the last committed frame to be on screen.
+  void WaitForKMSFence();
+
+  // Moves cursor plane to where MoveCursor asked for while it couldn't
+  // be moved. Needs cursor_lock_ to be held.
+  void ApplyPendingCursorPosition();
+
+  // Returns position MoveCursor left the cursor at since the last
+  // Present, if it was moved, and forgets about it.
+  bool TakeCursorPosition(int32_t* x, int32_t* y);
 
   void SetMediaEffectsState(bool apply_effects,
                             const std::vector<OverlayLayer>& layers,
@@ -254,8 +320,21 @@ class DisplayQueue {
   std::unique_ptr<VblankEventHandler> vblank_handler_;
   std::unique_ptr<DisplayPlaneManager> display_plane_manager_;
   std::unique_ptr<ResourceManager> resource_manager_;
+  std::unique_ptr<PresentTraceWriter> present_trace_;
+  HWCPlaneAssignment plane_assignment_ = kPlaneAssignmentGreedy;
+  uint64_t offscreen_budget_ = 0;
+  bool share_offscreen_budget_ = false;
+  uint32_t hysteresis_frames_ = PlacementHistory::kDefaultSwitchFrames;
+  uint32_t hysteresis_margin_ = PlacementHistory::kDefaultSwitchMargin;
   std::vector<OverlayLayer> in_flight_layers_;
+  std::vector<int32_t> clone_release_fences_;
   DisplayPlaneStateList previous_plane_state_;
+  // Storage for state of the frame being prepared. Swapped with
+  // in_flight_layers_ and previous_plane_state_ on commit.
+  std::vector<OverlayLayer> current_layers_;
+  DisplayPlaneStateList current_composition_planes_;
+  std::vector<HwcRect<int>> layers_rects_;
+  LayerStackDiff layer_diff_;
   FrameStateTracker idle_tracker_;
   ScalingTracker scaling_tracker_;
   // shared_ptr since we need to use this outside of the thread lock (to
@@ -269,6 +348,18 @@ class DisplayQueue {
   bool handle_display_initializations_ = true;  // to disable hwclock thread.
   HWCRotation rotation_ = kRotateNone;
   SpinLock video_lock_;
+  // Guards cursor_plane_, committing_ and the cursor position,
+  // MoveCursor can be called while a frame is being prepared. A mutex
+  // rather than a SpinLock, as MoveCursor holds it during its commit.
+  std::mutex cursor_lock_;
+  const DisplayPlane* cursor_plane_ = NULL;
+  bool committing_ = false;
+  bool cursor_moved_ = false;
+  int32_t cursor_x_ = 0;
+  int32_t cursor_y_ = 0;
+  bool cursor_pending_ = false;
+  int32_t pending_cursor_x_ = 0;
+  int32_t pending_cursor_y_ = 0;
   bool requested_video_effect_ = false;
   bool applied_video_effect_ = false;
   // Set to true when layers are validated and commit fails.
@@ -281,6 +372,8 @@ class DisplayQueue {
   // need to be marked as not in use during next
   // frame.
   std::vector<NativeSurface*> surfaces_not_inuse_;
+  // Per stage timings of the last few updates.
+  FrameTimingTracker frame_timing_;
 };
 
 }  // namespace hwcomposer
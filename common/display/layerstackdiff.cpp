@@ -0,0 +1,124 @@
+/*
+// Copyright (c) 2018 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+#include "layerstackdiff.h"
+
+#include <algorithm>
+
+#include "overlaylayer.h"
+
+namespace hwcomposer {
+
+void LayerStackDiff::Reset(const std::vector<OverlayLayer>& previous_layers) {
+  previous_layers_ = &previous_layers;
+  previous_size_ = previous_layers.size();
+  size_ = 0;
+  added_ = 0;
+  first_changed_ = -1;
+  last_changed_ = -1;
+  index_built_ = false;
+  previous_indices_.clear();
+  matched_.assign(previous_size_, false);
+}
+
+void LayerStackDiff::BuildIndex() {
+  index_.clear();
+  for (uint32_t i = 0; i < previous_size_; i++) {
+    index_.emplace_back(previous_layers_->at(i).GetLayerId(), i);
+  }
+
+  std::sort(index_.begin(), index_.end());
+  index_built_ = true;
+}
+
+int LayerStackDiff::Find(uint64_t id) {
+  // Common case, layer is still at the same position.
+  if (size_ < previous_size_ && !matched_[size_] &&
+      previous_layers_->at(size_).GetLayerId() == id) {
+    return size_;
+  }
+
+  if (!index_built_)
+    BuildIndex();
+
+  auto it = std::lower_bound(index_.begin(), index_.end(),
+                             std::make_pair(id, static_cast<uint32_t>(0)));
+  for (; it != index_.end() && it->first == id; ++it) {
+    if (!matched_[it->second])
+      return it->second;
+  }
+
+  return -1;
+}
+
+void LayerStackDiff::Add(int previous_index) {
+  if (previous_index >= 0) {
+    matched_[previous_index] = true;
+  } else {
+    added_++;
+  }
+
+  if (first_changed_ == -1 && previous_index != static_cast<int>(size_))
+    first_changed_ = size_;
+
+  previous_indices_.emplace_back(previous_index);
+  size_++;
+}
+
+void LayerStackDiff::MarkChanged(uint32_t z_order) {
+  if (first_changed_ == -1 || static_cast<int>(z_order) < first_changed_)
+    first_changed_ = z_order;
+
+  if (static_cast<int>(z_order) > last_changed_)
+    last_changed_ = z_order;
+}
+
+int LayerStackDiff::GetFirstChangedIndex() const {
+  if (first_changed_ != -1)
+    return first_changed_;
+
+  // All layers matched in place, check if some were removed from top.
+  if (size_ < previous_size_)
+    return size_;
+
+  return -1;
+}
+
+bool LayerStackDiff::GetEdit(LayerStackEdit* edit) const {
+  int begin = GetFirstChangedIndex();
+  if (begin == -1)
+    return false;
+
+  // Walk down from the top while layers match those at the top of
+  // the previous stack, without going below the first change.
+  int shift = static_cast<int>(previous_size_) - static_cast<int>(size_);
+  int end = size_;
+  int lowest = std::max(begin, last_changed_ + 1);
+  while (end > lowest && end + shift > begin &&
+         previous_indices_.at(end - 1) == end - 1 + shift) {
+    end--;
+  }
+
+  if (end == static_cast<int>(size_))
+    return false;
+
+  edit->begin_ = begin;
+  edit->previous_end_ = end + shift;
+  edit->end_ = end;
+  return true;
+}
+
+}  // namespace hwcomposer
@@ -0,0 +1,111 @@
+/*
+// Copyright (c) 2018 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+#ifndef COMMON_DISPLAY_LAYERSTACKDIFF_H_
+#define COMMON_DISPLAY_LAYERSTACKDIFF_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <utility>
+#include <vector>
+
+namespace hwcomposer {
+
+struct OverlayLayer;
+
+// Range of z orders in which two layer stacks differ. Layers below
+// begin_ are the same in both stacks. Layers from previous_end_ on in
+// the previous stack are, in the same order, the ones from end_ on in
+// the new stack. Layers in between were removed or added.
+struct LayerStackEdit {
+  uint32_t begin_ = 0;
+  uint32_t previous_end_ = 0;
+  uint32_t end_ = 0;
+};
+
+// Matches layers of a new frame with the ones of the previous frame
+// using their layer id, rather than their position in the stack. Tracks
+// the first z order at which the stack differs, so that layers and planes
+// below it can be re-used as is when a layer is added, removed or moved,
+// and the unchanged layers above the edit, so that their planes can be
+// kept as well.
+//
+// Usage, for every frame:
+//   Reset(previous_layers);
+//   For every visible layer, in z order:
+//     int previous = Find(id);
+//     ...
+//     Add(previous);
+//   GetFirstChangedIndex();
+//   GetEdit(&edit);
+class LayerStackDiff {
+ public:
+  LayerStackDiff() = default;
+
+  LayerStackDiff(const LayerStackDiff& rhs) = delete;
+  LayerStackDiff& operator=(const LayerStackDiff& rhs) = delete;
+
+  void Reset(const std::vector<OverlayLayer>& previous_layers);
+
+  // Returns index in previous layers of layer with id, or -1 if this
+  // layer is new or has already been matched.
+  int Find(uint64_t id);
+
+  // Adds layer matched with previous_index (can be -1) as the next
+  // layer of the new stack.
+  void Add(int previous_index);
+
+  // Marks stack as changed at z_order, even if layers there match.
+  void MarkChanged(uint32_t z_order);
+
+  // Returns first z order of the new stack which differs from
+  // previous stack, or -1 if both stacks are the same.
+  int GetFirstChangedIndex() const;
+
+  // Returns false if stacks are the same or layers at the top of the
+  // new stack differ from the previous one. Otherwise, sets edit to
+  // the range which changed.
+  bool GetEdit(LayerStackEdit* edit) const;
+
+  uint32_t GetAddedLayers() const {
+    return added_;
+  }
+
+  uint32_t GetRemovedLayers() const {
+    return previous_size_ + added_ - size_;
+  }
+
+ private:
+  void BuildIndex();
+
+  const std::vector<OverlayLayer>* previous_layers_ = NULL;
+  // Previous layers as (id, index) pairs sorted by id. Only built
+  // when we can't match layers by position.
+  std::vector<std::pair<uint64_t, uint32_t>> index_;
+  std::vector<bool> matched_;
+  // Index in previous layers of each layer added so far, or -1.
+  std::vector<int> previous_indices_;
+  bool index_built_ = false;
+  uint32_t previous_size_ = 0;
+  uint32_t size_ = 0;
+  uint32_t added_ = 0;
+  int first_changed_ = -1;
+  int last_changed_ = -1;
+};
+
+}  // namespace hwcomposer
+#endif  // COMMON_DISPLAY_LAYERSTACKDIFF_H_
@@ -0,0 +1,76 @@
+/*
+// Copyright (c) 2018 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+#include "modifiernegotiator.h"
+
+#include <drm_fourcc.h>
+
+#include <algorithm>
+
+namespace hwcomposer {
+
+uint32_t ModifierNegotiator::GetRank(uint64_t modifier) {
+  switch (modifier) {
+#ifdef I915_FORMAT_MOD_Y_TILED_CCS
+    case I915_FORMAT_MOD_Y_TILED_CCS:
+      return 0;
+#endif
+#ifdef I915_FORMAT_MOD_Yf_TILED_CCS
+    case I915_FORMAT_MOD_Yf_TILED_CCS:
+      return 1;
+#endif
+    case I915_FORMAT_MOD_Y_TILED:
+      return 2;
+#ifdef I915_FORMAT_MOD_Yf_TILED
+    case I915_FORMAT_MOD_Yf_TILED:
+      return 3;
+#endif
+    case I915_FORMAT_MOD_X_TILED:
+      return 4;
+    case DRM_FORMAT_MOD_LINEAR:
+      return 6;
+    default:
+      // Some other vendor's tiling, still better than linear.
+      return 5;
+  }
+}
+
+void ModifierNegotiator::Negotiate(
+    const std::vector<uint64_t>& plane_modifiers,
+    const std::vector<uint64_t>& allocator_modifiers, bool allocator_known,
+    std::vector<uint64_t>* modifiers) {
+  modifiers->clear();
+  for (const uint64_t& modifier : plane_modifiers) {
+    if (modifier == DRM_FORMAT_MOD_INVALID)
+      continue;
+
+    if (allocator_known &&
+        std::find(allocator_modifiers.begin(), allocator_modifiers.end(),
+                  modifier) == allocator_modifiers.end())
+      continue;
+
+    if (std::find(modifiers->begin(), modifiers->end(), modifier) ==
+        modifiers->end())
+      modifiers->emplace_back(modifier);
+  }
+
+  std::stable_sort(modifiers->begin(), modifiers->end(),
+                   [](uint64_t lhs, uint64_t rhs) {
+                     return GetRank(lhs) < GetRank(rhs);
+                   });
+}
+
+}  // namespace hwcomposer
@@ -0,0 +1,47 @@
+/*
+// Copyright (c) 2018 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+#ifndef COMMON_DISPLAY_MODIFIERNEGOTIATOR_H_
+#define COMMON_DISPLAY_MODIFIERNEGOTIATOR_H_
+
+#include <stdint.h>
+
+#include <vector>
+
+namespace hwcomposer {
+
+// Picks layout modifiers of offscreen targets which both the plane
+// showing them and the buffer allocator support. Works on plain lists,
+// so that it can be exercised with made up tables.
+class ModifierNegotiator {
+ public:
+  // Orders modifiers by scanout and blend bandwidth, lower is better.
+  // Compressed layouts come first and linear last.
+  static uint32_t GetRank(uint64_t modifier);
+
+  // Fills modifiers with those in both plane_modifiers and
+  // allocator_modifiers, best first. allocator_known being false means
+  // the allocator didn't report any and picks among plane_modifiers
+  // itself. modifiers is left empty if there is nothing in common,
+  // in which case a buffer with implicit layout should be used.
+  static void Negotiate(const std::vector<uint64_t>& plane_modifiers,
+                        const std::vector<uint64_t>& allocator_modifiers,
+                        bool allocator_known,
+                        std::vector<uint64_t>* modifiers);
+};
+
+}  // namespace hwcomposer
+#endif  // COMMON_DISPLAY_MODIFIERNEGOTIATOR_H_
@@ -0,0 +1,198 @@
+/*
+// Copyright (c) 2018 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+#include "placementhistory.h"
+
+#include "overlaylayer.h"
+
+namespace hwcomposer {
+
+void PlacementHistory::SetThresholds(uint32_t frames, uint32_t margin) {
+  switch_frames_ = frames;
+  switch_margin_ = margin < 100 ? margin : 99;
+}
+
+const PlacementHistory::Entry* PlacementHistory::Find(uint64_t layer_id,
+                                                      size_t hint) const {
+  // Layers mostly keep their position in the stack.
+  if (hint < entries_.size() && entries_[hint].layer_id_ == layer_id)
+    return &entries_[hint];
+
+  for (const Entry& entry : entries_) {
+    if (entry.layer_id_ == layer_id)
+      return &entry;
+  }
+
+  return NULL;
+}
+
+PlacementHistory::Entry* PlacementHistory::Find(uint64_t layer_id,
+                                                size_t hint) {
+  return const_cast<Entry*>(
+      static_cast<const PlacementHistory*>(this)->Find(layer_id, hint));
+}
+
+bool PlacementHistory::GetPlacement(const OverlayLayer& layer,
+                                    bool* scanout) const {
+  const Entry* entry = Find(layer.GetLayerId(), layer.GetZorder());
+  if (!entry)
+    return false;
+
+  *scanout = entry->scanout_;
+  return true;
+}
+
+uint32_t PlacementHistory::CountChanges(const std::vector<OverlayLayer*>& layers,
+                                        const bool* scanout) const {
+  uint32_t changes = 0;
+  size_t size = layers.size();
+  for (size_t i = 0; i < size; i++) {
+    const OverlayLayer* layer = layers.at(i);
+    const Entry* entry = Find(layer->GetLayerId(), layer->GetZorder());
+    if (entry && entry->scanout_ != scanout[i])
+      changes++;
+  }
+
+  return changes;
+}
+
+bool PlacementHistory::AllowSwitch(const std::vector<OverlayLayer*>& layers,
+                                   const bool* scanout, bool better) {
+  validated_ = true;
+  bool allow = true;
+  size_t size = layers.size();
+  for (size_t i = 0; i < size; i++) {
+    const OverlayLayer* layer = layers.at(i);
+    Entry* entry = Find(layer->GetLayerId(), layer->GetZorder());
+    if (!entry)
+      continue;
+
+    if (entry->scanout_ == scanout[i] || !better) {
+      entry->streak_ = 0;
+      continue;
+    }
+
+    entry->streak_++;
+    if (entry->streak_ < switch_frames_)
+      allow = false;
+  }
+
+  return allow && better;
+}
+
+bool PlacementHistory::AllowScanout(const OverlayLayer& layer,
+                                    bool can_scanout) {
+  Entry* entry = Find(layer.GetLayerId(), layer.GetZorder());
+  if (!entry)
+    return true;
+
+  if (!can_scanout || entry->scanout_ || !IsEnabled()) {
+    entry->scanout_wins_ = 0;
+    return true;
+  }
+
+  entry->scanout_wins_++;
+  return entry->scanout_wins_ >= switch_frames_;
+}
+
+uint32_t PlacementHistory::Update(const std::vector<OverlayLayer>& layers,
+                                  const DisplayPlaneStateList& composition) {
+  size_t size = layers.size();
+  scanout_.assign(size, 0);
+  for (const DisplayPlaneState& plane : composition) {
+    if (!plane.Scanout())
+      continue;
+
+    for (size_t index : plane.GetSourceLayers()) {
+      if (index < size)
+        scanout_[index] = 1;
+    }
+  }
+
+  uint32_t changes = 0;
+  next_entries_.clear();
+  for (size_t i = 0; i < size; i++) {
+    uint64_t layer_id = layers.at(i).GetLayerId();
+    bool scanout = scanout_[i];
+    uint32_t streak = 0;
+    uint32_t scanout_wins = 0;
+    const Entry* entry = Find(layer_id, i);
+    if (entry) {
+      if (entry->scanout_ != scanout) {
+        changes++;
+      } else {
+        streak = entry->streak_;
+        scanout_wins = entry->scanout_wins_;
+      }
+    }
+
+    next_entries_.push_back({layer_id, scanout, streak, scanout_wins});
+  }
+
+  entries_.swap(next_entries_);
+  transitions_ += changes;
+  // Streaks only count consecutive frames.
+  if (!validated_)
+    ResetStreaks();
+
+  validated_ = false;
+  return changes;
+}
+
+void PlacementHistory::SkipFrame() {
+  ResetStreaks();
+  validated_ = false;
+}
+
+void PlacementHistory::Reset() {
+  entries_.clear();
+  validated_ = false;
+}
+
+void PlacementHistory::ResetStreaks() {
+  for (Entry& entry : entries_) {
+    entry.streak_ = 0;
+  }
+}
+
+uint64_t StickyPlaneCostModel::PlaneCost() const {
+  return model_.PlaneCost();
+}
+
+uint64_t StickyPlaneCostModel::ScanoutCost(const OverlayLayer& layer) const {
+  bool scanout = true;
+  uint64_t cost = model_.ScanoutCost(layer);
+  if (history_.GetPlacement(layer, &scanout) && !scanout)
+    cost += kSwitchPenalty;
+
+  return cost;
+}
+
+uint64_t StickyPlaneCostModel::CompositionCost(const OverlayLayer& layer) const {
+  bool scanout = false;
+  uint64_t cost = model_.CompositionCost(layer);
+  if (history_.GetPlacement(layer, &scanout) && scanout)
+    cost += kSwitchPenalty;
+
+  return cost;
+}
+
+uint64_t StickyPlaneCostModel::TargetCost(uint32_t width,
+                                          uint32_t height) const {
+  return model_.TargetCost(width, height);
+}
+
+}  // namespace hwcomposer
@@ -0,0 +1,153 @@
+/*
+// Copyright (c) 2018 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+#ifndef COMMON_DISPLAY_PLACEMENTHISTORY_H_
+#define COMMON_DISPLAY_PLACEMENTHISTORY_H_
+
+#include <stdint.h>
+
+#include <vector>
+
+#include "displayplanestate.h"
+#include "planeassignment.h"
+
+namespace hwcomposer {
+
+struct OverlayLayer;
+
+// Remembers which layers were scanned out and which were composited with
+// the GPU on the last frame. Animated content easily makes the cheapest
+// assignment flip between the two every frame, each flip costing new
+// offscreen targets and a full validation. Plane assignment uses this to
+// keep layers where they are, unless moving them was clearly (by a margin)
+// cheaper on a number of consecutive frames. First fit validation and
+// revalidation of cached planes have no costs to compare, they keep a
+// composited layer off its own plane until it could have had one on a
+// number of validations in a row. Layers they can't scan out anymore still
+// move right away.
+class PlacementHistory {
+ public:
+  static const uint32_t kDefaultSwitchFrames = 3;
+  static const uint32_t kDefaultSwitchMargin = 10;
+
+  PlacementHistory() = default;
+
+  PlacementHistory(const PlacementHistory& rhs) = delete;
+  PlacementHistory& operator=(const PlacementHistory& rhs) = delete;
+
+  // A layer changes placement only once the new one was at least margin
+  // percent cheaper on frames consecutive frames, each of them fully
+  // validated. frames of 0 lets layers move whenever the cheapest
+  // assignment changes.
+  void SetThresholds(uint32_t frames, uint32_t margin);
+
+  bool IsEnabled() const {
+    return switch_frames_ > 0;
+  }
+
+  uint32_t GetSwitchMargin() const {
+    return switch_margin_;
+  }
+
+  // Returns false if layer wasn't shown on the last frame.
+  bool GetPlacement(const OverlayLayer& layer, bool* scanout) const;
+
+  // Number of layers for which scanout[i] differs from their last
+  // placement.
+  uint32_t CountChanges(const std::vector<OverlayLayer*>& layers,
+                        const bool* scanout) const;
+
+  // Called for every validation proposing scanout[i] for layers.
+  // better tells if the proposal was clearly cheaper than keeping
+  // layers where they are. Returns true if the proposal may be used.
+  bool AllowSwitch(const std::vector<OverlayLayer*>& layers,
+                   const bool* scanout, bool better);
+
+  // Called when deciding placement of a single layer, can_scanout tells
+  // if it could get a plane of its own. Returns false if it was composited
+  // on the last frame and should stay so, as that wasn't the case on
+  // frames validations in a row yet. Frames without validation don't
+  // break the row.
+  bool AllowScanout(const OverlayLayer& layer, bool can_scanout);
+
+  // Records where layers ended up in composition. Streaks start over
+  // if AllowSwitch wasn't called since the last Update. Returns number
+  // of layers which changed placement.
+  uint32_t Update(const std::vector<OverlayLayer>& layers,
+                  const DisplayPlaneStateList& composition);
+
+  // Called for frames which don't reach Update, as no layer changed.
+  // Streaks start over, as nothing was validated.
+  void SkipFrame();
+
+  // Forgets placements of all layers, for frames composited with the GPU
+  // regardless of what layers could use.
+  void Reset();
+
+  // Total number of placement changes seen by Update.
+  uint64_t GetTransitions() const {
+    return transitions_;
+  }
+
+ private:
+  struct Entry {
+    uint64_t layer_id_;
+    bool scanout_;
+    // Frames in a row the other placement was clearly cheaper.
+    uint32_t streak_;
+    // Validations in a row a composited layer could be scanned out.
+    uint32_t scanout_wins_;
+  };
+
+  void ResetStreaks();
+
+  const Entry* Find(uint64_t layer_id, size_t hint) const;
+  Entry* Find(uint64_t layer_id, size_t hint);
+
+  std::vector<Entry> entries_;
+  std::vector<Entry> next_entries_;
+  std::vector<uint8_t> scanout_;
+  uint32_t switch_frames_ = kDefaultSwitchFrames;
+  uint32_t switch_margin_ = kDefaultSwitchMargin;
+  uint64_t transitions_ = 0;
+  // AllowSwitch was called since the last Update.
+  bool validated_ = false;
+};
+
+// Makes moving a layer away from its last placement prohibitively
+// expensive, so that solving with it keeps layers where they are
+// whenever possible.
+class StickyPlaneCostModel : public PlaneCostModel {
+ public:
+  static const uint64_t kSwitchPenalty = 1ULL << 40;
+
+  StickyPlaneCostModel(const PlaneCostModel& model,
+                       const PlacementHistory& history)
+      : model_(model), history_(history) {
+  }
+
+  uint64_t PlaneCost() const override;
+  uint64_t ScanoutCost(const OverlayLayer& layer) const override;
+  uint64_t CompositionCost(const OverlayLayer& layer) const override;
+  uint64_t TargetCost(uint32_t width, uint32_t height) const override;
+
+ private:
+  const PlaneCostModel& model_;
+  const PlacementHistory& history_;
+};
+
+}  // namespace hwcomposer
+#endif  // COMMON_DISPLAY_PLACEMENTHISTORY_H_
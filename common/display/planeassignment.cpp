@@ -0,0 +1,187 @@
+/*
+// Copyright (c) 2018 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+#include "planeassignment.h"
+
+#include <algorithm>
+
+#include "displayplane.h"
+#include "frametimingtracker.h"
+#include "hwctrace.h"
+#include "overlaylayer.h"
+#include "scalercapabilities.h"
+
+namespace hwcomposer {
+
+// GPU traffic also costs GPU time and power, weigh it higher.
+static const uint64_t kGpuWeight = 2;
+// Video needs colour conversion when composited with the GPU.
+static const uint64_t kVideoCompositionWeight = 2;
+// Roughly a 64x64 cursor, keeps us from using planes for no gain.
+static const uint64_t kPlaneCost = 64 * 64 * 4;
+static const uint64_t kInvalidCost = ~0ULL;
+
+// Bytes per pixel times two, video is assumed to be 4:2:0.
+static uint64_t HalfBytesPerPixel(const OverlayLayer& layer) {
+  return layer.IsVideoLayer() ? 3 : 8;
+}
+
+uint64_t DefaultPlaneCostModel::PlaneCost() const {
+  return kPlaneCost;
+}
+
+uint64_t DefaultPlaneCostModel::ScanoutCost(const OverlayLayer& layer) const {
+  uint64_t pixels = static_cast<uint64_t>(layer.GetSourceCropWidth()) *
+                    layer.GetSourceCropHeight();
+  return (pixels * HalfBytesPerPixel(layer)) / 2;
+}
+
+uint64_t DefaultPlaneCostModel::CompositionCost(
+    const OverlayLayer& layer) const {
+  // Read the source and blend (read + write) into the target.
+  uint64_t source = static_cast<uint64_t>(layer.GetSourceCropWidth()) *
+                    layer.GetSourceCropHeight();
+  uint64_t target = static_cast<uint64_t>(layer.GetDisplayFrameWidth()) *
+                    layer.GetDisplayFrameHeight();
+  uint64_t cost =
+      ((source * HalfBytesPerPixel(layer)) / 2 + target * 8) * kGpuWeight;
+  if (layer.PreferSeparatePlane())
+    cost *= kVideoCompositionWeight;
+
+  return cost;
+}
+
+uint64_t DefaultPlaneCostModel::TargetCost(uint32_t width,
+                                           uint32_t height) const {
+  // Clear with the GPU, then scan out.
+  uint64_t pixels = static_cast<uint64_t>(width) * height;
+  return pixels * 4 * kGpuWeight + pixels * 4;
+}
+
+void PlaneAssignment::GetPlacements(bool* scanout) const {
+  for (const Group& group : groups_) {
+    for (uint32_t i = group.begin_; i < group.end_; i++) {
+      scanout[i] = group.scanout_;
+    }
+  }
+}
+
+bool PlaneAssignment::Solve(const std::vector<OverlayLayer*>& layers,
+                            const std::vector<DisplayPlane*>& planes,
+                            const PlaneCostModel& model, uint32_t width,
+                            uint32_t height, int64_t budget_ns) {
+  int64_t start = FrameTimingTracker::Now();
+  uint32_t num_layers = layers.size();
+  uint32_t num_planes = planes.size();
+  if (num_layers == 0 || num_planes == 0 || num_layers > kMaxLayers)
+    return false;
+
+  if (num_planes > kMaxPlanes)
+    num_planes = kMaxPlanes;
+
+  for (uint32_t i = 0; i < num_layers; i++) {
+    composition_cost_[i] = model.CompositionCost(*layers.at(i));
+    for (uint32_t p = 0; p < num_planes; p++) {
+      can_scanout_[p][i] =
+          planes.at(p)->ValidateLayer(layers.at(i)) &&
+          (!scaler_caps_ ||
+           scaler_caps_->CanScale(planes.at(p), layers.at(i), 0));
+    }
+  }
+
+  for (uint32_t p = 0; p <= num_planes; p++) {
+    for (uint32_t i = 0; i <= num_layers; i++) {
+      best_[p][i] = kInvalidCost;
+    }
+  }
+
+  uint64_t plane_cost = model.PlaneCost();
+  best_[0][0] = 0;
+  // best_[p][j] is the cheapest way of showing layers [0, j) with the
+  // first p planes, the last group being [parent_[p][j], j).
+  for (uint32_t p = 0; p < num_planes; p++) {
+    for (uint32_t i = 0; i < num_layers; i++) {
+      uint64_t base = best_[p][i];
+      if (base == kInvalidCost)
+        continue;
+
+      if (FrameTimingTracker::Now() - start > budget_ns) {
+        IDISPLAYMANAGERTRACE("Plane assignment exceeded budget.");
+        return false;
+      }
+
+      // Offscreen targets are sized to the bounding box of their layers.
+      uint64_t composition = base + plane_cost;
+      HwcRect<int> bounds = layers.at(i)->GetDisplayFrame();
+      for (uint32_t j = i + 1; j <= num_layers; j++) {
+        const HwcRect<int>& frame = layers.at(j - 1)->GetDisplayFrame();
+        bounds.left = std::max(std::min(bounds.left, frame.left), 0);
+        bounds.top = std::max(std::min(bounds.top, frame.top), 0);
+        bounds.right = std::min(std::max(bounds.right, frame.right),
+                                static_cast<int>(width));
+        bounds.bottom = std::min(std::max(bounds.bottom, frame.bottom),
+                                 static_cast<int>(height));
+        composition += composition_cost_[j - 1];
+        uint64_t cost = composition;
+        if (bounds.right > bounds.left && bounds.bottom > bounds.top)
+          cost += model.TargetCost(bounds.right - bounds.left,
+                                   bounds.bottom - bounds.top);
+        bool scanout = false;
+        if (j == i + 1 && can_scanout_[p][i]) {
+          uint64_t scanout_cost =
+              base + plane_cost + model.ScanoutCost(*layers.at(i));
+          if (scanout_cost <= cost) {
+            cost = scanout_cost;
+            scanout = true;
+          }
+        }
+
+        if (cost < best_[p + 1][j]) {
+          best_[p + 1][j] = cost;
+          parent_[p + 1][j] = i;
+          parent_scanout_[p + 1][j] = scanout;
+        }
+      }
+    }
+  }
+
+  uint32_t used_planes = 0;
+  for (uint32_t p = 1; p <= num_planes; p++) {
+    if (best_[p][num_layers] == kInvalidCost)
+      continue;
+
+    if (!used_planes || best_[p][num_layers] < best_[used_planes][num_layers])
+      used_planes = p;
+  }
+
+  if (!used_planes)
+    return false;
+
+  cost_ = best_[used_planes][num_layers];
+  groups_.resize(used_planes);
+  uint32_t end = num_layers;
+  for (uint32_t p = used_planes; p > 0; p--) {
+    Group& group = groups_.at(p - 1);
+    group.begin_ = parent_[p][end];
+    group.end_ = end;
+    group.scanout_ = parent_scanout_[p][end];
+    end = group.begin_;
+  }
+
+  return true;
+}
+
+}  // namespace hwcomposer
@@ -0,0 +1,124 @@
+/*
+// Copyright (c) 2018 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+#ifndef COMMON_DISPLAY_PLANEASSIGNMENT_H_
+#define COMMON_DISPLAY_PLANEASSIGNMENT_H_
+
+#include <stdlib.h>
+#include <stdint.h>
+
+#include <vector>
+
+namespace hwcomposer {
+
+class DisplayPlane;
+class ScalerCapabilities;
+struct OverlayLayer;
+
+// Estimates cost of showing layers in a given way, used to pick the
+// cheapest assignment of layers to planes. Costs are relative, they
+// only need to be comparable with each other.
+class PlaneCostModel {
+ public:
+  virtual ~PlaneCostModel() {
+  }
+
+  // Cost of enabling one more plane.
+  virtual uint64_t PlaneCost() const = 0;
+
+  // Cost of scanning out layer directly from its buffer.
+  virtual uint64_t ScanoutCost(const OverlayLayer& layer) const = 0;
+
+  // Cost of blending layer into an offscreen target with the GPU.
+  virtual uint64_t CompositionCost(const OverlayLayer& layer) const = 0;
+
+  // Cost of clearing an offscreen target of width x height and
+  // scanning it out.
+  virtual uint64_t TargetCost(uint32_t width, uint32_t height) const = 0;
+};
+
+// Counts bytes of memory traffic per frame, GPU traffic being weighed
+// higher than scanout as it also keeps the GPU busy.
+class DefaultPlaneCostModel : public PlaneCostModel {
+ public:
+  uint64_t PlaneCost() const override;
+  uint64_t ScanoutCost(const OverlayLayer& layer) const override;
+  uint64_t CompositionCost(const OverlayLayer& layer) const override;
+  uint64_t TargetCost(uint32_t width, uint32_t height) const override;
+};
+
+// Finds the cheapest way of splitting layers, in z order, into contiguous
+// groups shown by consecutive planes starting with the primary one. A group
+// with a single layer the plane accepts is scanned out directly, any other
+// group is composited into an offscreen target first. Uses dynamic
+// programming over (plane, first layer of group), bailing out if that
+// takes longer than a given budget.
+class PlaneAssignment {
+ public:
+  static const uint32_t kMaxLayers = 32;
+  static const uint32_t kMaxPlanes = 8;
+
+  struct Group {
+    uint32_t begin_;  // First layer of the group.
+    uint32_t end_;    // One past the last layer of the group.
+    bool scanout_;    // Layer is scanned out directly.
+  };
+
+  PlaneAssignment() = default;
+
+  PlaneAssignment(const PlaneAssignment& rhs) = delete;
+  PlaneAssignment& operator=(const PlaneAssignment& rhs) = delete;
+
+  // Layers needing scaling which capabilities rule out are never
+  // scanned out directly.
+  void SetScalerCapabilities(const ScalerCapabilities* capabilities) {
+    scaler_caps_ = capabilities;
+  }
+
+  // Returns false if there are too many layers, nothing to assign or
+  // budget_ns was exceeded. Offscreen targets cover the bounding box
+  // of their layers, clipped to the width x height display.
+  bool Solve(const std::vector<OverlayLayer*>& layers,
+             const std::vector<DisplayPlane*>& planes,
+             const PlaneCostModel& model, uint32_t width, uint32_t height,
+             int64_t budget_ns);
+
+  // Groups of last successful Solve, group i being shown by planes[i].
+  const std::vector<Group>& GetGroups() const {
+    return groups_;
+  }
+
+  uint64_t GetCost() const {
+    return cost_;
+  }
+
+  // Sets scanout[i] to true if layer i of last successful
+  // Solve is scanned out directly.
+  void GetPlacements(bool* scanout) const;
+
+ private:
+  uint64_t best_[kMaxPlanes + 1][kMaxLayers + 1];
+  uint8_t parent_[kMaxPlanes + 1][kMaxLayers + 1];
+  bool parent_scanout_[kMaxPlanes + 1][kMaxLayers + 1];
+  bool can_scanout_[kMaxPlanes][kMaxLayers];
+  uint64_t composition_cost_[kMaxLayers];
+  std::vector<Group> groups_;
+  uint64_t cost_ = 0;
+  const ScalerCapabilities* scaler_caps_ = NULL;
+};
+
+}  // namespace hwcomposer
+#endif  // COMMON_DISPLAY_PLANEASSIGNMENT_H_
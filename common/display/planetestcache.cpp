@@ -0,0 +1,186 @@
+/*
+// Copyright (c) 2018 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+#include "planetestcache.h"
+
+#include <drm_fourcc.h>
+#include <string.h>
+
+#include <algorithm>
+
+#include "displayplane.h"
+#include "hwctrace.h"
+#include "overlaybuffer.h"
+#include "overlaylayer.h"
+
+namespace hwcomposer {
+
+bool PlaneTestCache::BuildKey(const std::vector<OverlayPlane>& commit_planes) {
+  size_t size = commit_planes.size();
+  if (size == 0 || size > kMaxPlanes)
+    return false;
+
+  uint32_t hash = 2166136261u;
+  for (size_t i = 0; i < size; i++) {
+    const OverlayPlane& plane = commit_planes.at(i);
+    const OverlayLayer* layer = plane.layer;
+    OverlayBuffer* buffer = layer->GetBuffer();
+    if (!buffer)
+      return false;
+
+    PlaneKey& key = pending_.planes_[i];
+    key.plane_id_ = plane.plane->id();
+    // Test commit fails anyway without a framebuffer, don't
+    // let that decide the result for buffers which have one.
+    key.has_fb_ = buffer->GetFb() != 0;
+    key.format_ = buffer->GetFormat();
+    uint64_t modifier = 0;
+    if (!buffer->GetModifier(&modifier))
+      modifier = DRM_FORMAT_MOD_INVALID;
+
+    key.modifier_lo_ = static_cast<uint32_t>(modifier);
+    key.modifier_hi_ = static_cast<uint32_t>(modifier >> 32);
+    key.buffer_width_ = buffer->GetWidth();
+    key.buffer_height_ = buffer->GetHeight();
+    key.source_width_ = layer->GetSourceCropWidth();
+    key.source_height_ = layer->GetSourceCropHeight();
+    key.display_width_ = layer->GetDisplayFrameWidth();
+    key.display_height_ = layer->GetDisplayFrameHeight();
+    key.transform_ = layer->GetPlaneTransform();
+
+    // Kernel clips planes to the display, which changes the scaling and
+    // source size it checks. Source is clipped in proportion, along the
+    // other axis for layers rotated by 90 or 270 degrees.
+    const HwcRect<int>& frame = layer->GetDisplayFrame();
+    int left = std::max(frame.left, 0);
+    int top = std::max(frame.top, 0);
+    int right = std::min(frame.right, static_cast<int>(width_));
+    int bottom = std::min(frame.bottom, static_cast<int>(height_));
+    key.on_screen_ = left == frame.left && top == frame.top &&
+                     right == frame.right && bottom == frame.bottom;
+    key.visible_display_width_ = right > left ? right - left : 0;
+    key.visible_display_height_ = bottom > top ? bottom - top : 0;
+    key.visible_source_width_ = key.source_width_;
+    key.visible_source_height_ = key.source_height_;
+    if (!key.on_screen_) {
+      uint32_t width = key.visible_display_width_;
+      uint32_t height = key.visible_display_height_;
+      uint32_t full_width = key.display_width_;
+      uint32_t full_height = key.display_height_;
+      if (key.transform_ & (kTransform90 | kTransform270)) {
+        std::swap(width, height);
+        std::swap(full_width, full_height);
+      }
+
+      if (full_width)
+        key.visible_source_width_ = static_cast<uint32_t>(
+            static_cast<uint64_t>(key.source_width_) * width / full_width);
+      if (full_height)
+        key.visible_source_height_ = static_cast<uint32_t>(
+            static_cast<uint64_t>(key.source_height_) * height / full_height);
+    }
+
+    // Plane alpha is only applied to pre-multiplied layers.
+    key.alpha_ = 0xFF;
+    if (layer->GetBlending() == HWCBlending::kBlendingPremult)
+      key.alpha_ = layer->GetAlpha();
+
+    const uint32_t* words = reinterpret_cast<const uint32_t*>(&key);
+    for (size_t j = 0; j < sizeof(PlaneKey) / sizeof(uint32_t); j++) {
+      hash = (hash ^ words[j]) * 16777619u;
+    }
+  }
+
+  pending_.num_planes_ = size;
+  pending_.hash_ = hash;
+  return true;
+}
+
+bool PlaneTestCache::Find(const std::vector<OverlayPlane>& commit_planes,
+                          bool* result) {
+  pending_valid_ = BuildKey(commit_planes);
+  if (!pending_valid_)
+    return false;
+
+  clock_++;
+  for (uint32_t i = 0; i < size_; i++) {
+    Entry& entry = entries_[i];
+    if (entry.hash_ != pending_.hash_ ||
+        entry.num_planes_ != pending_.num_planes_)
+      continue;
+
+    if (memcmp(entry.planes_, pending_.planes_,
+               sizeof(PlaneKey) * pending_.num_planes_))
+      continue;
+
+    entry.last_used_ = clock_;
+    *result = entry.result_;
+    pending_valid_ = false;
+    hits_++;
+    return true;
+  }
+
+  misses_++;
+  return false;
+}
+
+void PlaneTestCache::Add(bool result) {
+  if (!pending_valid_)
+    return;
+
+  pending_valid_ = false;
+  uint32_t index = size_;
+  if (size_ < kMaxEntries) {
+    size_++;
+  } else {
+    // Replace least recently used result.
+    index = 0;
+    for (uint32_t i = 1; i < kMaxEntries; i++) {
+      if (entries_[i].last_used_ < entries_[index].last_used_)
+        index = i;
+    }
+  }
+
+  Entry& entry = entries_[index];
+  entry.hash_ = pending_.hash_;
+  entry.num_planes_ = pending_.num_planes_;
+  entry.last_used_ = clock_;
+  entry.result_ = result;
+  memcpy(entry.planes_, pending_.planes_,
+         sizeof(PlaneKey) * pending_.num_planes_);
+}
+
+void PlaneTestCache::SetDisplaySize(uint32_t width, uint32_t height) {
+  if (width == width_ && height == height_)
+    return;
+
+  width_ = width;
+  height_ = height;
+  Invalidate();
+}
+
+void PlaneTestCache::Invalidate() {
+  if (size_ == 0)
+    return;
+
+  IDISPLAYMANAGERTRACE("PlaneTestCache invalidated: %llu hits %llu misses",
+                       (unsigned long long)hits_,
+                       (unsigned long long)misses_);
+  size_ = 0;
+  pending_valid_ = false;
+}
+
+}  // namespace hwcomposer
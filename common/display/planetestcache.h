@@ -0,0 +1,121 @@
+/*
+// Copyright (c) 2018 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+#ifndef COMMON_DISPLAY_PLANETESTCACHE_H_
+#define COMMON_DISPLAY_PLANETESTCACHE_H_
+
+#include <stdint.h>
+
+#include <vector>
+
+#include "displayplanehandler.h"
+
+namespace hwcomposer {
+
+// Remembers results of recent test commits, so that plane configurations
+// we keep coming back to (i.e. video toggling fullscreen or a window being
+// dragged around) don't need a round trip to the kernel every time.
+// Configurations are keyed by everything deciding if a plane can show a
+// layer: plane, format, source and destination size, rotation and alpha.
+// Positions are only part of the key as far as the display clips a layer,
+// by the size of what is left visible and whether anything was clipped.
+//
+// Usage:
+//   bool result;
+//   if (!cache.Find(commit_planes, &result)) {
+//     result = TestCommit(commit_planes);
+//     cache.Add(result);
+//   }
+class PlaneTestCache {
+ public:
+  static const uint32_t kMaxEntries = 32;
+  // Configurations using more planes than this are never cached.
+  static const uint32_t kMaxPlanes = 8;
+
+  PlaneTestCache() = default;
+
+  PlaneTestCache(const PlaneTestCache& rhs) = delete;
+  PlaneTestCache& operator=(const PlaneTestCache& rhs) = delete;
+
+  // Returns true and sets result if commit_planes were tested
+  // before. Otherwise, a following Add stores the result for them.
+  bool Find(const std::vector<OverlayPlane>& commit_planes, bool* result);
+
+  void Add(bool result);
+
+  // Drops all results, this needs to be called whenever
+  // the display mode or connection changes.
+  void Invalidate();
+
+  // Size of the display layers are clipped to.
+  void SetDisplaySize(uint32_t width, uint32_t height);
+
+  uint64_t GetHits() const {
+    return hits_;
+  }
+
+  uint64_t GetMisses() const {
+    return misses_;
+  }
+
+ private:
+  // Only uint32_t members, so that keys can be compared with memcmp.
+  struct PlaneKey {
+    uint32_t plane_id_;
+    uint32_t has_fb_;
+    uint32_t format_;
+    uint32_t modifier_lo_;
+    uint32_t modifier_hi_;
+    uint32_t buffer_width_;
+    uint32_t buffer_height_;
+    uint32_t source_width_;
+    uint32_t source_height_;
+    uint32_t display_width_;
+    uint32_t display_height_;
+    // Display frame lies fully inside the display.
+    uint32_t on_screen_;
+    uint32_t visible_source_width_;
+    uint32_t visible_source_height_;
+    uint32_t visible_display_width_;
+    uint32_t visible_display_height_;
+    uint32_t transform_;
+    uint32_t alpha_;
+  };
+
+  struct Entry {
+    uint32_t hash_ = 0;
+    uint32_t num_planes_ = 0;
+    uint32_t last_used_ = 0;
+    bool result_ = false;
+    PlaneKey planes_[kMaxPlanes];
+  };
+
+  bool BuildKey(const std::vector<OverlayPlane>& commit_planes);
+
+  Entry entries_[kMaxEntries];
+  // Key of last configuration passed to Find.
+  Entry pending_;
+  bool pending_valid_ = false;
+  uint32_t size_ = 0;
+  uint32_t clock_ = 0;
+  uint32_t width_ = 0;
+  uint32_t height_ = 0;
+  uint64_t hits_ = 0;
+  uint64_t misses_ = 0;
+};
+
+}  // namespace hwcomposer
+#endif  // COMMON_DISPLAY_PLANETESTCACHE_H_
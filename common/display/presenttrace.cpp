@@ -0,0 +1,229 @@
+/*
+// Copyright (c) 2018 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+#include "presenttrace.h"
+
+#include <string.h>
+
+#include <hwclayer.h>
+
+#include "hwctrace.h"
+#include "overlaybuffer.h"
+#include "overlaylayer.h"
+
+namespace hwcomposer {
+
+PresentTraceWriter::~PresentTraceWriter() {
+  if (file_)
+    fclose(file_);
+}
+
+bool PresentTraceWriter::Open(const char* file) {
+  if (file_) {
+    fclose(file_);
+    file_ = NULL;
+  }
+
+  file_ = fopen(file, "wb");
+  if (!file_) {
+    ETRACE("Failed to open present trace file %s. %s", file, PRINTERROR());
+    return false;
+  }
+
+  PresentTraceHeader header;
+  header.magic_ = kPresentTraceMagic;
+  header.version_ = kPresentTraceVersion;
+  if (fwrite(&header, sizeof(header), 1, file_) != 1) {
+    ETRACE("Failed to write present trace header. %s", PRINTERROR());
+    fclose(file_);
+    file_ = NULL;
+    return false;
+  }
+
+  start_ns_ = -1;
+  buffers_.clear();
+  return true;
+}
+
+void PresentTraceWriter::WriteFrame(const std::vector<HwcLayer*>& source_layers,
+                                    const std::vector<OverlayLayer>& layers,
+                                    uint32_t width, uint32_t height,
+                                    int64_t timestamp_ns, uint32_t flags) {
+  if (!file_)
+    return;
+
+  if (start_ns_ == -1)
+    start_ns_ = timestamp_ns;
+
+  PresentTraceFrame frame;
+  frame.timestamp_ns_ = timestamp_ns - start_ns_;
+  frame.display_width_ = width;
+  frame.display_height_ = height;
+  frame.num_layers_ = source_layers.size();
+  frame.flags_ = flags;
+  bool success = fwrite(&frame, sizeof(frame), 1, file_) == 1;
+
+  // OverlayLayers are in the same order as source layers, with
+  // invisible ones skipped.
+  size_t overlay_index = 0;
+  size_t total_overlays = layers.size();
+  for (size_t i = 0; i < source_layers.size() && success; i++) {
+    const HwcLayer* layer = source_layers.at(i);
+    PresentTraceLayer entry;
+    memset(&entry, 0, sizeof(entry));
+    entry.layer_id_ = layer->GetLayerId();
+    entry.transform_ = layer->GetTransform();
+    entry.blending_ = static_cast<uint32_t>(layer->GetBlending());
+    entry.alpha_ = layer->GetAlpha();
+    if (layer->IsVisible())
+      entry.flags_ |= kTraceLayerVisible;
+
+    if (layer->HasLayerContentChanged())
+      entry.flags_ |= kTraceLayerContentChanged;
+
+    const HwcRect<int>& display_frame = layer->GetDisplayFrame();
+    entry.display_frame_[0] = display_frame.left;
+    entry.display_frame_[1] = display_frame.top;
+    entry.display_frame_[2] = display_frame.right;
+    entry.display_frame_[3] = display_frame.bottom;
+    const HwcRect<float>& source_crop = layer->GetSourceCrop();
+    entry.source_crop_[0] = source_crop.left;
+    entry.source_crop_[1] = source_crop.top;
+    entry.source_crop_[2] = source_crop.right;
+    entry.source_crop_[3] = source_crop.bottom;
+    const HwcRect<int>& visible_rect = layer->GetVisibleRect();
+    entry.visible_rect_[0] = visible_rect.left;
+    entry.visible_rect_[1] = visible_rect.top;
+    entry.visible_rect_[2] = visible_rect.right;
+    entry.visible_rect_[3] = visible_rect.bottom;
+
+    HWCNativeHandle handle = layer->GetNativeHandle();
+    if (handle) {
+      auto it = buffers_.find(handle);
+      if (it == buffers_.end()) {
+        it = buffers_.emplace(handle, buffers_.size() + 1).first;
+      }
+
+      entry.buffer_id_ = it->second;
+    }
+
+    while (overlay_index < total_overlays &&
+           layers.at(overlay_index).GetLayerIndex() < i) {
+      overlay_index++;
+    }
+
+    if (overlay_index < total_overlays &&
+        layers.at(overlay_index).GetLayerIndex() == i) {
+      OverlayBuffer* buffer = layers.at(overlay_index).GetBuffer();
+      if (buffer) {
+        entry.buffer_format_ = buffer->GetFormat();
+        entry.buffer_width_ = buffer->GetWidth();
+        entry.buffer_height_ = buffer->GetHeight();
+        entry.buffer_usage_ = buffer->GetUsage();
+      }
+    }
+
+    const HwcRegion& damage = layer->GetSurfaceDamageRegion();
+    damage_.clear();
+    if (entry.flags_ & kTraceLayerContentChanged) {
+      for (const HwcRect<int>& rect : damage) {
+        damage_.emplace_back(rect.left);
+        damage_.emplace_back(rect.top);
+        damage_.emplace_back(rect.right);
+        damage_.emplace_back(rect.bottom);
+      }
+    }
+
+    entry.num_damage_rects_ = damage_.size() / 4;
+    success = fwrite(&entry, sizeof(entry), 1, file_) == 1;
+    if (success && !damage_.empty()) {
+      success = fwrite(damage_.data(), sizeof(int32_t), damage_.size(),
+                       file_) == damage_.size();
+    }
+  }
+
+  if (!success) {
+    ETRACE("Failed to write present trace, disabling it. %s", PRINTERROR());
+    fclose(file_);
+    file_ = NULL;
+  }
+}
+
+PresentTraceReader::~PresentTraceReader() {
+  if (file_)
+    fclose(file_);
+}
+
+bool PresentTraceReader::Open(const char* file) {
+  if (file_) {
+    fclose(file_);
+    file_ = NULL;
+  }
+
+  file_ = fopen(file, "rb");
+  if (!file_) {
+    ETRACE("Failed to open present trace file %s. %s", file, PRINTERROR());
+    return false;
+  }
+
+  PresentTraceHeader header;
+  if (fread(&header, sizeof(header), 1, file_) != 1 ||
+      header.magic_ != kPresentTraceMagic ||
+      header.version_ != kPresentTraceVersion) {
+    ETRACE("%s is not a supported present trace.", file);
+    fclose(file_);
+    file_ = NULL;
+    return false;
+  }
+
+  return true;
+}
+
+bool PresentTraceReader::ReadFrame(PresentTraceFrame* frame,
+                                   std::vector<PresentTraceLayer>* layers,
+                                   std::vector<HwcRegion>* damage) {
+  if (!file_)
+    return false;
+
+  if (fread(frame, sizeof(PresentTraceFrame), 1, file_) != 1)
+    return false;
+
+  layers->resize(frame->num_layers_);
+  damage->resize(frame->num_layers_);
+  for (uint32_t i = 0; i < frame->num_layers_; i++) {
+    PresentTraceLayer& entry = layers->at(i);
+    if (fread(&entry, sizeof(entry), 1, file_) != 1) {
+      ETRACE("Present trace is truncated.");
+      return false;
+    }
+
+    HwcRegion& region = damage->at(i);
+    region.clear();
+    for (uint32_t r = 0; r < entry.num_damage_rects_; r++) {
+      int32_t rect[4];
+      if (fread(rect, sizeof(int32_t), 4, file_) != 4) {
+        ETRACE("Present trace is truncated.");
+        return false;
+      }
+
+      region.emplace_back(rect[0], rect[1], rect[2], rect[3]);
+    }
+  }
+
+  return true;
+}
+
+}  // namespace hwcomposer
@@ -0,0 +1,133 @@
+/*
+// Copyright (c) 2018 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+#ifndef COMMON_DISPLAY_PRESENTTRACE_H_
+#define COMMON_DISPLAY_PRESENTTRACE_H_
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <hwcdefs.h>
+#include <platformdefines.h>
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace hwcomposer {
+
+struct HwcLayer;
+struct OverlayLayer;
+
+// Binary trace of layers passed to a display every frame. The file starts
+// with a PresentTraceHeader, followed by one PresentTraceFrame per frame.
+// Every frame is followed by its PresentTraceLayer entries, and each layer
+// by its damage rects (as int32_t left, top, right, bottom). All values
+// are stored in host byte order.
+static const uint32_t kPresentTraceMagic = 0x54435748;  // "HWCT"
+static const uint32_t kPresentTraceVersion = 1;
+
+struct PresentTraceHeader {
+  uint32_t magic_;
+  uint32_t version_;
+};
+
+enum PresentTraceFrameFlags {
+  kTraceIdleUpdate = 1 << 0,
+  kTraceHandleConstraints = 1 << 1
+};
+
+struct PresentTraceFrame {
+  int64_t timestamp_ns_;  // Relative to first frame in the trace.
+  uint32_t display_width_;
+  uint32_t display_height_;
+  uint32_t num_layers_;
+  uint32_t flags_;
+};
+
+enum PresentTraceLayerFlags {
+  kTraceLayerVisible = 1 << 0,
+  kTraceLayerContentChanged = 1 << 1
+};
+
+struct PresentTraceLayer {
+  uint64_t layer_id_;
+  // Buffers are numbered in order of first use. Zero means
+  // layer has no buffer.
+  uint32_t buffer_id_;
+  uint32_t buffer_format_;
+  uint32_t buffer_width_;
+  uint32_t buffer_height_;
+  uint32_t buffer_usage_;
+  uint32_t transform_;
+  uint32_t blending_;
+  uint32_t flags_;
+  int32_t display_frame_[4];
+  float source_crop_[4];
+  int32_t visible_rect_[4];
+  uint8_t alpha_;
+  uint8_t reserved_[3];
+  // Number of damage rects following this layer. Zero with
+  // kTraceLayerContentChanged set means the whole layer changed.
+  uint32_t num_damage_rects_;
+};
+
+// Records layers passed to a display in a trace file.
+class PresentTraceWriter {
+ public:
+  PresentTraceWriter() = default;
+  ~PresentTraceWriter();
+
+  PresentTraceWriter(const PresentTraceWriter& rhs) = delete;
+  PresentTraceWriter& operator=(const PresentTraceWriter& rhs) = delete;
+
+  bool Open(const char* file);
+
+  // Writes one frame. layers are the OverlayLayers created for
+  // visible source_layers and are used to describe their buffers.
+  void WriteFrame(const std::vector<HwcLayer*>& source_layers,
+                  const std::vector<OverlayLayer>& layers, uint32_t width,
+                  uint32_t height, int64_t timestamp_ns, uint32_t flags);
+
+ private:
+  FILE* file_ = NULL;
+  int64_t start_ns_ = -1;
+  std::unordered_map<HWCNativeHandle, uint32_t> buffers_;
+  std::vector<int32_t> damage_;
+};
+
+// Reads back a trace written by PresentTraceWriter.
+class PresentTraceReader {
+ public:
+  PresentTraceReader() = default;
+  ~PresentTraceReader();
+
+  PresentTraceReader(const PresentTraceReader& rhs) = delete;
+  PresentTraceReader& operator=(const PresentTraceReader& rhs) = delete;
+
+  bool Open(const char* file);
+
+  // Reads next frame. Returns false at end of trace or on error.
+  bool ReadFrame(PresentTraceFrame* frame,
+                 std::vector<PresentTraceLayer>* layers,
+                 std::vector<HwcRegion>* damage);
+
+ private:
+  FILE* file_ = NULL;
+};
+
+}  // namespace hwcomposer
+#endif  // COMMON_DISPLAY_PRESENTTRACE_H_
@@ -0,0 +1,246 @@
+/*
+// Copyright (c) 2018 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+#include "scalercapabilities.h"
+
+#include <hwcdefs.h>
+
+#include <algorithm>
+
+#include "overlaybuffer.h"
+#include "overlaylayer.h"
+
+namespace hwcomposer {
+
+static bool IsRotated(uint32_t transform) {
+  return transform & (kTransform90 | kTransform270);
+}
+
+// Largest factors by which source is enlarged and shrunk in any
+// direction, 1 if it isn't.
+static void GetScaleFactors(uint32_t source_width, uint32_t source_height,
+                            uint32_t display_width, uint32_t display_height,
+                            float* upscale, float* downscale) {
+  *upscale = 1.0f;
+  *downscale = 1.0f;
+  uint32_t sources[2] = {source_width, source_height};
+  uint32_t displays[2] = {display_width, display_height};
+  for (uint32_t i = 0; i < 2; i++) {
+    float factor = static_cast<float>(displays[i]) / sources[i];
+    if (factor > 1.0f) {
+      *upscale = std::max(*upscale, factor);
+    } else if (factor < 1.0f) {
+      *downscale = std::max(*downscale, 1.0f / factor);
+    }
+  }
+}
+
+void ScalerCapabilities::Initialize(
+    const std::vector<std::unique_ptr<DisplayPlane>>& planes,
+    uint32_t max_scaled_planes) {
+  planes_.clear();
+  planes_.reserve(planes.size());
+  for (const std::unique_ptr<DisplayPlane>& plane : planes) {
+    planes_.emplace_back();
+    PlaneEntry& entry = planes_.back();
+    entry.plane_ = plane.get();
+    entry.known_ = plane->GetScalingLimits(&entry.limits_);
+  }
+
+  max_scaled_planes_ = max_scaled_planes;
+  learned_.clear();
+  learned_.reserve(kMaxLearned);
+}
+
+bool ScalerCapabilities::NeedsScaling(const OverlayLayer* layer) {
+  uint32_t source_width = layer->GetSourceCropWidth();
+  uint32_t source_height = layer->GetSourceCropHeight();
+  if (IsRotated(layer->GetPlaneTransform()))
+    std::swap(source_width, source_height);
+
+  return source_width != layer->GetDisplayFrameWidth() ||
+         source_height != layer->GetDisplayFrameHeight();
+}
+
+uint32_t ScalerCapabilities::CountScaledPlanes(
+    const std::vector<OverlayPlane>& commit_planes,
+    const DisplayPlane* plane) {
+  uint32_t scaled_planes = 0;
+  for (const OverlayPlane& commit_plane : commit_planes) {
+    if (commit_plane.plane != plane && commit_plane.layer &&
+        NeedsScaling(commit_plane.layer))
+      scaled_planes++;
+  }
+
+  return scaled_planes;
+}
+
+bool ScalerCapabilities::CanScale(const DisplayPlane* plane, uint32_t format,
+                                  uint32_t transform, uint32_t source_width,
+                                  uint32_t source_height,
+                                  uint32_t display_width,
+                                  uint32_t display_height,
+                                  uint32_t other_scaled_planes) const {
+  bool rotated = IsRotated(transform);
+  if (rotated)
+    std::swap(source_width, source_height);
+
+  if (source_width == display_width && source_height == display_height)
+    return true;
+
+  if (!source_width || !source_height || !display_width || !display_height)
+    return Reject();
+
+  float upscale;
+  float downscale;
+  GetScaleFactors(source_width, source_height, display_width, display_height,
+                  &upscale, &downscale);
+  // Without known limits, only learned ones apply.
+  const PlaneEntry* entry = FindPlane(plane);
+  if (entry && entry->known_) {
+    const PlaneScalingLimits& limits = entry->limits_;
+    if (!limits.scaling_)
+      return Reject();
+
+    if (limits.max_upscale_ > 0 && upscale > limits.max_upscale_)
+      return Reject();
+
+    if (limits.max_downscale_ > 0 && downscale > limits.max_downscale_)
+      return Reject();
+
+    if (rotated && !limits.rotated_scaling_)
+      return Reject();
+
+    uint32_t min_size = std::min(std::min(source_width, source_height),
+                                 std::min(display_width, display_height));
+    if (limits.min_size_ && min_size < limits.min_size_)
+      return Reject();
+
+    uint32_t max_size = std::max(std::max(source_width, source_height),
+                                 std::max(display_width, display_height));
+    if (limits.max_size_ && max_size > limits.max_size_)
+      return Reject();
+
+    const std::vector<uint32_t>& formats = limits.unscalable_formats_;
+    if (std::find(formats.begin(), formats.end(), format) != formats.end())
+      return Reject();
+  }
+
+  if (max_scaled_planes_ && other_scaled_planes >= max_scaled_planes_)
+    return Reject();
+
+  const Learned* learned = FindLearned(plane->id(), format);
+  if (learned) {
+    if (learned->failed_upscale_ > 0 && upscale >= learned->failed_upscale_)
+      return Reject();
+
+    if (learned->failed_downscale_ > 0 &&
+        downscale >= learned->failed_downscale_)
+      return Reject();
+  }
+
+  return true;
+}
+
+bool ScalerCapabilities::CanScale(const DisplayPlane* plane,
+                                  const OverlayLayer* layer,
+                                  uint32_t other_scaled_planes) const {
+  return CanScale(plane, layer->GetBuffer()->GetFormat(),
+                  layer->GetPlaneTransform(), layer->GetSourceCropWidth(),
+                  layer->GetSourceCropHeight(), layer->GetDisplayFrameWidth(),
+                  layer->GetDisplayFrameHeight(), other_scaled_planes);
+}
+
+void ScalerCapabilities::ScalingFailed(
+    const DisplayPlane* plane, uint32_t format, uint32_t transform,
+    uint32_t source_width, uint32_t source_height, uint32_t display_width,
+    uint32_t display_height, uint32_t other_scaled_planes) {
+  // Can't tell which of the scalers was to blame.
+  if (other_scaled_planes > 0)
+    return;
+
+  if (IsRotated(transform))
+    std::swap(source_width, source_height);
+
+  if (!source_width || !source_height || !display_width || !display_height)
+    return;
+
+  float upscale;
+  float downscale;
+  GetScaleFactors(source_width, source_height, display_width, display_height,
+                  &upscale, &downscale);
+  // Enlarging one direction and shrinking the other, we don't know
+  // which one failed.
+  if ((upscale > 1.0f) == (downscale > 1.0f))
+    return;
+
+  Learned* learned = FindLearned(plane->id(), format);
+  if (!learned) {
+    if (learned_.size() >= kMaxLearned)
+      return;
+
+    learned_.emplace_back();
+    learned = &learned_.back();
+    learned->plane_id_ = plane->id();
+    learned->format_ = format;
+    learned->failed_upscale_ = 0;
+    learned->failed_downscale_ = 0;
+  }
+
+  if (upscale > 1.0f) {
+    if (!learned->failed_upscale_ || upscale < learned->failed_upscale_)
+      learned->failed_upscale_ = upscale;
+  } else if (!learned->failed_downscale_ ||
+             downscale < learned->failed_downscale_) {
+    learned->failed_downscale_ = downscale;
+  }
+}
+
+void ScalerCapabilities::Reset() {
+  learned_.clear();
+}
+
+bool ScalerCapabilities::Reject() const {
+  rejections_++;
+  return false;
+}
+
+const ScalerCapabilities::PlaneEntry* ScalerCapabilities::FindPlane(
+    const DisplayPlane* plane) const {
+  for (const PlaneEntry& entry : planes_) {
+    if (entry.plane_ == plane)
+      return &entry;
+  }
+
+  return NULL;
+}
+
+ScalerCapabilities::Learned* ScalerCapabilities::FindLearned(
+    uint32_t plane_id, uint32_t format) {
+  for (Learned& learned : learned_) {
+    if (learned.plane_id_ == plane_id && learned.format_ == format)
+      return &learned;
+  }
+
+  return NULL;
+}
+
+const ScalerCapabilities::Learned* ScalerCapabilities::FindLearned(
+    uint32_t plane_id, uint32_t format) const {
+  return const_cast<ScalerCapabilities*>(this)->FindLearned(plane_id, format);
+}
+
+}  // namespace hwcomposer
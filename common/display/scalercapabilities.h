@@ -0,0 +1,114 @@
+/*
+// Copyright (c) 2018 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+#ifndef COMMON_DISPLAY_SCALERCAPABILITIES_H_
+#define COMMON_DISPLAY_SCALERCAPABILITIES_H_
+
+#include <stdint.h>
+
+#include <memory>
+#include <vector>
+
+#include "displayplane.h"
+#include "displayplanehandler.h"
+
+namespace hwcomposer {
+
+// Table of what scalers of every plane can do, built from limits planes
+// report when populated. Lets plane scaling which can't work be rejected
+// without a test commit. Test commits which fail only because of scaling
+// tighten limits for that plane and format, so that the same or larger
+// factors aren't tried again until Reset.
+class ScalerCapabilities {
+ public:
+  // Formats with learned limits. Failures beyond this aren't remembered.
+  static const uint32_t kMaxLearned = 32;
+
+  ScalerCapabilities() = default;
+
+  ScalerCapabilities(const ScalerCapabilities& rhs) = delete;
+  ScalerCapabilities& operator=(const ScalerCapabilities& rhs) = delete;
+
+  void Initialize(const std::vector<std::unique_ptr<DisplayPlane>>& planes,
+                  uint32_t max_scaled_planes);
+
+  // Returns true if showing layer on a plane needs a scaler.
+  static bool NeedsScaling(const OverlayLayer* layer);
+
+  // Number of planes in commit_planes, other than plane, using a scaler.
+  static uint32_t CountScaledPlanes(
+      const std::vector<OverlayPlane>& commit_planes,
+      const DisplayPlane* plane);
+
+  // Returns false if plane surely can't scale source_width x
+  // source_height of format to display_width x display_height, while
+  // other_scaled_planes of the commit use a scaler. True if no scaling
+  // is needed or only a test commit can tell.
+  bool CanScale(const DisplayPlane* plane, uint32_t format,
+                uint32_t transform, uint32_t source_width,
+                uint32_t source_height, uint32_t display_width,
+                uint32_t display_height, uint32_t other_scaled_planes) const;
+
+  bool CanScale(const DisplayPlane* plane, const OverlayLayer* layer,
+                uint32_t other_scaled_planes) const;
+
+  // A test commit with plane scaling source_width x source_height of
+  // format to display_width x display_height failed, while the same
+  // commit passed with plane not scaling. Callers need to check the
+  // latter, so that failures due to bandwidth or watermarks aren't
+  // taken for scaling limits. Learned only if no other plane of the
+  // commit used a scaler.
+  void ScalingFailed(const DisplayPlane* plane, uint32_t format,
+                     uint32_t transform, uint32_t source_width,
+                     uint32_t source_height, uint32_t display_width,
+                     uint32_t display_height, uint32_t other_scaled_planes);
+
+  // Forgets learned limits, as they may depend on the display mode.
+  void Reset();
+
+  // Number of scaling checks which failed, saving a test commit.
+  uint64_t GetRejections() const {
+    return rejections_;
+  }
+
+ private:
+  struct PlaneEntry {
+    const DisplayPlane* plane_;
+    bool known_;
+    PlaneScalingLimits limits_;
+  };
+
+  struct Learned {
+    uint32_t plane_id_;
+    uint32_t format_;
+    // Smallest factors known to fail, zero if none.
+    float failed_upscale_;
+    float failed_downscale_;
+  };
+
+  bool Reject() const;
+  const PlaneEntry* FindPlane(const DisplayPlane* plane) const;
+  Learned* FindLearned(uint32_t plane_id, uint32_t format);
+  const Learned* FindLearned(uint32_t plane_id, uint32_t format) const;
+
+  std::vector<PlaneEntry> planes_;
+  std::vector<Learned> learned_;
+  uint32_t max_scaled_planes_ = 0;
+  mutable uint64_t rejections_ = 0;
+};
+
+}  // namespace hwcomposer
+#endif  // COMMON_DISPLAY_SCALERCAPABILITIES_H_
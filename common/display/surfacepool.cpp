@@ -0,0 +1,282 @@
+/*
+// Copyright (c) 2018 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+#include "surfacepool.h"
+
+#include <drm_fourcc.h>
+
+#include "hwcutils.h"
+#include "nativesurface.h"
+#include "overlaybuffer.h"
+
+namespace hwcomposer {
+
+// Smallest size class, in pixels.
+static const uint32_t kMinSizeClass = 64;
+
+static uint64_t EstimateSurfaceBytes(NativeSurface* surface) {
+  OverlayBuffer* buffer = surface->GetLayer()->GetBuffer();
+  if (!buffer)
+    return 0;
+
+  // Chroma planes of multi-planar formats are assumed to be
+  // subsampled vertically, which holds for all formats we
+  // composite into.
+  const uint32_t* pitches = buffer->GetPitches();
+  uint32_t height = buffer->GetHeight();
+  uint32_t total_planes = GetTotalPlanesForFormat(buffer->GetFormat());
+  uint64_t bytes = static_cast<uint64_t>(pitches[0]) * height;
+  for (uint32_t i = 1; i < total_planes; i++) {
+    bytes += static_cast<uint64_t>(pitches[i]) * ((height + 1) / 2);
+  }
+
+  return bytes;
+}
+
+std::shared_ptr<SurfacePoolBudget> SurfacePoolBudget::Shared() {
+  static std::shared_ptr<SurfacePoolBudget> budget(new SurfacePoolBudget());
+  return budget;
+}
+
+SurfacePool::SurfacePool() : budget_(new SurfacePoolBudget()) {
+}
+
+SurfacePool::~SurfacePool() {
+  ReleaseAll();
+}
+
+void SurfacePool::SetMaxSize(uint32_t max_width, uint32_t max_height) {
+  max_width_ = max_width;
+  max_height_ = max_height;
+}
+
+void SurfacePool::SetBudget(std::shared_ptr<SurfacePoolBudget> budget) {
+  if (budget == budget_)
+    return;
+
+  budget_->Refund(bytes_);
+  budget_ = std::move(budget);
+  budget_->Charge(bytes_);
+}
+
+uint32_t SurfacePool::RoundToSizeClass(uint32_t size, uint32_t max_size) const {
+  uint32_t size_class = kMinSizeClass;
+  if (size > kMinSizeClass) {
+    // Four classes per power of two, wasting at most a
+    // quarter of every dimension.
+    uint32_t power = 1;
+    while (power < size / 2)
+      power <<= 1;
+
+    uint32_t step = power / 4;
+    size_class = ((size + step - 1) / step) * step;
+  }
+
+  if (max_size && size_class > max_size && size <= max_size)
+    size_class = max_size;
+
+  return size_class;
+}
+
+uint32_t SurfacePool::GetBucket(uint32_t format, uint32_t usage,
+                                uint64_t modifier, uint32_t width,
+                                uint32_t height) {
+  BucketKey key;
+  key.size_key_ = (static_cast<uint64_t>(format) << 32) |
+                  (static_cast<uint64_t>(usage & 0x3) << 30) |
+                  (static_cast<uint64_t>(width & 0x7fff) << 15) |
+                  static_cast<uint64_t>(height & 0x7fff);
+  key.modifier_ = modifier;
+  auto it = bucket_index_.find(key);
+  if (it != bucket_index_.end())
+    return it->second;
+
+  uint32_t bucket = buckets_.size();
+  buckets_.emplace_back();
+  bucket_index_.emplace(key, bucket);
+  return bucket;
+}
+
+NativeSurface* SurfacePool::Acquire(uint32_t format, uint32_t usage,
+                                    const std::vector<uint64_t>& modifiers,
+                                    uint32_t* width, uint32_t* height) {
+  *width = RoundToSizeClass(*width, max_width_);
+  *height = RoundToSizeClass(*height, max_height_);
+  uint32_t slot = kNone;
+  for (const uint64_t& modifier : modifiers) {
+    slot = buckets_[GetBucket(format, usage, modifier, *width, *height)]
+               .free_head_;
+    if (slot != kNone)
+      break;
+  }
+
+  if (slot == kNone) {
+    slot = buckets_[GetBucket(format, usage, DRM_FORMAT_MOD_INVALID, *width,
+                              *height)].free_head_;
+  }
+
+  if (slot == kNone)
+    return NULL;
+
+  reuses_++;
+  NativeSurface* surface = entries_[slot].surface_.get();
+  surface->SetInUse(true);
+  return surface;
+}
+
+NativeSurface* SurfacePool::Add(NativeSurface* surface, uint32_t format,
+                                uint32_t usage) {
+  uint32_t slot = entries_.size();
+  entries_.emplace_back();
+  Entry& entry = entries_.back();
+  entry.surface_.reset(surface);
+  uint64_t modifier = DRM_FORMAT_MOD_INVALID;
+  OverlayBuffer* buffer = surface->GetLayer()->GetBuffer();
+  if (!buffer || !buffer->GetModifier(&modifier))
+    modifier = DRM_FORMAT_MOD_INVALID;
+
+  entry.bucket_ = GetBucket(format, usage, modifier, surface->GetWidth(),
+                            surface->GetHeight());
+  entry.bytes_ = EstimateSurfaceBytes(surface);
+  bytes_ += entry.bytes_;
+  budget_->Charge(entry.bytes_);
+  allocations_++;
+
+  surface->pool_ = this;
+  surface->pool_slot_ = slot;
+  surface->SetInUse(true);
+  return surface;
+}
+
+void SurfacePool::SurfaceInUseChanged(uint32_t slot, bool in_use) {
+  Entry& entry = entries_[slot];
+  if (in_use && entry.free_) {
+    Unlink(slot);
+  } else if (!in_use && !entry.free_) {
+    Link(slot);
+  }
+}
+
+void SurfacePool::Link(uint32_t slot) {
+  Entry& entry = entries_[slot];
+  entry.free_ = true;
+
+  entry.lru_prev_ = kNone;
+  entry.lru_next_ = lru_head_;
+  if (lru_head_ != kNone)
+    entries_[lru_head_].lru_prev_ = slot;
+  else
+    lru_tail_ = slot;
+  lru_head_ = slot;
+
+  Bucket& bucket = buckets_[entry.bucket_];
+  entry.free_prev_ = kNone;
+  entry.free_next_ = bucket.free_head_;
+  if (bucket.free_head_ != kNone)
+    entries_[bucket.free_head_].free_prev_ = slot;
+  bucket.free_head_ = slot;
+}
+
+void SurfacePool::Unlink(uint32_t slot) {
+  Entry& entry = entries_[slot];
+  entry.free_ = false;
+
+  if (entry.lru_prev_ != kNone)
+    entries_[entry.lru_prev_].lru_next_ = entry.lru_next_;
+  else
+    lru_head_ = entry.lru_next_;
+  if (entry.lru_next_ != kNone)
+    entries_[entry.lru_next_].lru_prev_ = entry.lru_prev_;
+  else
+    lru_tail_ = entry.lru_prev_;
+
+  if (entry.free_prev_ != kNone)
+    entries_[entry.free_prev_].free_next_ = entry.free_next_;
+  else
+    buckets_[entry.bucket_].free_head_ = entry.free_next_;
+  if (entry.free_next_ != kNone)
+    entries_[entry.free_next_].free_prev_ = entry.free_prev_;
+
+  entry.lru_prev_ = entry.lru_next_ = kNone;
+  entry.free_prev_ = entry.free_next_ = kNone;
+}
+
+void SurfacePool::Relocate(uint32_t from, uint32_t to) {
+  entries_[to] = std::move(entries_[from]);
+  Entry& entry = entries_[to];
+  entry.surface_->pool_slot_ = to;
+  if (!entry.free_)
+    return;
+
+  if (entry.lru_prev_ != kNone)
+    entries_[entry.lru_prev_].lru_next_ = to;
+  else
+    lru_head_ = to;
+  if (entry.lru_next_ != kNone)
+    entries_[entry.lru_next_].lru_prev_ = to;
+  else
+    lru_tail_ = to;
+
+  if (entry.free_prev_ != kNone)
+    entries_[entry.free_prev_].free_next_ = to;
+  else
+    buckets_[entry.bucket_].free_head_ = to;
+  if (entry.free_next_ != kNone)
+    entries_[entry.free_next_].free_prev_ = to;
+}
+
+void SurfacePool::Remove(uint32_t slot) {
+  Entry& entry = entries_[slot];
+  if (entry.free_)
+    Unlink(slot);
+
+  bytes_ -= entry.bytes_;
+  budget_->Refund(entry.bytes_);
+  entry.surface_.reset(nullptr);
+
+  uint32_t last = entries_.size() - 1;
+  if (slot != last)
+    Relocate(last, slot);
+
+  entries_.pop_back();
+}
+
+void SurfacePool::Trim() {
+  while (lru_tail_ != kNone && budget_->IsOverLimit()) {
+    Remove(lru_tail_);
+    evictions_++;
+  }
+}
+
+void SurfacePool::ReleaseFree() {
+  while (lru_tail_ != kNone) {
+    Remove(lru_tail_);
+  }
+}
+
+void SurfacePool::ReleaseAll() {
+  budget_->Refund(bytes_);
+  bytes_ = 0;
+  std::vector<Entry>().swap(entries_);
+  for (Bucket& bucket : buckets_) {
+    bucket.free_head_ = kNone;
+  }
+
+  lru_head_ = kNone;
+  lru_tail_ = kNone;
+}
+
+}  // namespace hwcomposer
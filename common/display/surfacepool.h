@@ -0,0 +1,232 @@
+/*
+// Copyright (c) 2018 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+#ifndef COMMON_DISPLAY_SURFACEPOOL_H_
+#define COMMON_DISPLAY_SURFACEPOOL_H_
+
+#include <stdint.h>
+
+#include <atomic>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+namespace hwcomposer {
+
+class NativeSurface;
+
+// Limits memory used by offscreen surfaces. A budget can be
+// shared by the surface pools of several displays. The limit is
+// best effort: it never fails an allocation, it only decides how
+// many unused surfaces a pool evicts in Trim. Pools only evict
+// their own surfaces, on the thread of their display, so unused
+// surfaces of a display which doesn't present are kept even while
+// other displays sharing the budget are over it. A limit of 0
+// means no limit.
+class SurfacePoolBudget {
+ public:
+  explicit SurfacePoolBudget(uint64_t limit = 0) : limit_(limit), used_(0) {
+  }
+
+  SurfacePoolBudget(const SurfacePoolBudget& rhs) = delete;
+  SurfacePoolBudget& operator=(const SurfacePoolBudget& rhs) = delete;
+
+  // Budget shared by all displays in this process.
+  static std::shared_ptr<SurfacePoolBudget> Shared();
+
+  void SetLimit(uint64_t limit) {
+    limit_.store(limit, std::memory_order_relaxed);
+  }
+
+  uint64_t GetLimit() const {
+    return limit_.load(std::memory_order_relaxed);
+  }
+
+  uint64_t GetUsed() const {
+    return used_.load(std::memory_order_relaxed);
+  }
+
+  bool IsOverLimit() const {
+    uint64_t limit = GetLimit();
+    return limit && GetUsed() > limit;
+  }
+
+  void Charge(uint64_t bytes) {
+    used_.fetch_add(bytes, std::memory_order_relaxed);
+  }
+
+  void Refund(uint64_t bytes) {
+    used_.fetch_sub(bytes, std::memory_order_relaxed);
+  }
+
+ private:
+  std::atomic<uint64_t> limit_;
+  std::atomic<uint64_t> used_;
+};
+
+// Owns offscreen surfaces of a display. Surfaces are bucketed by
+// format, usage, layout modifier and size class, every bucket keeping a list of
+// its unused surfaces, so that acquiring one is O(1). Surfaces
+// report going in and out of use themselves (NativeSurface::SetInUse),
+// which keeps the lists current without any scanning. Unused surfaces
+// are also kept in least recently used order, oldest ones are evicted
+// first once the budget is exceeded.
+//
+// Usage:
+//   NativeSurface* surface =
+//       pool.Acquire(format, usage, modifiers, &width, &height);
+//   if (!surface) {
+//     surface = Create3DBuffer(width, height);
+//     surface->Init(resource_manager, format, usage, modifiers);
+//     pool.Add(surface, format, usage);
+//   }
+//
+// All calls need to be made on the thread updating the display.
+class SurfacePool {
+ public:
+  SurfacePool();
+  ~SurfacePool();
+
+  SurfacePool(const SurfacePool& rhs) = delete;
+  SurfacePool& operator=(const SurfacePool& rhs) = delete;
+
+  // Size classes are capped to max_width x max_height, so that
+  // surfaces covering the whole display are allocated at its size.
+  void SetMaxSize(uint32_t max_width, uint32_t max_height);
+
+  void SetBudget(std::shared_ptr<SurfacePoolBudget> budget);
+
+  const std::shared_ptr<SurfacePoolBudget>& GetBudget() const {
+    return budget_;
+  }
+
+  // Rounds width and height up to their size class and returns an unused
+  // surface of that size, format and usage marked as in use, or NULL in
+  // case a new surface of width x height needs to be allocated. Surfaces
+  // laid out as per one of modifiers are preferred in that order, those
+  // with implicit layout are taken otherwise.
+  NativeSurface* Acquire(uint32_t format, uint32_t usage,
+                         const std::vector<uint64_t>& modifiers,
+                         uint32_t* width, uint32_t* height);
+
+  // Takes ownership of surface, allocated after Acquire failed,
+  // and marks it as in use.
+  NativeSurface* Add(NativeSurface* surface, uint32_t format, uint32_t usage);
+
+  // Evicts least recently used surfaces of this pool until the budget
+  // is met or no unused surfaces are left. Unused surfaces must not be
+  // referenced by the frame being prepared when this is called.
+  void Trim();
+
+  // Frees all unused surfaces.
+  void ReleaseFree();
+
+  // Frees all surfaces.
+  void ReleaseAll();
+
+  bool IsEmpty() const {
+    return entries_.empty();
+  }
+
+  size_t GetSize() const {
+    return entries_.size();
+  }
+
+  // Bytes used by surfaces of this pool.
+  uint64_t GetBytes() const {
+    return bytes_;
+  }
+
+  uint64_t GetAllocations() const {
+    return allocations_;
+  }
+
+  uint64_t GetReuses() const {
+    return reuses_;
+  }
+
+  uint64_t GetEvictions() const {
+    return evictions_;
+  }
+
+ private:
+  friend class NativeSurface;
+
+  static const uint32_t kNone = UINT32_MAX;
+
+  struct Entry {
+    std::unique_ptr<NativeSurface> surface_;
+    uint64_t bytes_ = 0;
+    uint32_t bucket_ = 0;
+    // Links of the least recently used list and of the free list of
+    // the bucket. Only valid while the surface is unused.
+    uint32_t lru_prev_ = kNone;
+    uint32_t lru_next_ = kNone;
+    uint32_t free_prev_ = kNone;
+    uint32_t free_next_ = kNone;
+    bool free_ = false;
+  };
+
+  // Unused surfaces, most recently used first.
+  struct Bucket {
+    uint32_t free_head_ = kNone;
+  };
+
+  struct BucketKey {
+    uint64_t size_key_;
+    uint64_t modifier_;
+
+    bool operator==(const BucketKey& rhs) const {
+      return size_key_ == rhs.size_key_ && modifier_ == rhs.modifier_;
+    }
+  };
+
+  struct BucketKeyHash {
+    size_t operator()(const BucketKey& key) const {
+      return std::hash<uint64_t>()(key.size_key_ ^ (key.modifier_ * 31));
+    }
+  };
+
+  // Called by NativeSurface whenever it goes in or out of use.
+  void SurfaceInUseChanged(uint32_t slot, bool in_use);
+
+  uint32_t RoundToSizeClass(uint32_t size, uint32_t max_size) const;
+  // modifier is DRM_FORMAT_MOD_INVALID for implicit layouts.
+  uint32_t GetBucket(uint32_t format, uint32_t usage, uint64_t modifier,
+                     uint32_t width, uint32_t height);
+
+  void Link(uint32_t slot);
+  void Unlink(uint32_t slot);
+  // Moves entry at from to slot to, which must be unused.
+  void Relocate(uint32_t from, uint32_t to);
+  void Remove(uint32_t slot);
+
+  std::vector<Entry> entries_;
+  std::vector<Bucket> buckets_;
+  std::unordered_map<BucketKey, uint32_t, BucketKeyHash> bucket_index_;
+  std::shared_ptr<SurfacePoolBudget> budget_;
+  uint32_t lru_head_ = kNone;
+  uint32_t lru_tail_ = kNone;
+  uint32_t max_width_ = 0;
+  uint32_t max_height_ = 0;
+  uint64_t bytes_ = 0;
+  uint64_t allocations_ = 0;
+  uint64_t reuses_ = 0;
+  uint64_t evictions_ = 0;
+};
+
+}  // namespace hwcomposer
+#endif  // COMMON_DISPLAY_SURFACEPOOL_H_
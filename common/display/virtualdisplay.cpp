@@ -93,6 +93,7 @@ bool VirtualDisplay::Present(std::vector<HwcLayer *> &source_layers,
   uint32_t z_order = 0;
 
   resource_manager_->RefreshBufferCache();
+  layer_diff_.Reset(in_flight_layers_);
   for (size_t layer_index = 0; layer_index < size; layer_index++) {
     HwcLayer *layer = source_layers.at(layer_index);
     layer->SetReleaseFence(-1);
@@ -102,8 +103,9 @@ bool VirtualDisplay::Present(std::vector<HwcLayer *> &source_layers,
     layers.emplace_back();
     OverlayLayer& overlay_layer = layers.back();
     OverlayLayer* previous_layer = NULL;
-    if (previous_size > z_order) {
-      previous_layer = &(in_flight_layers_.at(z_order));
+    int previous_index = layer_diff_.Find(layer->GetLayerId());
+    if (previous_index != -1) {
+      previous_layer = &(in_flight_layers_.at(previous_index));
     }
 
     overlay_layer.InitializeFromHwcLayer(
@@ -111,6 +113,7 @@ bool VirtualDisplay::Present(std::vector<HwcLayer *> &source_layers,
         width_, kRotateNone, handle_constraints);
     index.emplace_back(z_order);
     layers_rects.emplace_back(layer->GetDisplayFrame());
+    layer_diff_.Add(previous_index);
     z_order++;
 
     if (frame_changed) {
@@ -127,6 +130,10 @@ bool VirtualDisplay::Present(std::vector<HwcLayer *> &source_layers,
     layer->Validate();
   }
 
+  // Layers might have been re-ordered.
+  if (layer_diff_.GetFirstChangedIndex() != -1)
+    layers_changed = true;
+
   if (layers_changed) {
     if (!compositor_.BeginFrame(false)) {
       ETRACE("Failed to initialize compositor.");
@@ -23,6 +23,7 @@
 #include <vector>
 
 #include "compositor.h"
+#include "layerstackdiff.h"
 #include "resourcemanager.h"
 
 namespace hwcomposer {
@@ -86,6 +87,7 @@ class VirtualDisplay : public NativeDisplay {
   uint32_t width_ = 1;
   uint32_t height_ = 1;
   std::vector<OverlayLayer> in_flight_layers_;
+  LayerStackDiff layer_diff_;
   HWCNativeHandle handle_ = 0;
   std::unique_ptr<ResourceManager> resource_manager_;
 };
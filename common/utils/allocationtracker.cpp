@@ -0,0 +1,92 @@
+/*
+// Copyright (c) 2018 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+#include "allocationtracker.h"
+
+#include "hwctrace.h"
+
+#ifdef ALLOCATION_TRACING
+#include <stdlib.h>
+
+#include <new>
+#endif
+
+namespace hwcomposer {
+
+#ifdef ALLOCATION_TRACING
+static thread_local uint64_t thread_allocations = 0;
+
+static void* CountedAllocation(size_t size) {
+  thread_allocations++;
+  return malloc(size ? size : 1);
+}
+
+uint64_t GetThreadAllocationCount() {
+  return thread_allocations;
+}
+#else
+uint64_t GetThreadAllocationCount() {
+  return 0;
+}
+#endif
+
+}  // namespace hwcomposer
+
+#ifdef ALLOCATION_TRACING
+void* operator new(size_t size) {
+  void* ptr = hwcomposer::CountedAllocation(size);
+  if (!ptr)
+    abort();
+
+  return ptr;
+}
+
+void* operator new[](size_t size) {
+  return operator new(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+  return hwcomposer::CountedAllocation(size);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+  return hwcomposer::CountedAllocation(size);
+}
+
+void operator delete(void* ptr) noexcept {
+  free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept {
+  free(ptr);
+}
+
+void operator delete(void* ptr, const std::nothrow_t&) noexcept {
+  free(ptr);
+}
+
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept {
+  free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept {
+  free(ptr);
+}
+
+void operator delete[](void* ptr, size_t) noexcept {
+  free(ptr);
+}
+#endif
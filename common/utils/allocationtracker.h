@@ -0,0 +1,31 @@
+/*
+// Copyright (c) 2018 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+#ifndef COMMON_UTILS_ALLOCATIONTRACKER_H_
+#define COMMON_UTILS_ALLOCATIONTRACKER_H_
+
+#include <stdint.h>
+
+namespace hwcomposer {
+
+// Returns number of heap allocations done so far by the calling thread.
+// Allocations are only counted when ALLOCATION_TRACING is enabled in
+// hwctrace.h, in which case we replace the global operator new. Otherwise
+// this always returns zero.
+uint64_t GetThreadAllocationCount();
+
+}  // namespace hwcomposer
+#endif  // COMMON_UTILS_ALLOCATIONTRACKER_H_
@@ -0,0 +1,243 @@
+/*
+// Copyright (c) 2018 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+#include "damageregion.h"
+
+#include <algorithm>
+#include <utility>
+
+#include "hwcutils.h"
+
+namespace hwcomposer {
+
+static bool IsEmptyRect(const HwcRect<int>& rect) {
+  return rect.left >= rect.right || rect.top >= rect.bottom;
+}
+
+DamageRegion::DamageRegion(const HwcRect<int>& rect) {
+  Reset(rect);
+}
+
+void DamageRegion::Clear() {
+  size_ = 0;
+  batch_.Clear();
+  bounds_ = HwcRect<int>(0, 0, 0, 0);
+}
+
+void DamageRegion::Reset(const HwcRect<int>& rect) {
+  Clear();
+  if (IsEmptyRect(rect))
+    return;
+
+  rects_[0] = rect;
+  size_ = 1;
+  bounds_ = rect;
+  batch_.Add(rect);
+}
+
+void DamageRegion::Reset(const std::vector<HwcRect<int>>& rects) {
+  Clear();
+  // Build takes at most kMaxRects new rects along with the current ones.
+  const HwcRect<int>* next = rects.data();
+  size_t remaining = rects.size();
+  while (remaining) {
+    size_t count = remaining;
+    if (count > kMaxRects)
+      count = kMaxRects;
+
+    HwcRect<int> input[kMaxInputRects];
+    std::copy(begin(), end(), input);
+    std::copy(next, next + count, input + size_);
+    Build(input, size_ + count);
+    next += count;
+    remaining -= count;
+  }
+}
+
+void DamageRegion::Union(const HwcRect<int>& rect) {
+  if (IsEmptyRect(rect))
+    return;
+
+  if (IsEmpty()) {
+    Reset(rect);
+    return;
+  }
+
+  // Nothing to do if rect is already part of the region.
+  if (batch_.Encloses(rect))
+    return;
+
+  HwcRect<int> input[kMaxInputRects];
+  std::copy(begin(), end(), input);
+  input[size_] = rect;
+  Build(input, size_ + 1);
+}
+
+void DamageRegion::Union(const DamageRegion& region) {
+  if (region.IsEmpty())
+    return;
+
+  if (IsEmpty()) {
+    *this = region;
+    return;
+  }
+
+  HwcRect<int> input[kMaxInputRects];
+  std::copy(begin(), end(), input);
+  std::copy(region.begin(), region.end(), input + size_);
+  Build(input, size_ + region.size());
+}
+
+void DamageRegion::Intersect(const HwcRect<int>& bounds) {
+  if (IsEmpty() || IsEnclosedBy(bounds_, bounds))
+    return;
+
+  batch_.Clip(bounds);
+  HwcRect<int> input[kMaxInputRects];
+  size_t count = 0;
+  for (size_t i = 0; i < batch_.size(); i++) {
+    HwcRect<int> rect = batch_.Get(i);
+    if (!IsEmptyRect(rect))
+      input[count++] = rect;
+  }
+
+  Build(input, count);
+}
+
+bool DamageRegion::Intersects(const HwcRect<int>& rect) const {
+  if (IsEmpty() || !IsOverlapping(bounds_, rect))
+    return false;
+
+  return size_ == 1 || batch_.Overlaps(rect);
+}
+
+void DamageRegion::Offset(int dx, int dy) {
+  for (size_t i = 0; i < size_; i++) {
+    HwcRect<int>& rect = rects_[i];
+    rect.left += dx;
+    rect.right += dx;
+    rect.top += dy;
+    rect.bottom += dy;
+  }
+
+  bounds_.left += dx;
+  bounds_.right += dx;
+  bounds_.top += dy;
+  bounds_.bottom += dy;
+  batch_.Reset(rects_, size_);
+}
+
+void DamageRegion::Build(const HwcRect<int>* input, size_t count) {
+  // All scratch space lives on the stack, regions are updated for
+  // every layer of every frame.
+  int edges[kMaxInputRects * 2];
+  size_t total_edges = 0;
+  HwcRect<int> bounds(0, 0, 0, 0);
+  for (size_t i = 0; i < count; i++) {
+    const HwcRect<int>& rect = input[i];
+    if (IsEmptyRect(rect))
+      continue;
+
+    edges[total_edges++] = rect.top;
+    edges[total_edges++] = rect.bottom;
+    if (total_edges == 2) {
+      bounds = rect;
+    } else {
+      bounds.left = std::min(bounds.left, rect.left);
+      bounds.top = std::min(bounds.top, rect.top);
+      bounds.right = std::max(bounds.right, rect.right);
+      bounds.bottom = std::max(bounds.bottom, rect.bottom);
+    }
+  }
+
+  Clear();
+  if (!total_edges)
+    return;
+
+  std::sort(edges, edges + total_edges);
+  total_edges = std::unique(edges, edges + total_edges) - edges;
+
+  typedef std::pair<int, int> Span;
+  Span spans[kMaxInputRects];
+  Span previous_spans[kMaxInputRects];
+  size_t total_spans = 0;
+  size_t total_previous_spans = 0;
+  size_t previous_band = 0;
+  // Set once the union needs more than kMaxRects rects.
+  bool overflow = false;
+  for (size_t i = 0; i + 1 < total_edges && !overflow; i++) {
+    int top = edges[i];
+    int bottom = edges[i + 1];
+    total_spans = 0;
+    for (size_t j = 0; j < count; j++) {
+      const HwcRect<int>& rect = input[j];
+      if (IsEmptyRect(rect) || rect.top > top || rect.bottom < bottom)
+        continue;
+
+      spans[total_spans++] = Span(rect.left, rect.right);
+    }
+
+    if (!total_spans)
+      continue;
+
+    // Merge overlapping and touching spans.
+    std::sort(spans, spans + total_spans);
+    size_t merged = 0;
+    for (size_t j = 1; j < total_spans; j++) {
+      if (spans[j].first <= spans[merged].second) {
+        spans[merged].second = std::max(spans[merged].second, spans[j].second);
+      } else {
+        spans[++merged] = spans[j];
+      }
+    }
+    total_spans = merged + 1;
+
+    // Extend band above if it touches this one and has same spans.
+    if (size_ && rects_[size_ - 1].bottom == top &&
+        total_spans == total_previous_spans &&
+        std::equal(spans, spans + total_spans, previous_spans)) {
+      for (size_t j = previous_band; j < size_; j++) {
+        rects_[j].bottom = bottom;
+      }
+
+      continue;
+    }
+
+    if (size_ + total_spans > kMaxRects) {
+      overflow = true;
+      break;
+    }
+
+    previous_band = size_;
+    for (size_t j = 0; j < total_spans; j++) {
+      rects_[size_++] =
+          HwcRect<int>(spans[j].first, top, spans[j].second, bottom);
+    }
+
+    std::copy(spans, spans + total_spans, previous_spans);
+    total_previous_spans = total_spans;
+  }
+
+  bounds_ = bounds;
+  if (overflow) {
+    rects_[0] = bounds_;
+    size_ = 1;
+  }
+
+  batch_.Reset(rects_, size_);
+}
+
+}  // namespace hwcomposer
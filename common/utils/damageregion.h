@@ -0,0 +1,100 @@
+/*
+// Copyright (c) 2018 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+#ifndef COMMON_UTILS_DAMAGEREGION_H_
+#define COMMON_UTILS_DAMAGEREGION_H_
+
+#include <stddef.h>
+
+#include <hwcdefs.h>
+
+#include <vector>
+
+#include "rectbatch.h"
+
+namespace hwcomposer {
+
+// Region stored as a list of non overlapping rects, sorted in bands
+// from top to bottom. Rects in a band share the same top and bottom
+// and are sorted from left to right. Vertically adjacent bands with
+// the same spans are merged, so that we keep the number of rects (and
+// with it number of scissored draws) small. Rects are stored inline,
+// a region with a single rect never allocates.
+class DamageRegion {
+ public:
+  // Once we need more rects than this, region is replaced by its
+  // bounding box.
+  static const size_t kMaxRects = 16;
+
+  typedef const HwcRect<int>* const_iterator;
+
+  DamageRegion() = default;
+  explicit DamageRegion(const HwcRect<int>& rect);
+
+  void Clear();
+
+  // Replaces region with rect or rects.
+  void Reset(const HwcRect<int>& rect);
+  void Reset(const std::vector<HwcRect<int>>& rects);
+
+  bool IsEmpty() const {
+    return size_ == 0;
+  }
+
+  void Union(const HwcRect<int>& rect);
+  void Union(const DamageRegion& region);
+
+  // Clips region to bounds.
+  void Intersect(const HwcRect<int>& bounds);
+
+  bool Intersects(const HwcRect<int>& rect) const;
+
+  // Moves region by dx, dy.
+  void Offset(int dx, int dy);
+
+  // Bounding box of the region. Only valid if region is not empty.
+  const HwcRect<int>& GetBounds() const {
+    return bounds_;
+  }
+
+  size_t size() const {
+    return size_;
+  }
+
+  const_iterator begin() const {
+    return rects_;
+  }
+
+  const_iterator end() const {
+    return rects_ + size_;
+  }
+
+ private:
+  // Most rects Build takes at once: those of two full regions.
+  static const size_t kMaxInputRects = kMaxRects * 2;
+
+  // Rebuilds bands out of count rects in input.
+  void Build(const HwcRect<int>* input, size_t count);
+
+  HwcRect<int> rects_[kMaxRects];
+  // Same rects as rects_, for checking rects against all of them at once.
+  RectBatch batch_;
+  size_t size_ = 0;
+  HwcRect<int> bounds_ = HwcRect<int>(0, 0, 0, 0);
+};
+
+}  // namespace hwcomposer
+#endif  // COMMON_UTILS_DAMAGEREGION_H_
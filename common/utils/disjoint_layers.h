@@ -21,63 +21,96 @@
 
 #include <hwcrect.h>
 
+#include <algorithm>
 #include <vector>
 
 namespace hwcomposer {
 
 // Some of the structs are adopted from drm_hwcomposer
+// Set of rect ids. Ids below kInlineBits are stored inline, so that
+// copying sets of up to that many rects never allocates.
 struct RectIDs {
  public:
   typedef uint64_t TId;
 
-  RectIDs() : bitset(0) {
-  }
+  static const TId npos = ~static_cast<TId>(0);
+  static const size_t kInlineWords = 4;
+  static const size_t kInlineBits = kInlineWords * 64;
+
+  RectIDs() = default;
 
-  explicit RectIDs(TId id) : bitset(0) {
+  explicit RectIDs(TId id) {
     add(id);
   }
 
   void add(TId id) {
-    bitset |= ((uint64_t)1) << id;
+    size_t word = id / 64;
+    if (word >= kInlineWords) {
+      size_t index = word - kInlineWords;
+      if (index >= overflow_.size())
+        overflow_.resize(index + 1, 0);
+    }
+
+    Word(word) |= ((uint64_t)1) << (id % 64);
   }
 
   void subtract(TId id) {
-    bitset &= ~(((uint64_t)1) << id);
-  }
+    size_t word = id / 64;
+    if (word >= kInlineWords + overflow_.size())
+      return;
 
-  bool isEmpty() const {
-    return bitset == 0;
+    Word(word) &= ~(((uint64_t)1) << (id % 64));
   }
 
-  uint64_t getBits() const {
-    return bitset;
+  bool contains(TId id) const {
+    return GetWord(id / 64) & (((uint64_t)1) << (id % 64));
   }
 
-  bool operator==(const RectIDs &rhs) const {
-    return bitset == rhs.bitset;
+  void clear() {
+    std::fill_n(words_, kInlineWords, 0);
+    std::fill(overflow_.begin(), overflow_.end(), 0);
   }
 
-  bool operator<(const RectIDs &rhs) const {
-    return bitset < rhs.bitset;
-  }
+  bool isEmpty() const;
 
-  RectIDs operator|(const RectIDs &rhs) const {
-    RectIDs ret;
-    ret.bitset = bitset | rhs.bitset;
-    return ret;
+  // Returns first id in the set which is not smaller than from,
+  // npos if there is none.
+  TId next(TId from) const;
+
+  bool operator==(const RectIDs &rhs) const;
+
+  bool operator!=(const RectIDs &rhs) const {
+    return !(*this == rhs);
   }
 
+  RectIDs operator|(const RectIDs &rhs) const;
+
   RectIDs operator|(TId id) const {
-    RectIDs ret;
-    ret.bitset = bitset;
+    RectIDs ret(*this);
     ret.add(id);
     return ret;
   }
 
-  static const int max_elements = sizeof(TId) * 8;
-
  private:
-  uint64_t bitset;
+  uint64_t &Word(size_t word) {
+    return word < kInlineWords ? words_[word]
+                               : overflow_[word - kInlineWords];
+  }
+
+  uint64_t GetWord(size_t word) const {
+    if (word < kInlineWords)
+      return words_[word];
+
+    word -= kInlineWords;
+    return word < overflow_.size() ? overflow_[word] : 0;
+  }
+
+  size_t GetWordCount() const {
+    return kInlineWords + overflow_.size();
+  }
+
+  uint64_t words_[kInlineWords] = {};
+  std::vector<uint64_t> overflow_;
 };
 
 template <typename TNum>
@@ -93,6 +126,10 @@ struct RectSet {
   }
 };
 
+// Splits the union of rects in into disjoint rects, each tagged with
+// ids (indices into in) of all rects covering it. Empty rects are
+// ignored. Works on sorted flat arrays, so apart from out only a few
+// scratch buffers are allocated per call.
 void get_draw_regions(const std::vector<Rect<int>> &in,
                       std::vector<RectSet<int>> *out);
 }  // namespace hwcomposer
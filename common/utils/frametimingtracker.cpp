@@ -0,0 +1,162 @@
+/*
+// Copyright (c) 2018 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+#include "frametimingtracker.h"
+
+#include <chrono>
+
+#include "allocationtracker.h"
+#include "hwctrace.h"
+
+namespace hwcomposer {
+
+FrameTimingTracker::FrameTimingTracker() : frames_(0) {
+  for (uint32_t i = 0; i < kMaxFrames; i++) {
+    Slot& slot = slots_[i];
+    slot.sequence_.store(0, std::memory_order_relaxed);
+    for (uint32_t j = 0; j < kSlotDataSize; j++) {
+      slot.data_[j].store(0, std::memory_order_relaxed);
+    }
+  }
+}
+
+int64_t FrameTimingTracker::Now() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+void FrameTimingTracker::BeginFrame() {
+  current_ = HwcFrameTiming();
+  current_.frame_ = frames_.load(std::memory_order_relaxed);
+  current_.start_ns_ = Now();
+  start_allocations_ = GetThreadAllocationCount();
+  in_frame_ = true;
+}
+
+void FrameTimingTracker::AddStageTime(HWCFrameStage stage, int64_t start_ns) {
+  if (!in_frame_)
+    return;
+
+  current_.stage_ns_[stage] += Now() - start_ns;
+}
+
+void FrameTimingTracker::AddTestCommits(uint32_t count) {
+  if (!in_frame_)
+    return;
+
+  current_.test_commits_ += count;
+}
+
+void FrameTimingTracker::AddPlacementTransitions(uint32_t count) {
+  if (!in_frame_)
+    return;
+
+  current_.placement_transitions_ += count;
+}
+
+void FrameTimingTracker::AddTargetBytesSaved(uint64_t bytes) {
+  if (!in_frame_)
+    return;
+
+  current_.target_bytes_saved_ += bytes;
+}
+
+void FrameTimingTracker::EndFrame() {
+  if (!in_frame_)
+    return;
+
+  in_frame_ = false;
+  current_.total_ns_ = Now() - current_.start_ns_;
+  current_.allocations_ = GetThreadAllocationCount() - start_allocations_;
+  IALLOCATIONTRACE("Frame %llu: %llu allocations",
+                   (unsigned long long)current_.frame_,
+                   (unsigned long long)current_.allocations_);
+
+  uint64_t frame = current_.frame_;
+  Slot& slot = slots_[frame % kMaxFrames];
+  // Odd sequence tells readers the slot is being written.
+  uint32_t sequence = slot.sequence_.load(std::memory_order_relaxed);
+  slot.sequence_.store(sequence + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+
+  slot.data_[kSlotFrame].store(frame, std::memory_order_relaxed);
+  slot.data_[kSlotStart].store(current_.start_ns_, std::memory_order_relaxed);
+  slot.data_[kSlotTotal].store(current_.total_ns_, std::memory_order_relaxed);
+  slot.data_[kSlotAllocations].store(current_.allocations_,
+                                     std::memory_order_relaxed);
+  slot.data_[kSlotTestCommits].store(current_.test_commits_,
+                                     std::memory_order_relaxed);
+  slot.data_[kSlotTransitions].store(current_.placement_transitions_,
+                                     std::memory_order_relaxed);
+  slot.data_[kSlotTargetBytesSaved].store(current_.target_bytes_saved_,
+                                          std::memory_order_relaxed);
+  for (uint32_t i = 0; i < kMaxFrameStage; i++) {
+    slot.data_[kSlotStages + i].store(current_.stage_ns_[i],
+                                      std::memory_order_relaxed);
+  }
+
+  slot.sequence_.store(sequence + 2, std::memory_order_release);
+  frames_.store(frame + 1, std::memory_order_release);
+}
+
+uint32_t FrameTimingTracker::GetFrameTimings(HwcFrameTiming* timings,
+                                             uint32_t max_frames) const {
+  if (!timings || max_frames == 0)
+    return 0;
+
+  uint64_t frames = frames_.load(std::memory_order_acquire);
+  uint64_t available = frames < kMaxFrames ? frames : kMaxFrames;
+  if (available > max_frames)
+    available = max_frames;
+
+  uint32_t copied = 0;
+  for (uint64_t frame = frames - available; frame < frames; frame++) {
+    const Slot& slot = slots_[frame % kMaxFrames];
+    uint32_t sequence = slot.sequence_.load(std::memory_order_acquire);
+    if (sequence & 1)
+      continue;
+
+    HwcFrameTiming& timing = timings[copied];
+    timing.frame_ = slot.data_[kSlotFrame].load(std::memory_order_relaxed);
+    timing.start_ns_ = slot.data_[kSlotStart].load(std::memory_order_relaxed);
+    timing.total_ns_ = slot.data_[kSlotTotal].load(std::memory_order_relaxed);
+    timing.allocations_ =
+        slot.data_[kSlotAllocations].load(std::memory_order_relaxed);
+    timing.test_commits_ =
+        slot.data_[kSlotTestCommits].load(std::memory_order_relaxed);
+    timing.placement_transitions_ =
+        slot.data_[kSlotTransitions].load(std::memory_order_relaxed);
+    timing.target_bytes_saved_ =
+        slot.data_[kSlotTargetBytesSaved].load(std::memory_order_relaxed);
+    for (uint32_t i = 0; i < kMaxFrameStage; i++) {
+      timing.stage_ns_[i] =
+          slot.data_[kSlotStages + i].load(std::memory_order_relaxed);
+    }
+
+    std::atomic_thread_fence(std::memory_order_acquire);
+    // Slot was recycled for a newer frame while we were copying it.
+    if (slot.sequence_.load(std::memory_order_relaxed) != sequence ||
+        timing.frame_ != frame)
+      continue;
+
+    copied++;
+  }
+
+  return copied;
+}
+
+}  // namespace hwcomposer
@@ -0,0 +1,99 @@
+/*
+// Copyright (c) 2018 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+#ifndef COMMON_UTILS_FRAMETIMINGTRACKER_H_
+#define COMMON_UTILS_FRAMETIMINGTRACKER_H_
+
+#include <stdint.h>
+
+#include <hwcdefs.h>
+
+#include <atomic>
+
+namespace hwcomposer {
+
+// Keeps per-stage timings of the last kMaxFrames display updates.
+// There is a single writer (the thread updating the display) and any
+// number of readers. Every slot is guarded by a sequence counter, so
+// neither side ever takes a lock and readers simply drop a slot which
+// was overwritten while being copied.
+class FrameTimingTracker {
+ public:
+  static const uint32_t kMaxFrames = 64;
+
+  FrameTimingTracker();
+
+  FrameTimingTracker(const FrameTimingTracker& rhs) = delete;
+  FrameTimingTracker& operator=(const FrameTimingTracker& rhs) = delete;
+
+  static int64_t Now();
+
+  // Writer side.
+  void BeginFrame();
+  // Adds time elapsed since start_ns to stage of the current frame.
+  void AddStageTime(HWCFrameStage stage, int64_t start_ns);
+  void AddTestCommits(uint32_t count);
+  void AddPlacementTransitions(uint32_t count);
+  void AddTargetBytesSaved(uint64_t bytes);
+  void EndFrame();
+
+  // Copies up to max_frames of the most recent timings to
+  // timings, oldest first. Returns number of entries copied.
+  uint32_t GetFrameTimings(HwcFrameTiming* timings, uint32_t max_frames) const;
+
+ private:
+  enum SlotData {
+    kSlotFrame = 0,
+    kSlotStart = 1,
+    kSlotTotal = 2,
+    kSlotAllocations = 3,
+    kSlotTestCommits = 4,
+    kSlotTransitions = 5,
+    kSlotTargetBytesSaved = 6,
+    kSlotStages = 7,
+    kSlotDataSize = kSlotStages + kMaxFrameStage
+  };
+
+  struct Slot {
+    std::atomic<uint32_t> sequence_;
+    std::atomic<int64_t> data_[kSlotDataSize];
+  };
+
+  Slot slots_[kMaxFrames];
+  std::atomic<uint64_t> frames_;
+  HwcFrameTiming current_;
+  uint64_t start_allocations_ = 0;
+  bool in_frame_ = false;
+};
+
+// Brackets a display update, ensuring timings are published
+// on every exit path.
+class ScopedFrameTiming {
+ public:
+  explicit ScopedFrameTiming(FrameTimingTracker& tracker) : tracker_(tracker) {
+    tracker_.BeginFrame();
+  }
+
+  ~ScopedFrameTiming() {
+    tracker_.EndFrame();
+  }
+
+ private:
+  FrameTimingTracker& tracker_;
+};
+
+}  // namespace hwcomposer
+#endif  // COMMON_UTILS_FRAMETIMINGTRACKER_H_
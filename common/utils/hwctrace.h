@@ -43,6 +43,7 @@ extern "C" {
 // #define SURFACE_DUPLICATE_LAYER_TRACING 1
 // #define SURFACE_BASIC_TRACING 1
 // #define COMPOSITOR_TRACING 1
+// #define ALLOCATION_TRACING 1
 
 // Function call tracing
 #ifdef FUNCTION_CALL_TRACING
@@ -128,6 +129,12 @@ class TraceFunc {
 #define ISURFACETRACE ((void)0)
 #endif
 
+#ifdef ALLOCATION_TRACING
+#define IALLOCATIONTRACE ITRACE
+#else
+#define IALLOCATIONTRACE(fmt, ...) ((void)0)
+#endif
+
 // Errors
 #define PRINTERROR() strerror(-errno)
 
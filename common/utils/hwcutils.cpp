@@ -19,6 +19,7 @@
 #include <poll.h>
 
 #include "hwctrace.h"
+#include "rectbatch.h"
 
 #include <drm_fourcc.h>
 
@@ -37,6 +38,27 @@ int HWCPoll(int fd, int timeout) {
   return ret;
 }
 
+int HWCMergeFences(int fence1, int fence2) {
+  if (fence1 <= 0)
+    return fence2;
+
+  if (fence2 <= 0)
+    return fence1;
+
+  int merged = sync_merge("hwc_merged_fence", fence1, fence2);
+  if (merged < 0) {
+    // Waiting on either fence is still better than losing both.
+    ETRACE("Failed to merge fences %s", PRINTERROR());
+    HWCPoll(fence2, -1);
+    close(fence2);
+    return fence1;
+  }
+
+  close(fence1);
+  close(fence2);
+  return merged;
+}
+
 void ResetRectToRegion(const HwcRegion& hwc_region, HwcRect<int>& rect) {
   size_t total_rects = hwc_region.size();
   if (total_rects == 0) {
@@ -47,19 +69,7 @@ void ResetRectToRegion(const HwcRegion& hwc_region, HwcRect<int>& rect) {
     return;
   }
 
-  const HwcRect<int>& new_rect = hwc_region.at(0);
-  rect.left = new_rect.left;
-  rect.top = new_rect.top;
-  rect.right = new_rect.right;
-  rect.bottom = new_rect.bottom;
-
-  for (uint32_t r = 1; r < total_rects; r++) {
-    const HwcRect<int>& temp = hwc_region.at(r);
-    rect.left = std::min(rect.left, temp.left);
-    rect.top = std::min(rect.top, temp.top);
-    rect.right = std::max(rect.right, temp.right);
-    rect.bottom = std::max(rect.bottom, temp.bottom);
-  }
+  rect = GetBoundingRect(hwc_region.data(), total_rects);
 }
 
 bool IsSupportedMediaFormat(uint32_t format) {
@@ -111,4 +121,23 @@ uint32_t GetTotalPlanesForFormat(uint32_t format) {
   return 1;
 }
 
+uint32_t GetBytesPerPixel(uint32_t format) {
+  switch (format) {
+    case DRM_FORMAT_RGB565:
+    case DRM_FORMAT_BGR565:
+    case DRM_FORMAT_XRGB1555:
+    case DRM_FORMAT_ARGB1555:
+    case DRM_FORMAT_XRGB4444:
+    case DRM_FORMAT_ARGB4444:
+      return 2;
+    case DRM_FORMAT_RGB888:
+    case DRM_FORMAT_BGR888:
+      return 3;
+    default:
+      break;
+  }
+
+  return 4;
+}
+
 }  // namespace hwcomposer
@@ -0,0 +1,517 @@
+/*
+// Copyright (c) 2018 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+
+#include "rectbatch.h"
+
+#include <algorithm>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define RECTBATCH_X86
+#endif
+
+namespace hwcomposer {
+
+namespace {
+
+enum Edge { kLeft = 0, kTop = 1, kRight = 2, kBottom = 3 };
+
+static_assert(sizeof(HwcRect<int>) == 4 * sizeof(int32_t),
+              "Kernels load rects as vectors of their edges");
+
+struct Columns {
+  const int32_t* left;
+  const int32_t* top;
+  const int32_t* right;
+  const int32_t* bottom;
+};
+
+// Every kernel handles rects from start on, returning where it stopped
+// so that the scalar version can finish off the tail.
+struct Kernels {
+  size_t (*classify)(const Columns& rects, size_t start, size_t count,
+                     const HwcRect<int>& bounds, uint8_t* types);
+  size_t (*overlaps)(const Columns& rects, size_t start, size_t count,
+                     const HwcRect<int>& rect, bool* found);
+  size_t (*encloses)(const Columns& rects, size_t start, size_t count,
+                     const HwcRect<int>& rect, bool* found);
+  size_t (*clip)(int32_t* const* rects, size_t start, size_t count,
+                 const HwcRect<int>& bounds);
+  size_t (*bounds)(const HwcRect<int>* rects, size_t start, size_t count,
+                   HwcRect<int>* bounds);
+};
+
+size_t ClassifyScalar(const Columns& rects, size_t start, size_t count,
+                      const HwcRect<int>& bounds, uint8_t* types) {
+  for (size_t i = start; i < count; i++) {
+    types[i] = AnalyseOverlap(HwcRect<int>(rects.left[i], rects.top[i],
+                                           rects.right[i], rects.bottom[i]),
+                              bounds);
+  }
+
+  return count;
+}
+
+size_t OverlapsScalar(const Columns& rects, size_t start, size_t count,
+                      const HwcRect<int>& rect, bool* found) {
+  for (size_t i = start; i < count && !*found; i++) {
+    *found = IsOverlapping(rects.left[i], rects.top[i], rects.right[i],
+                           rects.bottom[i], rect.left, rect.top, rect.right,
+                           rect.bottom);
+  }
+
+  return count;
+}
+
+size_t EnclosesScalar(const Columns& rects, size_t start, size_t count,
+                      const HwcRect<int>& rect, bool* found) {
+  for (size_t i = start; i < count && !*found; i++) {
+    *found = IsEnclosedBy(rect.left, rect.top, rect.right, rect.bottom,
+                          rects.left[i], rects.top[i], rects.right[i],
+                          rects.bottom[i]);
+  }
+
+  return count;
+}
+
+size_t ClipScalar(int32_t* const* rects, size_t start, size_t count,
+                  const HwcRect<int>& bounds) {
+  for (size_t i = start; i < count; i++) {
+    rects[kLeft][i] = std::max(rects[kLeft][i], bounds.left);
+    rects[kTop][i] = std::max(rects[kTop][i], bounds.top);
+    rects[kRight][i] = std::min(rects[kRight][i], bounds.right);
+    rects[kBottom][i] = std::min(rects[kBottom][i], bounds.bottom);
+  }
+
+  return count;
+}
+
+size_t BoundsScalar(const HwcRect<int>* rects, size_t start, size_t count,
+                    HwcRect<int>* bounds) {
+  for (size_t i = start; i < count; i++) {
+    const HwcRect<int>& rect = rects[i];
+    bounds->left = std::min(bounds->left, rect.left);
+    bounds->top = std::min(bounds->top, rect.top);
+    bounds->right = std::max(bounds->right, rect.right);
+    bounds->bottom = std::max(bounds->bottom, rect.bottom);
+  }
+
+  return count;
+}
+
+const Kernels kScalarKernels = {ClassifyScalar, OverlapsScalar,
+                                EnclosesScalar, ClipScalar, BoundsScalar};
+
+#ifdef RECTBATCH_X86
+// OverlapType of four rects against bounds, packed in the low byte of
+// every lane.
+__attribute__((target("sse4.1"))) inline __m128i ClassifySSE(
+    __m128i left, __m128i top, __m128i right, __m128i bottom,
+    const __m128i* bounds) {
+  // l >= L && t >= T && r <= R && b <= B
+  __m128i enclosed = _mm_andnot_si128(
+      _mm_or_si128(_mm_or_si128(_mm_cmplt_epi32(left, bounds[kLeft]),
+                                _mm_cmplt_epi32(top, bounds[kTop])),
+                   _mm_or_si128(_mm_cmpgt_epi32(right, bounds[kRight]),
+                                _mm_cmpgt_epi32(bottom, bounds[kBottom]))),
+      _mm_set1_epi32(-1));
+  // l < R && r > L && t < B && b > T
+  __m128i overlapping =
+      _mm_and_si128(_mm_and_si128(_mm_cmplt_epi32(left, bounds[kRight]),
+                                  _mm_cmpgt_epi32(right, bounds[kLeft])),
+                    _mm_and_si128(_mm_cmplt_epi32(top, bounds[kBottom]),
+                                  _mm_cmpgt_epi32(bottom, bounds[kTop])));
+  __m128i type = _mm_blendv_epi8(_mm_set1_epi32(kOutside),
+                                 _mm_set1_epi32(kOverlapping), overlapping);
+  return _mm_blendv_epi8(type, _mm_set1_epi32(kEnclosed), enclosed);
+}
+
+__attribute__((target("sse4.1"))) size_t ClassifySSE41(
+    const Columns& rects, size_t start, size_t count,
+    const HwcRect<int>& bounds, uint8_t* types) {
+  const __m128i edges[4] = {
+      _mm_set1_epi32(bounds.left), _mm_set1_epi32(bounds.top),
+      _mm_set1_epi32(bounds.right), _mm_set1_epi32(bounds.bottom)};
+  size_t i = start;
+  for (; i + 4 <= count; i += 4) {
+    __m128i type = ClassifySSE(
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(rects.left + i)),
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(rects.top + i)),
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(rects.right + i)),
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(rects.bottom + i)),
+        edges);
+    // Gather low bytes of the lanes.
+    type = _mm_shuffle_epi8(
+        type, _mm_setr_epi8(0, 4, 8, 12, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+                            -1, -1, -1));
+    int32_t packed = _mm_cvtsi128_si32(type);
+    std::copy_n(reinterpret_cast<const uint8_t*>(&packed), 4, types + i);
+  }
+
+  return i;
+}
+
+__attribute__((target("sse4.1"))) size_t OverlapsSSE41(
+    const Columns& rects, size_t start, size_t count,
+    const HwcRect<int>& rect, bool* found) {
+  __m128i left = _mm_set1_epi32(rect.left);
+  __m128i top = _mm_set1_epi32(rect.top);
+  __m128i right = _mm_set1_epi32(rect.right);
+  __m128i bottom = _mm_set1_epi32(rect.bottom);
+  size_t i = start;
+  for (; i + 4 <= count; i += 4) {
+    __m128i overlapping = _mm_and_si128(
+        _mm_and_si128(
+            _mm_cmplt_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(
+                                rects.left + i)),
+                            right),
+            _mm_cmpgt_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(
+                                rects.right + i)),
+                            left)),
+        _mm_and_si128(
+            _mm_cmplt_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(
+                                rects.top + i)),
+                            bottom),
+            _mm_cmpgt_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(
+                                rects.bottom + i)),
+                            top)));
+    if (!_mm_testz_si128(overlapping, overlapping)) {
+      *found = true;
+      return count;
+    }
+  }
+
+  return i;
+}
+
+__attribute__((target("sse4.1"))) size_t EnclosesSSE41(
+    const Columns& rects, size_t start, size_t count,
+    const HwcRect<int>& rect, bool* found) {
+  __m128i left = _mm_set1_epi32(rect.left);
+  __m128i top = _mm_set1_epi32(rect.top);
+  __m128i right = _mm_set1_epi32(rect.right);
+  __m128i bottom = _mm_set1_epi32(rect.bottom);
+  size_t i = start;
+  for (; i + 4 <= count; i += 4) {
+    // Lanes where rect sticks out of the batch rect.
+    __m128i outside = _mm_or_si128(
+        _mm_or_si128(
+            _mm_cmpgt_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(
+                                rects.left + i)),
+                            left),
+            _mm_cmpgt_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(
+                                rects.top + i)),
+                            top)),
+        _mm_or_si128(
+            _mm_cmplt_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(
+                                rects.right + i)),
+                            right),
+            _mm_cmplt_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(
+                                rects.bottom + i)),
+                            bottom)));
+    if (_mm_movemask_ps(_mm_castsi128_ps(outside)) != 0xF) {
+      *found = true;
+      return count;
+    }
+  }
+
+  return i;
+}
+
+__attribute__((target("sse4.1"))) size_t ClipSSE41(
+    int32_t* const* rects, size_t start, size_t count,
+    const HwcRect<int>& bounds) {
+  const __m128i edges[4] = {
+      _mm_set1_epi32(bounds.left), _mm_set1_epi32(bounds.top),
+      _mm_set1_epi32(bounds.right), _mm_set1_epi32(bounds.bottom)};
+  size_t i = start;
+  for (; i + 4 <= count; i += 4) {
+    for (int column = kLeft; column <= kBottom; column++) {
+      __m128i* edge = reinterpret_cast<__m128i*>(rects[column] + i);
+      __m128i value = _mm_loadu_si128(edge);
+      value = column < kRight ? _mm_max_epi32(value, edges[column])
+                              : _mm_min_epi32(value, edges[column]);
+      _mm_storeu_si128(edge, value);
+    }
+  }
+
+  return i;
+}
+
+// A rect fills one vector, so the union is a lane wise min of left and
+// top and max of right and bottom.
+__attribute__((target("sse4.1"))) size_t BoundsSSE41(
+    const HwcRect<int>* rects, size_t start, size_t count,
+    HwcRect<int>* bounds) {
+  __m128i current =
+      _mm_loadu_si128(reinterpret_cast<const __m128i*>(bounds->bounds));
+  __m128i min = current;
+  __m128i max = current;
+  for (size_t i = start; i < count; i++) {
+    __m128i rect =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(rects[i].bounds));
+    min = _mm_min_epi32(min, rect);
+    max = _mm_max_epi32(max, rect);
+  }
+
+  current = _mm_blend_epi16(min, max, 0xF0);
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(bounds->bounds), current);
+  return count;
+}
+
+const Kernels kSSE41Kernels = {ClassifySSE41, OverlapsSSE41, EnclosesSSE41,
+                               ClipSSE41, BoundsSSE41};
+
+__attribute__((target("avx2"))) size_t ClassifyAVX2(
+    const Columns& rects, size_t start, size_t count,
+    const HwcRect<int>& bounds, uint8_t* types) {
+  __m256i edges[4] = {
+      _mm256_set1_epi32(bounds.left), _mm256_set1_epi32(bounds.top),
+      _mm256_set1_epi32(bounds.right), _mm256_set1_epi32(bounds.bottom)};
+  size_t i = start;
+  for (; i + 8 <= count; i += 8) {
+    __m256i left =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(rects.left + i));
+    __m256i top =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(rects.top + i));
+    __m256i right =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(rects.right + i));
+    __m256i bottom =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(rects.bottom + i));
+    // AVX2 only has greater than, l < R is R > l.
+    __m256i stick_out = _mm256_or_si256(
+        _mm256_or_si256(_mm256_cmpgt_epi32(edges[kLeft], left),
+                        _mm256_cmpgt_epi32(edges[kTop], top)),
+        _mm256_or_si256(_mm256_cmpgt_epi32(right, edges[kRight]),
+                        _mm256_cmpgt_epi32(bottom, edges[kBottom])));
+    __m256i overlapping = _mm256_and_si256(
+        _mm256_and_si256(_mm256_cmpgt_epi32(edges[kRight], left),
+                         _mm256_cmpgt_epi32(right, edges[kLeft])),
+        _mm256_and_si256(_mm256_cmpgt_epi32(edges[kBottom], top),
+                         _mm256_cmpgt_epi32(bottom, edges[kTop])));
+    __m256i type =
+        _mm256_blendv_epi8(_mm256_set1_epi32(kOutside),
+                           _mm256_set1_epi32(kOverlapping), overlapping);
+    type = _mm256_blendv_epi8(_mm256_set1_epi32(kEnclosed), type, stick_out);
+    // Gather low bytes of the lanes, four per 128 bit half.
+    type = _mm256_shuffle_epi8(
+        type, _mm256_setr_epi8(0, 4, 8, 12, -1, -1, -1, -1, -1, -1, -1, -1,
+                               -1, -1, -1, -1, 0, 4, 8, 12, -1, -1, -1, -1,
+                               -1, -1, -1, -1, -1, -1, -1, -1));
+    int32_t low = _mm256_extract_epi32(type, 0);
+    int32_t high = _mm256_extract_epi32(type, 4);
+    std::copy_n(reinterpret_cast<const uint8_t*>(&low), 4, types + i);
+    std::copy_n(reinterpret_cast<const uint8_t*>(&high), 4, types + i + 4);
+  }
+
+  // Leave what is left to the SSE4.1 kernel.
+  return ClassifySSE41(rects, i, count, bounds, types);
+}
+
+__attribute__((target("avx2"))) size_t ClipAVX2(int32_t* const* rects,
+                                                  size_t start, size_t count,
+                                                  const HwcRect<int>& bounds) {
+  const __m256i edges[4] = {
+      _mm256_set1_epi32(bounds.left), _mm256_set1_epi32(bounds.top),
+      _mm256_set1_epi32(bounds.right), _mm256_set1_epi32(bounds.bottom)};
+  size_t i = start;
+  for (; i + 8 <= count; i += 8) {
+    for (int column = kLeft; column <= kBottom; column++) {
+      __m256i* edge = reinterpret_cast<__m256i*>(rects[column] + i);
+      __m256i value = _mm256_loadu_si256(edge);
+      value = column < kRight ? _mm256_max_epi32(value, edges[column])
+                              : _mm256_min_epi32(value, edges[column]);
+      _mm256_storeu_si256(edge, value);
+    }
+  }
+
+  return ClipSSE41(rects, i, count, bounds);
+}
+
+// Two rects per vector, halves are combined at the end.
+__attribute__((target("avx2"))) size_t BoundsAVX2(const HwcRect<int>* rects,
+                                                    size_t start, size_t count,
+                                                    HwcRect<int>* bounds) {
+  size_t i = start;
+  if (i + 2 > count)
+    return BoundsSSE41(rects, i, count, bounds);
+
+  __m256i min = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(rects + i));
+  __m256i max = min;
+  for (i += 2; i + 2 <= count; i += 2) {
+    __m256i pair =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(rects + i));
+    min = _mm256_min_epi32(min, pair);
+    max = _mm256_max_epi32(max, pair);
+  }
+
+  __m128i low = _mm_min_epi32(_mm256_castsi256_si128(min),
+                              _mm256_extracti128_si256(min, 1));
+  __m128i high = _mm_max_epi32(_mm256_castsi256_si128(max),
+                               _mm256_extracti128_si256(max, 1));
+  __m128i current =
+      _mm_loadu_si128(reinterpret_cast<const __m128i*>(bounds->bounds));
+  low = _mm_min_epi32(low, current);
+  high = _mm_max_epi32(high, current);
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(bounds->bounds),
+                   _mm_blend_epi16(low, high, 0xF0));
+  return BoundsSSE41(rects, i, count, bounds);
+}
+
+// Checks against a single rect exit early and batches are short, SSE4.1
+// does as well as AVX2 there.
+const Kernels kAVX2Kernels = {ClassifyAVX2, OverlapsSSE41, EnclosesSSE41,
+                              ClipAVX2, BoundsAVX2};
+#endif
+
+// Set by SetRectBatchKernels.
+const Kernels* forced_kernels = NULL;
+
+const Kernels& GetKernels() {
+  if (forced_kernels)
+    return *forced_kernels;
+
+#ifdef RECTBATCH_X86
+  static const Kernels& kernels = []() -> const Kernels& {
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+      return kAVX2Kernels;
+
+    if (__builtin_cpu_supports("sse4.1"))
+      return kSSE41Kernels;
+
+    return kScalarKernels;
+  }();
+  return kernels;
+#else
+  return kScalarKernels;
+#endif
+}
+
+}  // namespace
+
+void RectBatch::Reserve(size_t capacity) {
+  if (capacity <= capacity_)
+    return;
+
+  capacity = std::max(capacity, capacity_ * 2);
+  std::vector<int32_t> heap(capacity * 4);
+  for (size_t column = kLeft; column <= kBottom; column++) {
+    std::copy_n(Column(column), size_, heap.data() + column * capacity);
+  }
+
+  heap_.swap(heap);
+  capacity_ = capacity;
+}
+
+void RectBatch::Reset(const HwcRect<int>* rects, size_t count) {
+  size_ = 0;
+  Reserve(count);
+  int32_t* columns[4] = {Column(kLeft), Column(kTop), Column(kRight),
+                         Column(kBottom)};
+  for (size_t i = 0; i < count; i++) {
+    for (size_t column = kLeft; column <= kBottom; column++) {
+      columns[column][i] = rects[i].bounds[column];
+    }
+  }
+
+  size_ = count;
+}
+
+void RectBatch::Add(const HwcRect<int>& rect) {
+  Reserve(size_ + 1);
+  for (size_t column = kLeft; column <= kBottom; column++) {
+    Column(column)[size_] = rect.bounds[column];
+  }
+
+  size_++;
+}
+
+HwcRect<int> RectBatch::Get(size_t index) const {
+  return HwcRect<int>(Column(kLeft)[index], Column(kTop)[index],
+                      Column(kRight)[index], Column(kBottom)[index]);
+}
+
+void RectBatch::Classify(const HwcRect<int>& bounds, uint8_t* types) const {
+  Columns rects = {Column(kLeft), Column(kTop), Column(kRight),
+                   Column(kBottom)};
+  size_t done = GetKernels().classify(rects, 0, size_, bounds, types);
+  ClassifyScalar(rects, done, size_, bounds, types);
+}
+
+bool RectBatch::Overlaps(const HwcRect<int>& rect) const {
+  Columns rects = {Column(kLeft), Column(kTop), Column(kRight),
+                   Column(kBottom)};
+  bool found = false;
+  size_t done = GetKernels().overlaps(rects, 0, size_, rect, &found);
+  OverlapsScalar(rects, done, size_, rect, &found);
+  return found;
+}
+
+bool RectBatch::Encloses(const HwcRect<int>& rect) const {
+  Columns rects = {Column(kLeft), Column(kTop), Column(kRight),
+                   Column(kBottom)};
+  bool found = false;
+  size_t done = GetKernels().encloses(rects, 0, size_, rect, &found);
+  EnclosesScalar(rects, done, size_, rect, &found);
+  return found;
+}
+
+void RectBatch::Clip(const HwcRect<int>& bounds) {
+  int32_t* const rects[4] = {Column(kLeft), Column(kTop), Column(kRight),
+                             Column(kBottom)};
+  size_t done = GetKernels().clip(rects, 0, size_, bounds);
+  ClipScalar(rects, done, size_, bounds);
+}
+
+HwcRect<int> GetBoundingRect(const HwcRect<int>* rects, size_t count) {
+  HwcRect<int> bounds = rects[0];
+  size_t done = GetKernels().bounds(rects, 1, count, &bounds);
+  BoundsScalar(rects, done, count, &bounds);
+  return bounds;
+}
+
+bool SetRectBatchKernels(RectBatchKernels kernels) {
+  switch (kernels) {
+    case kRectBatchAuto:
+      forced_kernels = NULL;
+      return true;
+    case kRectBatchScalar:
+      forced_kernels = &kScalarKernels;
+      return true;
+#ifdef RECTBATCH_X86
+    case kRectBatchSSE41:
+      __builtin_cpu_init();
+      if (!__builtin_cpu_supports("sse4.1"))
+        return false;
+
+      forced_kernels = &kSSE41Kernels;
+      return true;
+    case kRectBatchAVX2:
+      __builtin_cpu_init();
+      if (!__builtin_cpu_supports("avx2"))
+        return false;
+
+      forced_kernels = &kAVX2Kernels;
+      return true;
+#endif
+    default:
+      return false;
+  }
+}
+
+}  // namespace hwcomposer
@@ -0,0 +1,107 @@
+/*
+// Copyright (c) 2018 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+
+#ifndef COMMON_UTILS_RECTBATCH_H_
+#define COMMON_UTILS_RECTBATCH_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <hwcdefs.h>
+#include <hwcutils.h>
+
+#include <vector>
+
+namespace hwcomposer {
+
+// Rects stored as structure of arrays, so that a rect can be checked
+// against all of them a vector at a time. Kernels use AVX2 or SSE4.1
+// when the CPU supports them and fall back to scalar code otherwise.
+// Up to kInlineRects rects are stored inline, without allocating.
+class RectBatch {
+ public:
+  static const size_t kInlineRects = 16;
+
+  RectBatch() = default;
+
+  void Clear() {
+    size_ = 0;
+  }
+
+  // Replaces batch with count rects.
+  void Reset(const HwcRect<int>* rects, size_t count);
+
+  void Add(const HwcRect<int>& rect);
+
+  HwcRect<int> Get(size_t index) const;
+
+  size_t size() const {
+    return size_;
+  }
+
+  bool empty() const {
+    return size_ == 0;
+  }
+
+  // Sets types[i] to the OverlapType of rect i against bounds.
+  void Classify(const HwcRect<int>& bounds, uint8_t* types) const;
+
+  // Returns true if rect overlaps any rect in the batch.
+  bool Overlaps(const HwcRect<int>& rect) const;
+
+  // Returns true if rect is enclosed by any rect in the batch.
+  bool Encloses(const HwcRect<int>& rect) const;
+
+  // Clips all rects to bounds. Rects outside of bounds become empty.
+  void Clip(const HwcRect<int>& bounds);
+
+ private:
+  void Reserve(size_t capacity);
+
+  int32_t* Column(size_t column) {
+    return (heap_.empty() ? storage_ : heap_.data()) + column * capacity_;
+  }
+
+  const int32_t* Column(size_t column) const {
+    return (heap_.empty() ? storage_ : heap_.data()) + column * capacity_;
+  }
+
+  // Left, top, right and bottom edges, capacity_ entries each.
+  int32_t storage_[kInlineRects * 4];
+  std::vector<int32_t> heap_;
+  size_t capacity_ = kInlineRects;
+  size_t size_ = 0;
+};
+
+// Bounding box of count rects, count needs to be at least one.
+HwcRect<int> GetBoundingRect(const HwcRect<int>* rects, size_t count);
+
+// Kernels used by RectBatch and GetBoundingRect.
+enum RectBatchKernels {
+  kRectBatchAuto = 0,  // Fastest the CPU supports.
+  kRectBatchScalar,
+  kRectBatchSSE41,
+  kRectBatchAVX2,
+};
+
+// Makes RectBatch use kernels from here on, so that tests can check them
+// against each other. Not thread safe. Returns false, leaving kernels as
+// they are, if the CPU doesn't support them.
+bool SetRectBatchKernels(RectBatchKernels kernels);
+
+}  // namespace hwcomposer
+#endif  // COMMON_UTILS_RECTBATCH_H_
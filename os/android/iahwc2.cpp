@@ -795,8 +795,17 @@ HWC2::Error IAHWC2::HwcDisplay::ValidateDisplay(uint32_t *num_types,
   return HWC2::Error::None;
 }
 
-HWC2::Error IAHWC2::Hwc2Layer::SetCursorPosition(int32_t /*x*/, int32_t /*y*/) {
+HWC2::Error IAHWC2::Hwc2Layer::SetCursorPosition(int32_t x, int32_t y) {
   supported(__func__);
+  if (!is_cursor_layer_)
+    return HWC2::Error::BadLayer;
+
+  // Only position changes, which lets next Present update just the
+  // cursor plane.
+  int32_t width = hwc_layer_.GetDisplayFrameWidth();
+  int32_t height = hwc_layer_.GetDisplayFrameHeight();
+  hwc_layer_.SetDisplayFrame(
+      hwcomposer::HwcRect<int>(x, y, x + width, y + height), x_translation_);
   return HWC2::Error::None;
 }
 
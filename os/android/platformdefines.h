@@ -30,6 +30,7 @@
 #include <hardware/hardware.h>
 #include <hardware/hwcomposer.h>
 #include <ui/GraphicBuffer.h>
+#include <sync/sync.h>
 #include "platformcommondefines.h"
 #include <cros_gralloc_handle.h>
 
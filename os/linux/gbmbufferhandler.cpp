@@ -122,6 +122,76 @@ bool GbmBufferHandler::CreateBuffer(uint32_t w, uint32_t h, int format,
   return true;
 }
 
+#ifdef USE_GBM_MODIFIERS
+bool GbmBufferHandler::CreateBufferWithModifiers(
+    uint32_t w, uint32_t h, int format, const std::vector<uint64_t> &modifiers,
+    HWCNativeHandle *handle, uint64_t *modifier) const {
+  if (modifiers.empty())
+    return false;
+
+  uint32_t gbm_format = format;
+  if (gbm_format == 0)
+    gbm_format = GBM_FORMAT_XRGB8888;
+
+  struct gbm_bo *bo = gbm_bo_create_with_modifiers(
+      device_, w, h, gbm_format, modifiers.data(), modifiers.size());
+  if (!bo)
+    return false;
+
+  struct gbm_handle *temp = new struct gbm_handle();
+  temp->import_data.width = gbm_bo_get_width(bo);
+  temp->import_data.height = gbm_bo_get_height(bo);
+  temp->import_data.format = gbm_bo_get_format(bo);
+#if USE_MINIGBM
+  temp->modifier = gbm_bo_get_format_modifier(bo);
+  size_t total_planes = gbm_bo_get_num_planes(bo);
+  for (size_t i = 0; i < total_planes; i++) {
+    temp->import_data.fds[i] = gbm_bo_get_plane_fd(bo, i);
+    temp->import_data.offsets[i] = gbm_bo_get_plane_offset(bo, i);
+    temp->import_data.strides[i] = gbm_bo_get_plane_stride(bo, i);
+    temp->import_data.format_modifiers[i] = temp->modifier;
+  }
+  temp->total_planes = total_planes;
+#else
+  // We share buffers as a single dma-buf, layouts with
+  // auxiliary planes can't be imported again.
+  if (gbm_bo_get_plane_count(bo) != 1) {
+    gbm_bo_destroy(bo);
+    delete temp;
+    return false;
+  }
+
+  temp->modifier = gbm_bo_get_modifier(bo);
+  temp->import_data.fd = gbm_bo_get_fd(bo);
+  temp->import_data.stride = gbm_bo_get_stride(bo);
+  temp->total_planes = drm_bo_get_num_planes(temp->import_data.format);
+#endif
+
+  temp->has_modifier = true;
+  temp->bo = bo;
+  temp->hwc_buffer_ = true;
+  temp->gbm_flags = GBM_BO_USE_SCANOUT | GBM_BO_USE_RENDERING;
+  *handle = temp;
+  *modifier = temp->modifier;
+
+  return true;
+}
+
+bool GbmBufferHandler::GetSupportedModifiers(
+    uint32_t /*format*/, std::vector<uint64_t> *modifiers) const {
+#if USE_MINIGBM
+  // Every plane of the buffer is shared, any layout will do.
+  return false;
+#else
+  // Only layouts without auxiliary planes, see above.
+  modifiers->emplace_back(I915_FORMAT_MOD_Y_TILED);
+  modifiers->emplace_back(I915_FORMAT_MOD_X_TILED);
+  modifiers->emplace_back(DRM_FORMAT_MOD_LINEAR);
+  return true;
+#endif
+}
+#endif
+
 bool GbmBufferHandler::ReleaseBuffer(HWCNativeHandle handle) const {
   if (handle->bo || handle->imported_bo) {
     if (handle->bo && handle->hwc_buffer_) {
@@ -159,6 +229,8 @@ void GbmBufferHandler::CopyHandle(HWCNativeHandle source,
     temp->import_data.fds[i] = dup(source->import_data.fds[i]);
     temp->import_data.offsets[i] = source->import_data.offsets[i];
     temp->import_data.strides[i] = source->import_data.strides[i];
+    temp->import_data.format_modifiers[i] =
+        source->import_data.format_modifiers[i];
   }
 #else
   temp->import_data.fd = dup(source->import_data.fd);
@@ -167,6 +239,8 @@ void GbmBufferHandler::CopyHandle(HWCNativeHandle source,
   temp->bo = source->bo;
   temp->total_planes = source->total_planes;
   temp->gbm_flags  = source->gbm_flags;
+  temp->modifier = source->modifier;
+  temp->has_modifier = source->has_modifier;
   *target = temp;
 }
 
@@ -183,9 +257,29 @@ bool GbmBufferHandler::ImportBuffer(HWCNativeHandle handle) const {
      if (!handle->imported_bo) {
         ETRACE("can't import bo");
       }
+#else
+#ifdef USE_GBM_MODIFIERS
+    if (handle->has_modifier) {
+      struct gbm_import_fd_modifier_data import_data;
+      memset(&import_data, 0, sizeof(import_data));
+      import_data.width = handle->import_data.width;
+      import_data.height = handle->import_data.height;
+      import_data.format = handle->import_data.format;
+      import_data.num_fds = 1;
+      import_data.fds[0] = handle->import_data.fd;
+      import_data.strides[0] = handle->import_data.stride;
+      import_data.modifier = handle->modifier;
+      handle->imported_bo =
+          gbm_bo_import(device_, GBM_BO_IMPORT_FD_MODIFIER, &import_data,
+                        handle->gbm_flags);
+    } else {
+      handle->imported_bo = gbm_bo_import(
+          device_, GBM_BO_IMPORT_FD, &handle->import_data, handle->gbm_flags);
+    }
 #else
     handle->imported_bo = gbm_bo_import(
         device_, GBM_BO_IMPORT_FD, &handle->import_data, handle->gbm_flags);
+#endif
     if (!handle->imported_bo) {
         ETRACE("can't import bo");
     }
@@ -203,6 +297,9 @@ bool GbmBufferHandler::ImportBuffer(HWCNativeHandle handle) const {
   handle->meta_data_.height_ = handle->import_data.height;
   // FIXME: Set right flag here.
   handle->meta_data_.usage_ = hwcomposer::kLayerNormal;
+  handle->meta_data_.modifier_ = handle->modifier;
+  handle->meta_data_.has_modifier_ = handle->has_modifier;
+  handle->meta_data_.total_planes_ = handle->total_planes;
 
 #if USE_MINIGBM
   handle->meta_data_.prime_fd_ = handle->import_data.fds[0];
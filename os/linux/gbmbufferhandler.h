@@ -34,6 +34,14 @@ class GbmBufferHandler : public NativeBufferHandler {
 
   bool CreateBuffer(uint32_t w, uint32_t h, int format, HWCNativeHandle *handle,
                     uint32_t layer_type) const override;
+#ifdef USE_GBM_MODIFIERS
+  bool CreateBufferWithModifiers(uint32_t w, uint32_t h, int format,
+                                 const std::vector<uint64_t> &modifiers,
+                                 HWCNativeHandle *handle,
+                                 uint64_t *modifier) const override;
+  bool GetSupportedModifiers(uint32_t format,
+                             std::vector<uint64_t> *modifiers) const override;
+#endif
   bool ReleaseBuffer(HWCNativeHandle handle) const override;
   void DestroyHandle(HWCNativeHandle handle) const override;
   void CopyHandle(HWCNativeHandle source,
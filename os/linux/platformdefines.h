@@ -43,6 +43,9 @@ struct gbm_handle {
   HwcBuffer meta_data_;
   bool hwc_buffer_ = false;
   uint32_t gbm_flags = 0;
+  // Layout chosen by CreateBufferWithModifiers.
+  uint64_t modifier = 0;
+  bool has_modifier = false;
 };
 
 typedef struct gbm_handle* HWCNativeHandle;
@@ -36,6 +36,12 @@ struct HwcBuffer {
   uint32_t gem_handles_[4];
   uint32_t prime_fd_ = 0;
   hwcomposer::HWCLayerType usage_ = hwcomposer::kLayerNormal;
+  // Explicit layout of the buffer, only valid if has_modifier_ is set.
+  // Layout is implied by usage otherwise. total_planes_ counts memory
+  // planes, including auxiliary ones of compressed layouts.
+  uint64_t modifier_ = 0;
+  bool has_modifier_ = false;
+  uint32_t total_planes_ = 0;
 };
 
 #endif  // PUBLIC_HWCBUFFER_H_
@@ -118,5 +118,41 @@ struct HWCColorProp {
 using HWCColorMap =
     std::unordered_map<HWCColorControl, HWCColorProp, EnumClassHash>;
 
+// Stages of a display update, used to index HwcFrameTiming::stage_ns_.
+enum HWCFrameStage {
+  kFrameStageLayerInit = 0,  // Initializing OverlayLayers from HwcLayers.
+  kFrameStageCachedLayers,   // Re-using plane state of the last frame.
+  kFrameStageValidate,       // Plane validation and re-validation.
+  kFrameStageComposition,    // Offscreen composition.
+  kFrameStageFenceWait,      // Waiting for previous frame to be on screen.
+  kFrameStageCommit,         // Atomic commit.
+  kMaxFrameStage
+};
+
+// Ways of assigning layers to display planes.
+enum HWCPlaneAssignment {
+  kPlaneAssignmentGreedy = 0,  // Bottom-up, first plane accepting a layer.
+  kPlaneAssignmentCost,        // Cheapest assignment as per a cost model.
+  kPlaneAssignmentBisect,      // Largest scanout prefix found by bisection.
+};
+
+struct HwcFrameTiming {
+  uint64_t frame_ = 0;     // Sequence number of the update on this display.
+  int64_t start_ns_ = 0;   // Monotonic time at which the update started.
+  int64_t total_ns_ = 0;   // Time spent in the whole update.
+  int64_t stage_ns_[kMaxFrameStage] = {};  // Time spent in each stage.
+  // Heap allocations done by the updating thread. Only counted when
+  // built with ALLOCATION_TRACING, zero otherwise.
+  uint64_t allocations_ = 0;
+  // Atomic test commits issued to validate planes of this update.
+  uint32_t test_commits_ = 0;
+  // Layers which moved between scanout and GPU composition.
+  uint32_t placement_transitions_ = 0;
+  // Bytes offscreen targets in narrower formats than their plane
+  // prefers or at reduced resolution saved scanning out and
+  // rendering this update.
+  uint64_t target_bytes_saved_ = 0;
+};
+
 }  // namespace hwcomposer
 #endif  // PUBLIC_HWCDEFS_H_
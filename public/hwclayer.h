@@ -26,7 +26,7 @@ namespace hwcomposer {
 struct HwcLayer {
   ~HwcLayer();
 
-  HwcLayer() = default;
+  HwcLayer();
 
   HwcLayer& operator=(const HwcLayer& rhs) = delete;
 
@@ -88,7 +88,8 @@ struct HwcLayer {
    *        layer has not changed from last Present call.
    *        If no of rects is zero than assumption is that
    *        the contents of layer has completely changed
-   *        from last Present call.
+   *        from last Present call. Otherwise, it contains
+   *        rects which changed, in buffer coordinates.
    */
   void SetSurfaceDamage(const HwcRegion& surface_damage);
 
@@ -99,6 +100,14 @@ struct HwcLayer {
     return surface_damage_;
   }
 
+  /**
+   * API for getting rects of surface damage of this layer,
+   * in buffer coordinates. Empty if whole layer is damaged.
+   */
+  const HwcRegion& GetSurfaceDamageRegion() const {
+    return surface_damage_region_;
+  }
+
   /**
    * API for querying damage region of this layer
    * has changed from last Present call to
@@ -227,6 +236,24 @@ struct HwcLayer {
     return z_order_;
   }
 
+  /**
+   * API for setting an id identifying this layer across frames.
+   * Every layer gets a unique id when created, clients only need
+   * to call this if they re-create HwcLayer objects for the same
+   * content every frame. Ids need to be unique among layers passed
+   * to a display and must not have the most significant bit set,
+   * as it is reserved for generated ids.
+   */
+  void SetLayerId(uint64_t id);
+
+  /**
+   * API for getting id of this layer. Layers are matched with
+   * the ones of previous frame using this id.
+   */
+  uint64_t GetLayerId() const {
+    return layer_id_;
+  }
+
   void SetLeftConstraint(int32_t left_constraint);
   int32_t GetLeftConstraint();
 
@@ -268,6 +295,7 @@ struct HwcLayer {
   HwcRect<float> source_crop_;
   HwcRect<int> display_frame_;
   HwcRect<int> surface_damage_;
+  HwcRegion surface_damage_region_;
   HwcRect<int> visible_rect_;
   HWCBlending blending_ = HWCBlending::kBlendingNone;
   HWCNativeHandle sf_handle_ = 0;
@@ -278,6 +306,7 @@ struct HwcLayer {
   std::vector<int32_t> left_source_constraint_;
   std::vector<int32_t> right_source_constraint_;
   uint32_t z_order_ = 0;
+  uint64_t layer_id_ = 0;
   int state_ = kVisible | kSurfaceDamageChanged | kVisibleRegionChanged;
   int layer_cache_ = kLayerAttributesChanged | kDisplayFrameRectChanged;
 };
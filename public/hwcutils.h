@@ -28,6 +28,10 @@ namespace hwcomposer {
 //  is not ready.
 int HWCPoll(int fd, int timeout);
 
+// Returns a fence signalled once both fence1 and fence2 are. Takes
+// ownership of both, either of which can be -1.
+int HWCMergeFences(int fence1, int fence2);
+
 // Reset's rect to include region hwc_region.
 void ResetRectToRegion(const HwcRegion& hwc_region, HwcRect<int>& rect);
 
@@ -37,6 +41,10 @@ bool IsSupportedMediaFormat(uint32_t format);
 // Returns total planes for a given format.
 uint32_t GetTotalPlanesForFormat(uint32_t format);
 
+// Returns bytes per pixel of packed RGB formats, 4 for
+// anything else.
+uint32_t GetBytesPerPixel(uint32_t format);
+
 template <class T>
 inline bool IsOverlapping(T l1, T t1, T r1, T b1, T l2, T t2, T r2, T b2)
 // Do two rectangles overlap?
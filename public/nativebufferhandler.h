@@ -22,6 +22,8 @@
 #include <platformdefines.h>
 #include <hwcdefs.h>
 
+#include <vector>
+
 namespace hwcomposer {
 
 class NativeBufferHandler {
@@ -35,6 +37,25 @@ class NativeBufferHandler {
                             HWCNativeHandle *handle = NULL,
                             uint32_t layer_type = kLayerNormal) const = 0;
 
+  // Creates a buffer using one of modifiers as its layout, preferring
+  // those listed first. Chosen one is returned in modifier. Returns
+  // false if none of them can be used, CreateBuffer should be used
+  // then.
+  virtual bool CreateBufferWithModifiers(
+      uint32_t /*w*/, uint32_t /*h*/, int /*format*/,
+      const std::vector<uint64_t> & /*modifiers*/, HWCNativeHandle * /*handle*/,
+      uint64_t * /*modifier*/) const {
+    return false;
+  }
+
+  // Appends modifiers the allocator can render to for format.
+  // Returns false if it doesn't know, in which case
+  // CreateBufferWithModifiers picks among those it is given.
+  virtual bool GetSupportedModifiers(
+      uint32_t /*format*/, std::vector<uint64_t> * /*modifiers*/) const {
+    return false;
+  }
+
   virtual bool ReleaseBuffer(HWCNativeHandle handle) const = 0;
 
   virtual void DestroyHandle(HWCNativeHandle handle) const = 0;
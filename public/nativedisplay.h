@@ -285,9 +285,23 @@ class NativeDisplay {
   virtual void HotPlugUpdate(bool /*connected*/) {
   }
 
+  /**
+  * API for querying time spent in each stage of the most recent updates
+  * of this display.
+  * @param timings array of at least max_frames entries, which will be
+  *        populated oldest frame first.
+  * @param max_frames maximum number of entries to be populated.
+  * @return number of entries populated.
+  */
+  virtual uint32_t GetFrameTimings(HwcFrameTiming * /*timings*/,
+                                   uint32_t /*max_frames*/) {
+    return 0;
+  }
+
  protected:
   friend class PhysicalDisplay;
   friend class GpuDevice;
+  friend class ClonePresentationHandler;
   virtual void OwnPresentation(NativeDisplay * /*clone*/) {
   }
 
@@ -299,6 +313,11 @@ class NativeDisplay {
     return false;
   }
 
+  // Merges release fences of source layers presented by the last
+  // PresentClone call into fences, indexed by source layer.
+  virtual void TakeCloneReleaseFences(std::vector<int32_t> * /*fences*/) {
+  }
+
   // Physical pipe order might be different to the display order
   // configured in hwcdisplay.ini. We need to always use any values
   // overridden by SetDisplayOrder to determine if a display is
@@ -311,6 +330,52 @@ class NativeDisplay {
   // to individual layers shown by this display.
   virtual void RotateDisplay(HWCRotation /*rotation*/) {
   }
+
+  // Records layers passed to Present in file, so that they
+  // can be replayed later for performance analysis.
+  virtual void SetPresentTraceFile(const char* /*file*/) {
+  }
+
+  // Presents clones of this display on threads of their own,
+  // in parallel with each other. When disabled, clones are
+  // presented one after another on the thread calling Present.
+  virtual void SetParallelClonePresentation(bool /*enable*/) {
+  }
+
+  // Selects how layers are assigned to display planes.
+  virtual void SetPlaneAssignment(HWCPlaneAssignment /*assignment*/) {
+  }
+
+  // Limits memory used by offscreen composition targets of this
+  // display to budget bytes, least recently used targets are freed
+  // first. 0 means no limit. Displays passing shared as true draw
+  // from a single budget. The limit is best effort: targets a frame
+  // needs are still allocated, and unused ones are only freed after
+  // this display presents, never by other displays sharing the budget.
+  virtual void SetOffScreenTargetBudget(uint64_t /*budget*/, bool /*shared*/) {
+  }
+
+  // Keeps layers from flipping between overlays and GPU composition.
+  // With cost based plane assignment, a layer moves during full
+  // validation only once that was at least margin percent cheaper on
+  // frames consecutive frames. Otherwise a composited layer gets its
+  // own plane only once it could have had one on frames validations in
+  // a row. frames of 0 disables this.
+  virtual void SetPlacementHysteresis(uint32_t /*frames*/,
+                                      uint32_t /*margin*/) {
+  }
+
+  // Moves cursor shown by last Present to x, y without waiting for the
+  // next frame. If a Present is being committed or the cursor plane
+  // has a flip pending, the position is applied once that is done.
+  // Returns false if the cursor can't be moved on its own, e.g. as it
+  // is composited with other layers, in which case a new frame needs
+  // to be presented. The position only lasts until the next Present,
+  // which shows the cursor at its layer's display frame again, so
+  // cursor layer still needs to be moved for following Presents.
+  virtual bool MoveCursor(int32_t /*x*/, int32_t /*y*/) {
+    return false;
+  }
 };
 
 /**
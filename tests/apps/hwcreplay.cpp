@@ -0,0 +1,275 @@
+/*
+// Copyright (c) 2018 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+// Replays a trace recorded with PRESENT_TRACE (see hwc_display.ini)
+// against a HeadlessDisplay and reports time spent per frame stage.
+
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+#include <hwcdefs.h>
+#include <hwclayer.h>
+#include <nativebufferhandler.h>
+
+#include "frametimingtracker.h"
+#include "headlessdisplay.h"
+#include "hwctrace.h"
+#include "tracereplayer.h"
+
+using namespace hwcomposer;
+
+static const char *kStageNames[kMaxFrameStage] = {
+    "layer-init", "cached-layers", "validate",
+    "composition", "fence-wait", "commit"};
+
+static void print_help(void) {
+  printf(
+      "usage: hwcreplay [-h] [-a] [-c config] [-d device] [-l loops] [-p] "
+      "[-v] trace\n");
+  printf("\t-h\tthis help message\n");
+  printf("\t-a\tfail if a frame replayed after the first loop, which\n");
+  printf("\t\tneeds no test commit or composition, allocates. Needs\n");
+  printf("\t\tALLOCATION_TRACING in hwctrace.h\n");
+  printf("\t-c\tplane config of the simulated display, see\n");
+  printf("\t\tsimulatedplanehandler.h (default accepts everything)\n");
+  printf("\t-d\tDRM device to use (default /dev/dri/renderD128)\n");
+  printf("\t-l\tnumber of times to replay the trace (default 1)\n");
+  printf("\t-p\tpace frames as they were recorded\n");
+  printf("\t-v\tprint timing of every frame\n");
+}
+
+static void sleep_until(int64_t target_ns) {
+  int64_t now = FrameTimingTracker::Now();
+  if (target_ns <= now)
+    return;
+
+  struct timespec delay;
+  delay.tv_sec = (target_ns - now) / 1000000000;
+  delay.tv_nsec = (target_ns - now) % 1000000000;
+  nanosleep(&delay, NULL);
+}
+
+static void print_stats(const char *name, std::vector<int64_t> &values) {
+  if (values.empty())
+    return;
+
+  std::sort(values.begin(), values.end());
+  int64_t total = 0;
+  for (int64_t value : values)
+    total += value;
+
+  size_t size = values.size();
+  printf("%-14s avg %8.1f p50 %8.1f p95 %8.1f max %8.1f us\n", name,
+         total / (size * 1000.0), values.at(size / 2) / 1000.0,
+         values.at((size * 95) / 100) / 1000.0, values.back() / 1000.0);
+}
+
+int main(int argc, char *argv[]) {
+  const char *device = "/dev/dri/renderD128";
+  const char *config = NULL;
+  uint32_t loops = 1;
+  bool pace = false;
+  bool verbose = false;
+  bool check_allocations = false;
+  int opt;
+  while ((opt = getopt(argc, argv, "hac:d:l:pv")) != -1) {
+    switch (opt) {
+      case 'a':
+        check_allocations = true;
+        break;
+      case 'c':
+        config = optarg;
+        break;
+      case 'd':
+        device = optarg;
+        break;
+      case 'l':
+        loops = atoi(optarg);
+        break;
+      case 'p':
+        pace = true;
+        break;
+      case 'v':
+        verbose = true;
+        break;
+      case 'h':
+      default:
+        print_help();
+        return opt == 'h' ? 0 : 1;
+    }
+  }
+
+  if (optind >= argc || loops == 0) {
+    print_help();
+    return 1;
+  }
+
+#ifndef ALLOCATION_TRACING
+  if (check_allocations) {
+    fprintf(stderr, "-a needs ALLOCATION_TRACING, see hwctrace.h\n");
+    return 1;
+  }
+#endif
+
+  int fd = open(device, O_RDWR | O_CLOEXEC);
+  if (fd < 0) {
+    fprintf(stderr, "Failed to open %s: %s\n", device, strerror(errno));
+    return 1;
+  }
+
+  std::unique_ptr<NativeBufferHandler> buffer_handler(
+      NativeBufferHandler::CreateInstance(fd));
+  if (!buffer_handler) {
+    fprintf(stderr, "Failed to create buffer handler\n");
+    close(fd);
+    return 1;
+  }
+
+  std::unique_ptr<TraceReplayer> replayer(
+      new TraceReplayer(buffer_handler.get()));
+  if (!replayer->Load(argv[optind])) {
+    fprintf(stderr, "Failed to read any frames from %s\n", argv[optind]);
+    close(fd);
+    return 1;
+  }
+
+  const std::vector<TraceFrame> &frames = replayer->GetFrames();
+  const PresentTraceFrame &first = frames.front().frame;
+  std::unique_ptr<HeadlessDisplay> display(
+      new HeadlessDisplay(fd, first.display_width_, first.display_height_));
+  if (config && !display->GetPlaneHandler().LoadConfig(config)) {
+    fprintf(stderr, "Failed to load plane config %s\n", config);
+    close(fd);
+    return 1;
+  }
+
+  display->Initialize(buffer_handler.get());
+  display->Connect();
+
+  std::vector<HwcLayer *> source_layers;
+  std::vector<int64_t> totals;
+  std::vector<int64_t> stages[kMaxFrameStage];
+  uint64_t last_frame = 0;
+  bool have_timing = false;
+  uint64_t transitions = 0;
+  uint64_t target_bytes_saved = 0;
+  int64_t first_start = 0;
+  int64_t last_end = 0;
+  uint64_t allocating_frames = 0;
+  bool failed = false;
+  for (uint32_t loop = 0; loop < loops && !failed; loop++) {
+    int64_t loop_start = FrameTimingTracker::Now();
+    for (size_t index = 0; index < frames.size(); index++) {
+      const TraceFrame &trace = frames.at(index);
+      if (!replayer->PrepareFrame(index, &source_layers)) {
+        failed = true;
+        break;
+      }
+
+      if (pace)
+        sleep_until(loop_start + trace.frame.timestamp_ns_);
+
+      int32_t retire_fence = -1;
+      display->Present(source_layers, &retire_fence);
+      if (retire_fence > 0)
+        close(retire_fence);
+
+      for (HwcLayer *layer : source_layers) {
+        int32_t release_fence = layer->GetReleaseFence();
+        if (release_fence > 0)
+          close(release_fence);
+      }
+
+      // Updates ignored by the queue don't produce timings.
+      HwcFrameTiming timing;
+      if (display->GetFrameTimings(&timing, 1) != 1 ||
+          (have_timing && timing.frame_ == last_frame))
+        continue;
+
+      if (!have_timing)
+        first_start = timing.start_ns_;
+
+      have_timing = true;
+      last_frame = timing.frame_;
+      last_end = timing.start_ns_ + timing.total_ns_;
+      transitions += timing.placement_transitions_;
+      target_bytes_saved += timing.target_bytes_saved_;
+      totals.emplace_back(timing.total_ns_);
+      for (uint32_t i = 0; i < kMaxFrameStage; i++)
+        stages[i].emplace_back(timing.stage_ns_[i]);
+
+      // Once every layer and buffer of the trace has been seen, frames
+      // which neither re-validate nor compose should reuse everything
+      // allocated by earlier ones.
+      if (loop > 0 && timing.test_commits_ == 0 &&
+          timing.stage_ns_[kFrameStageComposition] == 0 &&
+          timing.allocations_ > 0) {
+        allocating_frames++;
+        if (check_allocations)
+          printf("frame %llu: %llu allocations in steady state\n",
+                 (unsigned long long)timing.frame_,
+                 (unsigned long long)timing.allocations_);
+      }
+
+      if (verbose) {
+        printf("frame %llu: layers %u total %.1f us",
+               (unsigned long long)timing.frame_, trace.frame.num_layers_,
+               timing.total_ns_ / 1000.0);
+        for (uint32_t i = 0; i < kMaxFrameStage; i++)
+          printf(" %s %.1f", kStageNames[i], timing.stage_ns_[i] / 1000.0);
+
+        printf(" tests %u moves %u\n", timing.test_commits_,
+               timing.placement_transitions_);
+      }
+    }
+  }
+
+  printf("Replayed %zu frames, %zu updates, %llu test commits.\n",
+         frames.size() * loops, totals.size(),
+         (unsigned long long)display->GetPlaneHandler().GetTestCommitCount());
+  double seconds = (last_end - first_start) / 1000000000.0;
+  printf("%llu layers moved between scanout and GPU, %.1f per second.\n",
+         (unsigned long long)transitions,
+         seconds > 0 ? transitions / seconds : 0.0);
+  printf("%.1f MB/s saved by narrower or scaled offscreen targets.\n",
+         seconds > 0 ? target_bytes_saved / seconds / 1000000.0 : 0.0);
+  print_stats("total", totals);
+  for (uint32_t i = 0; i < kMaxFrameStage; i++)
+    print_stats(kStageNames[i], stages[i]);
+
+  if (check_allocations)
+    printf("%llu steady state frames allocated.\n",
+           (unsigned long long)allocating_frames);
+
+  display.reset(nullptr);
+  replayer.reset(nullptr);
+  buffer_handler.reset(nullptr);
+  close(fd);
+  if (failed)
+    return 1;
+
+  return check_allocations && allocating_frames > 0 ? 1 : 0;
+}
@@ -888,7 +888,7 @@ int main(int argc, char *argv[]) {
       frame->layer_renderers[j]->Draw(&gpu_fence_fd);
       frame->layers[j]->SetAcquireFence(gpu_fence_fd);
       std::vector<hwcomposer::HwcRect<int>> damage_region;
-      damage_region.emplace_back(frame->layers[j]->GetDisplayFrame());
+      damage_region.emplace_back(frame->layers[j]->GetSourceCrop());
       frame->layers[j]->SetSurfaceDamage(damage_region);
       layers.emplace_back(frame->layers[j].get());
     }
@@ -0,0 +1,121 @@
+/*
+// Copyright (c) 2018 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+
+// Checks ModifierNegotiator against made up plane and allocator
+// modifier tables. Exits with a non-zero status if any check fails.
+
+#include <stdio.h>
+
+#include <drm_fourcc.h>
+
+#include <vector>
+
+#include "modifiernegotiator.h"
+
+using namespace hwcomposer;
+
+// Tiling of some other vendor, ranked between Intel tilings and linear.
+static const uint64_t kVendorModifier = (0x08ULL << 56) | 1;
+static const uint64_t kOtherVendorModifier = (0x08ULL << 56) | 2;
+
+static uint32_t failures = 0;
+
+static void Check(const char *name, const std::vector<uint64_t> &plane,
+                  const std::vector<uint64_t> &allocator, bool allocator_known,
+                  const std::vector<uint64_t> &expected) {
+  std::vector<uint64_t> modifiers;
+  // Leftovers of an earlier negotiation must not survive.
+  modifiers.emplace_back(DRM_FORMAT_MOD_LINEAR);
+  ModifierNegotiator::Negotiate(plane, allocator, allocator_known,
+                                &modifiers);
+  if (modifiers == expected)
+    return;
+
+  failures++;
+  printf("FAIL %s: got", name);
+  for (uint64_t modifier : modifiers)
+    printf(" 0x%llx", static_cast<unsigned long long>(modifier));
+  printf(", expected");
+  for (uint64_t modifier : expected)
+    printf(" 0x%llx", static_cast<unsigned long long>(modifier));
+  printf("\n");
+}
+
+static void CheckRank(uint64_t better, uint64_t worse) {
+  if (ModifierNegotiator::GetRank(better) <
+      ModifierNegotiator::GetRank(worse))
+    return;
+
+  failures++;
+  printf("FAIL rank: 0x%llx should rank before 0x%llx\n",
+         static_cast<unsigned long long>(better),
+         static_cast<unsigned long long>(worse));
+}
+
+int main() {
+  CheckRank(I915_FORMAT_MOD_Y_TILED, I915_FORMAT_MOD_X_TILED);
+  CheckRank(I915_FORMAT_MOD_X_TILED, kVendorModifier);
+  CheckRank(kVendorModifier, DRM_FORMAT_MOD_LINEAR);
+#ifdef I915_FORMAT_MOD_Y_TILED_CCS
+  CheckRank(I915_FORMAT_MOD_Y_TILED_CCS, I915_FORMAT_MOD_Y_TILED);
+#endif
+
+  const std::vector<uint64_t> plane = {
+      DRM_FORMAT_MOD_LINEAR, I915_FORMAT_MOD_X_TILED, I915_FORMAT_MOD_Y_TILED};
+
+  Check("common subset, best first", plane,
+        {DRM_FORMAT_MOD_LINEAR, I915_FORMAT_MOD_Y_TILED}, true,
+        {I915_FORMAT_MOD_Y_TILED, DRM_FORMAT_MOD_LINEAR});
+
+  Check("nothing in common", {I915_FORMAT_MOD_Y_TILED},
+        {I915_FORMAT_MOD_X_TILED, DRM_FORMAT_MOD_LINEAR}, true, {});
+
+  Check("allocator reports no modifiers", plane, {}, true, {});
+
+  Check("plane without modifiers", {}, plane, true, {});
+
+  // Allocator can't tell what it supports, it picks among
+  // what the plane supports.
+  Check("unknown allocator", plane, {}, false,
+        {I915_FORMAT_MOD_Y_TILED, I915_FORMAT_MOD_X_TILED,
+         DRM_FORMAT_MOD_LINEAR});
+
+  Check("unknown allocator ignores its list", plane,
+        {DRM_FORMAT_MOD_LINEAR}, false,
+        {I915_FORMAT_MOD_Y_TILED, I915_FORMAT_MOD_X_TILED,
+         DRM_FORMAT_MOD_LINEAR});
+
+  Check("unknown allocator, plane without modifiers", {}, {}, false, {});
+
+  Check("invalid and duplicate modifiers dropped",
+        {DRM_FORMAT_MOD_INVALID, I915_FORMAT_MOD_X_TILED,
+         I915_FORMAT_MOD_X_TILED},
+        {}, false, {I915_FORMAT_MOD_X_TILED});
+
+  Check("equal ranks keep plane order",
+        {kOtherVendorModifier, DRM_FORMAT_MOD_LINEAR, kVendorModifier},
+        {kVendorModifier, kOtherVendorModifier, DRM_FORMAT_MOD_LINEAR}, true,
+        {kOtherVendorModifier, kVendorModifier, DRM_FORMAT_MOD_LINEAR});
+
+  if (failures) {
+    printf("%u checks failed\n", failures);
+    return 1;
+  }
+
+  printf("All checks passed\n");
+  return 0;
+}
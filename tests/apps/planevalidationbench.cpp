@@ -0,0 +1,386 @@
+/*
+// Copyright (c) 2018 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+// Measures plane validation cost against a SimulatedPlaneHandler. No GPU
+// or display is needed, buffers only exist as descriptions, so this can
+// run anywhere and be used to catch regressions in DisplayPlaneManager.
+
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+#include <drm_fourcc.h>
+
+#include <hwcdefs.h>
+#include <hwclayer.h>
+
+#include "displayplanemanager.h"
+#include "displayplanestate.h"
+#include "frametimingtracker.h"
+#include "nativesurface.h"
+#include "overlaylayer.h"
+#include "resourcemanager.h"
+#include "simulatedbufferhandler.h"
+#include "simulatedplanehandler.h"
+
+using namespace hwcomposer;
+
+enum Scene { kSceneRGB, kSceneScaled, kSceneVideo, kSceneCursor, kMaxScene };
+
+static const char *kSceneNames[kMaxScene] = {"rgb", "scaled", "video",
+                                             "cursor"};
+
+enum Pattern { kPatternFull, kPatternAppend, kPatternRecheck, kMaxPattern };
+
+static const char *kPatternNames[kMaxPattern] = {"full", "append", "recheck"};
+
+struct Result {
+  std::vector<int64_t> times;
+  uint64_t test_commits = 0;
+  uint64_t failed_test_commits = 0;
+  uint64_t cached_test_commits = 0;
+  size_t planes = 0;
+  size_t gpu_layers = 0;
+};
+
+class Benchmark {
+ public:
+  Benchmark(uint32_t width, uint32_t height)
+      : width_(width), height_(height), resource_manager_(&buffer_handler_) {
+    plane_handler_.SetDisplaySize(width, height);
+  }
+
+  ~Benchmark();
+
+  bool Initialize(const char *config, HWCPlaneAssignment assignment);
+
+  void Run(Scene scene, Pattern pattern, uint32_t num_layers,
+           uint32_t iterations, Result *result);
+
+ private:
+  void CreateLayers(Scene scene, uint32_t num_layers);
+  void InitializeLayers(uint32_t count);
+  bool Validate(int add_index, bool check_plane);
+  void RecycleSurfaces();
+  void Reset();
+
+  uint32_t width_;
+  uint32_t height_;
+  SimulatedBufferHandler buffer_handler_;
+  SimulatedPlaneHandler plane_handler_;
+  ResourceManager resource_manager_;
+  std::unique_ptr<DisplayPlaneManager> plane_manager_;
+  std::vector<std::unique_ptr<HwcLayer>> hwc_layers_;
+  std::vector<HWCNativeHandle> handles_;
+  std::vector<OverlayLayer> layers_;
+  DisplayPlaneStateList composition_;
+  DisplayPlaneStateList previous_composition_;
+  std::vector<NativeSurface *> mark_later_;
+};
+
+Benchmark::~Benchmark() {
+  Reset();
+  plane_manager_.reset(nullptr);
+  for (HWCNativeHandle handle : handles_) {
+    buffer_handler_.ReleaseBuffer(handle);
+    buffer_handler_.DestroyHandle(handle);
+  }
+
+  // Release copies of handles owned by imported buffers, which
+  // would otherwise be freed by the compositor thread.
+  for (uint32_t i = 0; i < BUFFER_CACHE_LENGTH; i++)
+    resource_manager_.RefreshBufferCache();
+
+  resource_manager_.PreparePurgedResources();
+  std::vector<ResourceHandle> gl_resources;
+  std::vector<MediaResourceHandle> media_resources;
+  bool has_gpu_resource = false;
+  resource_manager_.GetPurgedResources(gl_resources, media_resources,
+                                       &has_gpu_resource);
+  for (const ResourceHandle &handle : gl_resources) {
+    if (handle.handle_)
+      buffer_handler_.DestroyHandle(handle.handle_);
+  }
+}
+
+bool Benchmark::Initialize(const char *config,
+                           HWCPlaneAssignment assignment) {
+  if (config && !plane_handler_.LoadConfig(config))
+    return false;
+
+  plane_manager_.reset(
+      new DisplayPlaneManager(0, &plane_handler_, &resource_manager_));
+  plane_manager_->SetPlaneAssignment(assignment);
+  return plane_manager_->Initialize(width_, height_);
+}
+
+void Benchmark::CreateLayers(Scene scene, uint32_t num_layers) {
+  hwc_layers_.clear();
+  for (uint32_t i = 0; i < num_layers; i++) {
+    uint32_t format = DRM_FORMAT_ABGR8888;
+    uint32_t usage = kLayerNormal;
+    // Cascade layers, so that they all overlap but differ in size.
+    int32_t offset = (i * 32) % (height_ / 2);
+    HwcRect<int> frame(offset, offset, width_ - offset, height_ - offset);
+    HwcRect<float> crop(0, 0, frame.right - frame.left,
+                        frame.bottom - frame.top);
+    bool top = i == num_layers - 1;
+    if (scene == kSceneScaled && (i & 1)) {
+      crop.right /= 2;
+      crop.bottom /= 2;
+    } else if (scene == kSceneVideo && i == 0) {
+      format = DRM_FORMAT_NV12;
+      usage = kLayerVideo;
+      crop = HwcRect<float>(0, 0, 1280, 720);
+    } else if (scene == kSceneCursor && top && num_layers > 1) {
+      usage = kLayerCursor;
+      frame = HwcRect<int>(width_ / 2, height_ / 2, width_ / 2 + 64,
+                           height_ / 2 + 64);
+      crop = HwcRect<float>(0, 0, 64, 64);
+    }
+
+    HWCNativeHandle handle = NULL;
+    buffer_handler_.CreateBuffer(crop.right, crop.bottom, format, &handle,
+                                 usage);
+    buffer_handler_.ImportBuffer(handle);
+    handles_.emplace_back(handle);
+
+    HwcLayer *layer = new HwcLayer();
+    layer->SetNativeHandle(handle);
+    layer->SetDisplayFrame(frame, 0);
+    layer->SetSourceCrop(crop);
+    layer->SetBlending(HWCBlending::kBlendingPremult);
+    layer->SetAcquireFence(-1);
+    layer->SetLayerZOrder(i);
+    hwc_layers_.emplace_back(layer);
+  }
+}
+
+void Benchmark::InitializeLayers(uint32_t count) {
+  layers_.reserve(hwc_layers_.size());
+  for (uint32_t i = layers_.size(); i < count; i++) {
+    layers_.emplace_back();
+    layers_.back().InitializeFromHwcLayer(hwc_layers_.at(i).get(),
+                                          &resource_manager_, NULL, i, i,
+                                          height_, kRotateNone, false);
+  }
+}
+
+bool Benchmark::Validate(int add_index, bool check_plane) {
+  bool commit_checked = false;
+  bool render_layers = plane_manager_->ValidateLayers(
+      layers_, add_index, check_plane, false, &commit_checked, composition_,
+      previous_composition_, mark_later_);
+  for (NativeSurface *surface : mark_later_) {
+    surface->SetInUse(false);
+  }
+
+  mark_later_.clear();
+  return render_layers;
+}
+
+void Benchmark::RecycleSurfaces() {
+  for (DisplayPlaneState &plane : previous_composition_) {
+    for (NativeSurface *surface : plane.GetSurfaces())
+      surface->SetInUse(false);
+  }
+
+  previous_composition_.clear();
+  previous_composition_.swap(composition_);
+}
+
+void Benchmark::Reset() {
+  RecycleSurfaces();
+  RecycleSurfaces();
+  layers_.clear();
+}
+
+void Benchmark::Run(Scene scene, Pattern pattern, uint32_t num_layers,
+                    uint32_t iterations, Result *result) {
+  CreateLayers(scene, num_layers);
+  plane_manager_->InvalidateTestCache();
+  // First iteration warms up caches and offscreen surfaces.
+  for (uint32_t i = 0; i <= iterations; i++) {
+    // Full validation, as done by DisplayQueue.
+    int add_index = 0;
+    bool check_plane = false;
+    if (pattern == kPatternAppend && num_layers > 1) {
+      // Stack without the top layer was validated last frame.
+      Reset();
+      InitializeLayers(num_layers - 1);
+      Validate(0, false);
+      add_index = num_layers - 1;
+    } else if (pattern == kPatternRecheck && !composition_.empty()) {
+      // Re-check planes validated last frame.
+      check_plane = true;
+      add_index = -1;
+    }
+
+    InitializeLayers(num_layers);
+    if (check_plane) {
+      previous_composition_.swap(composition_);
+      composition_.clear();
+      for (DisplayPlaneState &plane : previous_composition_) {
+        composition_.emplace_back();
+        composition_.back().CopyState(plane);
+      }
+    } else if (add_index == 0) {
+      RecycleSurfaces();
+    }
+
+    uint64_t test_commits = plane_handler_.GetTestCommitCount();
+    uint64_t failed_test_commits = plane_handler_.GetFailedTestCommitCount();
+    uint64_t cached_test_commits = plane_manager_->GetTestCacheHits();
+    int64_t start = FrameTimingTracker::Now();
+    Validate(add_index, check_plane);
+    int64_t elapsed = FrameTimingTracker::Now() - start;
+    if (i == 0)
+      continue;
+
+    result->times.emplace_back(elapsed);
+    result->test_commits +=
+        plane_handler_.GetTestCommitCount() - test_commits;
+    result->failed_test_commits +=
+        plane_handler_.GetFailedTestCommitCount() - failed_test_commits;
+    result->cached_test_commits +=
+        plane_manager_->GetTestCacheHits() - cached_test_commits;
+  }
+
+  result->planes = composition_.size();
+  result->gpu_layers = 0;
+  for (DisplayPlaneState &plane : composition_) {
+    if (plane.NeedsOffScreenComposition())
+      result->gpu_layers += plane.GetSourceLayers().size();
+  }
+
+  Reset();
+  hwc_layers_.clear();
+}
+
+static void print_help(void) {
+  printf(
+      "usage: planevalidationbench [-h] [-a strategy] [-c config] "
+      "[-m max-layers] [-i iterations] [-s WxH] [-t budget]\n");
+  printf("\t-h\tthis help message\n");
+  printf("\t-a\tplane assignment, cost (default), bisect or greedy\n");
+  printf("\t-c\tplane config, see simulatedplanehandler.h\n");
+  printf("\t-m\tsweep layer counts from 1 to max-layers (default 12)\n");
+  printf("\t-i\tvalidations measured per case (default 200)\n");
+  printf("\t-s\tdisplay size (default 1920x1080)\n");
+  printf("\t-t\tfail if any case needs more test commits per frame\n");
+}
+
+int main(int argc, char *argv[]) {
+  const char *config = NULL;
+  uint32_t max_layers = 12;
+  uint32_t iterations = 200;
+  uint32_t width = 1920;
+  uint32_t height = 1080;
+  double budget = 0;
+  HWCPlaneAssignment assignment = kPlaneAssignmentCost;
+  int opt;
+  while ((opt = getopt(argc, argv, "ha:c:m:i:s:t:")) != -1) {
+    switch (opt) {
+      case 'a':
+        if (!strcmp(optarg, "greedy")) {
+          assignment = kPlaneAssignmentGreedy;
+        } else if (!strcmp(optarg, "bisect")) {
+          assignment = kPlaneAssignmentBisect;
+        } else if (strcmp(optarg, "cost")) {
+          print_help();
+          return 1;
+        }
+        break;
+      case 'c':
+        config = optarg;
+        break;
+      case 'm':
+        max_layers = atoi(optarg);
+        break;
+      case 'i':
+        iterations = atoi(optarg);
+        break;
+      case 's':
+        if (sscanf(optarg, "%ux%u", &width, &height) != 2) {
+          print_help();
+          return 1;
+        }
+        break;
+      case 't':
+        budget = atof(optarg);
+        break;
+      case 'h':
+      default:
+        print_help();
+        return opt == 'h' ? 0 : 1;
+    }
+  }
+
+  if (max_layers == 0 || iterations == 0 || width == 0 || height == 0) {
+    print_help();
+    return 1;
+  }
+
+  Benchmark benchmark(width, height);
+  if (!benchmark.Initialize(config, assignment)) {
+    fprintf(stderr, "Failed to initialize simulated display\n");
+    return 1;
+  }
+
+  bool over_budget = false;
+  printf("%-8s %-8s %6s %10s %10s %12s %12s %12s %6s %10s\n", "scene",
+         "pattern", "layers", "avg_us", "p95_us", "tests/frame",
+         "failed/frame", "cached/frame", "planes", "gpu_layers");
+  for (uint32_t scene = 0; scene < kMaxScene; scene++) {
+    for (uint32_t pattern = 0; pattern < kMaxPattern; pattern++) {
+      for (uint32_t layers = 1; layers <= max_layers; layers++) {
+        Result result;
+        benchmark.Run(static_cast<Scene>(scene), static_cast<Pattern>(pattern),
+                      layers, iterations, &result);
+        std::vector<int64_t> &times = result.times;
+        std::sort(times.begin(), times.end());
+        int64_t total = 0;
+        for (int64_t time : times)
+          total += time;
+
+        size_t size = times.size();
+        double tests = static_cast<double>(result.test_commits) / size;
+        printf(
+            "%-8s %-8s %6u %10.2f %10.2f %12.2f %12.2f %12.2f %6zu %10zu\n",
+            kSceneNames[scene], kPatternNames[pattern], layers,
+            total / (size * 1000.0), times.at((size * 95) / 100) / 1000.0,
+            tests, static_cast<double>(result.failed_test_commits) / size,
+            static_cast<double>(result.cached_test_commits) / size,
+            result.planes, result.gpu_layers);
+        if (budget > 0 && tests > budget)
+          over_budget = true;
+      }
+    }
+  }
+
+  if (over_budget) {
+    fprintf(stderr, "Test commits per frame exceeded budget of %.2f\n",
+            budget);
+    return 1;
+  }
+
+  return 0;
+}
@@ -0,0 +1,168 @@
+/*
+// Copyright (c) 2018 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+
+
+// Checks every RectBatch kernel set the CPU supports against the scalar
+// helpers in hwcutils.h, on random rects packed densely enough that many
+// of them are empty or share edges with the rect they are checked
+// against. Batch sizes run past multiples of the vector widths, so that
+// kernel tails are covered too. Exits with a non-zero status if any check
+// fails.
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "rectbatch.h"
+
+using namespace hwcomposer;
+
+// Largest batch checked, past the inline storage of RectBatch.
+static const size_t kMaxRects = 2 * RectBatch::kInlineRects + 7;
+static const uint32_t kRounds = 200;
+// Small coordinate range makes equal edges common.
+static const int kRange = 12;
+
+static uint32_t failures = 0;
+
+static HwcRect<int> RandomRect() {
+  int left = rand() % kRange;
+  int top = rand() % kRange;
+  // Leave some rects empty.
+  return HwcRect<int>(left, top, left + rand() % (kRange / 2),
+                      top + rand() % (kRange / 2));
+}
+
+static void Fail(const char *kernels, const char *check, size_t count,
+                 size_t index, const HwcRect<int> &rect,
+                 const HwcRect<int> &other) {
+  failures++;
+  printf("FAIL %s %s: %zu rects, rect %zu (%d, %d, %d, %d) against "
+         "(%d, %d, %d, %d)\n",
+         kernels, check, count, index, rect.left, rect.top, rect.right,
+         rect.bottom, other.left, other.top, other.right, other.bottom);
+}
+
+static void CheckBatch(const char *kernels,
+                       const std::vector<HwcRect<int>> &rects,
+                       const HwcRect<int> &rect) {
+  size_t count = rects.size();
+  RectBatch batch;
+  batch.Reset(rects.data(), count);
+  // Batches built one rect at a time need to hold the same rects.
+  RectBatch added;
+  for (const HwcRect<int> &source : rects)
+    added.Add(source);
+
+  uint8_t types[kMaxRects];
+  batch.Classify(rect, types);
+  bool overlaps = false;
+  bool encloses = false;
+  for (size_t i = 0; i < count; i++) {
+    const HwcRect<int> &source = rects.at(i);
+    if (types[i] != AnalyseOverlap(source, rect))
+      Fail(kernels, "Classify", count, i, source, rect);
+
+    HwcRect<int> stored = added.Get(i);
+    if (stored.left != source.left || stored.top != source.top ||
+        stored.right != source.right || stored.bottom != source.bottom)
+      Fail(kernels, "Add", count, i, stored, source);
+
+    overlaps |= IsOverlapping(source, rect);
+    encloses |= IsEnclosedBy(rect, source);
+  }
+
+  if (batch.Overlaps(rect) != overlaps)
+    Fail(kernels, "Overlaps", count, count, rect, rect);
+
+  if (batch.Encloses(rect) != encloses)
+    Fail(kernels, "Encloses", count, count, rect, rect);
+
+  batch.Clip(rect);
+  for (size_t i = 0; i < count; i++) {
+    const HwcRect<int> &source = rects.at(i);
+    HwcRect<int> clipped = batch.Get(i);
+    if (clipped.left != std::max(source.left, rect.left) ||
+        clipped.top != std::max(source.top, rect.top) ||
+        clipped.right != std::min(source.right, rect.right) ||
+        clipped.bottom != std::min(source.bottom, rect.bottom))
+      Fail(kernels, "Clip", count, i, clipped, rect);
+  }
+
+  if (count == 0)
+    return;
+
+  HwcRect<int> expected = rects.front();
+  for (const HwcRect<int> &source : rects) {
+    expected.left = std::min(expected.left, source.left);
+    expected.top = std::min(expected.top, source.top);
+    expected.right = std::max(expected.right, source.right);
+    expected.bottom = std::max(expected.bottom, source.bottom);
+  }
+
+  HwcRect<int> bounds = GetBoundingRect(rects.data(), count);
+  if (bounds.left != expected.left || bounds.top != expected.top ||
+      bounds.right != expected.right || bounds.bottom != expected.bottom)
+    Fail(kernels, "GetBoundingRect", count, count, bounds, expected);
+}
+
+static void CheckKernels(RectBatchKernels kernels, const char *name) {
+  if (!SetRectBatchKernels(kernels)) {
+    printf("Skipping %s kernels, not supported by this CPU\n", name);
+    return;
+  }
+
+  // Same rects for every kernel set.
+  srand(1);
+  std::vector<HwcRect<int>> rects;
+  for (uint32_t round = 0; round < kRounds; round++) {
+    for (size_t count = 0; count <= kMaxRects; count++) {
+      rects.clear();
+      for (size_t i = 0; i < count; i++)
+        rects.emplace_back(RandomRect());
+
+      HwcRect<int> rect = RandomRect();
+      CheckBatch(name, rects, rect);
+      // Rects touching the one checked against.
+      if (count > 0) {
+        const HwcRect<int> &last = rects.back();
+        CheckBatch(name, rects, HwcRect<int>(last.right, last.top,
+                                             last.right + 2, last.bottom));
+        CheckBatch(name, rects, HwcRect<int>(last.left, last.bottom,
+                                             last.right, last.bottom + 2));
+        CheckBatch(name, rects, last);
+      }
+    }
+  }
+}
+
+int main() {
+  CheckKernels(kRectBatchScalar, "scalar");
+  CheckKernels(kRectBatchSSE41, "SSE4.1");
+  CheckKernels(kRectBatchAVX2, "AVX2");
+  SetRectBatchKernels(kRectBatchAuto);
+
+  if (failures) {
+    printf("%u checks failed\n", failures);
+    return 1;
+  }
+
+  printf("All checks passed\n");
+  return 0;
+}
@@ -0,0 +1,570 @@
+/*
+// Copyright (c) 2018 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+// Compares get_draw_regions against the std::set/std::list based sweep it
+// replaced, kept below as the reference. Rect counts are swept well past
+// the 64 rects the old implementation could handle; output of the new one
+// is checked against brute force at every size.
+
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <list>
+#include <set>
+#include <vector>
+
+#include <hwcrect.h>
+
+#include "disjoint_layers.h"
+#include "frametimingtracker.h"
+
+using namespace hwcomposer;
+
+namespace legacy {
+
+struct RectIDs {
+ public:
+  typedef uint64_t TId;
+
+  RectIDs() : bitset(0) {
+  }
+
+  void add(TId id) {
+    bitset |= ((uint64_t)1) << id;
+  }
+
+  void subtract(TId id) {
+    bitset &= ~(((uint64_t)1) << id);
+  }
+
+  bool isEmpty() const {
+    return bitset == 0;
+  }
+
+  static const int max_elements = sizeof(TId) * 8;
+
+ private:
+  uint64_t bitset;
+};
+
+template <typename TNum>
+struct RectSet {
+  RectIDs id_set;
+  Rect<TNum> rect;
+
+  RectSet(const RectIDs &i, const Rect<TNum> &r) : id_set(i), rect(r) {
+  }
+};
+
+enum EventType { START, END };
+
+struct YPOI {
+  EventType type;
+  uint64_t y;
+  uint64_t rect_id;
+
+  bool operator<(const YPOI &rhs) const {
+    if (y == rhs.y)
+      return rect_id < rhs.rect_id;
+    else
+      return (y < rhs.y);
+  }
+};
+
+// Any region will have start X and set of Y coordinates.
+struct Region {
+  uint64_t sx;
+  std::set<YPOI> y_points;
+  RectIDs rect_ids;
+};
+
+// POI is the point of interest while traversing through x coordinates
+struct POI {
+  EventType type;
+  uint64_t rect_id;
+  uint64_t x;
+  uint64_t top_y;
+  uint64_t bot_y;
+
+  bool operator<(const POI &rhs) const {
+    return (x <= rhs.x);
+  }
+};
+
+// This function will take active region and right x
+// For an active region there will be set of YPOI
+// It will traverse through each y_poi and given out
+// rectangle with rect_ids active at that time.
+void GenerateOutLayers(Region *reg, uint64_t x,
+                       std::vector<RectSet<int>> *out) {
+  Rect<int> out_rect;
+  out_rect.left = reg->sx;
+  out_rect.right = x;
+  RectIDs rect_ids;
+
+  for (std::set<YPOI>::iterator y_poi_it = reg->y_points.begin();
+       y_poi_it != reg->y_points.end(); y_poi_it++) {
+    const YPOI &y_poi = *y_poi_it;
+    // No need to check for start or end event
+    // as rect_ids is empty
+    if (rect_ids.isEmpty()) {
+      out_rect.top = y_poi.y;
+      rect_ids.add(y_poi.rect_id);
+    } else {
+      if (out_rect.top == static_cast<int>(y_poi.y)) {
+        if (y_poi.type == START) {
+          rect_ids.add(y_poi.rect_id);
+        } else {
+          rect_ids.subtract(y_poi.rect_id);
+        }
+        continue;
+      }
+      out_rect.bottom = y_poi.y;
+      out->emplace_back(RectSet<int>(rect_ids, out_rect));
+      out_rect.top = y_poi.y;
+      if (y_poi.type == START) {
+        rect_ids.add(y_poi.rect_id);
+      } else {
+        rect_ids.subtract(y_poi.rect_id);
+      }
+    }
+  }
+}
+
+// This function will remove y coordinates corresponding to given rect_id
+void RemoveYpois(Region *reg, uint64_t rect_id) {
+  std::set<YPOI>::iterator top_it = reg->y_points.begin();
+  while (top_it != reg->y_points.end()) {
+    if ((*top_it).rect_id == rect_id) {
+      reg->y_points.erase(top_it++);
+    } else {
+      top_it++;
+    }
+  }
+}
+
+bool compare_region(const Region *first, const Region *second) {
+  uint64_t first_min_y = (*(first->y_points.begin())).y;
+  uint64_t second_min_y = (*(second->y_points.begin())).y;
+  return (first_min_y < second_min_y);
+}
+
+void get_draw_regions(const std::vector<Rect<int>> &in,
+                      std::vector<RectSet<int>> *out) {
+  if (in.size() > RectIDs::max_elements) {
+    return;
+  }
+
+  // Set of all point of interests from input rectangles.
+  std::set<POI> pois;
+  std::list<Region *> imp_reg;
+  std::list<Region> active_regions;
+
+  // This loop will add all point of interests into pois.
+  for (uint64_t i = 0; i < in.size(); i++) {
+    const Rect<int> &rect = in[i];
+
+    // Filter out empty or invalid rects.
+    if (rect.left >= rect.right || rect.top >= rect.bottom)
+      continue;
+
+    POI poi;
+    poi.rect_id = i;
+    poi.x = rect.left;
+    poi.top_y = rect.top;
+    poi.bot_y = rect.bottom;
+    poi.type = START;
+    pois.insert(poi);
+
+    poi.type = END;
+    poi.x = rect.right;
+    pois.insert(poi);
+  }
+
+  for (std::set<POI>::iterator it = pois.begin(); it != pois.end(); ++it) {
+    const POI &poi = *it;
+    // First rectangle has to be inserted into active region
+    // This condition will be true if existing all active
+    // regions are already copied to out.
+    // If current poi is of type END there are no active regions,
+    // then this poi might already covered in previous pass
+    if (active_regions.size() == 0 && poi.type == START) {
+      Region reg;
+      reg.sx = poi.x;
+      YPOI y_poi;
+
+      y_poi.rect_id = poi.rect_id;
+      y_poi.type = START;
+      y_poi.y = poi.top_y;
+      reg.y_points.insert(y_poi);
+
+      y_poi.type = END;
+      y_poi.y = poi.bot_y;
+      reg.y_points.insert(y_poi);
+
+      RectIDs rectIds;
+      rectIds.add(poi.rect_id);
+      reg.rect_ids = rectIds;
+      active_regions.push_back(reg);
+      continue;
+    }
+
+    // If active_regions in not empty, Check if current
+    // poi y points fall in range of any existing
+    // active_regions.
+    // If yes, get that active region and do further processing
+    // If No, create a new region and insert into active regions
+    // If it is start event then there is possibility that multiple
+    // active_regions get impacted.
+    // If it is end event then one or none active_regions will get
+    // impacted.
+    bool found = false;
+    imp_reg.clear();
+    std::list<Region>::iterator it_reg = active_regions.begin();
+    while (it_reg != active_regions.end()) {
+      Region &cur_reg = *it_reg;
+      uint64_t min_y = (*(cur_reg.y_points.begin())).y;
+      uint64_t max_y = (*(cur_reg.y_points.rbegin())).y;
+      // If bottom y is less than minimum y in region or top y is greater than
+      // max y in region, then this region is not impacted by this rect
+      if (poi.bot_y <= min_y || poi.top_y >= max_y) {
+        it_reg++;
+        continue;
+      } else {
+        found = true;
+        // Found atleast one affected active region. If it is start event,
+        // add rect_id to cur_reg.rect_ids, also top_y and bot_y to
+        // cur_reg.y_points. if it is end event, remove rect_id from
+        // cur_reg.rect_ids and also top_y and bot_y from cur_reg.y_points.
+        // Also, if it is end event, check cur_reg.rect_ids is non empty,
+        // if it is empty remove region from active_regions.
+        // If it is start or end event, check next poi.x and see if it is same
+        // and
+        // those y coordinates fall in this region and it is END event, if yes
+        // 1) remove that rect_id and y coordinates as well
+        // 2)contine to check next poi.x until you find mismatch x.
+        if (poi.x == cur_reg.sx) {
+          if (poi.type == START) {
+            cur_reg.rect_ids.add(poi.rect_id);
+            imp_reg.push_back(&cur_reg);
+          }
+
+          it_reg++;
+          continue;
+        }
+        if (poi.type == START) {
+          GenerateOutLayers(&cur_reg, poi.x, out);
+          cur_reg.sx = poi.x;
+          cur_reg.rect_ids.add(poi.rect_id);
+          imp_reg.push_back(&cur_reg);
+          std::set<POI>::iterator next_poi_it = it;
+          next_poi_it++;
+          for (; next_poi_it != pois.end(); next_poi_it++) {
+            const POI &next_poi = *next_poi_it;
+            if (next_poi.x != poi.x) {
+              break;
+            } else {
+              if (next_poi.bot_y <= min_y || next_poi.top_y >= max_y ||
+                  next_poi.type == START) {
+                continue;
+              }
+              cur_reg.rect_ids.subtract(next_poi.rect_id);
+              RemoveYpois(&cur_reg, next_poi.rect_id);
+            }
+          }
+          it_reg++;
+        } else {
+          GenerateOutLayers(&cur_reg, poi.x, out);
+          RemoveYpois(&cur_reg, poi.rect_id);
+          cur_reg.sx = poi.x;
+          cur_reg.rect_ids.subtract(poi.rect_id);
+
+          std::set<POI>::iterator next_poi_it = it;
+          next_poi_it++;
+          for (; next_poi_it != pois.end(); next_poi_it++) {
+            const POI &next_poi = *next_poi_it;
+            if (next_poi.x != poi.x) {
+              break;
+            } else {
+              if (next_poi.bot_y <= min_y || next_poi.top_y >= max_y ||
+                  next_poi.type == START) {
+                continue;
+              }
+              cur_reg.rect_ids.subtract(next_poi.rect_id);
+              RemoveYpois(&cur_reg, next_poi.rect_id);
+            }
+          }
+          if (cur_reg.rect_ids.isEmpty()) {
+            active_regions.erase(it_reg++);
+          } else {
+            it_reg++;
+          }
+        }
+      }
+    }
+    // If no affected active region found, add new active region
+    if (!found && poi.type == START) {
+      Region reg;
+      reg.sx = poi.x;
+      YPOI y_poi;
+
+      y_poi.rect_id = poi.rect_id;
+      y_poi.type = START;
+      y_poi.y = poi.top_y;
+      reg.y_points.insert(y_poi);
+
+      y_poi.type = END;
+      y_poi.y = poi.bot_y;
+      reg.y_points.insert(y_poi);
+
+      RectIDs rectIds;
+      rectIds.add(poi.rect_id);
+      reg.rect_ids = rectIds;
+      active_regions.push_back(reg);
+    } else {
+      if (imp_reg.size() > 1 && poi.type == START) {
+        imp_reg.sort(compare_region);
+        uint64_t cur_y = 0;
+        for (std::list<Region *>::iterator cur_imp_reg_it = imp_reg.begin();
+             cur_imp_reg_it != imp_reg.end(); cur_imp_reg_it++) {
+          Region &cur_imp_reg = *(*cur_imp_reg_it);
+          YPOI y_poi;
+          y_poi.rect_id = poi.rect_id;
+          y_poi.type = START;
+
+          if (cur_y == 0) {
+            y_poi.y = poi.top_y;
+          } else {
+            y_poi.y = cur_y;
+          }
+          // This is to split vertical
+          // line into all impacted
+          // regions.
+          cur_imp_reg.y_points.insert(y_poi);
+          // Take bottom of current region as start of next impacted region
+          cur_y = (*(cur_imp_reg.y_points.rbegin())).y;
+          std::list<Region *>::iterator next_imp_reg_it = cur_imp_reg_it;
+          next_imp_reg_it++;
+          if (next_imp_reg_it == imp_reg.end()) {
+            // If there is an another
+            // region which is impacted, no
+            // need to add anything.
+            // if there is no other active region left,
+            // take bottom y and push into this active region
+            y_poi.y = poi.bot_y;
+          } else {
+            y_poi.y = cur_y;
+          }
+          y_poi.type = END;
+          cur_imp_reg.y_points.insert(y_poi);
+        }
+      } else if (imp_reg.size() == 1 && poi.type == START) {
+        // Only one region got impacted add y coordinated to that region
+        std::list<Region *>::iterator cur_imp_reg_it = imp_reg.begin();
+        YPOI y_poi;
+        y_poi.rect_id = poi.rect_id;
+        y_poi.type = START;
+        y_poi.y = poi.top_y;
+        (*cur_imp_reg_it)->y_points.insert(y_poi);
+        y_poi.type = END;
+        y_poi.y = poi.bot_y;
+        (*cur_imp_reg_it)->y_points.insert(y_poi);
+      }
+    }
+  }
+}
+
+}  // namespace legacy
+
+struct Result {
+  std::vector<int64_t> times;
+  std::vector<int64_t> legacy_times;
+  size_t regions = 0;
+  size_t legacy_regions = 0;
+  bool valid = true;
+};
+
+// Scattered windows of varying size on a width x height display,
+// similar to what SeparateLayers sees with many overlapping layers.
+static void GenerateRects(uint32_t count, uint32_t width, uint32_t height,
+                          std::vector<Rect<int>> *rects) {
+  rects->clear();
+  for (uint32_t i = 0; i < count; i++) {
+    int w = 16 + rand() % (width / 2);
+    int h = 16 + rand() % (height / 2);
+    int left = rand() % (width - w);
+    int top = rand() % (height - h);
+    rects->emplace_back(Rect<int>(left, top, left + w, top + h));
+  }
+}
+
+// Every cell of the grid formed by all rect edges must be covered by
+// exactly one region, tagged with exactly the rects containing it.
+static bool Verify(const std::vector<Rect<int>> &in,
+                   const std::vector<RectSet<int>> &out) {
+  std::vector<int> xs;
+  std::vector<int> ys;
+  for (const Rect<int> &rect : in) {
+    xs.emplace_back(rect.left);
+    xs.emplace_back(rect.right);
+    ys.emplace_back(rect.top);
+    ys.emplace_back(rect.bottom);
+  }
+
+  std::sort(xs.begin(), xs.end());
+  xs.erase(std::unique(xs.begin(), xs.end()), xs.end());
+  std::sort(ys.begin(), ys.end());
+  ys.erase(std::unique(ys.begin(), ys.end()), ys.end());
+  for (size_t i = 0; i + 1 < ys.size(); i++) {
+    for (size_t j = 0; j + 1 < xs.size(); j++) {
+      int x = xs[j];
+      int y = ys[i];
+      RectIDs expected;
+      for (size_t k = 0; k < in.size(); k++) {
+        const Rect<int> &rect = in[k];
+        if (rect.left <= x && rect.right > x && rect.top <= y &&
+            rect.bottom > y)
+          expected.add(k);
+      }
+
+      size_t covering = 0;
+      for (const RectSet<int> &region : out) {
+        const Rect<int> &rect = region.rect;
+        if (rect.left > x || rect.right <= x || rect.top > y ||
+            rect.bottom <= y)
+          continue;
+
+        covering++;
+        if (region.id_set != expected)
+          return false;
+      }
+
+      if (covering != (expected.isEmpty() ? 0 : 1))
+        return false;
+    }
+  }
+
+  return true;
+}
+
+static void Run(uint32_t count, uint32_t width, uint32_t height,
+                uint32_t iterations, Result *result) {
+  std::vector<Rect<int>> rects;
+  std::vector<RectSet<int>> regions;
+  std::vector<legacy::RectSet<int>> legacy_regions;
+  bool run_legacy = count <= legacy::RectIDs::max_elements;
+  for (uint32_t i = 0; i < iterations; i++) {
+    GenerateRects(count, width, height, &rects);
+    regions.clear();
+    int64_t start = FrameTimingTracker::Now();
+    get_draw_regions(rects, &regions);
+    result->times.emplace_back(FrameTimingTracker::Now() - start);
+    result->regions += regions.size();
+    if (i == 0 && !Verify(rects, regions))
+      result->valid = false;
+
+    if (!run_legacy)
+      continue;
+
+    legacy_regions.clear();
+    start = FrameTimingTracker::Now();
+    legacy::get_draw_regions(rects, &legacy_regions);
+    result->legacy_times.emplace_back(FrameTimingTracker::Now() - start);
+    result->legacy_regions += legacy_regions.size();
+  }
+}
+
+static double Average(const std::vector<int64_t> &times) {
+  if (times.empty())
+    return 0;
+
+  int64_t total = 0;
+  for (int64_t time : times)
+    total += time;
+
+  return total / (times.size() * 1000.0);
+}
+
+static void print_help(void) {
+  printf("usage: regionseparationbench [-h] [-m max-rects] [-i iterations] "
+         "[-s WxH]\n");
+  printf("\t-h\tthis help message\n");
+  printf("\t-m\tdouble rect counts from 4 up to max-rects (default 256)\n");
+  printf("\t-i\truns per rect count (default 100)\n");
+  printf("\t-s\tdisplay size (default 1920x1080)\n");
+}
+
+int main(int argc, char *argv[]) {
+  uint32_t max_rects = 256;
+  uint32_t iterations = 100;
+  uint32_t width = 1920;
+  uint32_t height = 1080;
+  int opt;
+  while ((opt = getopt(argc, argv, "hm:i:s:")) != -1) {
+    switch (opt) {
+      case 'm':
+        max_rects = atoi(optarg);
+        break;
+      case 'i':
+        iterations = atoi(optarg);
+        break;
+      case 's':
+        if (sscanf(optarg, "%ux%u", &width, &height) != 2) {
+          print_help();
+          return 1;
+        }
+        break;
+      case 'h':
+      default:
+        print_help();
+        return opt == 'h' ? 0 : 1;
+    }
+  }
+
+  if (max_rects == 0 || iterations == 0 || width < 64 || height < 64) {
+    print_help();
+    return 1;
+  }
+
+  srand(1);
+  bool valid = true;
+  printf("%6s %10s %10s %10s %10s %8s\n", "rects", "avg_us", "legacy_us",
+         "regions", "legacy", "speedup");
+  for (uint32_t count = 4; count <= max_rects; count *= 2) {
+    Result result;
+    Run(count, width, height, iterations, &result);
+    double average = Average(result.times);
+    if (result.legacy_times.empty()) {
+      printf("%6u %10.2f %10s %10zu %10s %8s\n", count, average, "-",
+             result.regions / iterations, "-", "-");
+    } else {
+      double legacy_average = Average(result.legacy_times);
+      printf("%6u %10.2f %10.2f %10zu %10zu %8.2f\n", count, average,
+             legacy_average, result.regions / iterations,
+             result.legacy_regions / iterations, legacy_average / average);
+    }
+
+    if (!result.valid) {
+      fprintf(stderr, "Regions of %u rects don't match their coverage\n",
+              count);
+      valid = false;
+    }
+  }
+
+  return valid ? 0 : 1;
+}
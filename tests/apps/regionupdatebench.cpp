@@ -0,0 +1,244 @@
+/*
+// Copyright (c) 2018 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+
+// Measures the cost of keeping composition regions up to date while a
+// window is dragged across a desktop of overlapping windows, separating
+// all layers again every frame versus updating cached regions. Regions
+// of both are checked to cover the display the same way.
+
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <vector>
+
+#include <hwcdefs.h>
+
+#include "compositionregion.h"
+#include "frametimingtracker.h"
+
+using namespace hwcomposer;
+
+struct Result {
+  std::vector<int64_t> full_times;
+  std::vector<int64_t> update_times;
+  uint64_t full_regions = 0;
+  uint64_t cached_regions = 0;
+  uint64_t updated_regions = 0;
+  bool valid = true;
+};
+
+// Wallpaper, a panel and windows scattered over the display, bottom
+// most first.
+static void CreateDesktop(uint32_t num_layers, int width, int height,
+                          std::vector<HwcRect<int>> *frames) {
+  frames->clear();
+  frames->emplace_back(HwcRect<int>(0, 0, width, height));
+  for (uint32_t i = 1; i + 1 < num_layers; i++) {
+    int w = width / 6 + rand() % (width / 3);
+    int h = height / 6 + rand() % (height / 3);
+    int left = rand() % (width - w);
+    int top = rand() % (height - h);
+    frames->emplace_back(HwcRect<int>(left, top, left + w, top + h));
+  }
+
+  frames->emplace_back(HwcRect<int>(0, height - 48, width, height));
+}
+
+// Source layers covering the region containing x, y. Empty if there is
+// none.
+static std::vector<size_t> GetCoverage(
+    const std::vector<CompositionRegion> &regions, int x, int y,
+    size_t *covering) {
+  std::vector<size_t> layers;
+  *covering = 0;
+  for (const CompositionRegion &region : regions) {
+    const HwcRect<int> &frame = region.frame;
+    if (frame.left > x || frame.right <= x || frame.top > y ||
+        frame.bottom <= y)
+      continue;
+
+    (*covering)++;
+    layers = region.source_layers;
+  }
+
+  std::sort(layers.begin(), layers.end());
+  return layers;
+}
+
+// Cells of the grid formed by all layer edges must be covered by at
+// most one region of each, listing the same layers.
+static bool Verify(const std::vector<HwcRect<int>> &frames,
+                   const std::vector<CompositionRegion> &full,
+                   const std::vector<CompositionRegion> &cached) {
+  std::vector<int> xs;
+  std::vector<int> ys;
+  for (const HwcRect<int> &frame : frames) {
+    xs.emplace_back(frame.left);
+    xs.emplace_back(frame.right);
+    ys.emplace_back(frame.top);
+    ys.emplace_back(frame.bottom);
+  }
+
+  std::sort(xs.begin(), xs.end());
+  xs.erase(std::unique(xs.begin(), xs.end()), xs.end());
+  std::sort(ys.begin(), ys.end());
+  ys.erase(std::unique(ys.begin(), ys.end()), ys.end());
+  for (int y : ys) {
+    for (int x : xs) {
+      size_t full_covering = 0;
+      size_t cached_covering = 0;
+      if (GetCoverage(full, x, y, &full_covering) !=
+              GetCoverage(cached, x, y, &cached_covering) ||
+          full_covering > 1 || cached_covering > 1)
+        return false;
+    }
+  }
+
+  return true;
+}
+
+static void Run(uint32_t num_layers, uint32_t frames, int width, int height,
+                int step, uint32_t verify_interval, Result *result) {
+  std::vector<HwcRect<int>> display_frame;
+  CreateDesktop(num_layers, width, height, &display_frame);
+  std::vector<size_t> dedicated_layers;
+  std::vector<size_t> source_layers;
+  for (size_t i = 0; i < num_layers; i++)
+    source_layers.emplace_back(i);
+
+  // Drag a window from the middle of the stack, bouncing off the
+  // display edges.
+  HwcRect<int> &window = display_frame.at(num_layers / 2);
+  int dx = step;
+  int dy = step / 2 + 1;
+  CompositionRegionCache cache;
+  cache.Update(dedicated_layers, source_layers, display_frame);
+  std::vector<CompositionRegion> regions;
+  for (uint32_t i = 0; i < frames; i++) {
+    if (window.left + dx < 0 || window.right + dx > width)
+      dx = -dx;
+
+    if (window.top + dy < 0 || window.bottom + dy > height)
+      dy = -dy;
+
+    window.left += dx;
+    window.right += dx;
+    window.top += dy;
+    window.bottom += dy;
+
+    regions.clear();
+    int64_t start = FrameTimingTracker::Now();
+    SeparateLayers(dedicated_layers, source_layers, display_frame, regions);
+    result->full_times.emplace_back(FrameTimingTracker::Now() - start);
+
+    start = FrameTimingTracker::Now();
+    cache.Update(dedicated_layers, source_layers, display_frame);
+    result->update_times.emplace_back(FrameTimingTracker::Now() - start);
+
+    result->full_regions += regions.size();
+    result->cached_regions += cache.GetRegions().size();
+    result->updated_regions += cache.GetUpdatedRegionCount();
+    if (verify_interval && i % verify_interval == 0 &&
+        !Verify(display_frame, regions, cache.GetRegions()))
+      result->valid = false;
+  }
+}
+
+static void PrintTimes(const char *name, std::vector<int64_t> &times) {
+  std::sort(times.begin(), times.end());
+  int64_t total = 0;
+  for (int64_t time : times)
+    total += time;
+
+  size_t size = times.size();
+  printf("%-12s %10.2f %10.2f %10.2f\n", name, total / (size * 1000.0),
+         times.at(size / 2) / 1000.0, times.at((size * 95) / 100) / 1000.0);
+}
+
+static void print_help(void) {
+  printf(
+      "usage: regionupdatebench [-h] [-l layers] [-f frames] [-p step] "
+      "[-s WxH] [-v interval]\n");
+  printf("\t-h\tthis help message\n");
+  printf("\t-l\tlayers on the desktop (default 30)\n");
+  printf("\t-f\tframes the window is dragged for (default 1000)\n");
+  printf("\t-p\tpixels the window moves per frame (default 8)\n");
+  printf("\t-s\tdisplay size (default 1920x1080)\n");
+  printf("\t-v\tcompare regions every interval frames, 0 to skip "
+         "(default 50)\n");
+}
+
+int main(int argc, char *argv[]) {
+  uint32_t num_layers = 30;
+  uint32_t frames = 1000;
+  int step = 8;
+  uint32_t width = 1920;
+  uint32_t height = 1080;
+  uint32_t verify_interval = 50;
+  int opt;
+  while ((opt = getopt(argc, argv, "hl:f:p:s:v:")) != -1) {
+    switch (opt) {
+      case 'l':
+        num_layers = atoi(optarg);
+        break;
+      case 'f':
+        frames = atoi(optarg);
+        break;
+      case 'p':
+        step = atoi(optarg);
+        break;
+      case 's':
+        if (sscanf(optarg, "%ux%u", &width, &height) != 2) {
+          print_help();
+          return 1;
+        }
+        break;
+      case 'v':
+        verify_interval = atoi(optarg);
+        break;
+      case 'h':
+      default:
+        print_help();
+        return opt == 'h' ? 0 : 1;
+    }
+  }
+
+  if (num_layers < 3 || frames == 0 || step <= 0 || width < 64 ||
+      height < 64) {
+    print_help();
+    return 1;
+  }
+
+  srand(1);
+  Result result;
+  Run(num_layers, frames, width, height, step, verify_interval, &result);
+  printf("%-12s %10s %10s %10s\n", "update", "avg_us", "p50_us", "p95_us");
+  PrintTimes("full", result.full_times);
+  PrintTimes("incremental", result.update_times);
+  printf("regions/frame: full %.1f, cached %.1f, separated again %.1f\n",
+         static_cast<double>(result.full_regions) / frames,
+         static_cast<double>(result.cached_regions) / frames,
+         static_cast<double>(result.updated_regions) / frames);
+  if (!result.valid) {
+    fprintf(stderr, "Cached regions don't match full separation\n");
+    return 1;
+  }
+
+  return 0;
+}
@@ -0,0 +1,322 @@
+/*
+// Copyright (c) 2018 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+
+// Measures building render states for many regions of a deep layer
+// stack, deriving layer sampling parameters for every region and
+// prepending states as the compositor used to, versus deriving them
+// once per frame and appending states. Both need to produce the same
+// states. Buffers only exist as descriptions, no GPU is needed.
+
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+#include <drm_fourcc.h>
+
+#include <hwcdefs.h>
+#include <hwclayer.h>
+
+#include "compositionregion.h"
+#include "frametimingtracker.h"
+#include "overlaylayer.h"
+#include "renderstate.h"
+#include "resourcemanager.h"
+#include "simulatedbufferhandler.h"
+
+using namespace hwcomposer;
+
+static const uint32_t kTransforms[] = {
+    HWCTransform::kIdentity,     HWCTransform::kTransform90,
+    HWCTransform::kTransform180, HWCTransform::kTransform270,
+    HWCTransform::kReflectX,     HWCTransform::kTransform45};
+
+class Benchmark {
+ public:
+  Benchmark(uint32_t width, uint32_t height)
+      : width_(width), height_(height), resource_manager_(&buffer_handler_) {
+  }
+
+  ~Benchmark();
+
+  void CreateLayers(uint32_t num_layers);
+  void CreateRegions(uint32_t columns, uint32_t rows);
+
+  // Builds states of all regions. Returns time taken.
+  int64_t Run(bool precompute, std::vector<RenderState> &states);
+
+  size_t GetRegionCount() const {
+    return regions_.size();
+  }
+
+ private:
+  uint32_t width_;
+  uint32_t height_;
+  SimulatedBufferHandler buffer_handler_;
+  ResourceManager resource_manager_;
+  std::vector<std::unique_ptr<HwcLayer>> hwc_layers_;
+  std::vector<HWCNativeHandle> handles_;
+  std::vector<OverlayLayer> layers_;
+  std::vector<CompositionRegion> regions_;
+  std::vector<RenderState::LayerSampling> sampling_;
+};
+
+Benchmark::~Benchmark() {
+  layers_.clear();
+  hwc_layers_.clear();
+  for (HWCNativeHandle handle : handles_) {
+    buffer_handler_.ReleaseBuffer(handle);
+    buffer_handler_.DestroyHandle(handle);
+  }
+
+  // Release copies of handles owned by imported buffers, which
+  // would otherwise be freed by the compositor thread.
+  for (uint32_t i = 0; i < BUFFER_CACHE_LENGTH; i++)
+    resource_manager_.RefreshBufferCache();
+
+  resource_manager_.PreparePurgedResources();
+  std::vector<ResourceHandle> gl_resources;
+  std::vector<MediaResourceHandle> media_resources;
+  bool has_gpu_resource = false;
+  resource_manager_.GetPurgedResources(gl_resources, media_resources,
+                                       &has_gpu_resource);
+  for (const ResourceHandle &handle : gl_resources) {
+    if (handle.handle_)
+      buffer_handler_.DestroyHandle(handle.handle_);
+  }
+}
+
+void Benchmark::CreateLayers(uint32_t num_layers) {
+  for (uint32_t i = 0; i < num_layers; i++) {
+    // Wallpaper at the bottom, windows of varying size above it.
+    HwcRect<int> frame(0, 0, width_, height_);
+    if (i > 0) {
+      int w = width_ / 8 + rand() % (width_ / 2);
+      int h = height_ / 8 + rand() % (height_ / 2);
+      int left = rand() % (width_ - w);
+      int top = rand() % (height_ - h);
+      frame = HwcRect<int>(left, top, left + w, top + h);
+    }
+
+    uint32_t transform = i ? kTransforms[rand() % 6] : 0;
+    bool swap = transform & HWCTransform::kTransform90;
+    int frame_width = frame.right - frame.left;
+    int frame_height = frame.bottom - frame.top;
+    int buffer_width = swap ? frame_height : frame_width;
+    int buffer_height = swap ? frame_width : frame_height;
+    HWCNativeHandle handle = NULL;
+    buffer_handler_.CreateBuffer(buffer_width, buffer_height,
+                                 DRM_FORMAT_ABGR8888, &handle, kLayerNormal);
+    buffer_handler_.ImportBuffer(handle);
+    handles_.emplace_back(handle);
+
+    HwcLayer *layer = new HwcLayer();
+    layer->SetNativeHandle(handle);
+    layer->SetDisplayFrame(frame, 0);
+    layer->SetSourceCrop(HwcRect<float>(0, 0, buffer_width, buffer_height));
+    layer->SetTransform(transform);
+    layer->SetBlending(i ? HWCBlending::kBlendingPremult
+                         : HWCBlending::kBlendingNone);
+    layer->SetAlpha(i % 3 ? 0xFF : 0x80);
+    layer->SetAcquireFence(-1);
+    layer->SetLayerZOrder(i);
+    hwc_layers_.emplace_back(layer);
+  }
+
+  layers_.reserve(num_layers);
+  for (uint32_t i = 0; i < num_layers; i++) {
+    layers_.emplace_back();
+    layers_.back().InitializeFromHwcLayer(hwc_layers_.at(i).get(),
+                                          &resource_manager_, NULL, i, i,
+                                          height_, kRotateNone, false);
+  }
+}
+
+// Splits the display in a grid, listing layers covering each cell top
+// most first, as SeparateLayers does.
+void Benchmark::CreateRegions(uint32_t columns, uint32_t rows) {
+  for (uint32_t row = 0; row < rows; row++) {
+    for (uint32_t column = 0; column < columns; column++) {
+      HwcRect<int> frame(column * width_ / columns, row * height_ / rows,
+                         (column + 1) * width_ / columns,
+                         (row + 1) * height_ / rows);
+      regions_.emplace_back(CompositionRegion{frame, {}});
+      std::vector<size_t> &source = regions_.back().source_layers;
+      for (size_t i = layers_.size(); i > 0; i--) {
+        const HwcRect<int> &display_frame = layers_.at(i - 1).GetDisplayFrame();
+        if (display_frame.left < frame.right &&
+            display_frame.right > frame.left &&
+            display_frame.top < frame.bottom &&
+            display_frame.bottom > frame.top)
+          source.emplace_back(i - 1);
+      }
+    }
+  }
+}
+
+int64_t Benchmark::Run(bool precompute, std::vector<RenderState> &states) {
+  DamageRegion damage;
+  states.clear();
+  int64_t start = FrameTimingTracker::Now();
+  if (precompute) {
+    sampling_.assign(layers_.size(), RenderState::LayerSampling());
+    states.reserve(regions_.size());
+  }
+
+  for (const CompositionRegion &region : regions_) {
+    // Without a per frame table every region derives parameters
+    // of its layers again.
+    if (!precompute)
+      sampling_.assign(layers_.size(), RenderState::LayerSampling());
+
+    RenderState state;
+    state.ConstructState(layers_, sampling_, region, damage, true);
+    if (state.layer_state_.empty())
+      continue;
+
+    if (precompute) {
+      states.emplace_back(std::move(state));
+    } else {
+      states.emplace(states.begin(), state);
+    }
+  }
+
+  if (precompute)
+    std::reverse(states.begin(), states.end());
+
+  return FrameTimingTracker::Now() - start;
+}
+
+static bool SameStates(const std::vector<RenderState> &lhs,
+                       const std::vector<RenderState> &rhs) {
+  if (lhs.size() != rhs.size())
+    return false;
+
+  for (size_t i = 0; i < lhs.size(); i++) {
+    const std::vector<RenderState::LayerState> &left = lhs[i].layer_state_;
+    const std::vector<RenderState::LayerState> &right = rhs[i].layer_state_;
+    if (lhs[i].x_ != rhs[i].x_ || lhs[i].y_ != rhs[i].y_ ||
+        left.size() != right.size())
+      return false;
+
+    for (size_t j = 0; j < left.size(); j++) {
+      if (left[j].layer_index_ != right[j].layer_index_ ||
+          memcmp(left[j].crop_bounds_, right[j].crop_bounds_,
+                 sizeof(left[j].crop_bounds_)) ||
+          memcmp(left[j].texture_matrix_, right[j].texture_matrix_,
+                 sizeof(left[j].texture_matrix_)) ||
+          left[j].alpha_ != right[j].alpha_ ||
+          left[j].premult_ != right[j].premult_)
+        return false;
+    }
+  }
+
+  return true;
+}
+
+static void PrintTimes(const char *name, std::vector<int64_t> &times) {
+  std::sort(times.begin(), times.end());
+  int64_t total = 0;
+  for (int64_t time : times)
+    total += time;
+
+  size_t size = times.size();
+  printf("%-12s %10.2f %10.2f %10.2f\n", name, total / (size * 1000.0),
+         times.at(size / 2) / 1000.0, times.at((size * 95) / 100) / 1000.0);
+}
+
+static void print_help(void) {
+  printf(
+      "usage: renderstatebench [-h] [-l layers] [-r columnsxrows] "
+      "[-i iterations] [-s WxH]\n");
+  printf("\t-h\tthis help message\n");
+  printf("\t-l\tlayers to compose (default 50)\n");
+  printf("\t-r\tgrid of regions (default 20x10)\n");
+  printf("\t-i\tframes measured (default 500)\n");
+  printf("\t-s\tdisplay size (default 1920x1080)\n");
+}
+
+int main(int argc, char *argv[]) {
+  uint32_t num_layers = 50;
+  uint32_t columns = 20;
+  uint32_t rows = 10;
+  uint32_t iterations = 500;
+  uint32_t width = 1920;
+  uint32_t height = 1080;
+  int opt;
+  while ((opt = getopt(argc, argv, "hl:r:i:s:")) != -1) {
+    switch (opt) {
+      case 'l':
+        num_layers = atoi(optarg);
+        break;
+      case 'r':
+        if (sscanf(optarg, "%ux%u", &columns, &rows) != 2) {
+          print_help();
+          return 1;
+        }
+        break;
+      case 'i':
+        iterations = atoi(optarg);
+        break;
+      case 's':
+        if (sscanf(optarg, "%ux%u", &width, &height) != 2) {
+          print_help();
+          return 1;
+        }
+        break;
+      case 'h':
+      default:
+        print_help();
+        return opt == 'h' ? 0 : 1;
+    }
+  }
+
+  if (num_layers == 0 || columns == 0 || rows == 0 || iterations == 0 ||
+      width < 64 || height < 64) {
+    print_help();
+    return 1;
+  }
+
+  srand(1);
+  Benchmark benchmark(width, height);
+  benchmark.CreateLayers(num_layers);
+  benchmark.CreateRegions(columns, rows);
+
+  std::vector<int64_t> per_region;
+  std::vector<int64_t> precomputed;
+  std::vector<RenderState> states;
+  std::vector<RenderState> reference;
+  for (uint32_t i = 0; i < iterations; i++) {
+    per_region.emplace_back(benchmark.Run(false, reference));
+    precomputed.emplace_back(benchmark.Run(true, states));
+  }
+
+  printf("%u layers, %zu regions\n", num_layers, benchmark.GetRegionCount());
+  printf("%-12s %10s %10s %10s\n", "states", "avg_us", "p50_us", "p95_us");
+  PrintTimes("per region", per_region);
+  PrintTimes("precomputed", precomputed);
+  if (!SameStates(reference, states)) {
+    fprintf(stderr, "Precomputed parameters produce different states\n");
+    return 1;
+  }
+
+  return 0;
+}
@@ -0,0 +1,280 @@
+/*
+// Copyright (c) 2018 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+
+// Replays a made up trace against a HeadlessDisplay and fails if any
+// frame which neither re-validates planes nor composes allocates once
+// every layer and buffer of the trace has been seen. Exits with 77,
+// which make check reports as skipped, when no GPU can be opened.
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <drm_fourcc.h>
+
+#include <memory>
+#include <vector>
+
+#include <hwcdefs.h>
+#include <hwclayer.h>
+#include <nativebufferhandler.h>
+
+#include "allocationtracker.h"
+#include "headlessdisplay.h"
+#include "hwctrace.h"
+#include "tracereplayer.h"
+
+#ifndef ALLOCATION_TRACING
+#include <new>
+#endif
+
+using namespace hwcomposer;
+
+static const uint32_t kSkipped = 77;
+static const uint32_t kDisplayWidth = 1920;
+static const uint32_t kDisplayHeight = 1080;
+static const uint32_t kTraceFrames = 60;
+
+#ifdef ALLOCATION_TRACING
+static uint64_t AllocationCount() {
+  return GetThreadAllocationCount();
+}
+#else
+// Without ALLOCATION_TRACING libhwcomposer leaves operator new alone,
+// so count allocations of this thread here instead.
+static thread_local uint64_t thread_allocations = 0;
+
+static uint64_t AllocationCount() {
+  return thread_allocations;
+}
+
+void *operator new(size_t size) {
+  thread_allocations++;
+  void *ptr = malloc(size ? size : 1);
+  if (!ptr)
+    abort();
+
+  return ptr;
+}
+
+void *operator new[](size_t size) {
+  return operator new(size);
+}
+
+void operator delete(void *ptr) noexcept {
+  free(ptr);
+}
+
+void operator delete[](void *ptr) noexcept {
+  free(ptr);
+}
+
+void operator delete(void *ptr, size_t) noexcept {
+  free(ptr);
+}
+
+void operator delete[](void *ptr, size_t) noexcept {
+  free(ptr);
+}
+#endif
+
+static void FillLayer(PresentTraceLayer *layer, uint64_t id,
+                      uint32_t buffer_id, uint32_t format, int32_t left,
+                      int32_t top, int32_t width, int32_t height,
+                      bool changed) {
+  memset(layer, 0, sizeof(PresentTraceLayer));
+  layer->layer_id_ = id;
+  layer->buffer_id_ = buffer_id;
+  layer->buffer_format_ = format;
+  layer->buffer_width_ = width;
+  layer->buffer_height_ = height;
+  layer->buffer_usage_ = kLayerNormal;
+  layer->transform_ = kIdentity;
+  layer->blending_ = static_cast<uint32_t>(HWCBlending::kBlendingPremult);
+  layer->flags_ = kTraceLayerVisible;
+  if (changed)
+    layer->flags_ |= kTraceLayerContentChanged;
+
+  layer->display_frame_[0] = left;
+  layer->display_frame_[1] = top;
+  layer->display_frame_[2] = left + width;
+  layer->display_frame_[3] = top + height;
+  layer->source_crop_[2] = width;
+  layer->source_crop_[3] = height;
+  memcpy(layer->visible_rect_, layer->display_frame_,
+         sizeof(layer->visible_rect_));
+  layer->alpha_ = 0xff;
+}
+
+// Background and a window which don't change and a small layer on top
+// flipping between two buffers every frame, as when a video or an
+// animation plays over a static desktop.
+static bool WriteTrace(FILE *file) {
+  PresentTraceHeader header = {kPresentTraceMagic, kPresentTraceVersion};
+  if (fwrite(&header, sizeof(header), 1, file) != 1)
+    return false;
+
+  for (uint32_t i = 0; i < kTraceFrames; i++) {
+    PresentTraceFrame frame;
+    memset(&frame, 0, sizeof(frame));
+    frame.timestamp_ns_ = i * 16666667LL;
+    frame.display_width_ = kDisplayWidth;
+    frame.display_height_ = kDisplayHeight;
+    frame.num_layers_ = 3;
+    PresentTraceLayer layers[3];
+    FillLayer(&layers[0], 1, 1, DRM_FORMAT_XRGB8888, 0, 0, kDisplayWidth,
+              kDisplayHeight, i == 0);
+    FillLayer(&layers[1], 2, 2, DRM_FORMAT_ARGB8888, 200, 100, 800, 600,
+              i == 0);
+    FillLayer(&layers[2], 3, 3 + (i % 2), DRM_FORMAT_ARGB8888, 1200, 500,
+              256, 256, true);
+    if (fwrite(&frame, sizeof(frame), 1, file) != 1 ||
+        fwrite(layers, sizeof(PresentTraceLayer), 3, file) != 3)
+      return false;
+  }
+
+  return fflush(file) == 0;
+}
+
+int main() {
+  char trace_file[] = "/tmp/replayallocationtestXXXXXX";
+  int trace_fd = mkstemp(trace_file);
+  if (trace_fd < 0) {
+    printf("Failed to create trace file: %s\n", strerror(errno));
+    return 1;
+  }
+
+  FILE *file = fdopen(trace_fd, "wb");
+  bool written = file && WriteTrace(file);
+  if (file)
+    fclose(file);
+  else
+    close(trace_fd);
+
+  if (!written) {
+    printf("Failed to write trace file\n");
+    unlink(trace_file);
+    return 1;
+  }
+
+  int fd = open("/dev/dri/renderD128", O_RDWR | O_CLOEXEC);
+  if (fd < 0) {
+    printf("No GPU to replay on: %s\n", strerror(errno));
+    unlink(trace_file);
+    return kSkipped;
+  }
+
+  std::unique_ptr<NativeBufferHandler> buffer_handler(
+      NativeBufferHandler::CreateInstance(fd));
+  if (!buffer_handler) {
+    printf("Failed to create buffer handler\n");
+    unlink(trace_file);
+    close(fd);
+    return kSkipped;
+  }
+
+  std::unique_ptr<TraceReplayer> replayer(
+      new TraceReplayer(buffer_handler.get()));
+  bool loaded = replayer->Load(trace_file);
+  unlink(trace_file);
+  if (!loaded) {
+    printf("Failed to read back trace\n");
+    close(fd);
+    return 1;
+  }
+
+  std::unique_ptr<HeadlessDisplay> display(
+      new HeadlessDisplay(fd, kDisplayWidth, kDisplayHeight));
+  display->Initialize(buffer_handler.get());
+  display->Connect();
+
+  // The first pass creates layers, buffers and offscreen targets, the
+  // second one should only reuse them.
+  const size_t frames = replayer->GetFrames().size();
+  std::vector<HwcLayer *> source_layers;
+  source_layers.reserve(3);
+  uint64_t last_frame = 0;
+  uint32_t steady_frames = 0;
+  uint32_t failures = 0;
+  bool failed = false;
+  for (uint32_t loop = 0; loop < 2 && !failed; loop++) {
+    for (size_t index = 0; index < frames; index++) {
+      if (!replayer->PrepareFrame(index, &source_layers)) {
+        failed = true;
+        break;
+      }
+
+      int32_t retire_fence = -1;
+      uint64_t start = AllocationCount();
+      display->Present(source_layers, &retire_fence);
+      uint64_t allocations = AllocationCount() - start;
+      if (retire_fence > 0)
+        close(retire_fence);
+
+      for (HwcLayer *layer : source_layers) {
+        int32_t release_fence = layer->GetReleaseFence();
+        if (release_fence > 0)
+          close(release_fence);
+      }
+
+      HwcFrameTiming timing;
+      if (display->GetFrameTimings(&timing, 1) != 1 ||
+          timing.frame_ == last_frame)
+        continue;
+
+      last_frame = timing.frame_;
+      if (loop == 0 || timing.test_commits_ != 0 ||
+          timing.stage_ns_[kFrameStageComposition] != 0)
+        continue;
+
+      steady_frames++;
+      if (allocations == 0)
+        continue;
+
+      failures++;
+      printf("FAIL frame %llu: %llu allocations\n",
+             (unsigned long long)timing.frame_,
+             (unsigned long long)allocations);
+    }
+  }
+
+  display.reset(nullptr);
+  replayer.reset(nullptr);
+  buffer_handler.reset(nullptr);
+  close(fd);
+  if (failed) {
+    printf("Failed to set up layers\n");
+    return 1;
+  }
+
+  if (steady_frames == 0) {
+    printf("FAIL no frame reached steady state\n");
+    return 1;
+  }
+
+  if (failures) {
+    printf("%u of %u steady state frames allocated\n", failures,
+           steady_frames);
+    return 1;
+  }
+
+  printf("All %u steady state frames passed\n", steady_frames);
+  return 0;
+}
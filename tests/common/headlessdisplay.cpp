@@ -0,0 +1,84 @@
+/*
+// Copyright (c) 2018 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+#include "headlessdisplay.h"
+
+#include "displayqueue.h"
+
+namespace hwcomposer {
+
+HeadlessDisplay::HeadlessDisplay(uint32_t gpu_fd, uint32_t width,
+                                 uint32_t height)
+    : PhysicalDisplay(gpu_fd, 0) {
+  width_ = width;
+  height_ = height;
+  plane_handler_.SetDisplaySize(width, height);
+}
+
+HeadlessDisplay::~HeadlessDisplay() {
+}
+
+bool HeadlessDisplay::InitializeDisplay() {
+  return true;
+}
+
+void HeadlessDisplay::PowerOn() {
+}
+
+void HeadlessDisplay::UpdateDisplayConfig() {
+}
+
+void HeadlessDisplay::SetColorCorrection(struct gamma_colors /*gamma*/,
+                                         uint32_t /*contrast*/,
+                                         uint32_t /*brightness*/) const {
+}
+
+void HeadlessDisplay::SetColorTransformMatrix(
+    const float* /*color_transform_matrix*/,
+    HWCColorTransform /*color_transform_hint*/) const {
+}
+
+void HeadlessDisplay::Disable(
+    const DisplayPlaneStateList& /*composition_planes*/) {
+}
+
+bool HeadlessDisplay::Commit(
+    const DisplayPlaneStateList& /*composition_planes*/,
+    const DisplayPlaneStateList& /*previous_composition_planes*/,
+    bool /*disable_explicit_fence*/, int32_t* commit_fence) {
+  *commit_fence = -1;
+  commits_++;
+  return true;
+}
+
+bool HeadlessDisplay::TestCommit(
+    const std::vector<OverlayPlane>& commit_planes) const {
+  return plane_handler_.TestCommit(commit_planes);
+}
+
+bool HeadlessDisplay::CreateFrameBuffer(OverlayBuffer* buffer) const {
+  return plane_handler_.CreateFrameBuffer(buffer);
+}
+
+bool HeadlessDisplay::PopulatePlanes(
+    std::vector<std::unique_ptr<DisplayPlane>>& overlay_planes) {
+  return plane_handler_.PopulatePlanes(overlay_planes);
+}
+
+void HeadlessDisplay::NotifyClientsOfDisplayChangeStatus() {
+}
+
+}  // namespace hwcomposer
@@ -0,0 +1,79 @@
+/*
+// Copyright (c) 2018 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+#ifndef TESTS_COMMON_HEADLESSDISPLAY_H_
+#define TESTS_COMMON_HEADLESSDISPLAY_H_
+
+#include <stdint.h>
+
+#include <memory>
+#include <vector>
+
+#include "physicaldisplay.h"
+#include "simulatedplanehandler.h"
+
+namespace hwcomposer {
+
+// PhysicalDisplay which drives DisplayQueue without touching KMS.
+// Planes and test commits are handled by a SimulatedPlaneHandler and
+// every Commit succeeds, so validation and composition cost can be
+// measured on any machine with a GPU supported by the compositor.
+class HeadlessDisplay : public PhysicalDisplay {
+ public:
+  HeadlessDisplay(uint32_t gpu_fd, uint32_t width, uint32_t height);
+  ~HeadlessDisplay() override;
+
+  // Planes can only be configured before Connect is called.
+  SimulatedPlaneHandler& GetPlaneHandler() {
+    return plane_handler_;
+  }
+
+  bool InitializeDisplay() override;
+  void PowerOn() override;
+  void UpdateDisplayConfig() override;
+
+  void SetColorCorrection(struct gamma_colors gamma, uint32_t contrast,
+                          uint32_t brightness) const override;
+  void SetColorTransformMatrix(
+      const float* color_transform_matrix,
+      HWCColorTransform color_transform_hint) const override;
+
+  void Disable(const DisplayPlaneStateList& composition_planes) override;
+  bool Commit(const DisplayPlaneStateList& composition_planes,
+              const DisplayPlaneStateList& previous_composition_planes,
+              bool disable_explicit_fence, int32_t* commit_fence) override;
+
+  bool TestCommit(
+      const std::vector<OverlayPlane>& commit_planes) const override;
+
+  bool CreateFrameBuffer(OverlayBuffer* buffer) const override;
+
+  bool PopulatePlanes(
+      std::vector<std::unique_ptr<DisplayPlane>>& overlay_planes) override;
+
+  void NotifyClientsOfDisplayChangeStatus() override;
+
+  uint64_t GetCommitCount() const {
+    return commits_;
+  }
+
+ private:
+  SimulatedPlaneHandler plane_handler_;
+  uint64_t commits_ = 0;
+};
+
+}  // namespace hwcomposer
+#endif  // TESTS_COMMON_HEADLESSDISPLAY_H_
@@ -0,0 +1,136 @@
+/*
+// Copyright (c) 2018 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+#include "simulatedbufferhandler.h"
+
+#include <drm_fourcc.h>
+
+namespace hwcomposer {
+
+static uint32_t GetBytesPerPixel(uint32_t format) {
+  switch (format) {
+    case DRM_FORMAT_NV12:
+    case DRM_FORMAT_NV21:
+    case DRM_FORMAT_YUV420:
+    case DRM_FORMAT_YVU420:
+      return 1;
+    case DRM_FORMAT_YUYV:
+    case DRM_FORMAT_UYVY:
+    case DRM_FORMAT_RGB565:
+    case DRM_FORMAT_BGR565:
+      return 2;
+    default:
+      return 4;
+  }
+}
+
+static uint32_t GetPlanes(uint32_t format) {
+  switch (format) {
+    case DRM_FORMAT_NV12:
+    case DRM_FORMAT_NV21:
+      return 2;
+    case DRM_FORMAT_YUV420:
+    case DRM_FORMAT_YVU420:
+      return 3;
+    default:
+      return 1;
+  }
+}
+
+SimulatedBufferHandler::~SimulatedBufferHandler() {
+}
+
+bool SimulatedBufferHandler::CreateBuffer(uint32_t w, uint32_t h, int format,
+                                          HWCNativeHandle *handle,
+                                          uint32_t layer_type) const {
+  if (format == 0)
+    format = DRM_FORMAT_XRGB8888;
+
+  struct gbm_handle *temp = new struct gbm_handle();
+  temp->import_data.width = w;
+  temp->import_data.height = h;
+  temp->import_data.format = format;
+#if USE_MINIGBM
+  temp->import_data.fds[0] = next_fd_++;
+  temp->import_data.strides[0] = w * GetBytesPerPixel(format);
+#else
+  temp->import_data.fd = next_fd_++;
+  temp->import_data.stride = w * GetBytesPerPixel(format);
+#endif
+  temp->total_planes = GetPlanes(format);
+  temp->meta_data_.usage_ = static_cast<HWCLayerType>(layer_type);
+  *handle = temp;
+  return true;
+}
+
+bool SimulatedBufferHandler::ReleaseBuffer(HWCNativeHandle /*handle*/) const {
+  return true;
+}
+
+void SimulatedBufferHandler::DestroyHandle(HWCNativeHandle handle) const {
+  delete handle;
+}
+
+bool SimulatedBufferHandler::ImportBuffer(HWCNativeHandle handle) const {
+  HwcBuffer &meta_data = handle->meta_data_;
+  uint32_t format = handle->import_data.format;
+  meta_data.width_ = handle->import_data.width;
+  meta_data.height_ = handle->import_data.height;
+  meta_data.format_ = format;
+  meta_data.native_format_ = format;
+#if USE_MINIGBM
+  meta_data.prime_fd_ = handle->import_data.fds[0];
+#else
+  meta_data.prime_fd_ = handle->import_data.fd;
+#endif
+  uint32_t pitch = meta_data.width_ * GetBytesPerPixel(format);
+  for (uint32_t i = 0; i < 4; i++) {
+    bool valid = i < handle->total_planes;
+    meta_data.gem_handles_[i] = valid ? meta_data.prime_fd_ : 0;
+    meta_data.pitches_[i] = valid ? pitch : 0;
+    meta_data.offsets_[i] = valid ? i * pitch * meta_data.height_ : 0;
+  }
+
+  return true;
+}
+
+void SimulatedBufferHandler::CopyHandle(HWCNativeHandle source,
+                                        HWCNativeHandle *target) const {
+  struct gbm_handle *temp = new struct gbm_handle();
+  temp->import_data = source->import_data;
+  temp->total_planes = source->total_planes;
+  temp->meta_data_.usage_ = source->meta_data_.usage_;
+  *target = temp;
+}
+
+uint32_t SimulatedBufferHandler::GetTotalPlanes(HWCNativeHandle handle) const {
+  return handle->total_planes;
+}
+
+void *SimulatedBufferHandler::Map(HWCNativeHandle /*handle*/, uint32_t /*x*/,
+                                  uint32_t /*y*/, uint32_t /*width*/,
+                                  uint32_t /*height*/, uint32_t * /*stride*/,
+                                  void ** /*map_data*/,
+                                  size_t /*plane*/) const {
+  return NULL;
+}
+
+int32_t SimulatedBufferHandler::UnMap(HWCNativeHandle /*handle*/,
+                                      void * /*map_data*/) const {
+  return -1;
+}
+
+}  // namespace hwcomposer
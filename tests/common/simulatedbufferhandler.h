@@ -0,0 +1,53 @@
+/*
+// Copyright (c) 2018 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+#ifndef TESTS_COMMON_SIMULATEDBUFFERHANDLER_H_
+#define TESTS_COMMON_SIMULATEDBUFFERHANDLER_H_
+
+#include <nativebufferhandler.h>
+
+namespace hwcomposer {
+
+// NativeBufferHandler which hands out buffer descriptions without
+// any memory behind them. Good enough for exercising plane validation,
+// which only looks at buffer metadata, on machines without a GPU.
+class SimulatedBufferHandler : public NativeBufferHandler {
+ public:
+  SimulatedBufferHandler() = default;
+  ~SimulatedBufferHandler() override;
+
+  bool CreateBuffer(uint32_t w, uint32_t h, int format,
+                    HWCNativeHandle *handle = NULL,
+                    uint32_t layer_type = kLayerNormal) const override;
+  bool ReleaseBuffer(HWCNativeHandle handle) const override;
+  void DestroyHandle(HWCNativeHandle handle) const override;
+  bool ImportBuffer(HWCNativeHandle handle) const override;
+  void CopyHandle(HWCNativeHandle source,
+                  HWCNativeHandle *target) const override;
+  uint32_t GetTotalPlanes(HWCNativeHandle handle) const override;
+  void *Map(HWCNativeHandle handle, uint32_t x, uint32_t y, uint32_t width,
+            uint32_t height, uint32_t *stride, void **map_data,
+            size_t plane) const override;
+  int32_t UnMap(HWCNativeHandle handle, void *map_data) const override;
+
+ private:
+  // Stands in for dma-buf fds, so that every buffer is unique
+  // in ResourceManager's cache. Never passed to the kernel.
+  mutable int next_fd_ = 1 << 20;
+};
+
+}  // namespace hwcomposer
+#endif  // TESTS_COMMON_SIMULATEDBUFFERHANDLER_H_
@@ -0,0 +1,318 @@
+/*
+// Copyright (c) 2018 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+#include "simulatedplanehandler.h"
+
+#include <drm_fourcc.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#include <hwcdefs.h>
+#include <hwctrace.h>
+
+#include "overlaybuffer.h"
+#include "overlaylayer.h"
+
+namespace hwcomposer {
+
+static const uint32_t kPreferredFormats[] = {
+    DRM_FORMAT_XBGR8888, DRM_FORMAT_ABGR8888, DRM_FORMAT_XRGB8888,
+    DRM_FORMAT_ARGB8888};
+
+static const uint32_t kPreferredVideoFormats[] = {
+    DRM_FORMAT_NV12, DRM_FORMAT_YUYV, DRM_FORMAT_YUV420};
+
+SimulatedPlane::SimulatedPlane(uint32_t id, const SimulatedPlaneConfig& config)
+    : id_(id), config_(config) {
+  preferred_format_ = DRM_FORMAT_XBGR8888;
+  preferred_video_format_ = DRM_FORMAT_NV12;
+  if (config_.formats_.empty())
+    return;
+
+  preferred_format_ = config_.formats_.front();
+  for (uint32_t format : kPreferredFormats) {
+    if (IsSupportedFormat(format)) {
+      preferred_format_ = format;
+      break;
+    }
+  }
+
+  preferred_video_format_ = preferred_format_;
+  for (uint32_t format : kPreferredVideoFormats) {
+    if (IsSupportedFormat(format)) {
+      preferred_video_format_ = format;
+      break;
+    }
+  }
+}
+
+bool SimulatedPlane::ValidateLayer(const OverlayLayer* layer) {
+  uint8_t alpha = 0xFF;
+  if (layer->GetBlending() == HWCBlending::kBlendingPremult)
+    alpha = layer->GetAlpha();
+
+  if (!config_.alpha_ && alpha != 0 && alpha != 0xFF)
+    return false;
+
+  if (!config_.rotation_ && layer->GetPlaneTransform() != kIdentity)
+    return false;
+
+  return IsSupportedFormat(layer->GetBuffer()->GetFormat());
+}
+
+bool SimulatedPlane::IsSupportedFormat(uint32_t format) {
+  if (config_.formats_.empty())
+    return true;
+
+  for (uint32_t supported : config_.formats_) {
+    if (supported == format)
+      return true;
+  }
+
+  return false;
+}
+
+uint32_t SimulatedPlane::GetPreferredVideoFormat() const {
+  return preferred_video_format_;
+}
+
+uint32_t SimulatedPlane::GetPreferredFormat() const {
+  return preferred_format_;
+}
+
+void SimulatedPlane::Dump() const {
+  DUMPTRACE("Simulated Plane ID: %d Formats: %zu Universal: %d Scaling: %d",
+            id_, config_.formats_.size(), config_.universal_,
+            config_.scaling_);
+}
+
+static bool ValidateScalingRatio(uint32_t source, uint32_t destination,
+                                 float max_upscale, float max_downscale) {
+  if (source == 0 || destination == 0)
+    return false;
+
+  if (destination > source) {
+    return max_upscale == 0 ||
+           static_cast<float>(destination) / source <= max_upscale;
+  }
+
+  return max_downscale == 0 ||
+         static_cast<float>(source) / destination <= max_downscale;
+}
+
+bool SimulatedPlane::ValidateScaling(const OverlayLayer* layer,
+                                     bool* is_scaled) const {
+  uint32_t source_width = layer->GetSourceCropWidth();
+  uint32_t source_height = layer->GetSourceCropHeight();
+  if (layer->GetPlaneTransform() & (kTransform90 | kTransform270))
+    std::swap(source_width, source_height);
+
+  uint32_t display_width = layer->GetDisplayFrameWidth();
+  uint32_t display_height = layer->GetDisplayFrameHeight();
+  *is_scaled =
+      source_width != display_width || source_height != display_height;
+  if (!*is_scaled)
+    return true;
+
+  if (!config_.scaling_)
+    return false;
+
+  return ValidateScalingRatio(source_width, display_width,
+                              config_.max_upscale_, config_.max_downscale_) &&
+         ValidateScalingRatio(source_height, display_height,
+                              config_.max_upscale_, config_.max_downscale_);
+}
+
+bool SimulatedPlane::GetScalingLimits(PlaneScalingLimits* limits) const {
+  limits->scaling_ = config_.scaling_;
+  limits->max_upscale_ = config_.max_upscale_;
+  limits->max_downscale_ = config_.max_downscale_;
+  return true;
+}
+
+SimulatedPlaneHandler::SimulatedPlaneHandler() {
+  planes_.resize(kDefaultSimulatedPlanes);
+}
+
+SimulatedPlaneHandler::~SimulatedPlaneHandler() {
+}
+
+static uint32_t ParseFourcc(const std::string& value) {
+  if (value.size() != 4)
+    return 0;
+
+  return fourcc_code(value[0], value[1], value[2], value[3]);
+}
+
+static bool ParsePlane(const std::string& value, SimulatedPlaneConfig* plane) {
+  std::istringstream i_value(value);
+  std::string attribute;
+  while (std::getline(i_value, attribute, ';')) {
+    std::istringstream i_attribute(attribute);
+    std::string name;
+    std::string content;
+    std::getline(i_attribute, name, ':');
+    std::getline(i_attribute, content);
+    if (name.empty() || content.empty())
+      continue;
+
+    if (!name.compare("formats")) {
+      std::istringstream i_formats(content);
+      std::string format_str;
+      while (std::getline(i_formats, format_str, ',')) {
+        uint32_t format = ParseFourcc(format_str);
+        if (!format) {
+          ETRACE("Invalid format %s in plane config.", format_str.c_str());
+          return false;
+        }
+
+        plane->formats_.emplace_back(format);
+      }
+    } else if (!name.compare("universal")) {
+      plane->universal_ = atoi(content.c_str()) != 0;
+    } else if (!name.compare("rotation")) {
+      plane->rotation_ = atoi(content.c_str()) != 0;
+    } else if (!name.compare("alpha")) {
+      plane->alpha_ = atoi(content.c_str()) != 0;
+    } else if (!name.compare("scaling")) {
+      plane->scaling_ = atoi(content.c_str()) != 0;
+    } else if (!name.compare("max_upscale")) {
+      plane->max_upscale_ = atof(content.c_str());
+    } else if (!name.compare("max_downscale")) {
+      plane->max_downscale_ = atof(content.c_str());
+    } else {
+      ETRACE("Unknown plane attribute %s.", name.c_str());
+      return false;
+    }
+  }
+
+  return true;
+}
+
+bool SimulatedPlaneHandler::LoadConfig(const char* file) {
+  std::ifstream fin(file);
+  if (!fin.is_open()) {
+    ETRACE("Failed to open plane config %s.", file);
+    return false;
+  }
+
+  std::vector<SimulatedPlaneConfig> planes;
+  std::string key_plane("PLANE");
+  std::string key_max_scaled_planes("MAX_SCALED_PLANES");
+  std::string key_max_bandwidth("MAX_BANDWIDTH");
+  std::string cfg_line;
+  while (std::getline(fin, cfg_line)) {
+    std::istringstream i_line(cfg_line);
+    std::string key;
+    // Skip comments
+    if (cfg_line.empty() || cfg_line[0] == '#' ||
+        !std::getline(i_line, key, '='))
+      continue;
+
+    std::string content;
+    std::getline(i_line, content);
+    size_t begin = content.find('"');
+    size_t end = content.rfind('"');
+    if (begin == std::string::npos || end == begin)
+      continue;
+
+    std::string value = content.substr(begin + 1, end - begin - 1);
+    if (!key.compare(key_plane)) {
+      planes.emplace_back();
+      if (!ParsePlane(value, &planes.back()))
+        return false;
+    } else if (!key.compare(key_max_scaled_planes)) {
+      max_scaled_planes_ = atoi(value.c_str());
+    } else if (!key.compare(key_max_bandwidth)) {
+      max_bandwidth_ = atof(value.c_str());
+    }
+  }
+
+  if (!planes.empty())
+    planes_.swap(planes);
+
+  return true;
+}
+
+void SimulatedPlaneHandler::SetDisplaySize(uint32_t width, uint32_t height) {
+  display_width_ = width;
+  display_height_ = height;
+}
+
+bool SimulatedPlaneHandler::PopulatePlanes(
+    std::vector<std::unique_ptr<DisplayPlane>>& overlay_planes) {
+  uint32_t id = 1;
+  for (const SimulatedPlaneConfig& config : planes_) {
+    overlay_planes.emplace_back(new SimulatedPlane(id++, config));
+  }
+
+  return !overlay_planes.empty();
+}
+
+bool SimulatedPlaneHandler::TestCommit(
+    const std::vector<OverlayPlane>& commit_planes) const {
+  test_commits_++;
+  if (CheckCommit(commit_planes))
+    return true;
+
+  failed_test_commits_++;
+  return false;
+}
+
+bool SimulatedPlaneHandler::CheckCommit(
+    const std::vector<OverlayPlane>& commit_planes) const {
+  uint32_t scaled_planes = 0;
+  uint64_t fetched_pixels = 0;
+  for (const OverlayPlane& commit_plane : commit_planes) {
+    SimulatedPlane* plane = static_cast<SimulatedPlane*>(commit_plane.plane);
+    const OverlayLayer* layer = commit_plane.layer;
+    if (!plane->ValidateLayer(layer))
+      return false;
+
+    bool is_scaled = false;
+    if (!plane->ValidateScaling(layer, &is_scaled))
+      return false;
+
+    if (is_scaled)
+      scaled_planes++;
+
+    fetched_pixels += static_cast<uint64_t>(layer->GetSourceCropWidth()) *
+                      layer->GetSourceCropHeight();
+  }
+
+  if (max_scaled_planes_ && scaled_planes > max_scaled_planes_)
+    return false;
+
+  uint64_t display_pixels =
+      static_cast<uint64_t>(display_width_) * display_height_;
+  if (max_bandwidth_ > 0 && display_pixels &&
+      fetched_pixels > max_bandwidth_ * display_pixels)
+    return false;
+
+  return true;
+}
+
+bool SimulatedPlaneHandler::CreateFrameBuffer(
+    OverlayBuffer* /*buffer*/) const {
+  // Any buffer can be scanned out, nothing to create.
+  return true;
+}
+
+}  // namespace hwcomposer
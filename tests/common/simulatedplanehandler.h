@@ -0,0 +1,150 @@
+/*
+// Copyright (c) 2018 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+#ifndef TESTS_COMMON_SIMULATEDPLANEHANDLER_H_
+#define TESTS_COMMON_SIMULATEDPLANEHANDLER_H_
+
+#include <stdint.h>
+
+#include <memory>
+#include <vector>
+
+#include "displayplane.h"
+#include "displayplanehandler.h"
+
+namespace hwcomposer {
+
+// Capabilities of a simulated plane. Defaults accept everything.
+struct SimulatedPlaneConfig {
+  // Supported DRM formats, empty if any format can be scanned out.
+  std::vector<uint32_t> formats_;
+  bool universal_ = true;
+  bool rotation_ = true;
+  bool alpha_ = true;
+  bool scaling_ = true;
+  // Limits of scaling ratio in each direction. Zero means no limit.
+  float max_upscale_ = 0;
+  float max_downscale_ = 0;
+};
+
+class SimulatedPlane : public DisplayPlane {
+ public:
+  SimulatedPlane(uint32_t id, const SimulatedPlaneConfig& config);
+
+  uint32_t id() const override {
+    return id_;
+  }
+
+  bool ValidateLayer(const OverlayLayer* layer) override;
+
+  bool IsSupportedFormat(uint32_t format) override;
+
+  uint32_t GetPreferredVideoFormat() const override;
+
+  uint32_t GetPreferredFormat() const override;
+
+  void SetInUse(bool in_use) override {
+    in_use_ = in_use;
+  }
+
+  bool InUse() const override {
+    return in_use_;
+  }
+
+  bool IsUniversal() override {
+    return config_.universal_;
+  }
+
+  bool GetScalingLimits(PlaneScalingLimits* limits) const override;
+
+  void Dump() const override;
+
+  // Returns true if layer can be scanned out with its current scaling
+  // ratio. is_scaled is set if the plane scaler is needed.
+  bool ValidateScaling(const OverlayLayer* layer, bool* is_scaled) const;
+
+ private:
+  uint32_t id_;
+  SimulatedPlaneConfig config_;
+  uint32_t preferred_format_;
+  uint32_t preferred_video_format_;
+  bool in_use_ = false;
+};
+
+// DisplayPlaneHandler standing in for KMS, with planes described in a
+// config file using hwc_display.ini syntax. Planes are listed bottom to
+// top, one PLANE key each, with ';' separated attributes:
+//
+// PLANE="formats:XR24,AR24,NV12;scaling:1;max_upscale:8;max_downscale:2"
+// MAX_SCALED_PLANES="2"
+// MAX_BANDWIDTH="3.5"
+//
+// Other plane attributes are universal, rotation and alpha, set to 0 or
+// 1. Formats are DRM fourcc codes. MAX_SCALED_PLANES limits how many planes
+// may use scalers in a commit. MAX_BANDWIDTH limits pixels fetched by a
+// commit, as a multiple of display size. Missing attributes and limits
+// accept everything. Without a config, display has kDefaultSimulatedPlanes
+// planes which accept everything.
+static const uint32_t kDefaultSimulatedPlanes = 4;
+
+class SimulatedPlaneHandler : public DisplayPlaneHandler {
+ public:
+  SimulatedPlaneHandler();
+  ~SimulatedPlaneHandler() override;
+
+  bool LoadConfig(const char* file);
+
+  void SetDisplaySize(uint32_t width, uint32_t height);
+
+  bool PopulatePlanes(
+      std::vector<std::unique_ptr<DisplayPlane>>& overlay_planes) override;
+
+  bool TestCommit(
+      const std::vector<OverlayPlane>& commit_planes) const override;
+
+  bool CreateFrameBuffer(OverlayBuffer* buffer) const override;
+
+  uint32_t GetMaxScaledPlanes() const override {
+    return max_scaled_planes_;
+  }
+
+  uint64_t GetTestCommitCount() const {
+    return test_commits_;
+  }
+
+  uint64_t GetFailedTestCommitCount() const {
+    return failed_test_commits_;
+  }
+
+  void ResetCounters() {
+    test_commits_ = 0;
+    failed_test_commits_ = 0;
+  }
+
+ private:
+  bool CheckCommit(const std::vector<OverlayPlane>& commit_planes) const;
+
+  std::vector<SimulatedPlaneConfig> planes_;
+  uint32_t max_scaled_planes_ = 0;
+  float max_bandwidth_ = 0;
+  uint32_t display_width_ = 0;
+  uint32_t display_height_ = 0;
+  mutable uint64_t test_commits_ = 0;
+  mutable uint64_t failed_test_commits_ = 0;
+};
+
+}  // namespace hwcomposer
+#endif  // TESTS_COMMON_SIMULATEDPLANEHANDLER_H_
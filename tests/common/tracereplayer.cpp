@@ -0,0 +1,145 @@
+/*
+// Copyright (c) 2018 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+
+#include "tracereplayer.h"
+
+#include <stdio.h>
+
+#include <nativebufferhandler.h>
+
+namespace hwcomposer {
+
+TraceReplayer::TraceReplayer(NativeBufferHandler* buffer_handler)
+    : buffer_handler_(buffer_handler) {
+}
+
+TraceReplayer::~TraceReplayer() {
+  layers_.clear();
+  for (auto& buffer : buffers_) {
+    if (!buffer.second.handle)
+      continue;
+
+    buffer_handler_->ReleaseBuffer(buffer.second.handle);
+    buffer_handler_->DestroyHandle(buffer.second.handle);
+  }
+}
+
+bool TraceReplayer::Load(const char* file) {
+  PresentTraceReader reader;
+  if (!reader.Open(file))
+    return false;
+
+  frames_.clear();
+  TraceFrame frame;
+  while (reader.ReadFrame(&frame.frame, &frame.layers, &frame.damage)) {
+    frames_.emplace_back(frame);
+  }
+
+  return !frames_.empty();
+}
+
+bool TraceReplayer::PrepareBuffer(const PresentTraceLayer& entry,
+                                  ReplayBuffer* buffer) {
+  if (buffer->handle && buffer->format == entry.buffer_format_ &&
+      buffer->width == entry.buffer_width_ &&
+      buffer->height == entry.buffer_height_ &&
+      buffer->usage == entry.buffer_usage_)
+    return true;
+
+  if (buffer->handle) {
+    buffer_handler_->ReleaseBuffer(buffer->handle);
+    buffer_handler_->DestroyHandle(buffer->handle);
+    buffer->handle = NULL;
+  }
+
+  if (!buffer_handler_->CreateBuffer(entry.buffer_width_,
+                                     entry.buffer_height_,
+                                     entry.buffer_format_, &buffer->handle,
+                                     entry.buffer_usage_) ||
+      !buffer_handler_->ImportBuffer(buffer->handle)) {
+    fprintf(stderr, "Failed to create %ux%u buffer of format %x\n",
+            entry.buffer_width_, entry.buffer_height_, entry.buffer_format_);
+    return false;
+  }
+
+  buffer->format = entry.buffer_format_;
+  buffer->width = entry.buffer_width_;
+  buffer->height = entry.buffer_height_;
+  buffer->usage = entry.buffer_usage_;
+  return true;
+}
+
+bool TraceReplayer::PrepareFrame(size_t index,
+                                 std::vector<HwcLayer*>* source_layers) {
+  const TraceFrame& trace = frames_.at(index);
+  source_layers->clear();
+  for (size_t i = 0; i < trace.layers.size(); i++) {
+    const PresentTraceLayer& entry = trace.layers.at(i);
+    std::unique_ptr<HwcLayer>& layer = layers_[entry.layer_id_];
+    if (!layer) {
+      layer.reset(new HwcLayer());
+      layer->SetLayerId(entry.layer_id_);
+    }
+
+    HwcRect<int> display_frame(
+        entry.display_frame_[0], entry.display_frame_[1],
+        entry.display_frame_[2], entry.display_frame_[3]);
+    layer->SetDisplayFrame(display_frame, 0);
+    layer->SetSourceCrop(HwcRect<float>(
+        entry.source_crop_[0], entry.source_crop_[1], entry.source_crop_[2],
+        entry.source_crop_[3]));
+    layer->SetTransform(entry.transform_);
+    layer->SetAlpha(entry.alpha_);
+    layer->SetBlending(static_cast<HWCBlending>(entry.blending_));
+    layer->SetLayerZOrder(i);
+    layer->SetAcquireFence(-1);
+
+    // Layers without a known buffer were not shown when recorded.
+    bool visible = (entry.flags_ & kTraceLayerVisible) &&
+                   entry.buffer_id_ != 0 && entry.buffer_format_ != 0;
+    region_.clear();
+    if (visible) {
+      region_.emplace_back(entry.visible_rect_[0], entry.visible_rect_[1],
+                           entry.visible_rect_[2], entry.visible_rect_[3]);
+    } else {
+      region_.emplace_back(0, 0, 0, 0);
+    }
+
+    layer->SetVisibleRegion(region_);
+    if (visible) {
+      ReplayBuffer& buffer = buffers_[entry.buffer_id_];
+      if (!PrepareBuffer(entry, &buffer))
+        return false;
+
+      layer->SetNativeHandle(buffer.handle);
+    }
+
+    if (!(entry.flags_ & kTraceLayerContentChanged)) {
+      region_.clear();
+      region_.emplace_back(0, 0, 0, 0);
+      layer->SetSurfaceDamage(region_);
+    } else {
+      layer->SetSurfaceDamage(trace.damage.at(i));
+    }
+
+    source_layers->emplace_back(layer.get());
+  }
+
+  return true;
+}
+
+}  // namespace hwcomposer
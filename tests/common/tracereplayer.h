@@ -0,0 +1,85 @@
+/*
+// Copyright (c) 2018 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+
+#ifndef TESTS_COMMON_TRACEREPLAYER_H_
+#define TESTS_COMMON_TRACEREPLAYER_H_
+
+#include <stdint.h>
+
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include <hwcdefs.h>
+#include <hwclayer.h>
+#include <platformdefines.h>
+
+#include "presenttrace.h"
+
+namespace hwcomposer {
+
+class NativeBufferHandler;
+
+struct TraceFrame {
+  PresentTraceFrame frame;
+  std::vector<PresentTraceLayer> layers;
+  std::vector<HwcRegion> damage;
+};
+
+// Turns frames of a trace recorded with PRESENT_TRACE back into
+// HwcLayers. Layers and buffers are created the first time a frame
+// uses them and reused afterwards, so replaying a frame again only
+// updates existing layers.
+class TraceReplayer {
+ public:
+  explicit TraceReplayer(NativeBufferHandler* buffer_handler);
+  ~TraceReplayer();
+
+  TraceReplayer(const TraceReplayer& rhs) = delete;
+  TraceReplayer& operator=(const TraceReplayer& rhs) = delete;
+
+  bool Load(const char* file);
+
+  const std::vector<TraceFrame>& GetFrames() const {
+    return frames_;
+  }
+
+  // Sets up layers of frame at index and returns them in z order.
+  // Layers stay owned by the replayer and must not be used after it
+  // is destroyed.
+  bool PrepareFrame(size_t index, std::vector<HwcLayer*>* source_layers);
+
+ private:
+  struct ReplayBuffer {
+    HWCNativeHandle handle = NULL;
+    uint32_t format = 0;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint32_t usage = 0;
+  };
+
+  bool PrepareBuffer(const PresentTraceLayer& entry, ReplayBuffer* buffer);
+
+  NativeBufferHandler* buffer_handler_;
+  std::vector<TraceFrame> frames_;
+  std::unordered_map<uint64_t, std::unique_ptr<HwcLayer>> layers_;
+  std::unordered_map<uint32_t, ReplayBuffer> buffers_;
+  HwcRegion region_;
+};
+
+}  // namespace hwcomposer
+#endif  // TESTS_COMMON_TRACEREPLAYER_H_
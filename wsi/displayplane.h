@@ -20,10 +20,30 @@
 #include <stdlib.h>
 #include <stdint.h>
 
+#include <vector>
+
 namespace hwcomposer {
 
 struct OverlayLayer;
 
+// What the scalers a plane can use are capable of.
+struct PlaneScalingLimits {
+  bool scaling_ = false;
+  // Largest factor by which source can be enlarged or shrunk in
+  // each direction. Zero means no limit.
+  float max_upscale_ = 0;
+  float max_downscale_ = 0;
+  // Limits of source and destination width and height while
+  // scaling. Zero means no limit.
+  uint32_t min_size_ = 0;
+  uint32_t max_size_ = 0;
+  // Can scale while rotating by 90 or 270 degrees.
+  bool rotated_scaling_ = true;
+  // Formats which can't be scaled, even if the plane can scan
+  // them out.
+  std::vector<uint32_t> unscalable_formats_;
+};
+
 class DisplayPlane {
  public:
   virtual ~DisplayPlane() {
@@ -59,6 +79,25 @@ class DisplayPlane {
    */
   virtual bool IsUniversal() = 0;
 
+  /**
+   * API for querying limits of scaling done by this plane.
+   * Returns false if they are unknown, in which case only
+   * test commits can tell if scaling works.
+   */
+  virtual bool GetScalingLimits(PlaneScalingLimits* /*limits*/) const {
+    return false;
+  }
+
+  /**
+   * API for querying layout modifiers this plane can scan
+   * out format with. Returns false if the plane doesn't
+   * report any, only implicit layouts should be used then.
+   */
+  virtual bool GetFormatModifiers(
+      uint32_t /*format*/, std::vector<uint64_t>* /*modifiers*/) const {
+    return false;
+  }
+
   virtual void Dump() const = 0;
 };
 
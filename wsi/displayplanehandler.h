@@ -17,9 +17,13 @@
 #ifndef WSI_DISPLAYPLANEHANDLER_H_
 #define WSI_DISPLAYPLANEHANDLER_H_
 
+#include <memory>
+#include <vector>
+
 namespace hwcomposer {
 
 class DisplayPlane;
+class OverlayBuffer;
 struct OverlayLayer;
 
 struct OverlayPlane {
@@ -41,6 +45,16 @@ class DisplayPlaneHandler {
 
   virtual bool TestCommit(
       const std::vector<OverlayPlane>& commit_planes) const = 0;
+
+  // Makes sure buffer can be scanned out by planes of this
+  // handler, creating a framebuffer for it if needed.
+  virtual bool CreateFrameBuffer(OverlayBuffer* buffer) const = 0;
+
+  // Number of planes which can use a scaler in the same commit,
+  // 0 if unknown.
+  virtual uint32_t GetMaxScaledPlanes() const {
+    return 0;
+  }
 };
 
 }  // namespace hwcomposer
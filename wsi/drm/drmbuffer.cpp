@@ -73,6 +73,11 @@ void DrmBuffer::Initialize(const HwcBuffer& bo) {
   }
 
   total_planes_ = GetTotalPlanesForFormat(format_);
+  buffer_planes_ = total_planes_;
+  modifier_ = bo.modifier_;
+  has_modifier_ = bo.has_modifier_;
+  if (has_modifier_ && bo.total_planes_ > buffer_planes_)
+    buffer_planes_ = bo.total_planes_;
 }
 
 void DrmBuffer::InitializeFromNativeHandle(HWCNativeHandle handle,
@@ -132,6 +137,33 @@ const ResourceHandle& DrmBuffer::GetGpuResource(GpuDisplay egl_display,
             egl_display, EGL_NO_CONTEXT, EGL_LINUX_DMA_BUF_EXT,
             static_cast<EGLClientBuffer>(nullptr), attr_list_yv12);
       }
+#ifdef EGL_DMA_BUF_PLANE0_MODIFIER_LO_EXT
+    } else if (has_modifier_) {
+      EGLint modifier_lo = static_cast<EGLint>(modifier_ & 0xffffffff);
+      EGLint modifier_hi = static_cast<EGLint>(modifier_ >> 32);
+      // Auxiliary plane of compressed layouts follows the main one,
+      // the list ends there for other layouts.
+      EGLint aux_plane = buffer_planes_ > 1 ? EGL_DMA_BUF_PLANE1_FD_EXT
+                                            : EGL_NONE;
+      const EGLint attr_list_modifier[] = {
+          EGL_WIDTH,                          static_cast<EGLint>(width_),
+          EGL_HEIGHT,                         static_cast<EGLint>(height_),
+          EGL_LINUX_DRM_FOURCC_EXT,           static_cast<EGLint>(format_),
+          EGL_DMA_BUF_PLANE0_FD_EXT,          static_cast<EGLint>(prime_fd_),
+          EGL_DMA_BUF_PLANE0_PITCH_EXT,       static_cast<EGLint>(pitches_[0]),
+          EGL_DMA_BUF_PLANE0_OFFSET_EXT,      static_cast<EGLint>(offsets_[0]),
+          EGL_DMA_BUF_PLANE0_MODIFIER_LO_EXT, modifier_lo,
+          EGL_DMA_BUF_PLANE0_MODIFIER_HI_EXT, modifier_hi,
+          aux_plane,                          static_cast<EGLint>(prime_fd_),
+          EGL_DMA_BUF_PLANE1_PITCH_EXT,       static_cast<EGLint>(pitches_[1]),
+          EGL_DMA_BUF_PLANE1_OFFSET_EXT,      static_cast<EGLint>(offsets_[1]),
+          EGL_DMA_BUF_PLANE1_MODIFIER_LO_EXT, modifier_lo,
+          EGL_DMA_BUF_PLANE1_MODIFIER_HI_EXT, modifier_hi,
+          EGL_NONE,                           0};
+      image = eglCreateImageKHR(
+          egl_display, EGL_NO_CONTEXT, EGL_LINUX_DMA_BUF_EXT,
+          static_cast<EGLClientBuffer>(nullptr), attr_list_modifier);
+#endif
     } else {
       const EGLint attr_list[] = {
           EGL_WIDTH,                     static_cast<EGLint>(width_),
@@ -292,8 +324,24 @@ bool DrmBuffer::CreateFrameBuffer(uint32_t gpu_fd) {
   image_.drm_fd_ = 0;
   media_image_.drm_fd_ = 0;
 
-  int ret = drmModeAddFB2(gpu_fd, width_, height_, frame_buffer_format_,
-                          gem_handles_, pitches_, offsets_, &image_.drm_fd_, 0);
+  int ret = 0;
+#ifdef DRM_MODE_FB_MODIFIERS
+  if (has_modifier_) {
+    uint64_t modifiers[4] = {0, 0, 0, 0};
+    for (uint32_t i = 0; i < buffer_planes_ && i < 4; i++)
+      modifiers[i] = modifier_;
+
+    ret = drmModeAddFB2WithModifiers(
+        gpu_fd, width_, height_, frame_buffer_format_, gem_handles_, pitches_,
+        offsets_, modifiers, &image_.drm_fd_, DRM_MODE_FB_MODIFIERS);
+  } else {
+    ret = drmModeAddFB2(gpu_fd, width_, height_, frame_buffer_format_,
+                        gem_handles_, pitches_, offsets_, &image_.drm_fd_, 0);
+  }
+#else
+  ret = drmModeAddFB2(gpu_fd, width_, height_, frame_buffer_format_,
+                      gem_handles_, pitches_, offsets_, &image_.drm_fd_, 0);
+#endif
 
   if (ret) {
     ETRACE("drmModeAddFB2 error (%dx%d, %c%c%c%c, handle %d pitch %d) (%s)",
@@ -64,6 +64,11 @@ class DrmBuffer : public OverlayBuffer {
     return total_planes_;
   }
 
+  bool GetModifier(uint64_t* modifier) const override {
+    *modifier = modifier_;
+    return has_modifier_;
+  }
+
   const uint32_t* GetPitches() const override {
     return pitches_;
   }
@@ -97,6 +102,10 @@ class DrmBuffer : public OverlayBuffer {
   uint32_t prime_fd_ = 0;
   HWCLayerType usage_ = kLayerNormal;
   uint32_t total_planes_ = 0;
+  // Memory planes, compressed layouts add auxiliary ones.
+  uint32_t buffer_planes_ = 0;
+  uint64_t modifier_ = 0;
+  bool has_modifier_ = false;
   uint32_t previous_width_ = 0;   // For Media usage.
   uint32_t previous_height_ = 0;  // For Media usage.
   ResourceManager* resource_manager_ = 0;
@@ -18,6 +18,7 @@
 
 #include <cmath>
 #include <set>
+#include <drm_fourcc.h>
 
 #include <hwcdefs.h>
 #include <hwclayer.h>
@@ -273,24 +274,31 @@ bool DrmDisplay::Commit(
     const DisplayPlaneStateList &composition_planes,
     const DisplayPlaneStateList &previous_composition_planes,
     bool disable_explicit_fence, int32_t *commit_fence) {
-  // Do the actual commit.
-  ScopedDrmAtomicReqPtr pset(drmModeAtomicAlloc());
+  // Do the actual commit. Property set is kept around and only rewound
+  // here, to avoid allocating a new one every frame.
+  if (commit_pset_) {
+    drmModeAtomicSetCursor(commit_pset_.get(), 0);
+  } else {
+    commit_pset_.reset(drmModeAtomicAlloc());
+  }
 
-  if (!pset) {
+  if (!commit_pset_) {
     ETRACE("Failed to allocate property set %d", -ENOMEM);
     return false;
   }
 
+  drmModeAtomicReqPtr pset = commit_pset_.get();
+
   if (display_state_ & kNeedsModeset) {
-    if (!ApplyPendingModeset(pset.get())) {
+    if (!ApplyPendingModeset(pset)) {
       ETRACE("Failed to Modeset.");
       return false;
     }
   } else if (!disable_explicit_fence && out_fence_ptr_prop_) {
-    GetFence(pset.get(), commit_fence);
+    GetFence(pset, commit_fence);
   }
 
-  if (!CommitFrame(composition_planes, previous_composition_planes, pset.get(),
+  if (!CommitFrame(composition_planes, previous_composition_planes, pset,
                    flags_)) {
     ETRACE("Failed to Commit layers.");
     return false;
@@ -307,6 +315,56 @@ bool DrmDisplay::Commit(
   return true;
 }
 
+bool DrmDisplay::CommitPlanePosition(const DisplayPlane *plane, int32_t x,
+                                     int32_t y, int32_t *commit_fence) {
+  *commit_fence = -1;
+  // A modeset still has to go through a full commit.
+  if (display_state_ & kNeedsModeset)
+    return false;
+
+  // Legacy cursor updates are applied right away, even while a flip is
+  // still pending, where an atomic commit would fail with EBUSY.
+  const DrmPlane *drm_plane = static_cast<const DrmPlane *>(plane);
+  if (drm_plane->type() == DRM_PLANE_TYPE_CURSOR) {
+    int ret = drmModeMoveCursor(gpu_fd_, crtc_id_, x, y);
+    if (ret) {
+      IDISPLAYMANAGERTRACE("Failed to move cursor ret=%s\n", PRINTERROR());
+      return false;
+    }
+
+    return true;
+  }
+
+  if (position_pset_) {
+    drmModeAtomicSetCursor(position_pset_.get(), 0);
+  } else {
+    position_pset_.reset(drmModeAtomicAlloc());
+  }
+
+  if (!position_pset_) {
+    ETRACE("Failed to allocate property set %d", -ENOMEM);
+    return false;
+  }
+
+  drmModeAtomicReqPtr pset = position_pset_.get();
+  if (out_fence_ptr_prop_)
+    GetFence(pset, commit_fence);
+
+  if (!drm_plane->UpdatePosition(pset, x, y))
+    return false;
+
+  // Nothing else changes, so never block or allow a modeset here. This
+  // fails if a flip is still pending.
+  int ret = drmModeAtomicCommit(gpu_fd_, pset, DRM_MODE_ATOMIC_NONBLOCK, NULL);
+  if (ret) {
+    IDISPLAYMANAGERTRACE("Failed to move plane ret=%s\n", PRINTERROR());
+    *commit_fence = -1;
+    return false;
+  }
+
+  return true;
+}
+
 bool DrmDisplay::CommitFrame(
     const DisplayPlaneStateList &comp_planes,
     const DisplayPlaneStateList &previous_composition_planes,
@@ -646,6 +704,80 @@ void DrmDisplay::Disable(const DisplayPlaneStateList &composition_planes) {
                               DRM_MODE_DPMS_OFF);
 }
 
+// Scaling limits known for a display engine. Anything depending on
+// the mode is left to test commits, as is hardware not listed here.
+struct PlatformScalingLimits {
+  // Matches PCI device ids for which (id & device_mask_) == device_id_.
+  uint16_t device_mask_;
+  uint16_t device_id_;
+  // Planes which can use a scaler in the same commit, per pipe.
+  uint32_t max_scaled_planes_[3];
+  float max_downscale_;
+  uint32_t min_size_;
+  bool cursor_scaling_;
+  bool c8_scaling_;
+};
+
+static const PlatformScalingLimits kPlatformScalingLimits[] = {
+    // Gen9 (Skylake, Broxton, Kabylake, Coffeelake, Cometlake) has two
+    // scalers on pipes A and B but only one on pipe C, and shrinks
+    // sources by less than 3x only.
+    {0xff00, 0x1900, {2, 2, 1}, 2.99f, 8, false, false},
+    {0xffff, 0x0a84, {2, 2, 1}, 2.99f, 8, false, false},
+    {0xffff, 0x1a84, {2, 2, 1}, 2.99f, 8, false, false},
+    {0xffff, 0x1a85, {2, 2, 1}, 2.99f, 8, false, false},
+    {0xffff, 0x5a84, {2, 2, 1}, 2.99f, 8, false, false},
+    {0xffff, 0x5a85, {2, 2, 1}, 2.99f, 8, false, false},
+    {0xff00, 0x5900, {2, 2, 1}, 2.99f, 8, false, false},
+    {0xff00, 0x3e00, {2, 2, 1}, 2.99f, 8, false, false},
+    {0xff00, 0x9b00, {2, 2, 1}, 2.99f, 8, false, false},
+    // Geminilake and Gen11 (Icelake) have two scalers on every pipe.
+    {0xffff, 0x3184, {2, 2, 2}, 2.99f, 8, false, false},
+    {0xffff, 0x3185, {2, 2, 2}, 2.99f, 8, false, false},
+    {0xfff0, 0x8a50, {2, 2, 2}, 2.99f, 8, false, false},
+};
+
+static const PlatformScalingLimits *GetPlatformScalingLimits(uint32_t gpu_fd,
+                                                             uint32_t pipe) {
+  if (pipe >= 3)
+    return NULL;
+
+  drmDevicePtr device = NULL;
+  if (drmGetDevice(gpu_fd, &device) || !device)
+    return NULL;
+
+  const PlatformScalingLimits *platform_limits = NULL;
+  if (device->bustype == DRM_BUS_PCI && device->deviceinfo.pci &&
+      device->deviceinfo.pci->vendor_id == 0x8086) {
+    uint16_t device_id = device->deviceinfo.pci->device_id;
+    for (const PlatformScalingLimits &entry : kPlatformScalingLimits) {
+      if ((device_id & entry.device_mask_) == entry.device_id_) {
+        platform_limits = &entry;
+        break;
+      }
+    }
+  }
+
+  drmFreeDevice(&device);
+  return platform_limits;
+}
+
+static void FillScalingLimits(const PlatformScalingLimits &platform_limits,
+                              uint32_t plane_type,
+                              PlaneScalingLimits *limits) {
+  if (plane_type == DRM_PLANE_TYPE_CURSOR &&
+      !platform_limits.cursor_scaling_) {
+    limits->scaling_ = false;
+    return;
+  }
+
+  limits->scaling_ = true;
+  limits->max_downscale_ = platform_limits.max_downscale_;
+  limits->min_size_ = platform_limits.min_size_;
+  if (!platform_limits.c8_scaling_)
+    limits->unscalable_formats_.emplace_back(DRM_FORMAT_C8);
+}
+
 bool DrmDisplay::PopulatePlanes(
     std::vector<std::unique_ptr<DisplayPlane>> &overlay_planes) {
   ScopedDrmPlaneResPtr plane_resources(drmModeGetPlaneResources(gpu_fd_));
@@ -654,6 +786,11 @@ bool DrmDisplay::PopulatePlanes(
     return false;
   }
 
+  // Planes of hardware without known limits are left to test commits.
+  const PlatformScalingLimits *platform_limits =
+      GetPlatformScalingLimits(gpu_fd_, pipe_);
+  max_scaled_planes_ =
+      platform_limits ? platform_limits->max_scaled_planes_[pipe_] : 0;
   uint32_t num_planes = plane_resources->count_planes;
   uint32_t pipe_bit = 1 << pipe_;
   std::set<uint32_t> plane_ids;
@@ -678,6 +815,12 @@ bool DrmDisplay::PopulatePlanes(
       supported_formats[j] = drm_plane->formats[j];
 
     if (plane->Initialize(gpu_fd_, supported_formats)) {
+      if (platform_limits) {
+        PlaneScalingLimits scaling_limits;
+        FillScalingLimits(*platform_limits, plane->type(), &scaling_limits);
+        plane->SetScalingLimits(scaling_limits);
+      }
+
       if (plane->type() == DRM_PLANE_TYPE_CURSOR) {
         cursor_plane.reset(plane.release());
       } else {
@@ -704,6 +847,10 @@ bool DrmDisplay::PopulatePlanes(
   return true;
 }
 
+uint32_t DrmDisplay::GetMaxScaledPlanes() const {
+  return max_scaled_planes_;
+}
+
 void DrmDisplay::ForceRefresh() {
   display_queue_->ForceRefresh();
 }
@@ -59,6 +59,8 @@ class DrmDisplay : public PhysicalDisplay {
   bool Commit(const DisplayPlaneStateList &composition_planes,
               const DisplayPlaneStateList &previous_composition_planes,
               bool disable_explicit_fence, int32_t *commit_fence) override;
+  bool CommitPlanePosition(const DisplayPlane *plane, int32_t x, int32_t y,
+                           int32_t *commit_fence) override;
 
   uint32_t CrtcId() const {
     return crtc_id_;
@@ -76,6 +78,8 @@ class DrmDisplay : public PhysicalDisplay {
   bool PopulatePlanes(
       std::vector<std::unique_ptr<DisplayPlane>> &overlay_planes) override;
 
+  uint32_t GetMaxScaledPlanes() const override;
+
   void NotifyClientsOfDisplayChangeStatus() override;
 
   void ForceRefresh();
@@ -122,12 +126,19 @@ class DrmDisplay : public PhysicalDisplay {
   uint32_t active_prop_ = 0;
   uint32_t mode_id_prop_ = 0;
   uint32_t connector_ = 0;
+  // 0 unless the hardware is known to limit scaled planes.
+  uint32_t max_scaled_planes_ = 0;
   uint64_t lut_size_ = 0;
   int64_t broadcastrgb_full_ = -1;
   int64_t broadcastrgb_automatic_ = -1;
   uint32_t flags_ = DRM_MODE_ATOMIC_ALLOW_MODESET;
   drmModeModeInfo current_mode_;
   std::vector<drmModeModeInfo> modes_;
+  // Property set re-used by every Commit.
+  ScopedDrmAtomicReqPtr commit_pset_;
+  // Property set used to only move a plane. Kept apart from commit_pset_
+  // as planes can be moved from outside of the thread doing commits.
+  ScopedDrmAtomicReqPtr position_pset_;
   SpinLock display_lock_;
   DrmDisplayManager *manager_;
 };
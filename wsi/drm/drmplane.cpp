@@ -170,9 +170,80 @@ bool DrmPlane::Initialize(uint32_t gpu_fd,
     in_fence_fd_prop_.id = 0;
   }
 
+  InitializeModifiers(gpu_fd, plane_props);
+
+  return true;
+}
+
+void DrmPlane::InitializeModifiers(
+    uint32_t gpu_fd, const ScopedDrmObjectPropertyPtr& plane_props) {
+#ifdef FORMAT_BLOB_CURRENT
+  uint32_t count_props = plane_props->count_props;
+  for (uint32_t i = 0; i < count_props; i++) {
+    ScopedDrmPropertyPtr property(
+        drmModeGetProperty(gpu_fd, plane_props->props[i]));
+    if (!property || strcmp(property->name, "IN_FORMATS"))
+      continue;
+
+    ScopedDrmPropertyBlobPtr blob(
+        drmModeGetPropertyBlob(gpu_fd, plane_props->prop_values[i]));
+    if (!blob || blob->length < sizeof(struct drm_format_modifier_blob))
+      return;
+
+    const uint8_t* data = static_cast<const uint8_t*>(blob->data);
+    const struct drm_format_modifier_blob* header =
+        reinterpret_cast<const struct drm_format_modifier_blob*>(data);
+    if (header->version != FORMAT_BLOB_CURRENT)
+      return;
+
+    const uint32_t* formats =
+        reinterpret_cast<const uint32_t*>(data + header->formats_offset);
+    const struct drm_format_modifier* modifiers =
+        reinterpret_cast<const struct drm_format_modifier*>(
+            data + header->modifiers_offset);
+    for (uint32_t j = 0; j < header->count_modifiers; j++) {
+      const struct drm_format_modifier& modifier = modifiers[j];
+      // Bit n of formats stands for format at offset + n.
+      for (uint32_t bit = 0; bit < 64; bit++) {
+        if (!(modifier.formats & (1ULL << bit)))
+          continue;
+
+        uint32_t index = modifier.offset + bit;
+        if (index >= header->count_formats)
+          break;
+
+        format_modifiers_[formats[index]].emplace_back(modifier.modifier);
+      }
+    }
+
+    return;
+  }
+#endif
+}
+
+bool DrmPlane::GetFormatModifiers(uint32_t format,
+                                  std::vector<uint64_t>* modifiers) const {
+  auto it = format_modifiers_.find(format);
+  if (it == format_modifiers_.end())
+    return false;
+
+  modifiers->insert(modifiers->end(), it->second.begin(), it->second.end());
   return true;
 }
 
+bool DrmPlane::IsSupportedModifier(uint32_t format, uint64_t modifier) const {
+  auto it = format_modifiers_.find(format);
+  if (it == format_modifiers_.end())
+    return false;
+
+  for (const uint64_t& supported : it->second) {
+    if (supported == modifier)
+      return true;
+  }
+
+  return false;
+}
+
 bool DrmPlane::UpdateProperties(drmModeAtomicReqPtr property_set,
                                 uint32_t crtc_id, const OverlayLayer* layer,
                                 bool test_commit) const {
@@ -268,6 +339,20 @@ bool DrmPlane::UpdateProperties(drmModeAtomicReqPtr property_set,
   return true;
 }
 
+bool DrmPlane::UpdatePosition(drmModeAtomicReqPtr property_set, int32_t x,
+                              int32_t y) const {
+  int success =
+      drmModeAtomicAddProperty(property_set, id_, crtc_x_prop_.id, x) < 0;
+  success |=
+      drmModeAtomicAddProperty(property_set, id_, crtc_y_prop_.id, y) < 0;
+  if (success) {
+    ETRACE("Could not update position for plane with id: %d", id_);
+    return false;
+  }
+
+  return true;
+}
+
 void DrmPlane::SetNativeFence(int32_t fd) {
   // Release any existing fence.
   if (kms_fence_ > 0) {
@@ -349,6 +434,14 @@ bool DrmPlane::ValidateLayer(const OverlayLayer* layer) {
     return false;
   }
 
+  uint64_t modifier = 0;
+  if (layer->GetBuffer()->GetModifier(&modifier) &&
+      !IsSupportedModifier(layer->GetBuffer()->GetFormat(), modifier)) {
+    IDISPLAYMANAGERTRACE(
+        "Layer cannot be supported as modifier is not supported.");
+    return false;
+  }
+
   return true;
 }
 
@@ -24,6 +24,7 @@
 
 #include <drmscopedtypes.h>
 
+#include <unordered_map>
 #include <vector>
 
 #include "displayplane.h"
@@ -45,6 +46,11 @@ class DrmPlane : public DisplayPlane {
                         const OverlayLayer* layer,
                         bool test_commit = false) const;
 
+  // Adds only CRTC_X/Y of this plane to property_set, moving whatever
+  // it shows without touching any other state.
+  bool UpdatePosition(drmModeAtomicReqPtr property_set, int32_t x,
+                      int32_t y) const;
+
   void SetNativeFence(int32_t fd);
 
   bool Disable(drmModeAtomicReqPtr property_set);
@@ -62,6 +68,9 @@ class DrmPlane : public DisplayPlane {
   uint32_t GetPreferredVideoFormat() const override;
   uint32_t GetPreferredFormat() const override;
 
+  bool GetFormatModifiers(uint32_t format,
+                          std::vector<uint64_t>* modifiers) const override;
+
   void Dump() const override;
 
   void SetInUse(bool in_use) override;
@@ -74,6 +83,19 @@ class DrmPlane : public DisplayPlane {
     return !(type_ == DRM_PLANE_TYPE_CURSOR);
   }
 
+  void SetScalingLimits(const PlaneScalingLimits& limits) {
+    scaling_limits_ = limits;
+    scaling_limits_known_ = true;
+  }
+
+  bool GetScalingLimits(PlaneScalingLimits* limits) const override {
+    if (!scaling_limits_known_)
+      return false;
+
+    *limits = scaling_limits_;
+    return true;
+  }
+
  private:
   struct Property {
     Property();
@@ -82,6 +104,12 @@ class DrmPlane : public DisplayPlane {
     uint32_t id = 0;
   };
 
+  // Reads formats and modifiers advertised by IN_FORMATS.
+  void InitializeModifiers(uint32_t gpu_fd,
+                           const ScopedDrmObjectPropertyPtr& plane_props);
+
+  bool IsSupportedModifier(uint32_t format, uint64_t modifier) const;
+
   Property crtc_prop_;
   Property fb_prop_;
   Property crtc_x_prop_;
@@ -106,9 +134,13 @@ class DrmPlane : public DisplayPlane {
   bool in_use_;
 
   std::vector<uint32_t> supported_formats_;
+  // Empty unless the kernel exposes IN_FORMATS.
+  std::unordered_map<uint32_t, std::vector<uint64_t>> format_modifiers_;
   int32_t kms_fence_ = 0;
   uint32_t prefered_video_format_ = 0;
   uint32_t prefered_format_ = 0;
+  PlaneScalingLimits scaling_limits_;
+  bool scaling_limits_known_ = false;
 };
 
 }  // namespace hwcomposer
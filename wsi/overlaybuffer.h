@@ -57,6 +57,9 @@ class OverlayBuffer {
 
   virtual uint32_t GetTotalPlanes() const = 0;
 
+  // Returns false if the buffer has no explicit layout modifier.
+  virtual bool GetModifier(uint64_t* modifier) const = 0;
+
   virtual const uint32_t* GetPitches() const = 0;
 
   virtual const uint32_t* GetOffsets() const = 0;
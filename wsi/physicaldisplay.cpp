@@ -26,9 +26,11 @@
 #include <string>
 #include <sstream>
 
+#include "clonepresentationhandler.h"
 #include "displayqueue.h"
 #include "displayplanemanager.h"
 #include "hwcutils.h"
+#include "overlaybuffer.h"
 #include "wsi_utils.h"
 
 namespace hwcomposer {
@@ -326,15 +328,80 @@ bool PhysicalDisplay::PresentClone(std::vector<HwcLayer *> &source_layers,
   return success;
 }
 
+void PhysicalDisplay::StartClonePresentation(
+    std::vector<HwcLayer *> &source_layers) {
+  if (clones_started_ || clone_handlers_.empty())
+    return;
+
+  clones_started_ = true;
+  // Clones read layers from several threads at once, make sure no
+  // acquire fence is left for them to take.
+  size_t size = source_layers.size();
+  for (size_t layer_index = 0; layer_index < size; layer_index++) {
+    int32_t fence = source_layers.at(layer_index)->GetAcquireFence();
+    if (fence > 0) {
+      HWCPoll(fence, -1);
+      close(fence);
+    }
+  }
+
+  bool idle_frame = display_queue_->WasLastFrameIdleUpdate();
+  for (auto &handler : clone_handlers_) {
+    handler->Present(&source_layers, idle_frame);
+  }
+}
+
+void PhysicalDisplay::TakeCloneReleaseFences(std::vector<int32_t> *fences) {
+  display_queue_->TakeCloneReleaseFences(fences);
+}
+
 void PhysicalDisplay::HandleClonedDisplays(
     std::vector<HwcLayer *> &source_layers) {
   if (clones_.empty())
     return;
 
-  int32_t fence = -1;
+  if (clone_handlers_.empty()) {
+    int32_t fence = -1;
+    for (auto display : clones_) {
+      display->PresentClone(source_layers, &fence,
+                            display_queue_->WasLastFrameIdleUpdate());
+    }
+  } else {
+    StartClonePresentation(source_layers);
+    // Clones read source_layers, so all of them need to be done
+    // before we hand the layers back to the client.
+    for (auto &handler : clone_handlers_) {
+      handler->Wait();
+    }
+
+    clones_started_ = false;
+  }
+
+  // Layers can be released only once clones are done with them too.
+  std::vector<int32_t> fences;
   for (auto display : clones_) {
-    display->PresentClone(source_layers, &fence,
-                          display_queue_->WasLastFrameIdleUpdate());
+    display->TakeCloneReleaseFences(&fences);
+  }
+
+  // Clone of a clone, let our source display merge these too.
+  if (source_display_) {
+    display_queue_->MergeCloneReleaseFences(fences);
+    return;
+  }
+
+  size_t size = fences.size();
+  for (size_t layer_index = 0; layer_index < size; layer_index++) {
+    int32_t fence = fences.at(layer_index);
+    if (fence <= 0)
+      continue;
+
+    if (layer_index >= source_layers.size()) {
+      close(fence);
+      continue;
+    }
+
+    HwcLayer *layer = source_layers.at(layer_index);
+    layer->SetReleaseFence(HWCMergeFences(layer->GetReleaseFence(), fence));
   }
 }
 
@@ -384,6 +451,11 @@ bool PhysicalDisplay::CheckPlaneFormat(uint32_t format) {
   return display_queue_->CheckPlaneFormat(format);
 }
 
+uint32_t PhysicalDisplay::GetFrameTimings(HwcFrameTiming *timings,
+                                          uint32_t max_frames) {
+  return display_queue_->GetFrameTimings(timings, max_frames);
+}
+
 void PhysicalDisplay::SetGamma(float red, float green, float blue) {
   display_queue_->SetGamma(red, green, blue);
 }
@@ -430,6 +502,13 @@ bool PhysicalDisplay::TestCommit(
   return false;
 }
 
+bool PhysicalDisplay::CreateFrameBuffer(OverlayBuffer *buffer) const {
+  if (buffer->GetFb() != 0)
+    return true;
+
+  return buffer->CreateFrameBuffer(gpu_fd_);
+}
+
 void PhysicalDisplay::UpdateScalingRatio(uint32_t primary_width,
                                          uint32_t primary_height,
                                          uint32_t display_width,
@@ -483,11 +562,49 @@ void PhysicalDisplay::RotateDisplay(HWCRotation rotation) {
   display_queue_->RotateDisplay(rotation);
 }
 
+void PhysicalDisplay::SetPresentTraceFile(const char *file) {
+  display_queue_->SetPresentTraceFile(file);
+}
+
+void PhysicalDisplay::SetPlaneAssignment(HWCPlaneAssignment assignment) {
+  display_queue_->SetPlaneAssignment(assignment);
+}
+
+void PhysicalDisplay::SetOffScreenTargetBudget(uint64_t budget, bool shared) {
+  display_queue_->SetOffScreenTargetBudget(budget, shared);
+}
+
+void PhysicalDisplay::SetPlacementHysteresis(uint32_t frames,
+                                             uint32_t margin) {
+  display_queue_->SetPlacementHysteresis(frames, margin);
+}
+
+bool PhysicalDisplay::MoveCursor(int32_t x, int32_t y) {
+  SPIN_LOCK(modeset_lock_);
+  // Clones show the cursor of this display and need a full update.
+  bool can_move = (display_state_ & kUpdateDisplay) && !source_display_ &&
+                  clones_.empty();
+  SPIN_UNLOCK(modeset_lock_);
+  if (!can_move)
+    return false;
+
+  return display_queue_->MoveCursor(x, y);
+}
+
+void PhysicalDisplay::SetParallelClonePresentation(bool enable) {
+  SPIN_LOCK(modeset_lock_);
+  parallel_clones_ = enable;
+  display_state_ |= kRefreshClonedDisplays;
+  SPIN_UNLOCK(modeset_lock_);
+}
+
 void PhysicalDisplay::RefreshClones() {
   display_state_ &= ~kRefreshClonedDisplays;
   std::vector<NativeDisplay *>().swap(clones_);
-  if (cloned_displays_.empty())
+  if (cloned_displays_.empty()) {
+    RefreshCloneHandlers();
     return;
+  }
 
   size_t size = cloned_displays_.size();
   for (size_t i = 0; i < size; i++) {
@@ -498,6 +615,8 @@ void PhysicalDisplay::RefreshClones() {
     clones_.emplace_back(display);
   }
 
+  RefreshCloneHandlers();
+
   uint32_t primary_width = Width();
   uint32_t primary_height = Height();
   for (auto display : clones_) {
@@ -511,6 +630,33 @@ void PhysicalDisplay::RefreshClones() {
   }
 }
 
+void PhysicalDisplay::RefreshCloneHandlers() {
+  std::vector<std::unique_ptr<ClonePresentationHandler>> handlers;
+  if (parallel_clones_) {
+    for (auto display : clones_) {
+      std::unique_ptr<ClonePresentationHandler> handler;
+      // Re-use threads of clones we were already presenting.
+      for (auto &old_handler : clone_handlers_) {
+        if (old_handler && old_handler->GetDisplay() == display) {
+          handler = std::move(old_handler);
+          break;
+        }
+      }
+
+      if (!handler) {
+        handler.reset(new ClonePresentationHandler(display));
+        if (!handler->Initialize()) {
+          ETRACE("Failed to initialize clone presentation handler.");
+        }
+      }
+
+      handlers.emplace_back(std::move(handler));
+    }
+  }
+
+  clone_handlers_.swap(handlers);
+}
+
 bool PhysicalDisplay::GetDisplayAttribute(uint32_t /*config*/,
                                           HWCDisplayAttribute attribute,
                                           int32_t *value) {
@@ -34,6 +34,7 @@ namespace hwcomposer {
 class DisplayPlaneState;
 class DisplayPlaneManager;
 class DisplayQueue;
+class ClonePresentationHandler;
 class NativeBufferHandler;
 class GpuDevice;
 struct HwcLayer;
@@ -89,6 +90,9 @@ class PhysicalDisplay : public NativeDisplay, public DisplayPlaneHandler {
                      float* value, float* start, float* end) override;
   void RestoreVideoDefaultColor(HWCColorControl color)override;
 
+  uint32_t GetFrameTimings(HwcFrameTiming *timings,
+                           uint32_t max_frames) override;
+
   void Connect() override;
 
   bool IsConnected() const override;
@@ -96,6 +100,8 @@ class PhysicalDisplay : public NativeDisplay, public DisplayPlaneHandler {
   bool TestCommit(
       const std::vector<OverlayPlane> &commit_planes) const override;
 
+  bool CreateFrameBuffer(OverlayBuffer *buffer) const override;
+
   bool PopulatePlanes(
       std::vector<std::unique_ptr<DisplayPlane>> &overlay_planes) override;
 
@@ -108,6 +114,8 @@ class PhysicalDisplay : public NativeDisplay, public DisplayPlaneHandler {
   bool PresentClone(std::vector<HwcLayer *> &source_layers,
                     int32_t *retire_fence, bool idle_frame) override;
 
+  void TakeCloneReleaseFences(std::vector<int32_t> *fences) override;
+
   bool GetDisplayAttribute(uint32_t /*config*/, HWCDisplayAttribute attribute,
                            int32_t *value) override;
 
@@ -122,6 +130,26 @@ class PhysicalDisplay : public NativeDisplay, public DisplayPlaneHandler {
 
   void RotateDisplay(HWCRotation rotation) override;
 
+  void SetPresentTraceFile(const char *file) override;
+
+  void SetParallelClonePresentation(bool enable) override;
+
+  void SetPlaneAssignment(HWCPlaneAssignment assignment) override;
+
+  void SetOffScreenTargetBudget(uint64_t budget, bool shared) override;
+
+  void SetPlacementHysteresis(uint32_t frames, uint32_t margin) override;
+
+  bool MoveCursor(int32_t x, int32_t y) override;
+
+  /**
+  * API for starting presentation of source_layers on clones of
+  * this display, once this display has committed them. Clones
+  * are presented concurrently when parallel clone presentation
+  * is enabled and this returns without waiting for them.
+  */
+  void StartClonePresentation(std::vector<HwcLayer *> &source_layers);
+
   /**
   * API for setting color correction for display.
   */
@@ -153,6 +181,22 @@ class PhysicalDisplay : public NativeDisplay, public DisplayPlaneHandler {
                       const DisplayPlaneStateList &previous_composition_planes,
                       bool disable_explicit_fence, int32_t *commit_fence) = 0;
 
+  /**
+  * API for moving plane to x, y without changing anything else on
+  * display. Used when only the cursor moved since last commit.
+  * @param plane plane to be moved, enabled by last commit.
+  * @param commit_fence hardware fence associated with this commit request,
+  *        -1 if none.
+  * Returns false if this is not supported or the commit failed, in which
+  * case a full commit is needed.
+  */
+  virtual bool CommitPlanePosition(const DisplayPlane * /*plane*/,
+                                   int32_t /*x*/, int32_t /*y*/,
+                                   int32_t *commit_fence) {
+    *commit_fence = -1;
+    return false;
+  }
+
   /**
   * API is called if current active display configuration has changed.
   * Implementations need to reset any state in this case.
@@ -206,6 +250,7 @@ class PhysicalDisplay : public NativeDisplay, public DisplayPlaneHandler {
  private:
   bool UpdatePowerMode();
   void RefreshClones();
+  void RefreshCloneHandlers();
   void HandleClonedDisplays(std::vector<HwcLayer *> &source_layers);
 
  protected:
@@ -251,6 +296,10 @@ class PhysicalDisplay : public NativeDisplay, public DisplayPlaneHandler {
   NativeDisplay *source_display_ = NULL;
   std::vector<NativeDisplay *> cloned_displays_;
   std::vector<NativeDisplay *> clones_;
+  // One per entry of clones_ when clones are presented in parallel.
+  std::vector<std::unique_ptr<ClonePresentationHandler>> clone_handlers_;
+  bool parallel_clones_ = true;
+  bool clones_started_ = false;
 };
 
 }  // namespace hwcomposer